@@ -20,13 +20,25 @@
 #define BATTERY_CHARACTERISTIC_UUID "a20a1ce0-5f2e-4230-88fe-05eb329dc545"
 #define RAW_PPG_CHARACTERISTIC_UUID "4aa76196-2777-4205-8260-8e3274beb327"
 #define RECORDING_CONTROL_CHARACTERISTIC_UUID "684c8f42-a60c-431c-b8ed-251e966d6a9a"
+#define DIAGNOSTICS_CHARACTERISTIC_UUID "5d0b8a4e-3c71-4f2a-9e62-1b7d4c8f0a93"
+#define DIAGNOSTICS_SIZE 26
+#define DIAGNOSTICS_PACKET_SIZE 18  // Packet counters only (default MTU notifications)
+#define TIME_SYNC_CHARACTERISTIC_UUID "c3f1e2d4-7a58-4b6e-8d19-2f4a6b8c0e17"
+#define TIME_SYNC_REQUEST_SIZE 8
+#define TIME_SYNC_REPLY_SIZE 12
 
 // ============================================================================
 // Static Member Initialization
 // ============================================================================
 
 void (*BluetoothManager::userConnectionCallback)(void) = nullptr;
-bool BluetoothManager::connected = false;
+void (*BluetoothManager::wakeCallback)(void) = nullptr;
+volatile bool BluetoothManager::connected = false;
+volatile uint32_t BluetoothManager::connectionCount = 0;
+uint16_t BluetoothManager::connectionHandle = BLE_CONN_HANDLE_INVALID;
+volatile uint32_t BluetoothManager::txCompletions = 0;
+std::atomic<uint32_t> BluetoothManager::notificationsSent(0);
+volatile uint32_t BluetoothManager::notificationsLost = 0;
 BLECharacteristic rawPpgCharacteristic;  // Global for callback access
 
 BluetoothManager* BluetoothManager::instance = nullptr;
@@ -39,6 +51,18 @@ PowerManager* BluetoothManager::powerManager = nullptr;
 
 void BluetoothManager::begin(const char* devicePrefix, const char* deviceNumber) {
     instance = this;  // Store instance for static callback access
+    streaming = false;
+    memset(&txStats, 0, sizeof(txStats));
+    txCompletionsSeen = 0;
+    txRetryPending = false;
+    txFailTime = 0;
+    lastDiagnostics = 0;
+    txConnection = 0;
+    linkConnection = 0;
+
+    // Allow ATT MTU 247, LE Data Length Extension and longer connection
+    // events (must be configured before Bluefruit.begin())
+    Bluefruit.configPrphBandwidth(BANDWIDTH_MAX);
 
     // Initialize Bluefruit BLE stack
     Bluefruit.begin();
@@ -72,6 +96,9 @@ void BluetoothManager::begin(const char* devicePrefix, const char* deviceNumber)
     // -------------------------------------------------------------------------
     Bluefruit.Periph.setConnectCallback(connectCallback);
     Bluefruit.Periph.setDisconnectCallback(disconnectCallback);
+    
+    // Notification TX-complete events drive the raw PPG transmit queue
+    Bluefruit.setEventCallback(eventCallback);
 
     // -------------------------------------------------------------------------
     // Setup HRV Metrics Characteristic (notify only)
@@ -80,7 +107,7 @@ void BluetoothManager::begin(const char* devicePrefix, const char* deviceNumber)
     hrvCharacteristic = BLECharacteristic(METRIC_CHARACTERISTIC_UUID);
     hrvCharacteristic.setProperties(CHR_PROPS_NOTIFY);
     hrvCharacteristic.setPermission(SECMODE_OPEN, SECMODE_NO_ACCESS);
-    hrvCharacteristic.setFixedLen(128);  // Fixed length for metric data
+    hrvCharacteristic.setFixedLen(BLE_HRV_SIZE);  // Fits the default 20-byte notification
     hrvCharacteristic.begin();
 
     // -------------------------------------------------------------------------
@@ -100,7 +127,7 @@ void BluetoothManager::begin(const char* devicePrefix, const char* deviceNumber)
     rawPpgCharacteristic = BLECharacteristic(RAW_PPG_CHARACTERISTIC_UUID);
     rawPpgCharacteristic.setProperties(CHR_PROPS_NOTIFY);
     rawPpgCharacteristic.setPermission(SECMODE_OPEN, SECMODE_NO_ACCESS);
-    rawPpgCharacteristic.setFixedLen(20);  // MTU-optimized packet size
+    rawPpgCharacteristic.setMaxLen(BLE_NOTIFY_MAX_SIZE);  // Variable length, up to MTU - 3
     rawPpgCharacteristic.begin();
 
     // -------------------------------------------------------------------------
@@ -113,6 +140,29 @@ void BluetoothManager::begin(const char* devicePrefix, const char* deviceNumber)
     recControlCharacteristic.setPermission(SECMODE_OPEN, SECMODE_OPEN);
     recControlCharacteristic.setWriteCallback(recordingStartCallback);
     recControlCharacteristic.begin();
+
+    // -------------------------------------------------------------------------
+    // Setup TX Diagnostics Characteristic (read + notify)
+    // -------------------------------------------------------------------------
+    // Raw PPG transmit queue counters, so the app can tell dropped packets
+    // from gaps in the signal (layout in BluetoothManager.h)
+    diagnosticsCharacteristic = BLECharacteristic(DIAGNOSTICS_CHARACTERISTIC_UUID);
+    diagnosticsCharacteristic.setProperties(CHR_PROPS_READ | CHR_PROPS_NOTIFY);
+    diagnosticsCharacteristic.setPermission(SECMODE_OPEN, SECMODE_NO_ACCESS);
+    diagnosticsCharacteristic.setMaxLen(DIAGNOSTICS_SIZE);
+    diagnosticsCharacteristic.begin();
+
+    // -------------------------------------------------------------------------
+    // Setup Time Sync Characteristic (read + write + notify)
+    // -------------------------------------------------------------------------
+    // Maps packet timestamps (device millis()) to the phone's clock
+    // App writes its time (8 bytes); the reply adds the device time
+    timeSyncCharacteristic = BLECharacteristic(TIME_SYNC_CHARACTERISTIC_UUID);
+    timeSyncCharacteristic.setProperties(CHR_PROPS_READ | CHR_PROPS_WRITE | CHR_PROPS_NOTIFY);
+    timeSyncCharacteristic.setPermission(SECMODE_OPEN, SECMODE_OPEN);
+    timeSyncCharacteristic.setMaxLen(TIME_SYNC_REPLY_SIZE);
+    timeSyncCharacteristic.setWriteCallback(timeSyncCallback);
+    timeSyncCharacteristic.begin();
 }
 
 // ============================================================================
@@ -146,26 +196,172 @@ void BluetoothManager::startAdvertising() {
 // Data Transmission Functions
 // ============================================================================
 
-void BluetoothManager::sendHrvMetrics(const char* data, int length) {
+void BluetoothManager::sendHrvMetrics(const uint8_t* data, int length) {
     if (Bluefruit.connected()) {
-        hrvCharacteristic.notify((uint8_t*)data, length);
+        sendNotification(hrvCharacteristic, data, length);
         Serial.println("HRV metrics transmitted");
     }
 }
 
-void BluetoothManager::sendRawPpgData(const uint8_t* data, size_t length) {
-    if (Bluefruit.connected()) {
-        rawPpgCharacteristic.notify(data, length);
-        // Note: Avoid excessive Serial prints during high-frequency data streaming
+bool BluetoothManager::sendRawPpgData(const uint8_t* data, size_t length, uint8_t samples) {
+    syncTxConnection();
+    
+    // Nobody to send to
+    if (!Bluefruit.connected() || !rawPpgCharacteristic.notifyEnabled()) {
+        return true;
+    }
+    
+    // notify() would split a longer packet over several notifications,
+    // which the app cannot reassemble
+    BLETxPacket* slot;
+    if (length > getRawPpgPacketSize() || txQueue.prepare(&slot) == 0) {
+        txStats.dropped++;
+        txStats.samplesDropped += samples;
+        Serial.println("WARNING: PPG packet dropped (queue full or exceeds MTU)");
+        return false;
+    }
+    slot->length = length;
+    slot->samples = samples;
+    memcpy(slot->data, data, length);
+    txQueue.commit(1);
+    txStats.queued++;
+    if (txQueue.size() > txStats.highWater) {
+        txStats.highWater = txQueue.size();
+    }
+    
+    pumpTxQueue();
+    // Note: Avoid excessive Serial prints during high-frequency data streaming
+    return true;
+}
+
+bool BluetoothManager::canQueueRawPpgData() {
+    syncTxConnection();
+    return txQueue.freeSpace() > 0 || !Bluefruit.connected() || !rawPpgCharacteristic.notifyEnabled();
+}
+
+bool BluetoothManager::serviceTx() {
+    syncTxConnection();
+    if (txConnection == 0) {
+        return false;
+    }
+    
+    pumpTxQueue();
+    if (millis() - lastDiagnostics >= BLE_DIAG_INTERVAL) {
+        lastDiagnostics = millis();
+        updateDiagnostics();
+    }
+    return !txQueue.empty();
+}
+
+void BluetoothManager::syncTxConnection() {
+    // Connects and disconnects arrive in the BLE task; the queue's owner
+    // notices them here
+    uint32_t connection = getConnectionId();
+    if (connection == txConnection) {
+        return;
+    }
+    
+    // Packets still queued can no longer be delivered
+    const BLETxPacket* packet;
+    while (txQueue.peek(&packet) > 0) {
+        txStats.dropped++;
+        txStats.samplesDropped += packet->samples;
+        txQueue.consume(1);
+    }
+    txRetryPending = false;
+    txCompletionsSeen = txCompletions;
+    if (connection != 0) {
+        // Fresh transmit counters for every connection
+        memset(&txStats, 0, sizeof(txStats));
+        lastDiagnostics = millis();
+    }
+    txConnection = connection;
+}
+
+void BluetoothManager::pumpTxQueue() {
+    // Notifications of every characteristic the SoftDevice still holds
+    // (completions first: one that arrives meanwhile only overestimates)
+    uint32_t completions = txCompletions;
+    int32_t inFlight = (int32_t)(notificationsSent - completions - notificationsLost);
+    bool completed = completions != txCompletionsSeen;
+    txCompletionsSeen = completions;
+    
+    // After a failed notify(), wait for a TX-complete event (or the retry time)
+    if (txRetryPending && !completed && millis() - txFailTime < BLE_TX_RETRY_MS) {
+        return;
+    }
+    txRetryPending = false;
+    
+    const BLETxPacket* packet;
+    while (inFlight < BLE_TX_IN_FLIGHT && txQueue.peek(&packet) > 0) {
+        if (!sendNotification(rawPpgCharacteristic, packet->data, packet->length)) {
+            // Buffers taken meanwhile (another task notified): keep it queued
+            txStats.retried++;
+            txRetryPending = true;
+            txFailTime = millis();
+            break;
+        }
+        txQueue.consume(1);
+        inFlight++;
+        txStats.sent++;
     }
 }
 
+bool BluetoothManager::sendNotification(BLECharacteristic& characteristic, const void* data, uint16_t length) {
+    if (!characteristic.notify(data, length)) {
+        return false;
+    }
+    notificationsSent++;
+    return true;
+}
+
+void BluetoothManager::updateDiagnostics() {
+    txStats.depth = txQueue.size();
+    
+    uint8_t payload[DIAGNOSTICS_SIZE];
+    const uint32_t counters[4] = {txStats.queued, txStats.sent, txStats.retried, txStats.dropped};
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 4; b++) {
+            payload[i * 4 + b] = (counters[i] >> (8 * b)) & 0xFF;
+        }
+    }
+    payload[16] = txStats.depth;
+    payload[17] = txStats.highWater;
+    const uint32_t samples[2] = {txStats.samplesLost, txStats.samplesDropped};
+    for (int i = 0; i < 2; i++) {
+        for (int b = 0; b < 4; b++) {
+            payload[18 + i * 4 + b] = (samples[i] >> (8 * b)) & 0xFF;
+        }
+    }
+    
+    // One notification on any MTU; notify() also sets the value, so the
+    // whole payload is written after it
+    if (diagnosticsCharacteristic.notifyEnabled()) {
+        bool fits = getRawPpgPacketSize() >= DIAGNOSTICS_SIZE;
+        sendNotification(diagnosticsCharacteristic, payload, fits ? DIAGNOSTICS_SIZE : DIAGNOSTICS_PACKET_SIZE);
+    }
+    diagnosticsCharacteristic.write(payload, sizeof(payload));
+}
+
+uint16_t BluetoothManager::getRawPpgPacketSize() {
+    // Read per call: the central may start its own MTU exchange at any time
+    BLEConnection* connection = Bluefruit.Connection(connectionHandle);
+    if (!connected || connection == nullptr) {
+        return BLE_NOTIFY_DEFAULT_SIZE;
+    }
+    uint16_t size = connection->getMtu() - BLE_ATT_HEADER_SIZE;
+    if (size < BLE_NOTIFY_DEFAULT_SIZE) {
+        return BLE_NOTIFY_DEFAULT_SIZE;
+    }
+    return size < BLE_NOTIFY_MAX_SIZE ? size : BLE_NOTIFY_MAX_SIZE;
+}
+
 void BluetoothManager::updateBatteryStatus(char status) {
     if (Bluefruit.connected()) {
         uint8_t statusByte = static_cast<uint8_t>(status);
         Serial.print("Transmitting battery status: ");
         Serial.println(status);
-        batteryStatusCharacteristic.notify(&statusByte, sizeof(statusByte));
+        sendNotification(batteryStatusCharacteristic, &statusByte, sizeof(statusByte));
     }
 }
 
@@ -184,6 +380,47 @@ void BluetoothManager::stopAdvertising() {
     }
 }
 
+// ============================================================================
+// Connection Parameter Policy
+// ============================================================================
+
+void BluetoothManager::update() {
+    // Connects and disconnects arrive in the BLE task; the policy only runs
+    // here, and looks the connection up by handle on every call. A
+    // disconnect and reconnect between two calls still ends the old one.
+    uint32_t connection = getConnectionId();
+    if (linkPolicy.isActive() && connection != linkConnection) {
+        linkPolicy.end();
+        
+        // Nobody to stream to: end the recording (the BLE stage drops and
+        // counts the samples it still holds, see PPGManager::dropStaleSamples())
+        if (ppgManager != nullptr && ppgManager->isRecording()) {
+            Serial.println("Connection lost - stopping recording");
+            ppgManager->stopRealTimePPGRecording();
+        }
+    }
+    if (connection != 0 && !linkPolicy.isActive()) {
+        linkPolicy.begin(connectionHandle, streaming ? BLE_LINK_STREAMING : BLE_LINK_IDLE);
+        linkConnection = connection;
+    }
+    if (linkPolicy.isActive()) {
+        linkPolicy.setMode(streaming ? BLE_LINK_STREAMING : BLE_LINK_IDLE);
+        linkPolicy.update();
+    }
+}
+
+void BluetoothManager::setStreaming(bool streaming) {
+    this->streaming = streaming;
+}
+
+BLELinkParams BluetoothManager::getLinkParams() {
+    BLELinkParams params = linkPolicy.granted();
+    if (!linkPolicy.isActive()) {
+        memset(&params, 0, sizeof(params));
+    }
+    return params;
+}
+
 // ============================================================================
 // Manager Linking Functions
 // ============================================================================
@@ -204,19 +441,47 @@ bool BluetoothManager::isConnected() {
     return connected;
 }
 
+uint32_t BluetoothManager::getConnectionId() {
+    return connected ? connectionCount : 0;
+}
+
 void BluetoothManager::setConnectionCallback(void (*callback)(void)) {
     userConnectionCallback = callback;
 }
 
+void BluetoothManager::setWakeCallback(void (*callback)(void)) {
+    wakeCallback = callback;
+}
+
+void BluetoothManager::wakeLoop() {
+    if (wakeCallback) {
+        wakeCallback();
+    }
+}
+
 // ============================================================================
 // Static Callback: BLE Connection Event
 // ============================================================================
 
 void BluetoothManager::connectCallback(uint16_t conn_handle) {
     if (instance) {
+        // Notifications still counted in flight went down with the last link
+        notificationsLost = notificationsSent - txCompletions;
+        connectionCount = connectionCount + 1;
         instance->connected = true;
+        connectionHandle = conn_handle;
         Serial.println("BLE Device Connected");
 
+        // Ask for larger packets; old centrals reject or ignore this and
+        // stay at 20-byte notifications
+        BLEConnection* connection = Bluefruit.Connection(conn_handle);
+        if (connection) {
+            connection->requestDataLengthUpdate();
+            connection->requestMtuExchange(BLE_ATT_MTU_MAX);
+            Serial.print("ATT MTU: ");
+            Serial.println(connection->getMtu());
+        }
+
         // Read and transmit current battery status to newly connected device
         if (instance->powerManager) {
             instance->powerManager->readAndSaveBatteryStatus();
@@ -227,6 +492,7 @@ void BluetoothManager::connectCallback(uint16_t conn_handle) {
         if (userConnectionCallback) {
             userConnectionCallback();
         }
+        wakeLoop();
     }
 }
 
@@ -236,10 +502,45 @@ void BluetoothManager::connectCallback(uint16_t conn_handle) {
 
 void BluetoothManager::disconnectCallback(uint16_t conn_handle, uint8_t reason) {
     connected = false;
+    connectionHandle = BLE_CONN_HANDLE_INVALID;
     Serial.print("BLE Device Disconnected, reason: ");
     Serial.println(reason, HEX);
     
     // Note: Advertising will auto-restart if restartOnDisconnect is enabled
+    wakeLoop();
+}
+
+// ============================================================================
+// Static Callback: BLE Stack Events
+// ============================================================================
+
+void BluetoothManager::eventCallback(ble_evt_t* event) {
+    // Runs in the BLE task: only count, serviceTx() sends the next packets
+    if (event->header.evt_id == BLE_GATTS_EVT_HVN_TX_COMPLETE) {
+        txCompletions = txCompletions + event->evt.gatts_evt.params.hvn_tx_complete.count;
+        wakeLoop();
+    }
+}
+
+// ============================================================================
+// Static Callback: Time Sync Characteristic Write
+// ============================================================================
+
+void BluetoothManager::timeSyncCallback(uint16_t conn_hdl, BLECharacteristic *chr, uint8_t *data, uint16_t len) {
+    // Stamp first: the reply's accuracy is bounded by the time taken here
+    uint32_t deviceTime = millis();
+    if (len != TIME_SYNC_REQUEST_SIZE || instance == nullptr) {
+        Serial.println("Invalid time sync data received");
+        return;
+    }
+    
+    uint8_t reply[TIME_SYNC_REPLY_SIZE];
+    memcpy(reply, data, TIME_SYNC_REQUEST_SIZE);
+    for (int b = 0; b < 4; b++) {
+        reply[TIME_SYNC_REQUEST_SIZE + b] = (deviceTime >> (8 * b)) & 0xFF;
+    }
+    instance->timeSyncCharacteristic.write(reply, sizeof(reply));
+    sendNotification(instance->timeSyncCharacteristic, reply, sizeof(reply));
 }
 
 // ============================================================================
@@ -264,4 +565,5 @@ void BluetoothManager::recordingStartCallback(uint16_t conn_hdl, BLECharacterist
     } else {
         Serial.println("Invalid recording control data received");
     }
+    wakeLoop();
 }
@@ -13,16 +13,97 @@
  * BLE SERVICE STRUCTURE:
  * - Custom Service UUID: 2ef946af-49fc-43f4-95c1-882a483f0a76
  *   - Raw PPG Data Characteristic (notify): 4aa76196-2777-4205-8260-8e3274beb327
+ *     (variable length, up to the negotiated ATT MTU - 3)
  *   - HRV Metrics Characteristic (notify): 8881ab16-7694-4891-aebe-b0b11c6549d4
+ *     (BLE_HRV_SIZE bytes, see HRV METRICS)
  *   - Battery Status Characteristic (notify): a20a1ce0-5f2e-4230-88fe-05eb329dc545
  *   - Recording Control Characteristic (write): 684c8f42-a60c-431c-b8ed-251e966d6a9a
+ *   - TX Diagnostics Characteristic (read, notify): 5d0b8a4e-3c71-4f2a-9e62-1b7d4c8f0a93
+ *     (BLETxStats, see TRANSMIT QUEUE)
+ *   - Time Sync Characteristic (read, write, notify): c3f1e2d4-7a58-4b6e-8d19-2f4a6b8c0e17
+ * 
+ * PACKET SIZE:
+ * A notification carries at most ATT MTU - 3 bytes: 20 with the default
+ * MTU of 23. The peripheral is configured for the largest MTU (247) and
+ * LE Data Length Extension, and requests both on connect; centrals that
+ * support them (most phones) then take 244-byte raw PPG notifications, so
+ * the same data needs ~12x fewer notifications and connection events.
+ * getRawPpgPacketSize() reports the current limit (20 for old centrals).
+ * 
+ * CONNECTION PARAMETERS:
+ * update() (called from loop()) runs BLELinkPolicy (bleLinkPolicy.h): a
+ * short interval and the 2M PHY while PPG data streams (setStreaming()),
+ * a long interval with slave latency while connected but idle. The
+ * parameters the central actually granted are reported on Serial and by
+ * getLinkParams().
+ * 
+ * TRANSMIT QUEUE:
+ * notify() fails when the SoftDevice's notification buffers are full, and
+ * the packet used to be lost without a trace. Raw PPG packets now go
+ * through a bounded queue (BLE_TX_QUEUE_SIZE packets):
+ * - The queue belongs to one task: the one that calls sendRawPpgData()
+ *   (PPGManager's BLE stage), which also calls serviceTx()
+ * - At most BLE_TX_IN_FLIGHT notifications are handed to the SoftDevice.
+ *   Every characteristic notifies through sendNotification(), which
+ *   counts them, so HVN_TX_COMPLETE events (counted in the BLE task) are
+ *   matched against all of them; as they free buffers, serviceTx() sends
+ *   the next packets
+ * - A failed notify() leaves the packet queued; it is retried after the
+ *   next TX-complete event (or BLE_TX_RETRY_MS)
+ * - canQueueRawPpgData() is PPGManager's backpressure signal: while the
+ *   queue is full it holds packets back and stops draining the sensor
+ * - Packets still queued at a disconnect, or offered to a full queue,
+ *   are counted as dropped (serviceTx() notices the disconnect)
+ * - Samples are counted too, as a packet's samples are not all lost
+ *   alike: those that never reached PPGManager's BLE stage (sensor FIFO
+ *   overflow, processing or BLE stage behind) and those it had but could
+ *   not queue (batcher full, held at a disconnect) or whose packet was
+ *   dropped; the stage reports them with countLostSamples() /
+ *   countDroppedSamples()
+ * Counters are reset on connect and published on the diagnostics
+ * characteristic every BLE_DIAG_INTERVAL ms, as 26 bytes:
+ *   bytes 0-15   packets queued, sent, retried, dropped (uint32 LE)
+ *   byte 16      packets queued now
+ *   byte 17      most packets queued at once
+ *   bytes 18-25  samples lost before the BLE stage, samples dropped in
+ *                it (uint32 LE)
+ * Centrals on the default 23-byte MTU are notified of bytes 0-17 only
+ * (one notification); the read value is always whole.
+ * 
+ * HRV METRICS:
+ * While recording, PPGManager reports the rolling HRV window every
+ * HRV_REPORT_INTERVAL ms from its BLE stage, the task that owns the
+ * transmit queue, as BLE_HRV_SIZE (14) bytes, which fit the default
+ * 20-byte notification:
+ *   byte 0       format version (BLE_HRV_VERSION); receivers must reject
+ *                versions they do not know
+ *   byte 1       RR intervals in the window (saturates at 255)
+ *   bytes 2-13   HR (bpm), SDNN (ms), RMSSD (ms), pNN50 (%), SD1 (ms),
+ *                SD2 (ms): uint16 little-endian, x10, saturating at 65535
+ * 
+ * TIME SYNC:
+ * Raw PPG packets are stamped with the device's millis() (ppgPacket.h).
+ * To map that to wall-clock time, the app writes its clock T1 (8 bytes,
+ * e.g. uint64 ms since the Unix epoch, little-endian; echoed unchanged).
+ * The device replies with a notification (also the read value):
+ *   bytes 0-7    the 8 bytes written
+ *   bytes 8-11   device millis() when the write arrived (uint32 LE)
+ * With T2 the reply's arrival time, device time D happened at
+ * (T1 + T2) / 2, +/- (T2 - T1) / 2. The app keeps the sample with the
+ * shortest round trip out of a few, and repeats the sync now and then
+ * (the 32 kHz crystal drifts up to ~20 ppm, ~70 ms per hour). A packet's
+ * first sample is then at wall time (T1 + T2) / 2 +
+ * (PPGStreamTracker::unwrapFrom(timestamp, D) - D).
  * 
  * USAGE:
  * 1. Create instance: BluetoothManager bluetoothManager;
  * 2. Initialize: bluetoothManager.begin("W", "142");
  * 3. Set managers: setPowerManager() and setPPGManager()
  * 4. Start advertising: startAdvertising()
- * 5. Data automatically streams when connected
+ * 5. Call update() from loop() while in BLE mode, and serviceTx() from
+ *    the task that sends raw PPG data; an event-driven loop registers
+ *    setWakeCallback() to learn when either has work
+ * 6. Data automatically streams when connected
  * 
  * AUTHOR: Justin Laiti
  */
@@ -31,6 +112,44 @@
 #define BLUETOOTH_MANAGER_H
 
 #include <bluefruit.h>
+#include "bleLinkPolicy.h"
+#include "spscRing.h"
+#include <atomic>
+
+// ATT payload limits
+#define BLE_ATT_MTU_MAX 247                 // Largest ATT MTU requested (fits one LL packet with DLE)
+#define BLE_ATT_HEADER_SIZE 3               // Opcode + handle in every notification
+#define BLE_NOTIFY_DEFAULT_SIZE 20          // Default ATT MTU 23 - 3
+#define BLE_NOTIFY_MAX_SIZE (BLE_ATT_MTU_MAX - BLE_ATT_HEADER_SIZE)
+
+// Raw PPG transmit queue
+#define BLE_TX_QUEUE_SIZE 8                 // Packets (power of two)
+#define BLE_TX_IN_FLIGHT 3                  // SoftDevice notification queue with BANDWIDTH_MAX
+#define BLE_TX_RETRY_MS 50                  // Retry a failed notify() at least this often
+#define BLE_DIAG_INTERVAL 5000              // Diagnostics update period (ms)
+
+// HRV metrics notification (see HRV METRICS)
+#define BLE_HRV_VERSION 1
+#define BLE_HRV_SIZE 14
+
+// One queued raw PPG notification
+struct BLETxPacket {
+    uint8_t length;
+    uint8_t samples;                        // PPG samples it carries
+    uint8_t data[BLE_NOTIFY_MAX_SIZE];
+};
+
+// Transmit counters since the current connection started
+struct BLETxStats {
+    uint32_t queued;                        // Packets accepted into the queue
+    uint32_t sent;                          // Accepted by the SoftDevice
+    uint32_t retried;                       // notify() attempts that failed and were repeated
+    uint32_t dropped;                       // Queue full, or still queued at disconnect
+    uint32_t samplesLost;                   // Never reached the BLE stage (see TRANSMIT QUEUE)
+    uint32_t samplesDropped;                // Reached it, but not the central
+    uint8_t depth;                          // Packets queued now
+    uint8_t highWater;                      // Most packets queued at once
+};
 
 // Forward declarations to avoid circular dependencies
 class PPGManager;
@@ -49,11 +168,37 @@ public:
     // Stop BLE advertising and disconnect
     void stopAdvertising();
     
-    // Send HRV metrics to connected device
-    void sendHrvMetrics(const char* data, int length);
+    // Send HRV metrics to connected device (BLE_HRV_SIZE bytes, see HRV
+    // METRICS; same task as sendRawPpgData())
+    void sendHrvMetrics(const uint8_t* data, int length);
+    
+    // Queue raw PPG data samples for the connected device
+    // length must not exceed getRawPpgPacketSize() (one notification);
+    // samples: how many the packet carries (for the sample counters)
+    // Returns: false if the packet was dropped (queue full or too long)
+    bool sendRawPpgData(const uint8_t* data, size_t length, uint8_t samples);
+    
+    // True if sendRawPpgData() has room (always true when nobody listens)
+    bool canQueueRawPpgData();
     
-    // Send raw PPG data samples to connected device
-    void sendRawPpgData(const uint8_t* data, size_t length);
+    // Send queued raw PPG packets, drop those a lost connection left
+    // queued, and publish the diagnostics (same task as sendRawPpgData())
+    // Returns: true while packets are queued
+    bool serviceTx();
+    
+    // Samples of the recording that will not reach the central, counted
+    // by the BLE stage (same task as sendRawPpgData()): lost before it,
+    // or dropped in it before they were queued
+    void countLostSamples(uint32_t samples) { txStats.samplesLost += samples; }
+    void countDroppedSamples(uint32_t samples) { txStats.samplesDropped += samples; }
+    
+    // Transmit counters for the current connection (read from the task
+    // that sends, or once it is idle)
+    BLETxStats getTxStats() const { return txStats; }
+    
+    // Largest raw PPG notification on the current connection (bytes):
+    // negotiated ATT MTU - 3, or BLE_NOTIFY_DEFAULT_SIZE if not connected
+    uint16_t getRawPpgPacketSize();
     
     // Update and transmit battery status
     void updateBatteryStatus(const char status);
@@ -61,12 +206,30 @@ public:
     // Check if device is currently connected to mobile app
     bool isConnected();
     
+    // Different for every connection; 0 while not connected
+    uint32_t getConnectionId();
+    
+    // Apply the connection parameter / PHY policy (call from loop())
+    void update();
+    
+    // Select the streaming or idle link preset (applied by update())
+    void setStreaming(bool streaming);
+    
+    // Connection parameters granted by the central (zero if not connected)
+    BLELinkParams getLinkParams();
+    
     // Check if BLE advertising is active
     bool isAdvertising();
     
     // Register callback function to execute on connection
     void setConnectionCallback(void (*callback)(void));
     
+    // Register a callback run from the BLE task whenever update() or
+    // serviceTx() has work: connect, disconnect, recording control write,
+    // notifications sent
+    // (keep it short, e.g. EventScheduler::post())
+    void setWakeCallback(void (*callback)(void));
+    
     // Link PowerManager for battery status updates
     void setPowerManager(PowerManager& powerMgr);
     
@@ -79,17 +242,57 @@ private:
     BLECharacteristic hrvCharacteristic;
     BLECharacteristic batteryStatusCharacteristic;
     BLECharacteristic recControlCharacteristic;
+    BLECharacteristic diagnosticsCharacteristic;
+    BLECharacteristic timeSyncCharacteristic;
+    
+    // Raw PPG transmit queue (sending task only: sendRawPpgData(),
+    // canQueueRawPpgData() and serviceTx())
+    SpscRing<BLETxPacket, BLE_TX_QUEUE_SIZE> txQueue;
+    BLETxStats txStats;
+    uint32_t txCompletionsSeen;
+    bool txRetryPending;
+    unsigned long txFailTime;
+    unsigned long lastDiagnostics;
+    uint32_t txConnection;          // getConnectionId() the queue was filled for
+    
+    // Drop the queue and start new counters when the connection changed
+    void syncTxConnection();
+    
+    // Send queued packets while the SoftDevice has room
+    void pumpTxQueue();
+    
+    // notify() that counts the notification in notificationsSent (any
+    // task; every value sent fits one notification)
+    static bool sendNotification(BLECharacteristic& characteristic, const void* data, uint16_t length);
+    
+    // Publish txStats on the diagnostics characteristic
+    void updateDiagnostics();
+    
+    // Connection parameter policy (loop task, see update())
+    BLELinkPolicy linkPolicy;
+    uint32_t linkConnection;        // getConnectionId() the policy runs for
+    volatile bool streaming;        // Set from any task, applied by update()
     
     // Static callback functions (required by Bluefruit library)
     static void connectCallback(uint16_t conn_handle);
     static void disconnectCallback(uint16_t conn_handle, uint8_t reason);
     static void recordingStartCallback(uint16_t conn_hdl, BLECharacteristic *chr, uint8_t *data, uint16_t len);
+    static void eventCallback(ble_evt_t* event);
+    static void timeSyncCallback(uint16_t conn_hdl, BLECharacteristic *chr, uint8_t *data, uint16_t len);
     
-    // User-defined connection callback
+    // User-defined connection and wake callbacks
     static void (*userConnectionCallback)(void);
+    static void (*wakeCallback)(void);
+    static void wakeLoop();
     
     // Static state tracking (required for callbacks)
-    static bool connected;
+    static volatile bool connected;
+    static volatile uint32_t connectionCount;  // Connections so far (BLE task)
+    static uint16_t connectionHandle;
+    static volatile uint32_t txCompletions;  // HVN_TX_COMPLETE count (BLE task)
+    static std::atomic<uint32_t> notificationsSent;  // sendNotification() count (any task)
+    static volatile uint32_t notificationsLost;  // Sent - completed at connect: left
+                                                 // by an earlier link, never completed
     static BluetoothManager* instance;
     static PPGManager* ppgManager;
     static PowerManager* powerManager;
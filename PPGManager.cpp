@@ -7,15 +7,50 @@
 
 #include "PPGManager.h"
 #include "BluetoothManager.h"
-#include <vector>
+
+// Instance served by the FIFO and wear interrupts (attachInterrupt() takes a plain function)
+static PPGManager* sensorInterruptOwner = NULL;
+
+// Holds sensorLock for its scope (recursive: stopAcquisition() calls
+// shutDownSensor(), which also takes it). Without the lock (no heap)
+// nothing is held.
+class SensorLock {
+  public:
+    SensorLock(SemaphoreHandle_t lock) : lock(lock) {
+        if (lock != NULL) {
+            xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+        }
+    }
+    ~SensorLock() {
+        if (lock != NULL) {
+            xSemaphoreGiveRecursive(lock);
+        }
+    }
+    
+  private:
+    SemaphoreHandle_t lock;
+};
 
 // ============================================================================
 // Constructor
 // ============================================================================
 
 PPGManager::PPGManager(BluetoothManager& bluetoothManager)
-    : bluetoothManager(bluetoothManager), PPGindex(0), recordingInProgress(false) {
+    : bluetoothManager(bluetoothManager), fifo(Wire),
+      fifoInterruptWired(false), polledSamples(0), wakeCallback(NULL), pipeline(*this),
+      sensorLock(NULL), wear(particleSensor), wearEnabled(false), acquisitionActive(false),
+      wearCallback(NULL),
+      PPGindex(0), recordingInProgress(false),
+      liveFilter(PPG_BANDPASS_COEFFS),
+      liveBeats(EFFECTIVE_SAMPLING_RATE, LIVE_PEAK_THRESHOLD, LIVE_PEAK_MIN_DISTANCE),
+      liveQuality(EFFECTIVE_SAMPLING_RATE, LIVE_PEAK_MIN_DISTANCE), liveSignalGood(true),
+      lastHrvReport(0),
+      liveSampleCount(0), liveNextSample(0), lastBeatIndex(-1), liveHeartRate(0),
+      txBatcher(*this, 1000 / EFFECTIVE_SAMPLING_RATE, PPG_PACKET_ENCODING, PPG_RICE_ORDER),
+      txConnection(0), txNextSample(0) {
     // Initialize member variables
+    txBatcher.setMaxPacketSize(PPG_PACKET_SIZE_MAX);
+    txBatcher.setMaxHold(PPG_TX_MAX_HOLD_MS);
     // Sensor initialization happens in setUpSensor()
 }
 
@@ -24,6 +59,11 @@ PPGManager::PPGManager(BluetoothManager& bluetoothManager)
 // ============================================================================
 
 void PPGManager::setUpSensor() {
+    // Before any task shares the sensor
+    if (sensorLock == NULL) {
+        sensorLock = xSemaphoreCreateRecursiveMutex();
+    }
+    
     // Attempt to initialize MAX30105 sensor via I2C
     if (!particleSensor.begin(Wire, I2C_SPEED_FAST)) {
         Serial.println("ERROR: MAX30105 sensor not found!");
@@ -47,7 +87,30 @@ void PPGManager::setUpSensor() {
     // - sampleRate: 200 = 200 samples per second
     // - pulseWidth: 411 = 411 microseconds pulse width (affects resolution)
     // - adcRange: 2048 = ADC range in nanoamps (2048nA, lower = more sensitive)
-    particleSensor.setup(255, SAMPLING_AVERAGE, 3, SAMPLING_RATE, 411, 2048);
+    particleSensor.setup(255, SAMPLING_AVERAGE, LED_MODE, SAMPLING_RATE, 411, 2048);
+    
+    // FIFO samples contain all active slots; keep only the green one
+    fifo.begin(LED_MODE, PPG_FIFO_SLOT_GREEN);
+    
+#if PPG_FIFO_ACQUISITION && PPG_FIFO_INTERRUPT
+    // Drain on the almost-full interrupt if the INT pin is actually connected
+    fifoInterruptWired = checkFifoInterrupt();
+#endif
+    
+#if PPG_FIFO_ACQUISITION
+    // Drain on the interrupt if it works, otherwise on a timer
+    pipeline.setPollInterval(fifoInterruptWired ? PPG_TASK_NO_POLL : PPG_FIFO_POLL_INTERVAL);
+#else
+    // getGreen() waits for the next sample: one call per sample period
+    pipeline.setPollInterval(1000 / EFFECTIVE_SAMPLING_RATE);
+#endif
+    
+#if PPG_RTOS_TASKS
+    // Acquisition, processing and BLE stages in their own tasks
+    if (!pipeline.startTasks()) {
+        Serial.println("WARNING: Could not create recording tasks - stages run from loop");
+    }
+#endif
     
     // Disable Red and IR LEDs initially (we only use Green for PPG)
     // Green LED is optimal for heart rate detection through skin
@@ -55,6 +118,11 @@ void PPGManager::setUpSensor() {
     particleSensor.setPulseAmplitudeIR(0);     // IR LED off
     // Green LED brightness is set by setup() function above
     
+    // Proximity mode pulses the IR LED alone, at the pilot current
+    wear.begin(WEAR_PROXIMITY_THRESHOLD, WEAR_PILOT_AMPLITUDE, WEAR_SEARCH_INTERVAL,
+               WEAR_CHECK_INTERVAL, WEAR_CONFIRM_TIME);
+    wear.setPollInterval(fifoInterruptWired ? WEAR_NO_POLL : WEAR_POLL_INTERVAL);
+    
     Serial.println("Sensor configuration:");
     Serial.print("  Sampling rate: "); Serial.print(SAMPLING_RATE); Serial.println(" Hz");
     Serial.print("  Sample averaging: "); Serial.println(SAMPLING_AVERAGE);
@@ -71,15 +139,16 @@ void PPGManager::startRealTimePPGRecording() {
     // Reset data buffer for new recording
     resetPPGArray();
     
-    // Ensure sensor is powered on and ready
-    turnOnSensor();
-    
     // Record start time for automatic timeout
     recordingStartTime = millis();
     
     // Set recording flag
     recordingInProgress = true;
     
+    // The sensor, live pipeline and batcher restart in their own stages,
+    // in order: startAcquisition(), startLivePipeline(), startTransmission()
+    pipeline.start();
+    
     Serial.println("Recording active - data streaming to BLE");
 }
 
@@ -89,32 +158,62 @@ void PPGManager::stopRealTimePPGRecording() {
     // Clear recording flag
     recordingInProgress = false;
     
-    // Power down sensor to conserve battery
-    shutDownSensor();
-    
-    Serial.println("Recording stopped - sensor powered down");
+    // stopAcquisition() powers the sensor down; the blocks already acquired
+    // still go out, then stopTransmission() sends the last packet
+    pipeline.stop();
 }
 
 void PPGManager::realTimePPGRec() {
-    // Only proceed if recording is active
-    if (recordingInProgress) {
-        // Check if we're still within the 60-second recording window
-        if (millis() - recordingStartTime < COLLECTION_TIME) {
-            // Collect and transmit one PPG sample
-            collectPPGData();
-        } else {
-            // Recording duration exceeded - auto-stop
-            Serial.println("Recording timeout (60s) - stopping automatically");
-            stopRealTimePPGRecording();
-        }
+    // Check if we're still within the 60-second recording window
+    if (recordingInProgress && millis() - recordingStartTime >= COLLECTION_TIME) {
+        // Recording duration exceeded - auto-stop
+        Serial.println("Recording timeout (60s) - stopping automatically");
+        stopRealTimePPGRecording();
+    }
+    
+    if (pipeline.hasTasks()) {
+        // Notifications sent since the last call may have freed BLE buffers:
+        // the BLE stage sends the next packets (and notices a disconnect)
+        pipeline.wakeTransmit();
+    } else {
+        // Acquisition, processing and BLE transmission in turn, here in loop
+        pipeline.runInline(millis());
     }
 }
 
 // ============================================================================
-// Data Collection and Transmission
+// Acquisition Stage
 // ============================================================================
 
-void PPGManager::collectPPGData() {
+bool PPGManager::acquire(PPGTaskItem* item) {
+    SensorLock lock(sensorLock);
+    if (item->event == PPG_TASK_START) {
+        startAcquisition();
+        return true;
+    }
+    if (item->event == PPG_TASK_STOP) {
+        // Where the recording ended, so the BLE stage can count the samples
+        // dropped after its last block
+#if PPG_FIFO_ACQUISITION
+        item->block.firstSample = fifo.totalSamples() + fifo.lostSamples();
+#else
+        item->block.firstSample = polledSamples;
+#endif
+        stopAcquisition();
+        return true;
+    }
+    
+#if PPG_FIFO_ACQUISITION
+#if PPG_FIFO_INTERRUPT
+    if (fifoInterruptWired) {
+        // Clear A_FULL first so a threshold crossed during the drain raises a new edge
+        fifo.readInterruptStatus();
+    }
+#endif
+    
+    // Read everything in the FIFO (green channel) with burst I2C reads
+    return fifo.drain(&item->block) > 0;
+#else
     // Read raw PPG value from green LED channel
     // Green LED provides best signal quality for heart rate through skin
     // Alternative: particleSensor.getRed() or particleSensor.getIR()
@@ -123,82 +222,467 @@ void PPGManager::collectPPGData() {
     // Debug output (comment out for production to reduce serial overhead)
     Serial.println(ppgRaw);
     
-    // Batch data for efficient BLE transmission
-    batchPPGData(ppgRaw);
+    item->block.timestamp = millis();
+    item->block.firstSample = polledSamples++;
+    item->block.count = 1;
+    item->block.overflow = 0;
+    item->block.samples[0] = ppgRaw;
+    return true;
+#endif
 }
 
-void PPGManager::batchPPGData(uint32_t ppgSignal) {
-    // Static vector persists between function calls to accumulate samples
-    static std::vector<uint8_t> dataBatch;
+void PPGManager::startAcquisition() {
+    // Proximity mode off first, or the sensor would wait for skin contact
+    acquisitionActive = true;
+    if (wear.isRunning()) {
+        suspendWearDetection();
+    }
     
-    // Protocol constants
-    const uint8_t delimiter = 0xFE;    // Sample delimiter for parsing
-    const int packetSize = 18;         // BLE MTU-optimized packet size
+    // Ensure sensor is powered on and ready
+    turnOnSensor();
     
-    // Convert 32-bit sensor reading to 16-bit for transmission
-    // This reduces bandwidth while maintaining sufficient resolution
-    int16_t scaledSignal = static_cast<int16_t>(ppgSignal);
+    // Discard samples buffered before this recording
+    fifo.clear();
+    polledSamples = 0;
     
-    // Debug output (disable in production for performance)
-    Serial.print("PPG Signal: "); Serial.println(ppgSignal);
-    Serial.print("Scaled Signal: "); Serial.println(scaledSignal);
-    
-    // Pack 16-bit value as two bytes (big-endian)
-    dataBatch.push_back((scaledSignal >> 8) & 0xFF);  // High byte
-    dataBatch.push_back(scaledSignal & 0xFF);         // Low byte
-    dataBatch.push_back(delimiter);                   // Sample delimiter
-    
-    // Once we have enough data, transmit packet
-    if (dataBatch.size() >= packetSize) {
-        // Debug output (disable in production)
-        Serial.print("Transmitting batch: ");
-        for (auto byte : dataBatch) {
-            Serial.print(byte, HEX);
-            Serial.print(" ");
-        }
-        Serial.println();
+#if PPG_FIFO_ACQUISITION && PPG_FIFO_INTERRUPT
+    if (fifoInterruptWired) {
+        sensorInterruptOwner = this;
+        // Release INT so the first A_FULL of this recording is a falling edge
+        fifo.readInterruptStatus();
+        // The handler only wakes this stage (no I2C), so it needs no ISR_DEFERRED
+        attachInterrupt(digitalPinToInterrupt(PPG_INT_PIN), onFifoInterrupt, FALLING);
+    }
+#endif
+}
+
+void PPGManager::stopAcquisition() {
+#if PPG_FIFO_ACQUISITION && PPG_FIFO_INTERRUPT
+    if (fifoInterruptWired) {
+        detachInterrupt(digitalPinToInterrupt(PPG_INT_PIN));
+    }
+#endif
+    
+#if PPG_FIFO_ACQUISITION
+    Serial.print("Samples received: "); Serial.print(fifo.totalSamples());
+    Serial.print(", lost to FIFO overflow: "); Serial.print(fifo.lostSamples());
+    Serial.print(", I2C errors: "); Serial.println(fifo.errorCount());
+#endif
+    
+    acquisitionActive = false;
+    if (wearEnabled) {
+        // Back to proximity probes (main LEDs off)
+        resumeWearDetection();
+        Serial.println("Recording stopped - sensor back to wear detection");
+        return;
+    }
+    
+    // Power down sensor to conserve battery
+    shutDownSensor();
+    
+    Serial.println("Recording stopped - sensor powered down");
+}
+
+// ============================================================================
+// Interrupt-Driven Acquisition
+// ============================================================================
+
+bool PPGManager::checkFifoInterrupt() {
+    // INT is open-drain; the pull-up also keeps an unconnected pin HIGH
+    pinMode(PPG_INT_PIN, INPUT_PULLUP);
+    
+    if (!fifo.enableAlmostFullInterrupt(PPG_FIFO_A_FULL_SAMPLES)) {
+        Serial.println("WARNING: Could not enable FIFO interrupt - polling FIFO");
+        return false;
+    }
+    fifo.clear();
+    fifo.readInterruptStatus();  // Release INT (power-ready status is set at boot)
+    
+    // The FIFO reaches the threshold after PPG_FIFO_A_FULL_SAMPLES sample periods
+    unsigned long start = millis();
+    bool asserted = false;
+    while (!asserted && millis() - start < PPG_INT_CHECK_TIMEOUT) {
+        asserted = digitalRead(PPG_INT_PIN) == LOW;
+        delay(10);
+    }
+    fifo.readInterruptStatus();
+    
+    if (!asserted) {
+        fifo.disableAlmostFullInterrupt();
+        Serial.print("WARNING: No FIFO interrupt on pin "); Serial.print(PPG_INT_PIN);
+        Serial.println(" - polling FIFO");
+        return false;
+    }
+    Serial.println("FIFO interrupt active - sleeping between sample blocks");
+    return true;
+}
+
+void PPGManager::onFifoInterrupt() {
+    if (sensorInterruptOwner != NULL) {
+        sensorInterruptOwner->handleFifoInterrupt();
+    }
+}
+
+void PPGManager::handleFifoInterrupt() {
+    // The drain itself (I2C) happens in the acquisition stage
+    pipeline.wakeFromISR();
+    
+    // Without stage tasks, loop() runs the stages (realTimePPGRec())
+    if (!pipeline.hasTasks() && wakeCallback != NULL) {
+        wakeCallback();
+    }
+}
+
+// ============================================================================
+// Processing Stage
+// ============================================================================
+
+void PPGManager::process(PPGTaskItem* item) {
+    if (item->event == PPG_TASK_START) {
+        startLivePipeline();
+        return;
+    }
+    if (item->event != PPG_TASK_BLOCK) {
+        return;
+    }
+    const PPGSampleBlock& block = item->block;
+    
+    // Samples missing before this block: lost to FIFO overflow, or blocks
+    // dropped because this stage fell behind acquisition
+    uint32_t missing = block.firstSample - liveNextSample;
+    liveNextSample = block.firstSample + block.count;
+    if (missing > 0) {
+        Serial.print("Samples lost: "); Serial.println(missing);
+#if LIVE_HEART_RATE
+        // Sample indices no longer reflect elapsed time across the gap
+        lastBeatIndex = -1;
+        liveHrv.markGap();
+#endif
+    }
+    
+    for (int i = 0; i < block.count; i++) {
+#if LIVE_HEART_RATE
+        // Update live heart rate estimate as each sample arrives
+        updateLiveHeartRate(block.samples[i], item);
+#endif
         
-        // Transmit via BLE
-        bluetoothManager.sendRawPpgData(dataBatch.data(), dataBatch.size());
+#if LIVE_HEART_RATE && SQI_GATE_TRANSMISSION
+        // Save radio airtime while the sensor is loose or moving
+        if (!liveSignalGood) {
+            item->skip |= 1u << i;
+        }
+#endif
+    }
+}
+
+void PPGManager::startLivePipeline() {
+    // Reset live heart rate pipeline so no state carries over
+    liveFilter.reset();
+    liveSmoother.reset();
+    liveBeats.reset();
+    liveQuality.reset();
+    liveSignalGood = true;
+    liveHrv.reset();
+    
+    lastHrvReport = millis();
+    liveSampleCount = 0;
+    liveNextSample = 0;
+    lastBeatIndex = -1;
+    liveHeartRate = 0;
+}
+
+void PPGManager::updateLiveHeartRate(uint32_t ppgSignal, PPGTaskItem* item) {
+    // Filter the new sample (same stages as the batch pipeline)
+    float filtered = liveFilter.process((float)ppgSignal);
+    
+    // Skip filter start-up transient, as the batch pipeline trims edge samples
+    if (++liveSampleCount <= IGNORE_EDGE_SAMPLES) {
+        return;
+    }
+    float smoothed = liveSmoother.process(filtered);
+    
+    // Score each completed beat; the raw sample serves as the DC level
+    if (liveQuality.process(smoothed, (float)ppgSignal)) {
+        liveSignalGood = liveQuality.lastScore() >= SQI_GOOD_THRESHOLD;
+    }
+    
+    // Detect beats online (reported one sample after the peak)
+    long peakIndex;
+    if (!liveBeats.process(smoothed, &peakIndex)) {
+        return;
+    }
+    
+    if (lastBeatIndex >= 0) {
+        // Beat-to-beat interval, accepted only in physiological range (40-200 bpm)
+        int rrInterval = (peakIndex - lastBeatIndex) * 1000 / EFFECTIVE_SAMPLING_RATE;
+        if (rrInterval >= 300 && rrInterval <= 1500) {
+            liveHeartRate = 60000.0 / rrInterval;
+            // Serial.print("Live HR: "); Serial.print(liveHeartRate); Serial.println(" bpm");
+        }
         
-        // Clear batch for next packet
-        dataBatch.clear();
+        // Only clean intervals enter the HRV window; anything else breaks
+        // the successive-difference chain
+        if (rrInterval >= 300 && rrInterval <= 1500 && liveSignalGood) {
+            liveHrv.push(rrInterval);
+            reportLiveHrv(item);
+        } else {
+            liveHrv.markGap();
+        }
     }
+    lastBeatIndex = peakIndex;
+}
+
+static_assert(BLE_HRV_SIZE <= PPG_TASK_REPORT_SIZE, "HRV metrics ride on a PPGTaskItem");
+
+void PPGManager::reportLiveHrv(PPGTaskItem* item) {
+    if (liveHrv.size() < LIVE_HRV_MIN_BEATS ||
+        millis() - lastHrvReport < HRV_REPORT_INTERVAL) {
+        return;
+    }
+    
+    HRVMetrics m;
+    if (!liveHrv.getMetrics(&m)) {
+        return;
+    }
+    lastHrvReport = millis();
+    
+    // Fixed binary layout (BluetoothManager.h, HRV METRICS); the BLE stage
+    // sends it, as it owns the notification buffers
+    uint8_t* payload = item->report;
+    payload[0] = BLE_HRV_VERSION;
+    payload[1] = m.beats > 255 ? 255 : m.beats;
+    const float values[6] = {m.heartRate, m.sdnn, m.rmssd, m.pnn50, m.sd1, m.sd2};
+    for (int i = 0; i < 6; i++) {
+        float tenths = values[i] * 10 + 0.5f;
+        uint16_t value = tenths >= 65535 ? 65535 : tenths > 0 ? (uint16_t)tenths : 0;
+        payload[2 + 2 * i] = value & 0xFF;
+        payload[3 + 2 * i] = value >> 8;
+    }
+    item->reportLength = BLE_HRV_SIZE;
 }
 
 // ============================================================================
-// Proximity Detection (Wear Status)
+// BLE Stage
 // ============================================================================
 
-bool PPGManager::proximityCheck() {
-    Serial.println("Checking proximity (wear status)...");
+bool PPGManager::transmit(const PPGTaskItem& item) {
+    dropStaleSamples();
+    if (item.event == PPG_TASK_START) {
+        txNextSample = 0;
+        startTransmission();
+        return true;
+    }
+    if (item.event == PPG_TASK_STOP) {
+        countLostSamples(item.block.firstSample);
+        stopTransmission();
+        return true;
+    }
+    const PPGSampleBlock& block = item.block;
+    
+    // Backpressure: while samples back up behind a full BLE queue the block
+    // waits in the stage queue (blocks after it are dropped there, counted)
+    if (txBatcher.queueSpace() < block.count) {
+        return false;
+    }
+    if (item.reportLength > 0) {
+        bluetoothManager.sendHrvMetrics(item.report, item.reportLength);
+    }
+    countLostSamples(block.firstSample);
+    txNextSample = block.firstSample + block.count;
+    
+    // The block is stamped at its newest sample; earlier ones are one
+    // sensor sample period apart
+    const uint32_t period = 1000 / EFFECTIVE_SAMPLING_RATE;
+    for (int i = 0; i < block.count; i++) {
+        if (!(item.skip & (1u << i))) {
+            batchPPGData(block.samples[i], block.timestamp - (block.count - 1 - i) * period);
+        }
+    }
+    return true;
+}
+
+bool PPGManager::service(uint32_t now) {
+    // This stage owns the BLE transmit queue: send what freed notification
+    // buffers allow, then the batch hold time and packets the queue had no
+    // room for (also after a stop)
+    bool queued = bluetoothManager.serviceTx();
+    dropStaleSamples();
+    txBatcher.poll(now);
+    return queued || txBatcher.pending() > 0;
+}
+
+void PPGManager::dropStaleSamples() {
+    // While disconnected nothing is kept, so blocks still flow (and the
+    // stop behind them gets through)
+    uint32_t connection = bluetoothManager.getConnectionId();
+    if (connection != txConnection || connection == 0) {
+        txBatcher.discard();
+        txConnection = connection;
+    }
+}
+
+void PPGManager::countLostSamples(uint32_t nextSample) {
+    // Lost to FIFO overflow, or in blocks dropped because a stage fell
+    // behind (also those a stop let through, see ppgTasks.h)
+    uint32_t lost = nextSample - txNextSample;
+    if (lost > 0) {
+        bluetoothManager.countLostSamples(lost);
+    }
+}
+
+void PPGManager::startTransmission() {
+    // Packet sequence numbers and Rice adaptation restart with every recording;
+    // samples the last stop could not deliver are dropped, not sent now
+    txBatcher.start();
+    if (txBatcher.samplesDropped() > 0) {
+        Serial.print("Undelivered samples from previous recording dropped: ");
+        Serial.println(txBatcher.samplesDropped());
+    }
+    
+    // Short connection interval and 2M PHY while streaming
+    bluetoothManager.setStreaming(true);
+}
+
+void PPGManager::stopTransmission() {
+    // Send the partly filled packet now rather than leave it for the next recording
+    if (!txBatcher.flush()) {
+        Serial.print("Samples waiting for BLE: "); Serial.println(txBatcher.pending());
+    }
+    Serial.print("Samples sent: "); Serial.print(txBatcher.samplesSent());
+    Serial.print(" in "); Serial.print(txBatcher.packetsSent());
+    Serial.print(" packets, dropped: "); Serial.println(txBatcher.samplesDropped());
+    if (pipeline.acquiredOverruns() > 0 || pipeline.processedOverruns() > 0) {
+        Serial.print("Blocks dropped since power-on (processing / BLE fell behind): ");
+        Serial.print(pipeline.acquiredOverruns()); Serial.print(" / ");
+        Serial.println(pipeline.processedOverruns());
+    }
     
-    unsigned long startTime = millis();
-    float greenTotal = 0;
-    int sampleCount = 0;
+    // Back to the long, low-power connection interval
+    bluetoothManager.setStreaming(false);
+}
+
+void PPGManager::batchPPGData(uint32_t ppgSignal, uint32_t timestamp) {
+#if PPG_DEBUG_STREAM
+    Serial.print("PPG Signal: "); Serial.println(ppgSignal);
+#endif
     
-    // Collect samples over 3-second window
-    while (millis() - startTime < SAMPLE_WINDOW) {
-        float greenValue = particleSensor.getGreen();
-        greenTotal += greenValue;
-        sampleCount++;
-        delay(100);  // Sample every 100ms (10 Hz)
+    // A sample leaves the batcher only once it is in a packet: while the BLE
+    // queue is full, the finished packet and the samples after it wait there
+    if (!txBatcher.add(ppgSignal, timestamp)) {
+        // Not expected: transmit() checks queueSpace() first
+        Serial.println("WARNING: BLE transmit ring full - sample dropped");
     }
+}
+
+int PPGManager::maxPacketSize() {
+    // Size each packet for the current connection's MTU
+    return bluetoothManager.getRawPpgPacketSize();
+}
+
+bool PPGManager::canSend() {
+    // Backpressure: keep the packet until the BLE queue has room
+    return bluetoothManager.isConnected() && bluetoothManager.canQueueRawPpgData();
+}
+
+void PPGManager::send(const uint8_t* data, int length) {
+#if PPG_DEBUG_STREAM
+    Serial.print("Transmitting packet: ");
+    for (int i = 0; i < length; i++) {
+        Serial.print(data[i], HEX);
+        Serial.print(" ");
+    }
+    Serial.println();
+#endif
     
-    // Calculate average green LED intensity
-    float avgGreen = greenTotal / sampleCount;
+    // Transmit via BLE (byte 5: sample count, see ppgPacket.h)
+    bluetoothManager.sendRawPpgData(data, length, data[5]);
+}
+
+void PPGManager::dropped(uint32_t samples) {
+    // Batcher ring full, or samples of a lost connection or recording
+    bluetoothManager.countDroppedSamples(samples);
+}
+
+// ============================================================================
+// Wear Detection (Proximity Mode)
+// ============================================================================
+
+void PPGManager::startWearDetection() {
+#if WEAR_DETECTION
+    SensorLock lock(sensorLock);
+    if (wearEnabled) {
+        return;
+    }
+    wearEnabled = true;
     
-    Serial.print("Average Green LED reading: ");
-    Serial.println(avgGreen);
+    // During a recording, stopAcquisition() resumes it
+    if (!acquisitionActive) {
+        resumeWearDetection();
+    }
+    Serial.println("Wear detection active (sensor proximity mode)");
+#endif
+}
+
+void PPGManager::stopWearDetection() {
+    SensorLock lock(sensorLock);
+    wearEnabled = false;
+    if (wear.isRunning()) {
+        suspendWearDetection();
+        shutDownSensor();
+    }
+}
+
+WearEvent PPGManager::updateWearDetection() {
+    SensorLock lock(sensorLock);
+    if (!wear.isRunning()) {
+        return WEAR_NO_CHANGE;  // Recording (or not started)
+    }
     
-    // When sensor is touching skin, light is reflected back to detector
-    // Higher values indicate contact, lower values indicate no contact
-    bool isWorn = avgGreen > PROXIMITY_THRESHOLD;
+    // Reads INT_STATUS_1 at most once, never waits for a sample
+    WearEvent event = wear.update(millis());
+    if (event != WEAR_NO_CHANGE) {
+        Serial.println(event == WEAR_ON ? "Skin contact detected (worn)" : "Skin contact lost (not worn)");
+    }
+    return event;
+}
+
+uint32_t PPGManager::getWearUpdateDelay() {
+    SensorLock lock(sensorLock);
+    return wear.nextUpdate(millis());
+}
+
+void PPGManager::resumeWearDetection() {
+    // Probe now: the device may have been put on or taken off meanwhile
+    wear.start(millis());
     
-    Serial.print("Sensor status: ");
-    Serial.println(isWorn ? "WORN (contact detected)" : "NOT WORN (no contact)");
+#if PPG_FIFO_INTERRUPT
+    if (fifoInterruptWired) {
+        // PROX_INT pulls INT low, as A_FULL does while recording
+        sensorInterruptOwner = this;
+        attachInterrupt(digitalPinToInterrupt(PPG_INT_PIN), onWearInterrupt, FALLING);
+    }
+#endif
     
-    return isWorn;
+    // The loop schedules its next updateWearDetection() from here
+    if (wearCallback != NULL) {
+        wearCallback();
+    }
+}
+
+void PPGManager::suspendWearDetection() {
+#if PPG_FIFO_INTERRUPT
+    if (fifoInterruptWired) {
+        detachInterrupt(digitalPinToInterrupt(PPG_INT_PIN));
+    }
+#endif
+    wear.stop();
+}
+
+void PPGManager::onWearInterrupt() {
+    // Only wakes the loop: reading the status (I2C) happens in updateWearDetection()
+    if (sensorInterruptOwner != NULL && sensorInterruptOwner->wearCallback != NULL) {
+        sensorInterruptOwner->wearCallback();
+    }
 }
 
 // ============================================================================
@@ -299,6 +783,13 @@ bool PPGManager::proximityCheck() {
 //     movingAverageFilter(trimmedData, smoothedData, 
 //                         BUFFER_SIZE - 2 * IGNORE_EDGE_SAMPLES, 6);
 //     
+//     // Skip windows where the sensor was loose or moving
+//     if (!signalQual(smoothedData, BUFFER_SIZE - 2 * IGNORE_EDGE_SAMPLES,
+//                     SAMPLING_RATE / SAMPLING_AVERAGE)) {
+//         Serial.println("Poor signal quality - window skipped");
+//         return;
+//     }
+//     
 //     // Step 4: Detect peaks in smoothed signal (corresponds to heartbeats)
 //     Serial.println("Detecting peaks...");
 //     int peakCount;
@@ -368,6 +859,8 @@ void PPGManager::resetPPGArray() {
 }
 
 void PPGManager::shutDownSensor() {
+    SensorLock lock(sensorLock);
+    
     // Put MAX30105 into low-power shutdown mode
     // Consumes <1µA in this state vs ~600µA when active
     particleSensor.shutDown();
@@ -375,6 +868,8 @@ void PPGManager::shutDownSensor() {
 }
 
 void PPGManager::turnOnSensor() {
+    SensorLock lock(sensorLock);
+    
     // Wake sensor from shutdown mode
     // Sensor returns to previous configuration
     particleSensor.wakeUp();
@@ -6,9 +6,10 @@
  * FEATURES:
  * - Real-time PPG data collection and streaming
  * - Configurable sampling rate and LED settings
- * - Proximity detection for wear status
+ * - Background wear detection in the sensor's low-power proximity mode
  * - Optional motion detection via IMU (LSM6DS3)
  * - Optional on-device signal processing (see processing.h)
+ * - Live heart rate estimate while recording (see beatDetector.h)
  * - Power-efficient sensor shutdown when idle
  * 
  * SENSOR CONFIGURATION:
@@ -20,12 +21,29 @@
  * 
  * DATA STREAMING:
  * - Real-time mode: Continuous streaming via BLE
+ * - Acquisition: Sensor FIFO drained in bursts (see ppgFifo.h), on the
+ *   sensor's almost-full interrupt when its INT pin is wired
+ * - Tasks: acquisition, processing (live heart rate, SQI, HRV) and BLE
+ *   transmission run in their own FreeRTOS tasks, high to low priority,
+ *   linked by bounded queues (see ppgTasks.h), so slow BLE calls or
+ *   processing bursts do not delay FIFO drains
  * - Recording duration: 60 seconds (configurable)
- * - Data format: 16-bit samples with 0xFE delimiter
- * - Packet size: 18 bytes per BLE transmission
+ * - Data format: Versioned packets, lossless Rice-coded 18-bit samples (see ppgPacket.h)
+ * - Packet size: Negotiated ATT MTU - 3, up to 244 bytes (~170 samples); 20
+ *   bytes (6-byte header + ~8-9 samples) with centrals that keep the default MTU
+ * 
+ * WEAR DETECTION:
+ * - Outside recordings the sensor is shut down except for short probes in
+ *   proximity mode (IR pilot LED only, see wearDetector.h); the main LEDs
+ *   only power up for recording, and for the few samples after skin
+ *   contact raises PROX_INT
+ * - Wear state changes are returned by updateWearDetection(), called when
+ *   the wear callback runs (PROX_INT on the INT pin) and after
+ *   getWearUpdateDelay() ms; no call blocks
+ * - Recording suspends it: acquisition disables proximity mode before
+ *   powering the sensor up, and enables it again after the recording
  * 
  * OPTIONAL FEATURES:
- * - Proximity check: Detects if sensor is touching skin
  * - Motion check: Uses IMU to detect excessive movement
  * - On-device processing: Signal filtering and HRV calculation
  *   (Currently disabled, see processPPGData() for implementation)
@@ -34,8 +52,13 @@
  * 1. Create instance: PPGManager ppgManager(bluetoothManager);
  * 2. Initialize: ppgManager.setUpSensor();
  * 3. Start recording: ppgManager.startRealTimePPGRecording();
- * 4. Stream data: Call ppgManager.realTimePPGRec() in loop
+ * 4. Stream data: Call ppgManager.realTimePPGRec() in loop every ~100 ms
+ *    (timeout), and when notifications were sent; without stage tasks
+ *    (PPG_RTOS_TASKS 0, or no heap) also when the wake callback reports a
+ *    FIFO block, as it then runs the stages itself
  * 5. Stop recording: ppgManager.stopRealTimePPGRecording();
+ * 6. Wear detection: ppgManager.startWearDetection(), then
+ *    ppgManager.updateWearDetection() as above
  * 
  */
 
@@ -49,6 +72,14 @@ class BluetoothManager;
 #include "MAX30105.h"
 #include <math.h>
 #include "processing.h"
+#include "streamingFilters.h"
+#include "beatDetector.h"
+#include "signalQuality.h"
+#include "rollingHrv.h"
+#include "ppgFifo.h"
+#include "ppgBatcher.h"
+#include "ppgTasks.h"
+#include "wearDetector.h"
 #include "LSM6DS3.h"
 
 // ============================================================================
@@ -59,21 +90,84 @@ class BluetoothManager;
 #define SAMPLING_AVERAGE 8          // Number of samples averaged per reading
 #define COLLECTION_TIME 60000       // Recording duration (milliseconds)
 #define REST_TIME 30000             // Rest period between recordings (unused)
+#define EFFECTIVE_SAMPLING_RATE (SAMPLING_RATE / SAMPLING_AVERAGE)  // Readings per second after averaging
+#define LED_MODE 3                  // Red + IR + Green slots active (3 slots per FIFO sample)
+
+// Sample acquisition (1 = drain sensor FIFO in bursts, 0 = poll getGreen() per loop)
+// The FIFO holds 32 samples (1.28 s at 25 Hz); the poll interval must stay
+// well below that or samples are overwritten (counted as lost)
+#define PPG_FIFO_ACQUISITION 1
+#define PPG_FIFO_POLL_INTERVAL 320  // Time between FIFO drains (ms) - ~8 samples per block
+
+// Interrupt-driven acquisition (1 = drain on the FIFO almost-full interrupt, 0 = poll)
+// Requires PPG_FIFO_ACQUISITION and the MAX30105 INT pin wired to PPG_INT_PIN.
+// setUpSensor() checks that the interrupt arrives and otherwise falls back to
+// polling, so boards without the wire keep working.
+#define PPG_FIFO_INTERRUPT 1
+#define PPG_INT_PIN 2               // D2 <- MAX30105 INT (open-drain, active LOW)
+#define PPG_FIFO_A_FULL_SAMPLES 17  // Samples per interrupt (17-31) - 680 ms at 25 Hz
+#define PPG_INT_CHECK_TIMEOUT 1500  // Time allowed for the first interrupt at start-up (ms)
+
+// Recording stages in FreeRTOS tasks (1 = acquisition / processing / BLE
+// tasks, see ppgTasks.h; 0 = all three run from realTimePPGRec() in loop).
+// setUpSensor() falls back to 0 if the tasks cannot be created.
+#define PPG_RTOS_TASKS 1
+
+// BLE transmit batching (ppgBatcher.h): samples are encoded into an open
+// packet (ppgPacket.h) that goes out once the next sample no longer fits in
+// one notification (BluetoothManager::getRawPpgPacketSize(), read when a
+// packet is started). Larger packets mean fewer notifications and connection
+// events, but a 244-byte packet holds ~7 s of samples, so a packet is also
+// sent once its first sample has waited PPG_TX_MAX_HOLD_MS.
+#define PPG_PACKET_SIZE_MAX 244     // Largest packet used (<= PPG_PACKET_MAX_SIZE)
+#define PPG_TX_MAX_HOLD_MS 2000     // Longest a sample waits for its packet to fill (0 = until full)
+#define PPG_PACKET_ENCODING PPG_ENCODING_RICE  // Or PPG_ENCODING_PACKED18 (fixed 6 per packet)
+#define PPG_RICE_ORDER 1            // Rice predictor (1 or 2); 2 gains <3% when clean, loses with noise
+
+// Serial log of every streamed sample and packet (1 = on). The BLE stage
+// waits for the UART while it prints, so leave it off unless debugging.
+#define PPG_DEBUG_STREAM 0
 
 // Buffer sizing for on-device processing (if enabled)
 #define BUFFER_SIZE ((SAMPLING_RATE / SAMPLING_AVERAGE) * (COLLECTION_TIME / 2000))
 #define IGNORE_EDGE_SAMPLES 25      // Edge samples to ignore in filtering
 
-// Proximity and motion detection thresholds
-#define PROXIMITY_THRESHOLD 1000    // ADC threshold for skin contact detection
+// Background wear detection (1 = enabled, 0 = sensor shut down between recordings)
+// Probes run in the sensor's proximity mode: only the IR LED pulses, at
+// WEAR_PILOT_AMPLITUDE, until a reading above WEAR_PROXIMITY_THRESHOLD
+#define WEAR_DETECTION 1
+#define WEAR_PILOT_AMPLITUDE 0x0A   // PILOT_PA: IR LED current in proximity mode (0.2 mA steps)
+#define WEAR_PROXIMITY_THRESHOLD 8  // PROX_INT_THRESH: IR count >> 10 for skin contact (~8k counts)
+#define WEAR_SEARCH_INTERVAL 5000   // Time between probes while not worn (ms, 0 = search continuously)
+#define WEAR_CHECK_INTERVAL 30000   // Time between probes while worn (ms)
+#define WEAR_CONFIRM_TIME 200       // Longest probe without contact (ms) - 5 samples at 25 Hz
+#define WEAR_POLL_INTERVAL 500      // Continuous search without the INT pin: status reads (ms)
+
+// Motion detection thresholds
 #define GYRO_THRESHOLD 10.0         // Gyroscope magnitude threshold for motion
 #define SAMPLE_WINDOW 3000          // Sampling window for checks (milliseconds)
 
+// Live heart rate during real-time recording (1 = enabled, 0 = disabled)
+// Filters each sample as it arrives and detects beats with bounded latency
+#define LIVE_HEART_RATE 1
+#define LIVE_PEAK_THRESHOLD 0.9     // Peak threshold factor (same as batch pipeline)
+#define LIVE_PEAK_MIN_DISTANCE 0.4  // Minimum time between beats (seconds)
+#define LIVE_SMOOTHING_WINDOW 6     // Moving average window (samples)
+#define LIVE_HRV_WINDOW 64          // RR intervals in the rolling HRV window (~1 minute)
+#define LIVE_HRV_MIN_BEATS 8        // RR intervals needed before HRV is reported
+#define HRV_REPORT_INTERVAL 5000    // Time between HRV notifications (ms, 0 = every beat)
+
+// Skip BLE transmission while live signal quality is poor (1 = enabled, 0 = disabled)
+// Requires LIVE_HEART_RATE. Quality is decided per beat (see signalQuality.h),
+// so samples are dropped from the first bad beat until the next good one.
+// Disabled by default: the app currently expects an unbroken 60-second stream.
+#define SQI_GATE_TRANSMISSION 0
+
 // ============================================================================
 // PPGManager Class
 // ============================================================================
 
-class PPGManager {
+class PPGManager : public PPGPacketSink, public PPGTaskStages {
   public:
     // Constructor - requires reference to BluetoothManager for data transmission
     PPGManager(BluetoothManager& bluetoothManager);
@@ -81,12 +175,6 @@ class PPGManager {
     // Initialize MAX30105 sensor with default configuration
     void setUpSensor();
     
-    // Check if sensor is in contact with skin (returns true if worn)
-    bool proximityCheck();
-    
-    // Collect a single PPG sample and transmit via BLE
-    void collectPPGData();
-    
     // Clear internal data buffer
     void resetPPGArray();
     
@@ -99,22 +187,84 @@ class PPGManager {
     // Check if data collection has completed (for buffered mode)
     bool isDataCollected();
     
-    // Start real-time PPG recording session
+    // Start real-time PPG recording session (the sensor, live pipeline and
+    // batcher restart in their own stages, see ppgTasks.h)
     void startRealTimePPGRecording();
     
-    // Stop real-time PPG recording session
+    // Stop real-time PPG recording session (the BLE stage sends the samples
+    // still batched, then acquisition powers the sensor down)
     void stopRealTimePPGRecording();
     
+    bool isRecording() const { return recordingInProgress; }
+    
     // Main recording function - call repeatedly in loop during BLE mode
-    // Handles automatic 60-second recording timeout
+    // Handles automatic 60-second recording timeout and lets the BLE stage
+    // retry packets the BLE queue had no room for; without stage tasks it
+    // also runs acquisition, processing and BLE transmission
     void realTimePPGRec();
     
+    // Register a callback run from the FIFO interrupt when a block of
+    // samples is ready for realTimePPGRec(), only used without stage tasks
+    // (keep it short, e.g. EventScheduler::post())
+    void setWakeCallback(void (*callback)(void)) { wakeCallback = callback; }
+    
+    // Background wear detection (WEAR DETECTION above); suspended while
+    // recording. stop also leaves the sensor shut down between recordings
+    void startWearDetection();
+    void stopWearDetection();
+    
+    // Advance wear detection: call when the wear callback runs and after
+    // getWearUpdateDelay() ms (WEAR_NO_POLL: only on the callback)
+    // Returns: WEAR_ON / WEAR_OFF when the wear state changes
+    WearEvent updateWearDetection();
+    uint32_t getWearUpdateDelay();
+    
+    // Skin contact at the last probe
+    bool isWorn() const { return wear.isWorn(); }
+    
+    // Register a callback run when updateWearDetection() is due: from the
+    // INT pin interrupt (PROX_INT), and after a recording resumes wear
+    // detection (keep it short, e.g. EventScheduler::post())
+    void setWearCallback(void (*callback)(void)) { wearCallback = callback; }
+    
+    // Blocks dropped since power-on because processing / BLE fell behind
+    uint32_t getAcquiredOverruns() const { return pipeline.acquiredOverruns(); }
+    uint32_t getProcessedOverruns() const { return pipeline.processedOverruns(); }
+    
+    // Stage tasks created by setUpSensor() (PPG_RTOS_TASKS); stop makes
+    // them return (host tests; on the device they run until reset)
+    bool hasRecordingTasks() const { return pipeline.hasTasks(); }
+    void stopRecordingTasks() { pipeline.stopTasks(); }
+    
+    // Most recent live heart rate estimate in bpm (0 until two beats seen)
+    float getLiveHeartRate() const { return liveHeartRate; }
+    
+    // Quality score of the most recent beat (0 = unusable, 1 = clean)
+    float getLiveSignalQuality() const { return liveQuality.lastScore(); }
+    
   private:
     // Reference to BluetoothManager for data transmission
     BluetoothManager& bluetoothManager;
     
     // Hardware sensor instances
     MAX30105 particleSensor;        // MAX30105 PPG sensor
+    PPGFifoReader fifo;             // Burst reader for the sensor FIFO
+    bool fifoInterruptWired;        // INT pin verified by setUpSensor()
+    uint32_t polledSamples;         // Running sample index without the FIFO
+    void (*wakeCallback)(void);     // Block ready (see setWakeCallback())
+    
+    // Acquisition -> processing -> BLE stages (tasks and queues)
+    PPGTaskPipeline pipeline;
+    
+    // The acquisition task and the loop task (sleep, wear detection) both
+    // use the sensor; held around every I2C access once tasks run
+    SemaphoreHandle_t sensorLock;
+    
+    // Wear detection between recordings (see wearDetector.h)
+    WearDetector wear;
+    bool wearEnabled;               // startWearDetection() called
+    bool acquisitionActive;         // Acquisition stage has the sensor (under sensorLock)
+    void (*wearCallback)(void);     // Wear update due (see setWearCallback())
     LSM6DS3 myIMU;                  // LSM6DS3 IMU (optional, for motion detection)
     
     // Data buffers for on-device processing (if enabled)
@@ -128,9 +278,78 @@ class PPGManager {
     unsigned long recordingStartTime;  // Timestamp when recording started
     bool recordingInProgress;       // Flag indicating active recording
     
+    // Live heart rate pipeline (bandpass -> smoothing -> online peak detection)
+    Biquad liveFilter;
+    MovingAverage<LIVE_SMOOTHING_WINDOW> liveSmoother;
+    StreamingPeakDetector liveBeats;
+    StreamingSQI liveQuality;       // Per-beat signal quality on the same signal
+    bool liveSignalGood;            // Last scored beat reached SQI_GOOD_THRESHOLD
+    RollingHRV<LIVE_HRV_WINDOW> liveHrv;  // HRV over the most recent beats
+    unsigned long lastHrvReport;    // millis() of last HRV notification
+    long liveSampleCount;           // Samples fed to the live pipeline
+    uint32_t liveNextSample;        // Running index expected of the next block
+    long lastBeatIndex;             // Sample index of previous beat (-1 = none)
+    float liveHeartRate;            // Latest beat-to-beat heart rate (bpm)
+    
+    // Interrupt-driven acquisition: check the INT wire, then drain on A_FULL
+    // (handleFifoInterrupt() only wakes the acquisition stage)
+    bool checkFifoInterrupt();
+    static void onFifoInterrupt();
+    void handleFifoInterrupt();
+    
+    // Proximity mode on / off between recordings, with PROX_INT on the INT
+    // pin (the caller holds sensorLock)
+    void resumeWearDetection();
+    void suspendWearDetection();
+    static void onWearInterrupt();
+    
+    // PPGTaskStages, each called from its own stage task (see ppgTasks.h):
+    // acquire() drains the sensor FIFO, process() runs the live pipeline
+    // and the SQI gate, transmit() batches samples for BLE, service()
+    // sends held and refused packets and the BLE transmit queue
+    bool acquire(PPGTaskItem* item) override;
+    void process(PPGTaskItem* item) override;
+    bool transmit(const PPGTaskItem& item) override;
+    bool service(uint32_t now) override;
+    
+    // Recording start / stop in each stage
+    void startAcquisition();
+    void stopAcquisition();
+    void startLivePipeline();
+    void startTransmission();
+    void stopTransmission();
+    
+    // Feed one raw sample of item's block to the live heart rate and signal
+    // quality pipeline
+    void updateLiveHeartRate(uint32_t ppgSignal, PPGTaskItem* item);
+    
+    // Put rolling HRV metrics in item's report for the BLE stage to send
+    // (rate-limited by HRV_REPORT_INTERVAL)
+    // Format: BLE_HRV_SIZE bytes, see HRV METRICS in BluetoothManager.h
+    void reportLiveHrv(PPGTaskItem* item);
+    
+    // Samples waiting for BLE, and the packet being filled
+    PPGBatcher txBatcher;
+    uint32_t txConnection;          // BLE connection they are for (BLE stage)
+    uint32_t txNextSample;          // Running index expected of the next block (BLE stage)
+    
+    // Count the samples before running index nextSample that never reached
+    // the BLE stage (see BLETxStats)
+    void countLostSamples(uint32_t nextSample);
+    
+    // Drop (and count) batched samples whose connection has gone: they
+    // must not reach the next central either
+    void dropStaleSamples();
+    
     // Batch PPG samples for efficient BLE transmission
-    // Converts 32-bit sensor reading to 16-bit format with delimiter
-    void batchPPGData(uint32_t ppgSignal);
+    void batchPPGData(uint32_t ppgSignal, uint32_t timestamp);
+    
+    // PPGPacketSink: the raw PPG characteristic. canSend() is false while
+    // disconnected; dropStaleSamples() then counts what is left as dropped
+    int maxPacketSize() override;
+    bool canSend() override;
+    void send(const uint8_t* data, int length) override;
+    void dropped(uint32_t samples) override;
     
     // Optional: Motion detection using IMU
     // Uncomment in .cpp if LSM6DS3 is connected and configured
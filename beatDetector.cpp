@@ -0,0 +1,127 @@
+/*
+ * beatDetector.cpp
+ *
+ * Implementation of online heartbeat detection.
+ * See beatDetector.h for interface documentation.
+ */
+
+#include "beatDetector.h"
+#include <math.h>  // ceil
+
+// ============================================================================
+// STREAMING PEAK DETECTOR
+// ============================================================================
+
+StreamingPeakDetector::StreamingPeakDetector(int fs, float threshold_factor, float min_distance,
+                                             float baseline_window)
+    : thresholdFactor(threshold_factor) {
+    // Same rounding as thresholdPeakDetection()
+    minSpacing = (int)ceil(min_distance * fs);
+    baselineSamples = (long)(baseline_window * fs);
+    if (baselineSamples < 1) {
+        baselineSamples = 1;
+    }
+    reset();
+}
+
+void StreamingPeakDetector::reset() {
+    baseline = 0;
+    prevThreshold = 0;
+    prev1 = prev2 = 0;
+    sampleCount = 0;
+    lastPeakIndex = -1;
+}
+
+/*
+ * Each call evaluates the PREVIOUS sample as a peak candidate, because a
+ * local maximum needs its right-hand neighbour. The candidate is compared
+ * with the threshold as it stood when the candidate arrived.
+ */
+bool StreamingPeakDetector::process(float sample, long* peakIndex) {
+    bool found = false;
+    long candidate = sampleCount - 1;
+
+    // Candidate needs a left neighbour as well (index >= 1, as in batch)
+    if (candidate >= 1 &&
+        prev1 >= prevThreshold &&
+        prev1 > prev2 &&
+        prev1 > sample) {
+
+        // Enforce refractory period from previous peak
+        if (lastPeakIndex < 0 || (candidate - lastPeakIndex) > minSpacing) {
+            lastPeakIndex = candidate;
+            *peakIndex = candidate;
+            found = true;
+        }
+    }
+
+    // Update adaptive baseline: cumulative mean during warm-up, then EMA
+    sampleCount++;
+    long weight = sampleCount < baselineSamples ? sampleCount : baselineSamples;
+    baseline += (sample - baseline) / weight;
+    prevThreshold = baseline * thresholdFactor;
+
+    // Shift history
+    prev2 = prev1;
+    prev1 = sample;
+
+    return found;
+}
+
+// ============================================================================
+// STREAMING VALLEY DETECTOR
+// ============================================================================
+
+StreamingValleyDetector::StreamingValleyDetector(int fs, float min_distance, float baseline_window) {
+    // Same rounding as valleyDetection()
+    minSpacing = (int)ceil(min_distance * fs);
+    baselineSamples = (long)(baseline_window * fs);
+    if (baselineSamples < 1) {
+        baselineSamples = 1;
+    }
+    reset();
+}
+
+void StreamingValleyDetector::reset() {
+    baseline = 0;
+    sampleCount = 0;
+    runMinIndex = -1;
+    runMinValue = 0;
+    lastValleyIndex = -1;
+}
+
+/*
+ * Mirrors valleyDetection(): track the minimum of each run of samples at
+ * or below the baseline; when the run ends, accept its minimum as a valley
+ * if it is more than min_distance after the previous one.
+ */
+bool StreamingValleyDetector::process(float sample, CycleSegment* cycle) {
+    bool completed = false;
+    long index = sampleCount;
+
+    // Update adaptive baseline: cumulative mean during warm-up, then EMA
+    sampleCount++;
+    long weight = sampleCount < baselineSamples ? sampleCount : baselineSamples;
+    baseline += (sample - baseline) / weight;
+
+    if (sample <= baseline) {
+        // Below baseline - extend current valley run
+        if (runMinIndex < 0 || sample < runMinValue) {
+            runMinIndex = index;
+            runMinValue = sample;
+        }
+    } else if (runMinIndex >= 0) {
+        // Run ended - its minimum is a valley candidate
+        if (lastValleyIndex < 0 || (runMinIndex - lastValleyIndex) > minSpacing) {
+            if (lastValleyIndex >= 0) {
+                cycle->start = (int)lastValleyIndex;
+                cycle->end = (int)runMinIndex;
+                completed = true;
+            }
+            lastValleyIndex = runMinIndex;
+        }
+        runMinIndex = -1;
+    }
+
+    return completed;
+}
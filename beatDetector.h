@@ -0,0 +1,209 @@
+/*
+ * beatDetector.h
+ *
+ * Online (sample-by-sample) heartbeat detection for PPG signals.
+ *
+ * OVERVIEW:
+ * thresholdPeakDetection() in processing.h needs the whole 60-second
+ * window to compute its global mean before the first peak can be found.
+ * StreamingPeakDetector applies the same rules as each sample arrives:
+ * - A peak is a local maximum (greater than both neighbours)
+ * - It must be at or above threshold_factor * signal mean
+ * - It must be more than min_distance seconds after the previous peak
+ *
+ * ADAPTIVE THRESHOLD:
+ * The global mean is replaced by a running baseline. For the first
+ * baseline_window seconds this is the cumulative mean of all samples (so
+ * a short recording behaves like the batch detector); after that it
+ * becomes an exponential moving average with the same time constant, so
+ * the threshold follows slow baseline drift (breathing, posture, sensor
+ * pressure) instead of being fixed for the whole recording.
+ *
+ * LATENCY:
+ * A local maximum can only be confirmed once the next sample is known,
+ * so each peak is reported exactly one sample after it occurs - well
+ * inside one refractory period (min_distance).
+ *
+ * CYCLE SEGMENTS:
+ * StreamingValleyDetector applies the rules of valleyDetection() online
+ * and emits each completed cardiac cycle as a flat {start, end}
+ * CycleSegment (see processingTypes.h). SegmentRing stores the most recent
+ * segments in a fixed-capacity ring and can hand them to
+ * statisticDetection() / eliminateNoiseInTime() as one contiguous array.
+ *
+ * USAGE EXAMPLE:
+ *   StreamingPeakDetector detector(25, 0.9, 0.4);
+ *   long peakIndex;
+ *   if (detector.process(smoothedSample, &peakIndex)) { ...beat at peakIndex... }
+ *
+ *   StreamingValleyDetector valleys(25, 0.4);
+ *   SegmentRing<64> cycles;
+ *   CycleSegment cycle;
+ *   if (valleys.process(smoothedSample, &cycle)) cycles.push(cycle);
+ *
+ */
+
+#ifndef BEAT_DETECTOR_H
+#define BEAT_DETECTOR_H
+
+#include <Arduino.h>
+#include "processingTypes.h"  // CycleSegment
+
+// Default time constant of the adaptive baseline (seconds)
+#define BEAT_BASELINE_WINDOW 2.0
+
+// ============================================================================
+// STREAMING PEAK DETECTOR
+// ============================================================================
+
+class StreamingPeakDetector {
+public:
+    // Parameters (same meaning as thresholdPeakDetection()):
+    //   fs: Sampling frequency (Hz)
+    //   threshold_factor: Multiplier for the baseline threshold (typical: 0.8-1.2)
+    //   min_distance: Minimum time between peaks (seconds, typical: 0.4)
+    //   baseline_window: Time constant of the adaptive baseline (seconds)
+    StreamingPeakDetector(int fs, float threshold_factor, float min_distance,
+                          float baseline_window = BEAT_BASELINE_WINDOW);
+
+    // Forget all history (start of a new recording)
+    void reset();
+
+    // Add one sample. Returns true if a peak was confirmed; its absolute
+    // sample index (counted from the last reset) is written to peakIndex.
+    bool process(float sample, long* peakIndex);
+
+    // Current adaptive threshold (threshold_factor * baseline)
+    float threshold() const { return baseline * thresholdFactor; }
+
+    // Number of samples processed since reset
+    long samplesSeen() const { return sampleCount; }
+
+    // Index of the most recent peak (-1 if none yet)
+    long lastPeak() const { return lastPeakIndex; }
+
+private:
+    float thresholdFactor;
+    int minSpacing;        // Minimum samples between peaks (TH_elapsed)
+    long baselineSamples;  // Samples in the baseline time constant
+
+    float baseline;        // Running mean (cumulative, then EMA)
+    float prevThreshold;   // Threshold at the time of the previous sample
+    float prev1, prev2;    // Previous two samples
+    long sampleCount;      // Samples processed
+    long lastPeakIndex;    // Index of last accepted peak
+};
+
+// ============================================================================
+// STREAMING VALLEY DETECTOR
+// ============================================================================
+
+class StreamingValleyDetector {
+public:
+    // Parameters (same meaning as valleyDetection()):
+    //   fs: Sampling frequency (Hz)
+    //   min_distance: Minimum time between valleys (seconds)
+    //   baseline_window: Time constant of the adaptive baseline (seconds)
+    StreamingValleyDetector(int fs, float min_distance,
+                            float baseline_window = BEAT_BASELINE_WINDOW);
+
+    // Forget all history (start of a new recording)
+    void reset();
+
+    // Add one sample. Returns true when a cardiac cycle has completed; the
+    // segment from the previous valley to the new one is written to cycle.
+    // A valley is confirmed when the signal rises back above the baseline,
+    // so latency is at most one cardiac cycle.
+    bool process(float sample, CycleSegment* cycle);
+
+    // Index of the most recent accepted valley (-1 if none yet)
+    long lastValley() const { return lastValleyIndex; }
+
+private:
+    int minSpacing;        // Minimum samples between valleys (TH_elapsed)
+    long baselineSamples;  // Samples in the baseline time constant
+
+    float baseline;        // Running mean (cumulative, then EMA)
+    long sampleCount;      // Samples processed
+    long runMinIndex;      // Minimum of current below-baseline run (-1 = no run)
+    float runMinValue;     // Value at runMinIndex
+    long lastValleyIndex;  // Index of last accepted valley
+};
+
+// ============================================================================
+// SEGMENT RING
+// ============================================================================
+
+// Fixed-capacity ring of the most recent cycle segments
+// When full, pushing a new segment overwrites the oldest one (counted in
+// overwritten()). No heap allocation; storage is part of the object.
+template <int CAPACITY>
+class SegmentRing {
+public:
+    SegmentRing() { clear(); }
+
+    void clear() {
+        head = 0;
+        count = 0;
+        overwrites = 0;
+    }
+
+    // Append a segment (drops the oldest if the ring is full)
+    void push(const CycleSegment& segment) {
+        if (count < CAPACITY) {
+            buffer[(head + count) % CAPACITY] = segment;
+            count++;
+        } else {
+            buffer[head] = segment;
+            head = (head + 1) % CAPACITY;
+            overwrites++;
+        }
+    }
+
+    // Remove the oldest segment (returns false if empty)
+    bool pop(CycleSegment* segment) {
+        if (count == 0) {
+            return false;
+        }
+        *segment = buffer[head];
+        head = (head + 1) % CAPACITY;
+        count--;
+        return true;
+    }
+
+    // Segment i, oldest first
+    const CycleSegment& operator[](int i) const { return buffer[(head + i) % CAPACITY]; }
+
+    int size() const { return count; }
+    bool isFull() const { return count == CAPACITY; }
+    unsigned long overwritten() const { return overwrites; }
+
+    // Return all segments as one contiguous array, oldest first, for
+    // statisticDetection() / eliminateNoiseInTime(). If the ring has
+    // wrapped, storage is rotated in place first (O(CAPACITY), no copy).
+    const CycleSegment* linearize() {
+        if (head + count > CAPACITY) {
+            reverse(0, head);
+            reverse(head, CAPACITY);
+            reverse(0, CAPACITY);
+            head = 0;
+        }
+        return &buffer[head];
+    }
+
+private:
+    CycleSegment buffer[CAPACITY];
+    int head;                  // Index of oldest segment
+    int count;                 // Segments stored
+    unsigned long overwrites;  // Segments lost because the ring was full
+
+    void reverse(int from, int to) {
+        for (to--; from < to; from++, to--) {
+            CycleSegment tmp = buffer[from];
+            buffer[from] = buffer[to];
+            buffer[to] = tmp;
+        }
+    }
+};
+
+#endif
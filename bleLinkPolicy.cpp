@@ -0,0 +1,117 @@
+/*
+ * bleLinkPolicy.cpp
+ *
+ * Implementation of the BLE connection parameter and PHY policy.
+ * See bleLinkPolicy.h for interface documentation.
+ */
+
+#include "bleLinkPolicy.h"
+
+bool linkParamsValid(const BLELinkParams& params) {
+    uint32_t effectiveMs = (uint32_t)params.interval * 5 / 4 * (params.latency + 1);
+    uint32_t timeoutMs = (uint32_t)params.timeout * 10;
+    return params.interval >= 12 && effectiveMs <= 2000 && timeoutMs > 3 * effectiveMs &&
+           timeoutMs <= 6000;
+}
+
+BLELinkParams BLELinkPolicy::requested(BLELinkMode mode) {
+    BLELinkParams params;
+    if (mode == BLE_LINK_STREAMING) {
+        params.interval = BLE_LINK_STREAM_INTERVAL;
+        params.latency = BLE_LINK_STREAM_LATENCY;
+        params.timeout = BLE_LINK_STREAM_TIMEOUT;
+        params.phy = BLE_LINK_STREAM_PHY;
+    } else {
+        params.interval = BLE_LINK_IDLE_INTERVAL;
+        params.latency = BLE_LINK_IDLE_LATENCY;
+        params.timeout = BLE_LINK_IDLE_TIMEOUT;
+        params.phy = BLE_LINK_IDLE_PHY;
+    }
+    return params;
+}
+
+BLELinkPolicy::BLELinkPolicy()
+    : connHandle(BLE_CONN_HANDLE_INVALID), mode(BLE_LINK_IDLE), attempts(0), lastRequest(0),
+      requests(0) {
+    memset(&current, 0, sizeof(current));
+}
+
+void BLELinkPolicy::begin(uint16_t connHandle, BLELinkMode mode) {
+    this->connHandle = connHandle;
+    this->mode = mode;
+    memset(&current, 0, sizeof(current));
+    attempts = 0;
+    requests = 0;
+    update();
+}
+
+void BLELinkPolicy::end() {
+    connHandle = BLE_CONN_HANDLE_INVALID;
+}
+
+void BLELinkPolicy::setMode(BLELinkMode mode) {
+    if (mode == this->mode) {
+        return;
+    }
+    this->mode = mode;
+    attempts = 0;
+    update();
+}
+
+bool BLELinkPolicy::update() {
+    BLEConnection* connection = isActive() ? Bluefruit.Connection(connHandle) : NULL;
+    if (connection == NULL) {
+        return false;
+    }
+
+    BLELinkParams now;
+    now.interval = connection->getConnectionInterval();
+    now.latency = connection->getSlaveLatency();
+    now.timeout = connection->getSupervisionTimeout();
+    now.phy = connection->getPHY();
+    bool changed = memcmp(&now, &current, sizeof(now)) != 0;
+    current = now;
+    if (changed) {
+        report();
+    }
+
+    // Ask (again) while the preset is not in place; give the central time
+    // to run the update procedure before repeating
+    if (!satisfied() && attempts < BLE_LINK_MAX_ATTEMPTS &&
+        (attempts == 0 || millis() - lastRequest >= BLE_LINK_RETRY_MS)) {
+        request(connection);
+    }
+    return changed;
+}
+
+bool BLELinkPolicy::satisfied() const {
+    BLELinkParams target = requested(mode);
+    bool phyOk = target.phy == BLE_GAP_PHY_AUTO || current.phy == target.phy;
+    return current.interval == target.interval && current.latency == target.latency &&
+           current.timeout == target.timeout && phyOk;
+}
+
+void BLELinkPolicy::request(BLEConnection* connection) {
+    BLELinkParams target = requested(mode);
+    if (current.interval != target.interval || current.latency != target.latency ||
+        current.timeout != target.timeout) {
+        connection->requestConnectionParameter(target.interval, target.latency, target.timeout);
+    }
+    if (target.phy != BLE_GAP_PHY_AUTO && current.phy != target.phy) {
+        connection->requestPHY(target.phy);
+    }
+    attempts++;
+    requests++;
+    lastRequest = millis();
+}
+
+void BLELinkPolicy::report() const {
+    Serial.print("BLE link: interval ");
+    Serial.print(current.interval * 1.25);
+    Serial.print(" ms, latency ");
+    Serial.print((int)current.latency);
+    Serial.print(", timeout ");
+    Serial.print((int)current.timeout * 10);
+    Serial.print(" ms, PHY ");
+    Serial.println(current.phy == BLE_GAP_PHY_2MBPS ? "2M" : current.phy == BLE_GAP_PHY_CODED ? "coded" : "1M");
+}
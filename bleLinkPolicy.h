@@ -0,0 +1,126 @@
+/*
+ * bleLinkPolicy.h
+ *
+ * BLE connection parameter and PHY policy for the peripheral.
+ *
+ * OVERVIEW:
+ * The central picks the connection interval, slave latency, supervision
+ * timeout and PHY, and phones differ widely (7.5-50 ms intervals, 1M or
+ * 2M PHY), so throughput and radio power used to depend on the phone.
+ * BLELinkPolicy requests parameters that suit what the device is doing:
+ * - STREAMING: short interval, no latency, 2M PHY - packets go out within
+ *   one interval and spend half as long on air
+ * - IDLE (connected, not recording): long interval with slave latency, so
+ *   the radio wakes every interval * (latency + 1) = 1.5 s
+ * The central may grant something else, or nothing. update() polls what
+ * was granted, reports every change on Serial and re-requests up to
+ * BLE_LINK_MAX_ATTEMPTS times per mode change, BLE_LINK_RETRY_MS apart,
+ * then accepts what it has.
+ *
+ * UNITS:
+ * As on air: interval in 1.25 ms units, timeout in 10 ms units.
+ * The presets follow Apple's accessory guidelines (interval >= 15 ms,
+ * interval * (latency + 1) <= 2 s, timeout > 3 * interval * (latency + 1),
+ * timeout <= 6 s), which Android accepts as well; see linkParamsValid().
+ *
+ * THREADING:
+ * Call everything from one task (the loop): update() looks the connection
+ * up by handle on every call, so a disconnect in the BLE task never
+ * leaves it with a stale pointer.
+ *
+ * USAGE EXAMPLE:
+ *   BLELinkPolicy link;
+ *   link.begin(connHandle, BLE_LINK_IDLE);      // After connecting
+ *   link.setMode(BLE_LINK_STREAMING);           // Recording started
+ *   link.update();                              // Every loop() pass
+ *   BLELinkParams granted = link.granted();
+ *
+ */
+
+#ifndef BLE_LINK_POLICY_H
+#define BLE_LINK_POLICY_H
+
+#include <Arduino.h>
+#include <bluefruit.h>
+
+// ============================================================================
+// POLICY PRESETS
+// ============================================================================
+
+// Streaming: 30 ms interval, every event, 2M PHY
+#define BLE_LINK_STREAM_INTERVAL 24     // x 1.25 ms = 30 ms
+#define BLE_LINK_STREAM_LATENCY 0
+#define BLE_LINK_STREAM_TIMEOUT 200     // x 10 ms = 2 s
+#define BLE_LINK_STREAM_PHY BLE_GAP_PHY_2MBPS
+
+// Idle: 300 ms interval, may skip 4 events (1.5 s between radio wakes)
+#define BLE_LINK_IDLE_INTERVAL 240      // x 1.25 ms = 300 ms
+#define BLE_LINK_IDLE_LATENCY 4
+#define BLE_LINK_IDLE_TIMEOUT 600       // x 10 ms = 6 s
+#define BLE_LINK_IDLE_PHY BLE_GAP_PHY_AUTO  // Keep what streaming negotiated
+
+#define BLE_LINK_MAX_ATTEMPTS 3         // Requests per mode change
+#define BLE_LINK_RETRY_MS 5000          // Time the central gets to apply one
+
+// ============================================================================
+// LINK POLICY
+// ============================================================================
+
+enum BLELinkMode {
+    BLE_LINK_IDLE,
+    BLE_LINK_STREAMING
+};
+
+struct BLELinkParams {
+    uint16_t interval;          // 1.25 ms units
+    uint16_t latency;           // Connection events the peripheral may skip
+    uint16_t timeout;           // Supervision timeout, 10 ms units
+    uint8_t phy;                // BLE_GAP_PHY_1MBPS / 2MBPS (AUTO in a preset: no request)
+};
+
+// True if params meet the guideline limits above
+bool linkParamsValid(const BLELinkParams& params);
+
+class BLELinkPolicy {
+public:
+    BLELinkPolicy();
+
+    // Start managing a new connection in the given mode
+    void begin(uint16_t connHandle, BLELinkMode mode);
+
+    // Stop (after a disconnect)
+    void end();
+
+    bool isActive() const { return connHandle != BLE_CONN_HANDLE_INVALID; }
+
+    // Request the preset for mode (no-op if already in it)
+    void setMode(BLELinkMode mode);
+    BLELinkMode getMode() const { return mode; }
+
+    // Read the granted parameters, report changes and retry requests the
+    // central has not applied. Returns: true if the granted set changed.
+    bool update();
+
+    // Parameters last read from the connection
+    BLELinkParams granted() const { return current; }
+
+    // Preset requested for a mode
+    static BLELinkParams requested(BLELinkMode mode);
+
+    // Requests sent since begin()
+    uint32_t requestCount() const { return requests; }
+
+private:
+    uint16_t connHandle;
+    BLELinkMode mode;
+    BLELinkParams current;
+    uint8_t attempts;           // Requests sent for the current mode
+    unsigned long lastRequest;
+    uint32_t requests;
+
+    bool satisfied() const;
+    void request(BLEConnection* connection);
+    void report() const;
+};
+
+#endif
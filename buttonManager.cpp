@@ -124,6 +124,12 @@ bool ButtonManager::isDoublePress() {
     return false;
 }
 
+bool ButtonManager::isBusy() const {
+    // Pressed, waiting out the double press window, or locked out: the
+    // outcome depends on time passing, not only on the next edge
+    return isPressed || isSecondPress || lockOut;
+}
+
 // ============================================================================
 // LED Control - Visual feedback for device state
 // ============================================================================
@@ -31,6 +31,7 @@ public:
     void handleButton();          // Call this regularly in the loop
     bool isLongPress();           // Returns true if a long press is detected
     bool isDoublePress();         // Returns true if a double press is detected
+    bool isBusy() const;          // True while a press pattern is in progress (keep calling handleButton())
     void setLEDs(bool green, bool red, bool blue); // // Note: Assumes common cathode LED (active LOW)
 
 private:
@@ -0,0 +1,138 @@
+/*
+ * eventScheduler.cpp
+ *
+ * Implementation of the cooperative event and timer scheduler.
+ * See eventScheduler.h for interface documentation.
+ */
+
+#include "eventScheduler.h"
+#include <algorithm>
+
+EventScheduler::EventScheduler() : pending(0), loopTask(nullptr), timerCount(0), sleeps(0), handlersRun(0) {
+    memset(events, 0, sizeof(events));
+    memset(timers, 0, sizeof(timers));
+}
+
+void EventScheduler::onEvent(uint8_t event, SchedulerHandler handler, void* context) {
+    if (event < SCHEDULER_MAX_EVENTS) {
+        events[event].handler = handler;
+        events[event].context = context;
+    }
+}
+
+void EventScheduler::post(uint8_t event) {
+    if (event >= SCHEDULER_MAX_EVENTS) {
+        return;
+    }
+    pending.fetch_or(1u << event);
+    
+    // Before the first runOnce() there is nobody to wake: it checks pending first
+    TaskHandle_t task = loopTask.load();
+    if (task == nullptr) {
+        return;
+    }
+    if (isInISR()) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(task, &woken);
+        portYIELD_FROM_ISR(woken);
+    } else {
+        xTaskNotifyGive(task);
+    }
+}
+
+int EventScheduler::addTimer(SchedulerHandler handler, void* context) {
+    if (timerCount >= SCHEDULER_MAX_TIMERS) {
+        return -1;
+    }
+    timers[timerCount].handler = handler;
+    timers[timerCount].context = context;
+    timers[timerCount].running = false;
+    return timerCount++;
+}
+
+void EventScheduler::startTimer(int timer, unsigned long delayMs, unsigned long periodMs) {
+    if (timer < 0 || timer >= timerCount) {
+        return;
+    }
+    timers[timer].due = millis() + delayMs;
+    timers[timer].period = periodMs;
+    timers[timer].running = true;
+}
+
+void EventScheduler::stopTimer(int timer) {
+    if (timer >= 0 && timer < timerCount) {
+        timers[timer].running = false;
+    }
+}
+
+bool EventScheduler::isTimerRunning(int timer) const {
+    return timer >= 0 && timer < timerCount && timers[timer].running;
+}
+
+unsigned long EventScheduler::timeToNextTimer(unsigned long now) const {
+    unsigned long next = SCHEDULER_NO_TIMER;
+    for (int i = 0; i < timerCount; i++) {
+        if (!timers[i].running) {
+            continue;
+        }
+        // Signed difference, so millis() wrap-around is harmless
+        long remaining = (long)(timers[i].due - now);
+        if (remaining <= 0) {
+            return 0;
+        }
+        next = std::min(next, (unsigned long)remaining);
+    }
+    return next;
+}
+
+int EventScheduler::dispatch() {
+    int run = 0;
+    
+    // Take all pending events at once; ones posted meanwhile wait for the next call
+    uint32_t posted = pending.exchange(0, std::memory_order_acquire);
+    for (uint8_t event = 0; posted != 0; event++, posted >>= 1) {
+        if ((posted & 1) && events[event].handler != nullptr) {
+            events[event].handler(events[event].context);
+            run++;
+        }
+    }
+    
+    unsigned long now = millis();
+    for (int i = 0; i < timerCount; i++) {
+        Timer& timer = timers[i];
+        if (!timer.running || (long)(now - timer.due) < 0) {
+            continue;
+        }
+        if (timer.period > 0) {
+            // Keep the period's phase; skip runs missed while busy
+            do {
+                timer.due += timer.period;
+            } while ((long)(now - timer.due) >= 0);
+        } else {
+            timer.running = false;
+        }
+        // The handler may restart or stop this or any timer
+        timer.handler(timer.context);
+        run++;
+    }
+    handlersRun += run;
+    return run;
+}
+
+void EventScheduler::runOnce() {
+    if (loopTask.load() == nullptr) {
+        loopTask.store(xTaskGetCurrentTaskHandle());
+    }
+    dispatch();
+    if (pending.load() != 0) {
+        return;
+    }
+    unsigned long wait = timeToNextTimer(millis());
+    if (wait == 0) {
+        return;
+    }
+    
+    // A tick late rather than early, which would cost another pass
+    sleeps++;
+    ulTaskNotifyTake(pdTRUE, wait == SCHEDULER_NO_TIMER ? portMAX_DELAY : pdMS_TO_TICKS(wait) + 1);
+}
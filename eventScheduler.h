@@ -0,0 +1,114 @@
+/*
+ * eventScheduler.h
+ *
+ * Cooperative event and timer scheduler for the loop task.
+ *
+ * OVERVIEW:
+ * Instead of loop() polling every manager on every pass, work is posted
+ * as events (button edge, FIFO block ready, BLE activity) or scheduled on
+ * timers, and runOnce() runs only the handlers that have something to do.
+ * With nothing pending the loop task blocks on its task notification
+ * until post() or the next timer, so the CPU idles between events instead
+ * of spinning.
+ * - Events are bit flags: posting one that is already pending does
+ *   nothing, so a handler must look at its source for how much there is
+ *   (blocks in a ring, the button's pin level)
+ * - Timers are one-shot or periodic, in millis(); the loop task wakes for
+ *   the earliest one, up to one RTOS tick (~1 ms) late
+ * Handlers run to completion in the loop task, in event order and then
+ * timer order; they should not block (use a one-shot timer, not delay()).
+ *
+ * THREADING:
+ * post() may be called from interrupts and other tasks (BLE, deferred
+ * interrupt task); everything else from the loop task only, which is the
+ * task that first calls runOnce(). No wake-up is lost between the pending
+ * check and the wait: a post() in between leaves the notification given,
+ * so the wait returns at once.
+ *
+ * POWER:
+ * While the loop task waits, every task may be blocked, so tickless idle
+ * stops the RTOS tick and the CPU sleeps until an interrupt or the next
+ * timer: an idle device costs one short pass per event or timer, not one
+ * per tick.
+ *
+ * USAGE EXAMPLE:
+ *   EventScheduler scheduler;
+ *   scheduler.onEvent(EVENT_BUTTON, serviceButton);
+ *   int batteryTimer = scheduler.addTimer(readBattery);
+ *   scheduler.startTimer(batteryTimer, 60000, 60000);   // Every minute
+ *   attachInterrupt(pin, [] { scheduler.post(EVENT_BUTTON); }, CHANGE);
+ *   void loop() { scheduler.runOnce(); }
+ *
+ */
+
+#ifndef EVENT_SCHEDULER_H
+#define EVENT_SCHEDULER_H
+
+#include <Arduino.h>
+#include <atomic>
+
+#define SCHEDULER_MAX_EVENTS 16
+#define SCHEDULER_MAX_TIMERS 8
+#define SCHEDULER_NO_TIMER 0xFFFFFFFFul
+
+typedef void (*SchedulerHandler)(void* context);
+
+class EventScheduler {
+public:
+    EventScheduler();
+
+    // Run handler when event (0 - SCHEDULER_MAX_EVENTS-1) is posted
+    void onEvent(uint8_t event, SchedulerHandler handler, void* context = nullptr);
+
+    // Mark event pending (any task or interrupt)
+    void post(uint8_t event);
+
+    // Returns: timer id, or -1 if all SCHEDULER_MAX_TIMERS are taken
+    int addTimer(SchedulerHandler handler, void* context = nullptr);
+
+    // Run the timer's handler delayMs from now, then every periodMs (0 = once);
+    // restarting a running timer replaces its schedule
+    void startTimer(int timer, unsigned long delayMs, unsigned long periodMs = 0);
+    void stopTimer(int timer);
+    bool isTimerRunning(int timer) const;
+
+    // Run the handlers of pending events, then of due timers
+    // Returns: number of handlers run
+    int dispatch();
+
+    // dispatch(), then block until post() or the next timer unless more
+    // work is pending (call as the whole of loop())
+    void runOnce();
+
+    // Statistics since construction
+    uint32_t sleepCount() const { return sleeps; }
+    uint32_t handlerCount() const { return handlersRun; }
+
+private:
+    struct EventSlot {
+        SchedulerHandler handler;
+        void* context;
+    };
+
+    struct Timer {
+        SchedulerHandler handler;
+        void* context;
+        bool running;
+        unsigned long due;          // millis()
+        unsigned long period;
+    };
+
+    std::atomic<uint32_t> pending;  // Bit per event
+    std::atomic<TaskHandle_t> loopTask;  // Notified by post(), set by runOnce()
+    EventSlot events[SCHEDULER_MAX_EVENTS];
+    Timer timers[SCHEDULER_MAX_TIMERS];
+    int timerCount;
+    uint32_t sleeps;
+    uint32_t handlersRun;
+
+    // Returns: ms until the earliest timer is due (0: due), or
+    // SCHEDULER_NO_TIMER if none is running
+    unsigned long timeToNextTimer(unsigned long now) const;
+};
+
+#endif
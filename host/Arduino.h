@@ -0,0 +1,232 @@
+/*
+ * Arduino.h (host stub)
+ *
+ * Minimal stand-in for the Arduino core so the firmware sources can be
+ * compiled and run on Linux. Only what they use is provided: fixed-width
+ * integer types, Serial printing, millis()/micros()/delay(), GPIO, ADC
+ * and pin interrupts, the FreeRTOS task calls the firmware uses (run on
+ * std::thread), and the nRF52 registers sleepMode() touches (nRF52 core
+ * flavour).
+ * Simulations can switch time to a virtual clock that only moves when
+ * they advance it, and drive input pins and ADC readings.
+ *
+ * NOT FOR FIRMWARE BUILDS: The Arduino IDE only compiles the sketch root
+ * (and src/), so nothing in host/ is ever linked into the device image.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+
+#define HEX 16
+#define DEC 10
+
+// Pin modes, levels and interrupt modes (nRF52 core values)
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+#define INPUT_PULLDOWN 0x3
+#define LOW 0x0
+#define HIGH 0x1
+#define CHANGE 0x2
+#define FALLING 0x3
+#define RISING 0x4
+#define ISR_DEFERRED 0x10
+#define INPUT_PULLUP_SENSE 0x4      // INPUT_PULLUP, and wake from SYSTEMOFF on LOW
+
+#define D7 7
+
+// Seeed XIAO nRF52840 RGB LED (active LOW)
+#define LED_RED 11
+#define LED_BLUE 12
+#define LED_GREEN 13
+
+#define HOST_PIN_COUNT 48
+
+// Serial output goes to stderr so benchmark results on stdout stay clean;
+// setQuiet(true) discards it (set before any firmware task starts)
+class HostSerial {
+public:
+    void begin(unsigned long) {}
+    operator bool() const { return true; }
+    void setQuiet(bool on) { quiet = on; }
+
+    void print(const char* s);
+    void print(char c);
+    void print(int value, int base = DEC);
+    void print(unsigned int value, int base = DEC);
+    void print(long value, int base = DEC);
+    void print(unsigned long value, int base = DEC);
+    void print(double value, int digits = 2);
+
+    void println();
+    void flush() {}
+    template <typename T>
+    void println(T value) { print(value); println(); }
+    template <typename T>
+    void println(T value, int format) { print(value, format); println(); }
+
+private:
+    bool quiet = false;
+};
+
+extern HostSerial Serial;
+
+// Time since program start (or virtual time, see below)
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+// Virtual clock: while enabled, time starts at 0 and only moves with
+// hostAdvanceClock(), delay() or a wait of the loop task
+// (ulTaskNotifyTake(), below), so simulations are exact and fast
+void hostUseVirtualClock(bool enable);
+bool hostClockIsVirtual();
+void hostAdvanceClock(unsigned long us);
+
+// Time spent in delay() and ulTaskNotifyTake() on the virtual clock, where
+// the loop task blocks and the CPU is free to sleep
+unsigned long long hostBlockedMicros();
+
+// Called after every virtual clock advance (hostAdvanceClock(), delay()),
+// so simulated peripherals keep up with firmware that busy-waits
+typedef void (*HostClockListener)(void* context);
+void hostAddClockListener(HostClockListener listener, void* context);
+void hostRemoveClockListener(HostClockListener listener, void* context);
+
+// On the wall clock, firmware tasks (std::threads, see FREERTOS below) and
+// the board thread (hostBoard.h) use the simulated peripherals at once.
+// The stand-ins (pins, Wire, Bluefruit) hold this recursive lock while
+// they touch them, as the hardware serialises accesses; handlers they run
+// (pin interrupts, BLE callbacks) run with it held.
+class HostLock {
+public:
+    HostLock();
+    ~HostLock();
+};
+
+// ============================================================================
+// GPIO / ADC
+// ============================================================================
+
+void pinMode(uint32_t pin, uint32_t mode);
+void digitalWrite(uint32_t pin, uint32_t value);
+int digitalRead(uint32_t pin);
+uint32_t analogRead(uint32_t pin);
+
+// Interrupts on input pins; handlers run synchronously when a simulation
+// drives the edge, in interrupt context (isInISR()) unless attached with
+// ISR_DEFERRED, which runs them in a task on the nRF52 core
+inline uint32_t digitalPinToInterrupt(uint32_t pin) { return pin; }
+int attachInterrupt(uint32_t pin, void (*handler)(void), uint32_t mode);
+void detachInterrupt(uint32_t pin);
+bool isInISR();
+
+// Simulation control: drive an input from outside the MCU (e.g. an
+// open-drain INT line or a button); hostReleasePin() leaves it to the
+// pull resistor. Drives matching interrupt edges.
+void hostSetPin(uint32_t pin, int level);
+void hostReleasePin(uint32_t pin);
+void hostSetAnalog(uint32_t pin, uint32_t value);
+
+// Level last written by the firmware to an output pin
+int hostPinOutput(uint32_t pin);
+
+// Forget pin modes, levels, interrupts and the nRF52 registers below
+// (between simulations, or at a simulated reset)
+void hostResetPins();
+
+// ============================================================================
+// FREERTOS
+// ============================================================================
+
+// The nRF52 core's Arduino.h includes FreeRTOS (rtos.h). Tasks here are
+// std::threads: priorities are recorded but not enforced, ticks are
+// 1/HOST_RTOS_TICK_HZ s, and a task ends by returning after
+// vTaskDelete(NULL). Recursive mutexes are std::recursive_timed_mutexes.
+// Threads not created by xTaskCreate() (the program's own) act as the
+// loop task: xTaskGetCurrentTaskHandle() returns it.
+// Tasks need real time, so xTaskCreate() fails while the virtual clock is
+// on (one thread owns simulated time); firmware then runs without them,
+// as it would on a device out of heap. There the loop task's
+// ulTaskNotifyTake() moves the clock tick by tick until it is notified
+// (by a pin interrupt or BLE callback, which run as the clock moves) or
+// times out, or until hostSetWaitLimit()'s time, so a simulation can act
+// in between, or NRF_POWER->SYSTEMOFF is set (the device is off); nothing
+// else may wait without a timeout.
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void (*TaskFunction_t)(void* parameter);
+typedef struct HostTask* TaskHandle_t;
+typedef struct HostMutex* SemaphoreHandle_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xFFFFFFFFu
+#define HOST_RTOS_TICK_HZ 1024      // configTICK_RATE_HZ of the nRF52 core
+#define pdMS_TO_TICKS(ms) ((TickType_t)((uint64_t)(ms) * HOST_RTOS_TICK_HZ / 1000))
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
+#define configMINIMAL_STACK_SIZE 256  // Words
+
+// Task priorities of the nRF52 core (rtos.h); loop() runs at TASK_PRIO_LOW
+#define TASK_PRIO_LOWEST 0
+#define TASK_PRIO_LOW 1
+#define TASK_PRIO_NORMAL 2
+#define TASK_PRIO_HIGH 3
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackWords,
+                       void* parameter, UBaseType_t priority, TaskHandle_t* handle);
+void vTaskDelete(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken);
+
+// Virtual clock: the loop task's next waits return at this time (micros())
+// at the latest
+void hostSetWaitLimit(unsigned long long us);
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex();
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticksToWait);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex);
+
+// Wait for every task created so far to return (tests shut tasks down
+// through their own stop flag first)
+void hostJoinTasks();
+
+// ============================================================================
+// nRF52 REGISTERS
+// ============================================================================
+
+// Only what sleepMode() in wellby_firmware.ino uses; a simulation reads
+// them back to see the device enter SYSTEMOFF and what wakes it
+#define GPIO_PIN_CNF_SENSE_Pos 16
+#define GPIO_PIN_CNF_SENSE_Msk (0x3u << GPIO_PIN_CNF_SENSE_Pos)
+#define GPIO_PIN_CNF_SENSE_Disabled 0
+#define GPIO_PIN_CNF_SENSE_High 2
+#define GPIO_PIN_CNF_SENSE_Low 3
+
+struct HostNrfGpio {
+    volatile uint32_t PIN_CNF[32];
+};
+
+struct HostNrfPower {
+    volatile uint32_t SYSTEMOFF;
+};
+
+extern HostNrfGpio hostNrfGpio;
+extern HostNrfPower hostNrfPower;
+
+#define NRF_GPIO (&hostNrfGpio)
+#define NRF_POWER (&hostNrfPower)
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * LSM6DS3.h (host stub)
+ *
+ * The Seeed LSM6DS3 library interface, returning the motion a simulation
+ * sets in LSM6DS3::hostAccel / hostGyro (shared by all instances, like the
+ * one IMU on the board). At rest by default: 1 g on Z, no rotation.
+ */
+
+#ifndef HOST_LSM6DS3_H
+#define HOST_LSM6DS3_H
+
+#include "Arduino.h"
+
+#define I2C_MODE 0
+#define SPI_MODE 1
+
+typedef enum {
+    IMU_SUCCESS,
+    IMU_HW_ERROR,
+    IMU_NOT_SUPPORTED,
+    IMU_GENERIC_ERROR,
+    IMU_OUT_OF_BOUNDS,
+    IMU_ALL_ONES_WARNING,
+} status_t;
+
+class LSM6DS3 {
+public:
+    LSM6DS3(uint8_t busType = I2C_MODE, uint8_t inputArg = 0x6A) {}
+
+    status_t begin() { return IMU_SUCCESS; }
+
+    float readFloatAccelX() { return hostAccel[0]; }   // g
+    float readFloatAccelY() { return hostAccel[1]; }
+    float readFloatAccelZ() { return hostAccel[2]; }
+    float readFloatGyroX() { return hostGyro[0]; }     // deg/s
+    float readFloatGyroY() { return hostGyro[1]; }
+    float readFloatGyroZ() { return hostGyro[2]; }
+
+    // Simulation control
+    static inline float hostAccel[3] = {0, 0, 1};
+    static inline float hostGyro[3] = {0, 0, 0};
+};
+
+#endif
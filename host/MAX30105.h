@@ -0,0 +1,87 @@
+/*
+ * MAX30105.h (host stub)
+ *
+ * The parts of the SparkFun MAX30105 library used by PPGManager.cpp,
+ * implemented with the library's register accesses over the host Wire
+ * bus, so they configure and read the register-level simulation in
+ * max30105Sim.h. Sample storage and check()/safeCheck() follow the
+ * library: getRed()/getIR()/getGreen() wait up to 250 ms for a new sample
+ * and return the newest one.
+ */
+
+#ifndef HOST_MAX30105_H
+#define HOST_MAX30105_H
+
+#include "Wire.h"
+
+#define MAX30105_ADDRESS 0x57
+#define I2C_SPEED_STANDARD 100000
+#define I2C_SPEED_FAST 400000
+#define I2C_BUFFER_LENGTH HOST_WIRE_BUFFER
+
+#define MAX30105_STORAGE_SIZE 4     // Samples kept by check()
+
+class MAX30105 {
+public:
+    MAX30105();
+
+    // Returns: false if no MAX30105 answers (wrong part ID)
+    bool begin(TwoWire& wirePort = Wire, uint32_t i2cSpeed = I2C_SPEED_STANDARD,
+               uint8_t i2cAddress = MAX30105_ADDRESS);
+
+    // Library defaults: all LEDs at powerLevel, FIFO averaging and rollover,
+    // ledMode 1 = Red, 2 = Red + IR, 3 = Red + IR + Green
+    void setup(uint8_t powerLevel = 0x1F, uint8_t sampleAverage = 4, uint8_t ledMode = 3,
+               int sampleRate = 400, int pulseWidth = 411, int adcRange = 4096);
+
+    void softReset();
+    void shutDown();
+    void wakeUp();
+
+    void setPulseAmplitudeRed(uint8_t value);
+    void setPulseAmplitudeIR(uint8_t value);
+    void setPulseAmplitudeGreen(uint8_t value);
+    void setPulseAmplitudeProximity(uint8_t value);
+
+    void setFIFOAverage(uint8_t samples);
+    void enableFIFORollover();
+    void setFIFOAlmostFull(uint8_t freeSlots);
+    void enableAFULL();
+    void disableAFULL();
+    void enablePROXINT();
+    void disablePROXINT();
+    void setProximityThreshold(uint8_t threshMSB);
+    uint8_t getINT1();
+    void clearFIFO();
+
+    // Read new FIFO samples into storage; returns the number read
+    uint16_t check();
+    uint8_t available();
+
+    // Newest sample (waits up to 250 ms for one; 0 on timeout)
+    uint32_t getRed();
+    uint32_t getIR();
+    uint32_t getGreen();
+
+    uint8_t readPartID();
+    uint8_t readRegister8(uint8_t address, uint8_t reg);
+    void writeRegister8(uint8_t address, uint8_t reg, uint8_t value);
+
+private:
+    TwoWire* wire;
+    uint8_t address;
+    uint8_t activeLEDs;
+
+    struct {
+        uint32_t red[MAX30105_STORAGE_SIZE];
+        uint32_t IR[MAX30105_STORAGE_SIZE];
+        uint32_t green[MAX30105_STORAGE_SIZE];
+        uint8_t head;
+        uint8_t tail;
+    } sense;
+
+    bool safeCheck(uint8_t maxTimeToCheck);
+    void bitMask(uint8_t reg, uint8_t mask, uint8_t thing);
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * Wire.h (host stub)
+ *
+ * I2C master with the Arduino TwoWire interface. Transactions are routed
+ * to simulated devices (HostI2CDevice) attached by address, e.g. the
+ * register-level MAX30105 in max30105Sim.h. Transfers are limited to
+ * HOST_WIRE_BUFFER bytes like the Arduino core's Wire buffer.
+ */
+
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include "Arduino.h"
+
+#define HOST_WIRE_BUFFER 32
+#define HOST_WIRE_MAX_DEVICES 4
+
+// A simulated I2C slave
+class HostI2CDevice {
+public:
+    virtual ~HostI2CDevice() {}
+
+    // 7-bit address the device answers to
+    virtual uint8_t i2cAddress() const = 0;
+
+    // Master wrote 'length' bytes (first byte is usually a register address)
+    virtual void i2cWrite(const uint8_t* data, size_t length) = 0;
+
+    // Master reads 'length' bytes
+    virtual void i2cRead(uint8_t* data, size_t length) = 0;
+};
+
+class TwoWire {
+public:
+    TwoWire();
+
+    void begin() {}
+    void setClock(uint32_t) {}
+
+    void beginTransmission(uint8_t address);
+    void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+    size_t write(uint8_t value);
+    size_t write(const uint8_t* data, size_t length);
+    // Returns 0 on success, 2 if no device acknowledges the address
+    uint8_t endTransmission(bool stop = true);
+
+    // Returns the number of bytes received (0 if no device)
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, bool stop = true);
+    uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (uint8_t)quantity); }
+    int available();
+    int read();
+
+    // Simulation control
+    void attach(HostI2CDevice* device);
+    void detach(HostI2CDevice* device);
+
+    // Bus statistics
+    uint32_t transactions() const { return transactionCount; }
+    uint32_t bytesTransferred() const { return byteCount; }
+    void resetStatistics() { transactionCount = 0; byteCount = 0; }
+
+private:
+    HostI2CDevice* devices[HOST_WIRE_MAX_DEVICES];
+    uint8_t txAddress;
+    uint8_t txBuffer[HOST_WIRE_BUFFER];
+    size_t txLength;
+    uint8_t rxBuffer[HOST_WIRE_BUFFER];
+    size_t rxLength;
+    size_t rxIndex;
+    uint32_t transactionCount;
+    uint32_t byteCount;
+
+    HostI2CDevice* find(uint8_t address);
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,2721 @@
+/*
+ * bench.cpp
+ *
+ * Host benchmark for the on-device signal processing pipeline.
+ *
+ * OVERVIEW:
+ * Builds one recording (synthetic by default, or a recorded CSV) and
+ * reports, per processing stage:
+ * - ns/sample: median wall time of one call divided by the samples it
+ *   processes (the same window the firmware would process)
+ * - heap: peak bytes malloc'd during the call (see memoryTracker.h)
+ * - allocs: number of heap allocations per call
+ * - state: arena high-water mark, or object size for streaming stages
+ * The arena pipeline must make no heap allocation (and fit its arena),
+ * otherwise the run fails.
+ *
+ * Each stage is fed the precomputed output of the previous stage, so
+ * timings are isolated. Host timings are only comparable with each other;
+ * scale by the host/MCU speed ratio to estimate on-device cost.
+ *
+ * ACCURACY (labelled synthetic vectors only):
+ * - HRV from the batch pipeline vs the generator's true RR intervals
+ * - Streaming (live) peak detection vs batch detection and ground truth
+ * - Biquad (streamingFilters.h) vs batch bandpassFilter() and the original
+ *   batch loop: per sample, in-place blocks of random size and after
+ *   reset(), including the seeded start-up; any differing bit fails the run
+ * - Fixed-point (processingFixed.h) vs float pipeline, against the error
+ *   bounds that header promises
+ * - Per-beat SQI vs motion labels over a set of preset scenarios, each
+ *   with a floor on sensitivity and specificity
+ *
+ * ACQUISITION:
+ * PPGFifoReader (ppgFifo.h) drains a simulated register-level MAX30105
+ * (max30105Sim.h) at several poll intervals; every sample received is
+ * checked against the source, and lost samples against the simulator.
+ * A second table compares polling from loop() with draining on the
+ * simulated A_FULL interrupt through a PPGBlockRing, on a virtual clock:
+ * wake-ups, estimated MCU busy time and current, and how far each block's
+ * timestamp lags its newest sample. The current estimate is a model (see
+ * powerModel.h), not a measurement.
+ *
+ * PACKET FORMAT (ppgPacket.h):
+ * Every sample of the recording, plus edge values and random multi-channel
+ * frames, is encoded and decoded for each encoding and several packet
+ * sizes; any difference fails the run. Malformed packets must be rejected.
+ * Reports samples per notification and bytes per sample against the
+ * legacy int16 + 0xFE format, and how many samples that format wrapped.
+ *
+ * BATCHING (ppgBatcher.h):
+ * Recordings of random length are started and stopped through a sink that
+ * refuses packets at random and varies its packet size; every sample must
+ * arrive exactly once, in order, in its own recording, or be reported
+ * undelivered by the next start(). The hold time must bound how long a
+ * sample waits at a low packet rate.
+ *
+ * FIRMWARE ON HOST:
+ * PPGManager, BluetoothManager and PowerManager run unchanged on the host
+ * stand-ins (HostBoard, hostBoard.h): setup() and BLE-mode loop() passes on
+ * the virtual clock, a central connects and starts one recording of the
+ * input from the app. The app side decodes every notification and places
+ * its samples by timestamp; any sample out of place fails the run, as does
+ * a gap on a central whose link keeps up with the stream. Every HRV
+ * notification must arrive whole, with the expected size and version.
+ * Every sample the app found missing must be in the device's sample
+ * counters (diagnostics characteristic), which must stay at zero on links
+ * that keep up.
+ * One run disconnects a central that cannot keep up halfway through its
+ * recording and records again on a fast one: nothing of the first
+ * recording may reach the second central, whose stream must start at
+ * packet 0 and be complete.
+ *
+ * FIRMWARE TASKS:
+ * The same firmware on the wall clock, where setUpSensor() creates the
+ * acquisition, processing and BLE stage tasks (ppgTasks.h) as on the
+ * device; the board runs in its own thread. A few seconds recorded on a
+ * fast central must arrive complete and in place, with nothing dropped or
+ * counted lost; the run fails if the tasks could not be created.
+ *
+ * WEAR DETECTION (wearDetector.h):
+ * The simulated sensor is put on and taken off at random for a few hours
+ * of virtual time while WearDetector probes it in proximity mode at several
+ * search intervals. Every change must be reported once, within one probe
+ * interval, and nothing else; the time spent sampling at recording
+ * current, in proximity mode, and the sensor current (powerModel.h) are
+ * compared with the blocking once-a-minute check it replaces.
+ *
+ * RECORDING TASKS (ppgTasks.h):
+ * The acquisition, processing and BLE stages run as tasks on std::threads
+ * (Arduino.h FreeRTOS stand-in) with stand-in stages: a "sensor" thread
+ * raises the FIFO interrupt at random intervals while the main thread
+ * starts and stops recordings, processing has random bursts and the BLE
+ * stage refuses items or stalls at random. Every block must arrive in
+ * order, processed, in its own recording, or be counted by an overrun
+ * counter; every start/stop must reach every stage in order.
+ *
+ * SPSC RING (spscRing.h):
+ * A producer and a consumer thread move a numbered sequence through the
+ * ring using every push/pop variant (single, batch, prepare/commit,
+ * peek/consume); any lost, duplicated, reordered or torn item fails the
+ * run (on a single-core host the threads only interleave at preemption,
+ * so the test is stronger on multi-core machines). Throughput is compared
+ * with a mutex-guarded std::deque.
+ *
+ * USAGE:
+ *   ./bench [--hr BPM] [--sdnn MS] [--noise F] [--wander F] [--motion PER_MIN]
+ *           [--seconds S] [--seed N] [--reps N] [--csv FILE] [--dump FILE] [--serial]
+ *   --csv reads one raw sample per line (25 Hz) instead of generating
+ *   --dump writes the generated vector with its labels as CSV
+ *   --serial shows the firmware's Serial output (stderr), discarded by default
+ * Exits with status 1 if any check fails.
+ *
+ */
+
+#include "Arduino.h"
+#include "processing.h"
+#include "processingFixed.h"
+#include "streamingFilters.h"
+#include "beatDetector.h"
+#include "signalQuality.h"
+#include "rollingHrv.h"
+#include "ppgFifo.h"
+#include "spscRing.h"
+#include "ppgPacket.h"
+#include "ppgBatcher.h"
+#include "ppgTasks.h"
+#include "wearDetector.h"
+#include "bleLinkPolicy.h"
+#include "memoryTracker.h"
+#include "powerModel.h"
+#include "syntheticPpg.h"
+#include "max30105Sim.h"
+#include "hostBoard.h"
+#include "PPGManager.h"
+#include "BluetoothManager.h"
+#include "PowerManager.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define BENCH_FS 25                 // Firmware effective sampling rate
+#define BENCH_ARENA_BYTES 16384     // Arena for the heap-free pipeline
+#define MATCH_TOLERANCE 0.15        // Peak match tolerance vs ground truth (seconds)
+
+// Offsets used by the noise elimination thresholds (std, kurtosis, skew-, skew+)
+static float noiseThresholds[4] = {1.0, 1.0, 0.5, 0.5};
+
+// ============================================================================
+// OPTIONS
+// ============================================================================
+
+struct Options {
+    SyntheticPpgConfig synth;
+    int reps = 200;
+    const char* csvPath = NULL;
+    const char* dumpPath = NULL;
+    bool serial = false;
+};
+
+static void usage() {
+    printf("Usage: bench [--hr BPM] [--sdnn MS] [--noise F] [--wander F] [--motion PER_MIN]\n"
+           "             [--seconds S] [--seed N] [--reps N] [--csv FILE] [--dump FILE] [--serial]\n");
+}
+
+static bool parseOptions(int argc, char** argv, Options* options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--help") == 0) {
+            return false;
+        }
+        if (strcmp(arg, "--serial") == 0) {
+            options->serial = true;
+            continue;
+        }
+        if (value == NULL) {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return false;
+        }
+        i++;
+
+        if (strcmp(arg, "--hr") == 0) options->synth.heartRate = atof(value);
+        else if (strcmp(arg, "--sdnn") == 0) options->synth.sdnn = atof(value);
+        else if (strcmp(arg, "--noise") == 0) options->synth.noise = atof(value);
+        else if (strcmp(arg, "--wander") == 0) options->synth.wander = atof(value);
+        else if (strcmp(arg, "--motion") == 0) options->synth.motionBursts = atof(value);
+        else if (strcmp(arg, "--seconds") == 0) options->synth.seconds = atof(value);
+        else if (strcmp(arg, "--seed") == 0) options->synth.seed = (uint32_t)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--reps") == 0) options->reps = atoi(value);
+        else if (strcmp(arg, "--csv") == 0) options->csvPath = value;
+        else if (strcmp(arg, "--dump") == 0) options->dumpPath = value;
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            return false;
+        }
+    }
+    return options->reps > 0 && options->synth.seconds > 0;
+}
+
+// One raw sample per line; lines that do not start with a number are skipped
+static bool loadCsv(const char* path, std::vector<long>* samples) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return false;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char* end;
+        long value = strtol(line, &end, 10);
+        if (end != line) {
+            samples->push_back(value);
+        }
+    }
+    fclose(file);
+    return !samples->empty();
+}
+
+static void dumpCsv(const char* path, const SyntheticPpg& ppg) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return;
+    }
+    std::vector<uint8_t> isPeak(ppg.samples.size(), 0);
+    for (size_t i = 0; i < ppg.peaks.size(); i++) {
+        isPeak[ppg.peaks[i]] = 1;
+    }
+    fprintf(file, "index,raw,peak,motion\n");
+    for (size_t i = 0; i < ppg.samples.size(); i++) {
+        fprintf(file, "%zu,%ld,%d,%d\n", i, ppg.samples[i], isPeak[i], ppg.motion[i]);
+    }
+    fclose(file);
+}
+
+// Cheap xorshift generator for test values, batch sizes and method choice
+static uint32_t nextRandom(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// ============================================================================
+// STAGE TIMING
+// ============================================================================
+
+struct StageResult {
+    double nsPerSample;
+    size_t heapPeak;
+    size_t allocations;
+};
+
+// Run body 'reps' times (after one warm-up call) and report the median
+template <typename Body>
+static StageResult measure(int samples, int reps, Body body) {
+    body();
+
+    std::vector<double> times;
+    StageResult result = {0, 0, 0};
+    for (int r = 0; r < reps; r++) {
+        MemoryTracker::beginStage();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        body();
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        times.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+        result.heapPeak = std::max(result.heapPeak, MemoryTracker::stagePeak());
+        result.allocations = std::max(result.allocations, MemoryTracker::stageAllocations());
+    }
+
+    std::sort(times.begin(), times.end());
+    result.nsPerSample = times[times.size() / 2] / samples;
+    return result;
+}
+
+static void printHeader() {
+    printf("%-28s %12s %10s %7s %10s\n", "stage", "ns/sample", "heap (B)", "allocs", "state (B)");
+    printf("%-28s %12s %10s %7s %10s\n", "-----", "---------", "--------", "------", "---------");
+}
+
+static void printStage(const char* name, const StageResult& r, size_t state = 0) {
+    printf("%-28s %12.1f %10zu %7zu ", name, r.nsPerSample, r.heapPeak, r.allocations);
+    if (state > 0) {
+        printf("%10zu\n", state);
+    } else {
+        printf("%10s\n", "-");
+    }
+}
+
+// ============================================================================
+// LIVE PIPELINE (mirrors PPGManager::updateLiveHeartRate)
+// ============================================================================
+
+struct LivePipeline {
+    Biquad filter;
+    MovingAverage<PIPELINE_SMOOTHING_WINDOW> smoother;
+    StreamingPeakDetector beats;
+    StreamingSQI quality;
+    RollingHRV<64> hrv;
+    long count;
+    long lastBeat;
+
+    LivePipeline()
+        : filter(PPG_BANDPASS_COEFFS),
+          beats(BENCH_FS, PIPELINE_PEAK_THRESHOLD, PIPELINE_PEAK_MIN_DISTANCE),
+          quality(BENCH_FS, PIPELINE_PEAK_MIN_DISTANCE) {
+        reset();
+    }
+
+    void reset() {
+        filter.reset();
+        smoother.reset();
+        beats.reset();
+        quality.reset();
+        hrv.reset();
+        count = 0;
+        lastBeat = -1;
+    }
+
+    // Returns true with the raw-sample index of a detected peak
+    bool process(long raw, long* peak) {
+        float filtered = filter.process((float)raw);
+        if (++count <= PIPELINE_EDGE_SAMPLES) {
+            return false;
+        }
+        float smoothed = smoother.process(filtered);
+        quality.process(smoothed, (float)raw);
+
+        long index;
+        if (!beats.process(smoothed, &index)) {
+            return false;
+        }
+        if (lastBeat >= 0) {
+            int rr = (int)((index - lastBeat) * 1000 / BENCH_FS);
+            if (rr >= 300 && rr <= 1500) {
+                hrv.push(rr);
+            } else {
+                hrv.markGap();
+            }
+        }
+        lastBeat = index;
+        *peak = index + PIPELINE_EDGE_SAMPLES;
+        return true;
+    }
+};
+
+// ============================================================================
+// BENCHMARK
+// ============================================================================
+
+static bool runBenchmark(std::vector<long>& raw, int reps) {
+    int n = (int)raw.size();
+    int m = n - 2 * PIPELINE_EDGE_SAMPLES;
+    int searchSize = m - PIPELINE_PEAK_SKIP;
+    int fs = BENCH_FS;
+    if (searchSize < 3) {
+        printf("Recording too short\n");
+        return false;
+    }
+
+    // Precompute each stage's input
+    std::vector<float> filtered(n), smoothed(m);
+    std::vector<ppg_q_t> filteredQ(n), smoothedQ(m);
+    bandpassFilter(raw.data(), filtered.data(), n);
+    movingAverageFilter(filtered.data() + PIPELINE_EDGE_SAMPLES, smoothed.data(), m,
+                        PIPELINE_SMOOTHING_WINDOW);
+    bandpassFilterQ(raw.data(), filteredQ.data(), n);
+    movingAverageFilterQ(filteredQ.data() + PIPELINE_EDGE_SAMPLES, smoothedQ.data(), m,
+                         PIPELINE_SMOOTHING_WINDOW);
+
+    int valleyCount, peakCount, rrCount, metricsCount;
+    int* valleys = valleyDetection(smoothed.data(), m, fs, PIPELINE_PEAK_MIN_DISTANCE, &valleyCount);
+    int* peaks = thresholdPeakDetection(smoothed.data() + PIPELINE_PEAK_SKIP, searchSize, fs,
+                                        PIPELINE_PEAK_THRESHOLD, PIPELINE_PEAK_MIN_DISTANCE, &peakCount);
+    int* rr = calcRrIntervals(peaks, peakCount, fs, &rrCount);
+
+    std::vector<CycleSegment> segments;
+    for (int i = 0; i + 1 < valleyCount; i++) {
+        CycleSegment segment = {valleys[i], valleys[i + 1]};
+        segments.push_back(segment);
+    }
+
+    int minDistanceMs = (int)(PIPELINE_PEAK_MIN_DISTANCE * 1000);
+    int32_t thresholdQ = FLOAT_TO_Q(PIPELINE_PEAK_THRESHOLD, THRESHOLD_Q_FRAC_BITS);
+    std::vector<int> peaksQ(searchSize);
+    std::vector<int> valleysQ(m);
+
+    static StaticArena<BENCH_ARENA_BYTES> arena;
+    LivePipeline live;
+
+    printf("Window: %d samples (%.1f s at %d Hz), %d repetitions, median of each\n\n",
+           n, (float)n / fs, fs, reps);
+    printHeader();
+
+    printStage("bandpass", measure(n, reps, [&] {
+        bandpassFilter(raw.data(), filtered.data(), n);
+    }));
+    printStage("bandpass (Q)", measure(n, reps, [&] {
+        bandpassFilterQ(raw.data(), filteredQ.data(), n);
+    }));
+    printStage("moving average", measure(m, reps, [&] {
+        movingAverageFilter(filtered.data() + PIPELINE_EDGE_SAMPLES, smoothed.data(), m,
+                            PIPELINE_SMOOTHING_WINDOW);
+    }));
+    printStage("moving average (Q)", measure(m, reps, [&] {
+        movingAverageFilterQ(filteredQ.data() + PIPELINE_EDGE_SAMPLES, smoothedQ.data(), m,
+                             PIPELINE_SMOOTHING_WINDOW);
+    }));
+    printStage("valley detection", measure(m, reps, [&] {
+        int count;
+        free(valleyDetection(smoothed.data(), m, fs, PIPELINE_PEAK_MIN_DISTANCE, &count));
+    }));
+    printStage("valley detection (Q)", measure(m, reps, [&] {
+        valleyDetectionQ(smoothedQ.data(), m, fs, minDistanceMs, valleysQ.data(), m);
+    }));
+    printStage("peak detection", measure(searchSize, reps, [&] {
+        int count;
+        free(thresholdPeakDetection(smoothed.data() + PIPELINE_PEAK_SKIP, searchSize, fs,
+                                    PIPELINE_PEAK_THRESHOLD, PIPELINE_PEAK_MIN_DISTANCE, &count));
+    }));
+    printStage("peak detection (Q)", measure(searchSize, reps, [&] {
+        thresholdPeakDetectionQ(smoothedQ.data() + PIPELINE_PEAK_SKIP, searchSize, fs, thresholdQ,
+                                minDistanceMs, peaksQ.data(), searchSize);
+    }));
+    if (valleyCount > 1) {
+        printStage("noise elimination (int**)", measure(m, reps, [&] {
+            int** pairs = pairValley(valleys, valleyCount);
+            int cleanSize;
+            free(eliminateNoiseInTime(smoothed.data(), m, fs, noiseThresholds, 0, pairs,
+                                      valleyCount - 1, &cleanSize));
+            for (int i = 0; i < valleyCount - 1; i++) {
+                free(pairs[i]);
+            }
+            free(pairs);
+        }));
+        printStage("noise elimination (flat)", measure(m, reps, [&] {
+            int cleanSize;
+            free(eliminateNoiseInTime(smoothed.data(), m, fs, noiseThresholds, 0, segments.data(),
+                                      (int)segments.size(), &cleanSize));
+        }));
+    }
+    printStage("HRV metrics", measure(searchSize, reps, [&] {
+        int count, metricCount;
+        int* intervals = calcRrIntervals(peaks, peakCount, fs, &count);
+        free(calculateHRVMetrics(intervals, count, &metricCount));
+        free(intervals);
+    }));
+    printStage("HRV metrics (Q)", measure(searchSize, reps, [&] {
+        int32_t metricsQ[3];
+        calculateHRVMetricsQ(rr, rrCount, metricsQ);
+    }));
+    printStage("signal quality (SQI)", measure(m, reps, [&] {
+        signalQual(smoothed.data(), m, fs);
+    }), sizeof(StreamingSQI));
+
+    float metrics[3];
+    printStage("pipeline (malloc)", measure(n, reps, [&] {
+        runHRVPipeline(raw.data(), n, fs, metrics);
+    }));
+    StageResult arenaResult = measure(n, reps, [&] {
+        runHRVPipeline(raw.data(), n, fs, metrics, arena);
+    });
+    printStage("pipeline (arena)", arenaResult, arena.highWater());
+    printStage("live, per sample", measure(n, reps, [&] {
+        live.reset();
+        long peak;
+        for (int i = 0; i < n; i++) {
+            live.process(raw[i], &peak);
+        }
+    }), sizeof(LivePipeline));
+
+    // The arena pipeline must not touch the heap at all
+    bool heapFree = arenaResult.heapPeak == 0 && arenaResult.allocations == 0 && !arena.overflowed();
+    if (arena.overflowed()) {
+        printf("\narena of %d bytes overflowed\n", BENCH_ARENA_BYTES);
+    }
+    printf("\npipeline (arena) without heap allocations: %s\n", heapFree ? "PASS" : "FAIL");
+
+    free(valleys);
+    free(peaks);
+    free(rr);
+    (void)metricsCount;
+    return heapFree;
+}
+
+// ============================================================================
+// ACCURACY
+// ============================================================================
+
+// Count detections within 'tolerance' samples of a reference index
+// (each reference is matched at most once; both lists ascending)
+static int matchPeaks(const std::vector<long>& detected, const std::vector<long>& reference,
+                      long offset, long tolerance) {
+    int matched = 0;
+    size_t j = 0;
+    for (size_t i = 0; i < detected.size(); i++) {
+        long d = detected[i] - offset;
+        while (j < reference.size() && reference[j] < d - tolerance) {
+            j++;
+        }
+        if (j < reference.size() && labs(reference[j] - d) <= tolerance) {
+            matched++;
+            j++;
+        }
+    }
+    return matched;
+}
+
+// Median of (detected - nearest reference), i.e. the filter delay
+static long medianOffset(const std::vector<long>& detected, const std::vector<long>& reference) {
+    std::vector<long> offsets;
+    for (size_t i = 0; i < detected.size(); i++) {
+        long best = 0;
+        long bestDistance = -1;
+        for (size_t j = 0; j < reference.size(); j++) {
+            long distance = labs(detected[i] - reference[j]);
+            if (bestDistance < 0 || distance < bestDistance) {
+                bestDistance = distance;
+                best = detected[i] - reference[j];
+            }
+        }
+        offsets.push_back(best);
+    }
+    if (offsets.empty()) {
+        return 0;
+    }
+    std::sort(offsets.begin(), offsets.end());
+    return offsets[offsets.size() / 2];
+}
+
+static bool reportHrvAccuracy(std::vector<long>& raw, const SyntheticPpg& truth) {
+    int fs = BENCH_FS;
+    float metrics[3] = {0, 0, 0};
+    int count = runHRVPipeline(raw.data(), (int)raw.size(), fs, metrics);
+
+    // Ground truth restricted to the peaks the pipeline can see
+    long first = PIPELINE_EDGE_SAMPLES + PIPELINE_PEAK_SKIP;
+    long last = (long)raw.size() - PIPELINE_EDGE_SAMPLES;
+    std::vector<int> rrTruth;
+    for (size_t i = 0; i + 1 < truth.peaks.size(); i++) {
+        if (truth.peaks[i] >= first && truth.peaks[i + 1] < last) {
+            rrTruth.push_back(truth.rrIntervals[i]);
+        }
+    }
+    int metricCount;
+    float* expected = calculateHRVMetrics(rrTruth.data(), (int)rrTruth.size(), &metricCount);
+
+    bool pass = count == 3 && expected != NULL;
+
+    printf("\nHRV vs ground truth (%zu true RR intervals)\n", rrTruth.size());
+    if (pass) {
+        printf("  HR    %7.2f bpm  (true %7.2f)\n", metrics[0], expected[0]);
+        printf("  SDNN  %7.2f ms   (true %7.2f)\n", metrics[1], expected[1]);
+        printf("  RMSSD %7.2f ms   (true %7.2f)\n", metrics[2], expected[2]);
+    } else {
+        printf("  pipeline returned no metrics: FAIL\n");
+    }
+    free(expected);
+    return pass;
+}
+
+static bool reportPeakAccuracy(std::vector<long>& raw, const SyntheticPpg* truth) {
+    int n = (int)raw.size();
+    int m = n - 2 * PIPELINE_EDGE_SAMPLES;
+    int searchSize = m - PIPELINE_PEAK_SKIP;
+    int fs = BENCH_FS;
+
+    // Batch detection, mapped back to raw sample indices
+    std::vector<float> filtered(n), smoothed(m);
+    bandpassFilter(raw.data(), filtered.data(), n);
+    movingAverageFilter(filtered.data() + PIPELINE_EDGE_SAMPLES, smoothed.data(), m,
+                        PIPELINE_SMOOTHING_WINDOW);
+    int peakCount;
+    int* peaks = thresholdPeakDetection(smoothed.data() + PIPELINE_PEAK_SKIP, searchSize, fs,
+                                        PIPELINE_PEAK_THRESHOLD, PIPELINE_PEAK_MIN_DISTANCE, &peakCount);
+    std::vector<long> batch;
+    for (int i = 0; i < peakCount; i++) {
+        batch.push_back(peaks[i] + PIPELINE_PEAK_SKIP + PIPELINE_EDGE_SAMPLES);
+    }
+    free(peaks);
+
+    // Streaming detection; latency = arrival of the confirming sample - peak
+    LivePipeline live;
+    std::vector<long> streaming;
+    long latencySum = 0;
+    for (int i = 0; i < n; i++) {
+        long peak;
+        if (live.process(raw[i], &peak)) {
+            streaming.push_back(peak);
+            latencySum += i - peak;
+        }
+    }
+
+    printf("\nStreaming vs batch peak detection\n");
+    printf("  batch peaks %zu, streaming peaks %zu, streaming matching batch (+/-1) %d\n",
+           batch.size(), streaming.size(), matchPeaks(streaming, batch, 0, 1));
+    if (!streaming.empty()) {
+        printf("  streaming latency %.1f samples (%.0f ms) after the peak\n",
+               (float)latencySum / streaming.size(), 1000.0 * latencySum / streaming.size() / fs);
+    }
+
+    if (truth != NULL) {
+        std::vector<long> reference(truth->peaks.begin(), truth->peaks.end());
+        long tolerance = (long)(MATCH_TOLERANCE * fs + 0.5);
+        long delay = medianOffset(batch, reference);
+        int batchHits = matchPeaks(batch, reference, delay, tolerance);
+        int streamHits = matchPeaks(streaming, reference, delay, tolerance);
+        printf("  vs ground truth (filter delay %ld samples, tolerance %ld):\n", delay, tolerance);
+        printf("    batch     sensitivity %5.1f%%  precision %5.1f%%\n",
+               100.0 * batchHits / std::max<size_t>(reference.size(), 1),
+               100.0 * batchHits / std::max<size_t>(batch.size(), 1));
+        printf("    streaming sensitivity %5.1f%%  precision %5.1f%%\n",
+               100.0 * streamHits / std::max<size_t>(reference.size(), 1),
+               100.0 * streamHits / std::max<size_t>(streaming.size(), 1));
+    }
+    return batch.empty() || !streaming.empty();
+}
+
+// The batch bandpass loop as it was before it moved onto Biquad
+static void referenceBandpass(const long* input, float* output, int size) {
+    float b[] = {0.292893, 0, -0.292893};
+    float a[] = {1, -1.16574, 0.292893};
+    for (int i = 0; i < size; i++) {
+        if (i < 2) {
+            output[i] = input[i];
+        } else {
+            output[i] = b[0] * input[i] + b[1] * input[i - 1] + b[2] * input[i - 2] -
+                        a[1] * output[i - 1] - a[2] * output[i - 2];
+        }
+    }
+}
+
+// Samples whose bits differ (so -0/+0 and NaN payloads count too)
+static int bitDifferences(const std::vector<float>& a, const std::vector<float>& b) {
+    int differences = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        differences += memcmp(&a[i], &b[i], sizeof(float)) != 0;
+    }
+    return differences;
+}
+
+static bool reportBiquadEquivalence(std::vector<long>& raw) {
+    int n = (int)raw.size();
+    std::vector<float> batch(n), reference(n), perSample(n), blocks(n), restarted(n);
+    bandpassFilter(raw.data(), batch.data(), n);
+    referenceBandpass(raw.data(), reference.data(), n);
+
+    Biquad filter(PPG_BANDPASS_COEFFS, BIQUAD_SEED_FROM_INPUT);
+    for (int i = 0; i < n; i++) {
+        perSample[i] = filter.process((float)raw[i]);
+    }
+
+    // In place, in blocks of 1-32 samples (a block may hold the whole start-up)
+    filter.reset();
+    uint32_t state = 0xB1D0AD5;
+    for (int i = 0; i < n; i++) {
+        blocks[i] = (float)raw[i];
+    }
+    for (int i = 0; i < n;) {
+        int size = std::min<int>(1 + nextRandom(&state) % 32, n - i);
+        filter.processBlock(blocks.data() + i, blocks.data() + i, size);
+        i += size;
+    }
+
+    // A reset() filter must start up exactly like a new one
+    filter.reset();
+    filter.processBlock(raw.data(), restarted.data(), n);
+
+    int differences[] = {bitDifferences(reference, batch), bitDifferences(batch, perSample),
+                         bitDifferences(batch, blocks), bitDifferences(batch, restarted)};
+    bool pass = n >= 2 && differences[0] + differences[1] + differences[2] + differences[3] == 0;
+
+    printf("\nBiquad vs batch bandpass (%d samples, bits that differ)\n", n);
+    printf("  bandpassFilter() vs original loop %d, per sample %d, in-place blocks %d, after reset() %d\n",
+           differences[0], differences[1], differences[2], differences[3]);
+    printf("  bit-identical, including the seeded start-up: %s\n", pass ? "PASS" : "FAIL");
+    return pass;
+}
+
+// Bounds promised in processingFixed.h (ACCURACY)
+#define FIXED_BANDPASS_MAX_ERROR 1.0f                          // Counts
+#define FIXED_SMOOTHING_MAX_ERROR (1.0f / (1 << PPG_Q_FRAC_BITS))  // 1 LSB
+#define FIXED_HRV_MAX_ERROR (1.0f / (1 << HRV_Q_FRAC_BITS))        // 1 Q8 LSB
+
+static bool reportFixedPointError(std::vector<long>& raw) {
+    int n = (int)raw.size();
+    int m = n - 2 * PIPELINE_EDGE_SAMPLES;
+    int searchSize = m - PIPELINE_PEAK_SKIP;
+    int fs = BENCH_FS;
+    if (searchSize < 3) {
+        return false;
+    }
+
+    std::vector<float> filtered(n), smoothed(m);
+    std::vector<ppg_q_t> filteredQ(n), smoothedQ(m);
+    bandpassFilter(raw.data(), filtered.data(), n);
+    bandpassFilterQ(raw.data(), filteredQ.data(), n);
+    movingAverageFilter(filtered.data() + PIPELINE_EDGE_SAMPLES, smoothed.data(), m,
+                        PIPELINE_SMOOTHING_WINDOW);
+    movingAverageFilterQ(filteredQ.data() + PIPELINE_EDGE_SAMPLES, smoothedQ.data(), m,
+                         PIPELINE_SMOOTHING_WINDOW);
+
+    float maxError = 0;
+    for (int i = 0; i < n; i++) {
+        maxError = std::max(maxError, fabsf(filtered[i] - PPG_Q_TO_FLOAT(filteredQ[i])));
+    }
+
+    // Smoothing error on its own: both smoothers fed the fixed-point filter output
+    std::vector<float> sameInput(m), smoothedSame(m);
+    for (int i = 0; i < m; i++) {
+        sameInput[i] = PPG_Q_TO_FLOAT(filteredQ[i + PIPELINE_EDGE_SAMPLES]);
+    }
+    movingAverageFilter(sameInput.data(), smoothedSame.data(), m, PIPELINE_SMOOTHING_WINDOW);
+    float smoothingError = 0;
+    for (int i = 0; i < m; i++) {
+        smoothingError = std::max(smoothingError, fabsf(smoothedSame[i] - PPG_Q_TO_FLOAT(smoothedQ[i])));
+    }
+
+    int peakCount;
+    int* peaks = thresholdPeakDetection(smoothed.data() + PIPELINE_PEAK_SKIP, searchSize, fs,
+                                        PIPELINE_PEAK_THRESHOLD, PIPELINE_PEAK_MIN_DISTANCE, &peakCount);
+    std::vector<int> peaksQ(searchSize);
+    int peakCountQ = thresholdPeakDetectionQ(smoothedQ.data() + PIPELINE_PEAK_SKIP, searchSize, fs,
+                                             FLOAT_TO_Q(PIPELINE_PEAK_THRESHOLD, THRESHOLD_Q_FRAC_BITS),
+                                             (int)(PIPELINE_PEAK_MIN_DISTANCE * 1000),
+                                             peaksQ.data(), searchSize);
+
+    // A peak may only move (by one sample) between samples closer than the
+    // filter error
+    int samePeaks = 0;
+    bool peaksOk = peakCount == peakCountQ;
+    const float* search = smoothed.data() + PIPELINE_PEAK_SKIP;
+    for (int i = 0; i < std::min(peakCount, peakCountQ); i++) {
+        int offset = peaksQ[i] - peaks[i];
+        samePeaks += offset == 0;
+        peaksOk = peaksOk && abs(offset) <= 1 &&
+                  fabsf(search[peaks[i]] - search[peaksQ[i]]) < FIXED_BANDPASS_MAX_ERROR + FIXED_SMOOTHING_MAX_ERROR;
+    }
+
+    int rrCount, metricCount;
+    int* rr = calcRrIntervals(peaks, peakCount, fs, &rrCount);
+    float* metrics = calculateHRVMetrics(rr, rrCount, &metricCount);
+    int32_t metricsQ[3];
+    int countQ = calculateHRVMetricsQ(rr, rrCount, metricsQ);
+    float hrvError[3] = {0, 0, 0};
+    bool hrvOk = (metrics == NULL) == (countQ != 3);
+    if (metrics != NULL && countQ == 3) {
+        for (int k = 0; k < 3; k++) {
+            hrvError[k] = fabsf(metrics[k] - HRV_Q_TO_FLOAT(metricsQ[k]));
+            hrvOk = hrvOk && hrvError[k] <= FIXED_HRV_MAX_ERROR;
+        }
+    }
+
+    bool pass = maxError <= FIXED_BANDPASS_MAX_ERROR && smoothingError <= FIXED_SMOOTHING_MAX_ERROR &&
+                peaksOk && hrvOk;
+    printf("\nFixed point vs float\n");
+    printf("  bandpass max error %.4f counts (bound %.0f)\n", maxError, FIXED_BANDPASS_MAX_ERROR);
+    printf("  smoothing max error %.5f counts (bound 1 LSB = %.5f)\n", smoothingError, FIXED_SMOOTHING_MAX_ERROR);
+    printf("  peaks: float %d, fixed %d, identical %d\n", peakCount, peakCountQ, samePeaks);
+    if (metrics != NULL && countQ == 3) {
+        printf("  HRV error: HR %.4f bpm, SDNN %.4f ms, RMSSD %.4f ms (bound 1 Q8 LSB = %.4f)\n",
+               hrvError[0], hrvError[1], hrvError[2], FIXED_HRV_MAX_ERROR);
+    }
+    printf("  within the bounds of processingFixed.h: %s\n", pass ? "PASS" : "FAIL");
+    free(metrics);
+    free(rr);
+    free(peaks);
+    return pass;
+}
+
+// Per-beat SQI against motion labels: a beat is "corrupted" if any of its
+// samples lies in a motion burst, and "flagged" if its score is below
+// SQI_GOOD_THRESHOLD. Each scenario has a floor on both rates, with some
+// margin below what the detector reaches across seeds (dense motion
+// flags clean beats next to bursts while the template rebuilds). Long
+// scenarios keep the rates steady from one seed to the next.
+#define SQI_BENCH_SECONDS 1800
+
+static bool reportSqiAccuracy(uint32_t seed) {
+    struct Scenario {
+        const char* name;
+        float noise;
+        float motionBursts;
+        float minSensitivity;   // % of corrupted beats flagged
+        float minSpecificity;   // % of clean beats passed
+    };
+    const Scenario scenarios[] = {
+        {"clean", 0.02, 0, 0, 97},
+        {"noisy", 0.15, 0, 0, 82},
+        {"motion 2/min", 0.02, 2, 85, 80},
+        {"motion 6/min", 0.02, 6, 80, 55},
+    };
+
+    printf("\nSQI vs motion labels (%d s per scenario)\n", SQI_BENCH_SECONDS);
+    printf("  %-14s %6s %9s %12s %12s\n", "scenario", "beats", "corrupted", "sensitivity", "specificity");
+    bool pass = true;
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        SyntheticPpgConfig config;
+        config.seconds = SQI_BENCH_SECONDS;
+        config.noise = scenarios[s].noise;
+        config.motionBursts = scenarios[s].motionBursts;
+        config.seed = seed + (uint32_t)s;
+        SyntheticPpg ppg = generateSyntheticPpg(config);
+
+        Biquad filter(PPG_BANDPASS_COEFFS);
+        MovingAverage<PIPELINE_SMOOTHING_WINDOW> smoother;
+        StreamingSQI quality(BENCH_FS, PIPELINE_PEAK_MIN_DISTANCE);
+        int truePositive = 0, falseNegative = 0, trueNegative = 0, falsePositive = 0;
+
+        for (size_t i = 0; i < ppg.samples.size(); i++) {
+            float filtered = filter.process((float)ppg.samples[i]);
+            if (i < PIPELINE_EDGE_SAMPLES) {
+                continue;
+            }
+            if (!quality.process(smoother.process(filtered), (float)ppg.samples[i])) {
+                continue;
+            }
+            const CycleSegment& cycle = quality.lastCycle();
+            bool corrupted = false;
+            for (int j = cycle.start; j <= cycle.end; j++) {
+                corrupted |= ppg.motion[j + PIPELINE_EDGE_SAMPLES] != 0;
+            }
+            bool flagged = quality.lastScore() < SQI_GOOD_THRESHOLD;
+            if (corrupted) {
+                flagged ? truePositive++ : falseNegative++;
+            } else {
+                flagged ? falsePositive++ : trueNegative++;
+            }
+        }
+
+        int corrupted = truePositive + falseNegative;
+        int clean = trueNegative + falsePositive;
+        double sensitivity = 100.0 * truePositive / std::max(corrupted, 1);
+        double specificity = 100.0 * trueNegative / std::max(clean, 1);
+        bool ok = (corrupted == 0 || sensitivity >= scenarios[s].minSensitivity) &&
+                  clean > 0 && specificity >= scenarios[s].minSpecificity;
+        pass = pass && ok;
+        printf("  %-14s %6d %9d ", scenarios[s].name, corrupted + clean, corrupted);
+        if (corrupted > 0) {
+            printf("%11.1f%% ", sensitivity);
+        } else {
+            printf("%12s ", "-");
+        }
+        if (clean > 0) {
+            printf("%11.1f%%%s\n", specificity, ok ? "" : "  <- FAIL");
+        } else {
+            printf("%12s%s\n", "-", ok ? "" : "  <- FAIL");
+        }
+    }
+    printf("  sensitivity and specificity above each scenario's floor: %s\n", pass ? "PASS" : "FAIL");
+    return pass;
+}
+
+// ============================================================================
+// ACQUISITION
+// ============================================================================
+
+// Configure the simulated sensor like PPGManager::setUpSensor() (ledMode 3,
+// FIFO rollover) and drain it every 'interval' ms for the whole recording
+static bool reportFifoAcquisition(const std::vector<long>& raw) {
+    const unsigned long intervals[] = {40, 160, 320, 640, 1280, 2000};
+    unsigned long duration = (unsigned long)(raw.size() * 1000 / BENCH_FS);
+
+    printf("\nFIFO acquisition (simulated MAX30105, %lu s, ledMode 3)\n", duration / 1000);
+    printf("  %-9s %8s %9s %10s %9s %6s %9s %10s\n", "poll (ms)", "wakes/s", "I2C tx/s",
+           "I2C B/s", "received", "lost", "mismatch", "ns/sample");
+
+    bool pass = true;
+    for (size_t k = 0; k < sizeof(intervals) / sizeof(intervals[0]); k++) {
+        Max30105Sim sensor;
+        sensor.setSource(raw.data(), raw.size(), BENCH_FS, PPG_FIFO_SLOT_GREEN);
+        sensor.setReg(0x08, 0x10);  // FIFO_CONFIG: rollover enabled
+        sensor.setReg(0x09, 0x07);  // MODE_CONFIG: multi-LED
+        sensor.setReg(0x11, 0x21);  // Slot 1 red, slot 2 IR
+        sensor.setReg(0x12, 0x03);  // Slot 3 green
+        Wire.attach(&sensor);
+
+        PPGFifoReader reader(Wire);
+        reader.begin(3, PPG_FIFO_SLOT_GREEN);
+        reader.clear();
+        Wire.resetStatistics();
+
+        uint32_t mismatches = 0;
+        bool indexKnown = true;  // Until OVF_COUNTER saturates
+        double drainNs = 0;
+        PPGSampleBlock block;
+        for (unsigned long t = 0; t < duration; t += intervals[k]) {
+            sensor.advance(intervals[k]);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            int count = reader.drain(&block);
+            drainNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            indexKnown = indexKnown && block.overflow < PPG_FIFO_OVF_MAX;
+            for (int i = 0; indexKnown && i < count; i++) {
+                long expected = raw[(block.firstSample + i) % raw.size()] & PPG_FIFO_SAMPLE_MASK;
+                mismatches += block.samples[i] != (uint32_t)expected;
+            }
+        }
+        Wire.detach(&sensor);
+
+        float seconds = duration / 1000.0;
+        printf("  %-9lu %8.2f %9.1f %10.0f %9u %6u ", intervals[k],
+               reader.drainCount() / seconds, Wire.transactions() / seconds,
+               Wire.bytesTransferred() / seconds, reader.totalSamples(), reader.lostSamples());
+        if (indexKnown) {
+            printf("%9u ", mismatches);
+        } else {
+            printf("%9s ", "n/a");
+        }
+        printf("%10.1f\n", drainNs / std::max<uint32_t>(reader.totalSamples(), 1));
+        if (!indexKnown) {
+            printf("  (OVF_COUNTER saturated %u times: sensor dropped %u, reader counted %u)\n",
+                   reader.saturatedCount(), sensor.overflowedSamples(), reader.lostSamples());
+        } else if (reader.lostSamples() != sensor.overflowedSamples()) {
+            printf("  reader counted %u lost samples, sensor dropped %u: FAIL\n",
+                   reader.lostSamples(), sensor.overflowedSamples());
+        }
+        pass = pass && mismatches == 0 && (!indexKnown || reader.lostSamples() == sensor.overflowedSamples());
+    }
+    printf("  every sample as the sensor produced it, losses counted: %s\n", pass ? "PASS" : "FAIL");
+    return pass;
+}
+
+struct AcquisitionRun {
+    uint32_t wakes = 0;
+    uint32_t blocks = 0;
+    uint32_t mismatches = 0;
+    double lagSum = 0;          // Block timestamp - time of its newest sample (ms)
+    double lagMax = 0;
+    double busyUs = 0;          // Modelled CPU busy time (us)
+    uint32_t received = 0;
+    uint32_t lost = 0;
+};
+
+// One recording on the virtual clock: pollInterval > 0 drains from loop()
+// every pollInterval ms (loop spins in between); otherwise the drain runs on
+// each A_FULL edge at aFullSamples and loop() sleeps until the next event.
+// phase shifts the sensor's sample clock against the loop's.
+static AcquisitionRun simulateAcquisition(const std::vector<long>& raw, unsigned long pollInterval,
+                                          int aFullSamples, unsigned long phase) {
+    const unsigned long period = 1000 / BENCH_FS;
+    unsigned long duration = (unsigned long)(raw.size() * period);
+    AcquisitionRun run;
+
+    hostUseVirtualClock(true);
+    Max30105Sim sensor;
+    sensor.setSource(raw.data(), raw.size(), BENCH_FS, PPG_FIFO_SLOT_GREEN);
+    sensor.setReg(0x08, 0x10);  // FIFO_CONFIG: rollover enabled
+    sensor.setReg(0x09, 0x07);  // MODE_CONFIG: multi-LED
+    sensor.setReg(0x11, 0x21);  // Slot 1 red, slot 2 IR
+    sensor.setReg(0x12, 0x03);  // Slot 3 green
+    sensor.advance(phase);      // First sample at (period - phase) ms
+    Wire.attach(&sensor);
+
+    PPGFifoReader reader(Wire);
+    reader.begin(3, PPG_FIFO_SLOT_GREEN);
+    reader.clear();
+    bool interruptDriven = pollInterval == 0;
+    if (interruptDriven) {
+        reader.enableAlmostFullInterrupt(aFullSamples);
+        reader.readInterruptStatus();
+    }
+    Wire.resetStatistics();
+
+    PPGBlockRing ring;
+    uint32_t droppedBlocks = 0;
+    PPGSampleBlock block;
+    bool line = false;
+    unsigned long lastDrain = 0;
+    for (unsigned long t = 1; t <= duration; t++) {
+        hostAdvanceClock(1000);
+        sensor.advance(1);
+
+        // Producer: interrupt handler or timed poll
+        if (interruptDriven) {
+            bool asserted = sensor.interruptAsserted();
+            if (asserted && !line) {
+                run.wakes++;
+                reader.readInterruptStatus();
+                if (reader.drain(&block) > 0 && !ring.push(block)) {
+                    droppedBlocks++;
+                }
+            }
+            line = sensor.interruptAsserted();
+        } else if (millis() - lastDrain >= pollInterval) {
+            lastDrain = millis();
+            run.wakes++;
+            if (reader.drain(&block) > 0 && !ring.push(block)) {
+                droppedBlocks++;
+            }
+        }
+
+        // Consumer: loop()
+        while (ring.pop(&block)) {
+            run.blocks++;
+            for (int i = 0; i < block.count; i++) {
+                long expected = raw[(block.firstSample + i) % raw.size()] & PPG_FIFO_SAMPLE_MASK;
+                run.mismatches += block.samples[i] != (uint32_t)expected;
+            }
+            unsigned long newest = block.firstSample + block.count - 1;
+            double lag = (double)block.timestamp - (double)((period - phase) + newest * period);
+            run.lagSum += lag;
+            run.lagMax = std::max(run.lagMax, lag);
+        }
+    }
+    Wire.detach(&sensor);
+    hostUseVirtualClock(false);
+
+    double seconds = duration / 1000.0;
+    if (interruptDriven) {
+        // The loop task blocks between events (eventScheduler.h): one pass per wake-up
+        run.busyUs = run.wakes * (CPU_WAKE_US + CPU_LOOP_PASS_US) + Wire.bytesTransferred() * CPU_I2C_BYTE_US;
+    } else {
+        run.busyUs = seconds * 1e6;  // loop() never sleeps
+    }
+    run.received = reader.totalSamples();
+    run.lost = reader.lostSamples() + droppedBlocks;
+    return run;
+}
+
+static bool reportInterruptAcquisition(const std::vector<long>& raw) {
+    struct Mode { const char* name; unsigned long pollInterval; int aFullSamples; };
+    const Mode modes[] = {
+        {"poll 320 ms", 320, 0},
+        {"poll 640 ms", 640, 0},
+        {"A_FULL 17", 0, 17},
+        {"A_FULL 24", 0, 24},
+        {"A_FULL 31", 0, 31},
+    };
+    const unsigned long phases[] = {0, 9, 18, 27, 36};
+    const int phaseCount = sizeof(phases) / sizeof(phases[0]);
+    double seconds = raw.size() / (double)BENCH_FS;
+
+    printf("\nInterrupt vs polled acquisition (virtual clock, %.0f s x %d sensor phases)\n",
+           seconds, phaseCount);
+    printf("  %-12s %8s %7s %8s %9s %8s %9s %6s %9s\n", "mode", "wakes/s", "busy %",
+           "est. mA", "lag avg", "lag max", "received", "lost", "mismatch");
+
+    bool pass = true;
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        AcquisitionRun total;
+        for (int p = 0; p < phaseCount; p++) {
+            AcquisitionRun run = simulateAcquisition(raw, modes[m].pollInterval,
+                                                     modes[m].aFullSamples, phases[p]);
+            total.wakes += run.wakes;
+            total.blocks += run.blocks;
+            total.mismatches += run.mismatches;
+            total.lagSum += run.lagSum;
+            total.lagMax = std::max(total.lagMax, run.lagMax);
+            total.busyUs += run.busyUs;
+            total.received += run.received;
+            total.lost += run.lost;
+        }
+        double duty = total.busyUs / (seconds * phaseCount * 1e6);
+        double current = duty * CPU_ACTIVE_MA + (1 - duty) * CPU_SLEEP_MA;
+        printf("  %-12s %8.2f %7.2f %8.3f %7.1fms %6.0fms %9u %6u %9u\n", modes[m].name,
+               total.wakes / (seconds * phaseCount), duty * 100, current,
+               total.lagSum / std::max<uint32_t>(total.blocks, 1), total.lagMax,
+               total.received / phaseCount, total.lost, total.mismatches);
+        pass = pass && total.mismatches == 0;
+    }
+    printf("  (lag excludes interrupt latency; busy %% covers acquisition only, per-sample\n"
+           "   processing and BLE are the same in every mode)\n");
+    printf("  every sample as the sensor produced it: %s\n", pass ? "PASS" : "FAIL");
+    return pass;
+}
+
+// ============================================================================
+// PACKET FORMAT
+// ============================================================================
+
+// Encode values (frames of channelMask's channels) into packets of
+// packetSize bytes, decode them again and count mismatches; returns -1 if
+// a packet failed to decode. Every packet is decoded on its own, as a
+// receiver that lost the previous one would.
+static long roundTrip(const std::vector<uint32_t>& values, int packetSize, uint8_t encoding,
+                      int riceOrder, uint8_t channelMask, int* packets, long* bytes,
+                      double* encodeNs, double* decodeNs) {
+    int channels = ppgChannelCount(channelMask);
+    int valueBits = encoding == PPG_ENCODING_RICE ? PPG_VALUE_BITS : ppgEncodingBits(encoding);
+    uint32_t maxValue = (1ul << valueBits) - 1;
+    uint8_t buffer[PPG_PACKET_MAX_SIZE];
+    uint32_t decoded[PPG_PACKET_MAX_VALUES];
+    long mismatches = 0;
+    uint8_t sequence = 0;
+    *packets = 0;
+    *bytes = 0;
+
+    PPGPacketWriter writer(riceOrder);
+    size_t next = 0;
+    while (next + channels <= values.size()) {
+        uint32_t timestamp = (uint32_t)(next / channels) * 40;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        writer.begin(buffer, packetSize, sequence, timestamp, channelMask, encoding);
+        size_t first = next;
+        while (!writer.full() && next + channels <= values.size()) {
+            // A refused first value ends the packet; the rest of a frame always fits
+            if (!writer.add(values[next])) {
+                break;
+            }
+            for (int c = 1; c < channels; c++) {
+                writer.add(values[next + c]);
+            }
+            next += channels;
+        }
+        int length = writer.size();
+        std::chrono::steady_clock::time_point encoded = std::chrono::steady_clock::now();
+
+        PPGPacketHeader header;
+        int count = decodePPGPacket(buffer, length, &header, decoded, sizeof(decoded) / sizeof(decoded[0]));
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        *encodeNs += std::chrono::duration<double, std::nano>(encoded - start).count();
+        *decodeNs += std::chrono::duration<double, std::nano>(end - encoded).count();
+
+        if (count <= 0 || count != (int)(next - first) || length > packetSize || header.sequence != sequence ||
+            header.timestamp != (timestamp & 0xFFFFFF) || header.channelMask != channelMask ||
+            header.encoding != encoding) {
+            return -1;
+        }
+        for (int i = 0; i < count; i++) {
+            mismatches += decoded[i] != std::min(values[first + i], maxValue);
+        }
+        sequence++;
+        (*packets)++;
+        *bytes += length;
+    }
+    return mismatches;
+}
+
+static bool reportPacketFormat(const std::vector<long>& raw) {
+    printf("\nPacket format (ppgPacket.h, version %d; encode/decode in ns per sample)\n",
+           PPG_PACKET_VERSION);
+
+    // Recording (18-bit FIFO values) followed by edge cases
+    std::vector<uint32_t> samples;
+    for (size_t i = 0; i < raw.size(); i++) {
+        samples.push_back((uint32_t)raw[i] & PPG_FIFO_SAMPLE_MASK);
+    }
+    const uint32_t edges[] = {0, 1, 0x7FFF, 0x8000, 0xFE, 0xFEFE, 0x3FFFE, 0x3FFFF, 0x40000, 0xFFFFFF};
+    samples.insert(samples.end(), edges, edges + sizeof(edges) / sizeof(edges[0]));
+
+    uint32_t state = 0xC0FFEE;
+    std::vector<uint32_t> randomValues;
+    for (int i = 0; i < 30000; i++) {
+        randomValues.push_back(nextRandom(&state) & 0xFFFFFF);
+    }
+
+    // Samples per packet vary with the Rice encoding: averages over the recording
+    printf("  %-10s %7s %8s %10s %10s %9s %9s\n", "encoding", "packet", "samples", "B/sample",
+           "round-trip", "encode", "decode");
+    struct Encoding {
+        const char* name;
+        uint8_t encoding;
+        int riceOrder;
+    };
+    const Encoding encodings[] = {
+        {"packed18", PPG_ENCODING_PACKED18, 1},
+        {"packed24", PPG_ENCODING_PACKED24, 1},
+        {"rice o1", PPG_ENCODING_RICE, 1},
+        {"rice o2", PPG_ENCODING_RICE, 2},
+    };
+    const int sizes[] = {20, 64, 244};
+    bool pass = true;
+    for (size_t e = 0; e < sizeof(encodings) / sizeof(encodings[0]); e++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            int packets;
+            long bytes;
+            double encodeNs = 0, decodeNs = 0;
+            long mismatches = roundTrip(samples, sizes[s], encodings[e].encoding, encodings[e].riceOrder,
+                                        PPG_CHANNEL_GREEN, &packets, &bytes, &encodeNs, &decodeNs);
+
+            // All channel combinations with random full-range values
+            // (for Rice: mostly escapes, the worst case)
+            for (uint8_t mask = 1; mask <= 7 && mismatches == 0; mask++) {
+                int otherPackets;
+                long otherBytes;
+                double ignored = 0;
+                mismatches = roundTrip(randomValues, sizes[s], encodings[e].encoding, encodings[e].riceOrder,
+                                       mask, &otherPackets, &otherBytes, &ignored, &ignored);
+            }
+            pass = pass && mismatches == 0;
+
+            printf("  %-10s %7d %8.1f %10.2f %10s %9.1f %9.1f\n", encodings[e].name, sizes[s],
+                   (double)samples.size() / packets, (double)bytes / samples.size(),
+                   mismatches == 0 ? "PASS" : "FAIL", encodeNs / samples.size(),
+                   decodeNs / samples.size());
+        }
+    }
+    printf("  %-10s %7d %8d %10.2f %10s\n", "legacy", 18, 6, 3.0, "lossy");
+
+    // Malformed packets: truncated, unknown version, reserved encoding
+    uint8_t buffer[PPG_PACKET_MAX_SIZE];
+    uint32_t decoded[PPG_PACKET_MAX_VALUES];
+    PPGPacketHeader header;
+    PPGPacketWriter writer;
+    writer.begin(buffer, 20, 0, 0, PPG_CHANNEL_GREEN);
+    while (writer.add(0x12345)) {
+    }
+    bool rejects = decodePPGPacket(buffer, writer.size() - 1, &header, decoded, PPG_PACKET_MAX_VALUES) < 0 &&
+                   decodePPGPacket(buffer, 5, &header, decoded, PPG_PACKET_MAX_VALUES) < 0 &&
+                   decodePPGPacket(buffer, writer.size(), &header, decoded, 2) < 0;
+    PPGPacketWriter riceWriter;
+    uint8_t riceBuffer[20];
+    riceWriter.begin(riceBuffer, sizeof(riceBuffer), 0, 0, PPG_CHANNEL_GREEN, PPG_ENCODING_RICE);
+    for (uint32_t i = 0; riceWriter.add(100000 + i * i % 700); i++) {
+    }
+    rejects = rejects && decodePPGPacket(riceBuffer, riceWriter.size() - 1, &header, decoded, PPG_PACKET_MAX_VALUES) < 0;
+    buffer[0] = (2 << 5) | (buffer[0] & 0x1F);
+    rejects = rejects && decodePPGPacket(buffer, writer.size(), &header, decoded, PPG_PACKET_MAX_VALUES) < 0;
+    buffer[0] = (PPG_PACKET_VERSION << 5) | (3 << 3) | PPG_CHANNEL_GREEN;
+    rejects = rejects && decodePPGPacket(buffer, writer.size(), &header, decoded, PPG_PACKET_MAX_VALUES) < 0;
+    printf("  round-trip %s, malformed packets %s\n", pass ? "PASS" : "FAIL", rejects ? "rejected" : "ACCEPTED");
+    return pass && rejects;
+
+    // What the legacy int16 + 0xFE stream did to this recording
+    size_t wrapped = 0, delimiterBytes = 0;
+    for (size_t i = 0; i < raw.size(); i++) {
+        uint32_t value = (uint32_t)raw[i] & PPG_FIFO_SAMPLE_MASK;
+        int16_t legacy = (int16_t)value;
+        wrapped += (uint32_t)(long)legacy != value;
+        delimiterBytes += ((legacy >> 8) & 0xFF) == 0xFE || (legacy & 0xFF) == 0xFE;
+    }
+    printf("  legacy format on this recording: %zu of %zu samples wrapped, %zu contained 0xFE\n",
+           wrapped, raw.size(), delimiterBytes);
+}
+
+// ============================================================================
+// COMPRESSION
+// ============================================================================
+
+// Cycle counter for per-sample coding cost (TSC on x86; ns elsewhere)
+static uint64_t readCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct CompressionResult {
+    double bitsPerSample;           // Payload incl. headers
+    double samplesPerPacket;
+    double encodeCycles;            // Per sample
+    double decodeCycles;
+    bool lossless;
+};
+
+// Stream values through one writer as batchPPGData() does (a refused sample
+// starts the next packet), then decode every packet on its own
+static CompressionResult compress(const std::vector<uint32_t>& values, int packetSize, uint8_t encoding,
+                                  int riceOrder) {
+    std::vector<std::vector<uint8_t> > packets;
+    uint8_t buffer[PPG_PACKET_MAX_SIZE];
+    PPGPacketWriter writer(riceOrder);
+    bool open = false;
+    uint8_t sequence = 0;
+    long bytes = 0;
+
+    uint64_t start = readCycles();
+    for (size_t i = 0; i < values.size(); i++) {
+        if (open && writer.add(values[i])) {
+            if (!writer.full()) {
+                continue;
+            }
+            packets.push_back(std::vector<uint8_t>(buffer, buffer + writer.size()));
+            open = false;
+            continue;
+        }
+        if (open) {
+            packets.push_back(std::vector<uint8_t>(buffer, buffer + writer.size()));
+        }
+        writer.begin(buffer, packetSize, sequence++, (uint32_t)i * 40, PPG_CHANNEL_GREEN, encoding);
+        writer.add(values[i]);
+        open = true;
+    }
+    if (open) {
+        packets.push_back(std::vector<uint8_t>(buffer, buffer + writer.size()));
+    }
+    uint64_t encoded = readCycles();
+
+    std::vector<uint32_t> decoded(values.size());
+    size_t position = 0;
+    bool lossless = true;
+    PPGPacketHeader header;
+    for (size_t p = 0; p < packets.size() && lossless; p++) {
+        int count = decodePPGPacket(packets[p].data(), (int)packets[p].size(), &header,
+                                    decoded.data() + position, (int)(values.size() - position));
+        lossless = count > 0;
+        position += lossless ? count : 0;
+        bytes += packets[p].size();
+    }
+    uint64_t end = readCycles();
+    lossless = lossless && position == values.size() &&
+               std::equal(values.begin(), values.end(), decoded.begin());
+
+    CompressionResult result;
+    result.bitsPerSample = bytes * 8.0 / values.size();
+    result.samplesPerPacket = (double)values.size() / packets.size();
+    result.encodeCycles = (double)(encoded - start) / values.size();
+    result.decodeCycles = (double)(end - encoded) / values.size();
+    result.lossless = lossless;
+    return result;
+}
+
+static bool reportCompression(const std::vector<long>& raw, uint32_t seed) {
+    struct Input {
+        const char* name;
+        std::vector<uint32_t> values;
+    };
+    std::vector<Input> inputs(1);
+    inputs[0].name = "this input";
+    for (size_t i = 0; i < raw.size(); i++) {
+        inputs[0].values.push_back((uint32_t)raw[i] & PPG_FIFO_SAMPLE_MASK);
+    }
+    struct Scenario {
+        const char* name;
+        float noise;
+        float motionBursts;
+    };
+    const Scenario scenarios[] = {
+        {"clean", 0.02, 0},
+        {"noisy", 0.15, 0},
+        {"motion 6/min", 0.02, 6},
+    };
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        SyntheticPpgConfig config;
+        config.fs = BENCH_FS;
+        config.seconds = 300;
+        config.noise = scenarios[s].noise;
+        config.motionBursts = scenarios[s].motionBursts;
+        config.seed = seed + (uint32_t)s;
+        SyntheticPpg ppg = generateSyntheticPpg(config);
+        Input input;
+        input.name = scenarios[s].name;
+        for (size_t i = 0; i < ppg.samples.size(); i++) {
+            input.values.push_back((uint32_t)ppg.samples[i] & PPG_FIFO_SAMPLE_MASK);
+        }
+        inputs.push_back(input);
+    }
+
+    printf("\nLossless compression (Rice vs packed18, packets decoded independently;\n"
+           "  %s per sample)\n",
+#if defined(__x86_64__) || defined(__i386__)
+           "TSC cycles"
+#else
+           "ns"
+#endif
+    );
+    printf("  %-13s %6s %9s %9s %9s %7s %9s %9s %9s\n", "input", "packet", "encoding", "bits/smp",
+           "smp/pkt", "ratio", "encode", "decode", "lossless");
+    const int sizes[] = {20, 244};
+    bool pass = true;
+    for (size_t n = 0; n < inputs.size(); n++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            CompressionResult packed = compress(inputs[n].values, sizes[s], PPG_ENCODING_PACKED18, 1);
+            pass = pass && packed.lossless;
+            for (int order = 0; order <= 2; order++) {
+                CompressionResult r = order == 0 ? packed
+                                                 : compress(inputs[n].values, sizes[s], PPG_ENCODING_RICE, order);
+                pass = pass && r.lossless;
+                printf("  %-13s %6d %9s %9.2f %9.1f %6.2fx %9.1f %9.1f %9s\n", inputs[n].name, sizes[s],
+                       order == 0 ? "packed18" : order == 1 ? "rice o1" : "rice o2", r.bitsPerSample,
+                       r.samplesPerPacket, packed.bitsPerSample / r.bitsPerSample, r.encodeCycles,
+                       r.decodeCycles, r.lossless ? "yes" : "NO");
+            }
+        }
+    }
+    printf("  all streams lossless: %s\n", pass ? "PASS" : "FAIL");
+    return pass;
+}
+
+// ============================================================================
+// STREAM CONTINUITY
+// ============================================================================
+
+#define STREAM_LOSS_PERCENT 5       // Notifications lost in transit
+#define STREAM_OVERFLOW_AT 500      // Sample index where the FIFO overflows...
+#define STREAM_OVERFLOW_SAMPLES 10  // ...losing this many samples
+#define STREAM_JITTER_MS 15         // Block timestamp jitter (drain latency)
+#define STREAM_BLOCK 17             // Samples per FIFO block (A_FULL)
+
+// Packetize the input as PPGManager does (device clock starting just
+// before the 24-bit timestamp wraps, per-block timestamp jitter, one FIFO
+// overflow), lose packets at random, and check that PPGStreamTracker
+// finds exactly what is missing
+static bool reportStreamContinuity(const std::vector<long>& raw) {
+    const uint32_t period = 1000 / BENCH_FS;
+    const uint32_t clockStart = 0xFFFFFF - 20000;
+    uint32_t state = 0xBADC0DE;
+
+    // Sample times on the device clock (full 32-bit), with the overflow gap
+    std::vector<uint32_t> values, times;
+    uint32_t jitter = 0;
+    for (size_t i = 0, slot = 0; i < raw.size(); i++, slot++) {
+        if (i == STREAM_OVERFLOW_AT) {
+            slot += STREAM_OVERFLOW_SAMPLES;
+        }
+        if (i % STREAM_BLOCK == 0) {
+            jitter = nextRandom(&state) % STREAM_JITTER_MS;
+        }
+        values.push_back((uint32_t)raw[i] & PPG_FIFO_SAMPLE_MASK);
+        times.push_back(clockStart + (uint32_t)slot * period + jitter);
+    }
+
+    // Encode into 20-byte Rice packets (as batchPPGData())
+    std::vector<std::vector<uint8_t> > packets;
+    std::vector<uint32_t> firstTimes, counts;
+    bool overflowAtBoundary = false;
+    uint8_t buffer[20];
+    PPGPacketWriter writer(1);      // PPG_RICE_ORDER in PPGManager.h
+    uint8_t sequence = 0;
+    size_t next = 0;
+    while (next < values.size()) {
+        overflowAtBoundary = overflowAtBoundary || next == STREAM_OVERFLOW_AT;
+        writer.begin(buffer, sizeof(buffer), sequence++, times[next], PPG_CHANNEL_GREEN, PPG_ENCODING_RICE);
+        firstTimes.push_back(times[next]);
+        // Missing samples end a packet, as in batchPPGData()
+        do {
+            if (!writer.add(values[next])) {
+                break;
+            }
+            next++;
+        } while (next < values.size() && !writer.full() && times[next] - times[next - 1] <= period * 3 / 2);
+        packets.push_back(std::vector<uint8_t>(buffer, buffer + writer.size()));
+        counts.push_back(writer.sampleCount());
+    }
+
+    // Receive, losing some packets; the first always arrives
+    PPGStreamTracker tracker(period);
+    uint32_t droppedPackets = 0, droppedSamples = 0, gapsReported = 0;
+    uint32_t decoded[PPG_PACKET_MAX_VALUES];
+    bool timesOk = true;
+    for (size_t p = 0; p < packets.size(); p++) {
+        if (p > 0 && nextRandom(&state) % 100 < STREAM_LOSS_PERCENT) {
+            droppedPackets++;
+            droppedSamples += counts[p];
+            continue;
+        }
+        PPGPacketHeader header;
+        decodePPGPacket(packets[p].data(), (int)packets[p].size(), &header, decoded, PPG_PACKET_MAX_VALUES);
+        PPGStreamGap gap;
+        gapsReported += tracker.next(header, &gap);
+        // Full device time recovered from a reference up to a few hours off
+        timesOk = timesOk && PPGStreamTracker::unwrapFrom(header.timestamp, clockStart + 3600000) == firstTimes[p];
+    }
+
+    bool pass = overflowAtBoundary && tracker.lostPackets() == droppedPackets &&
+                tracker.missingSamples() == droppedSamples + STREAM_OVERFLOW_SAMPLES && timesOk;
+    printf("\nStream continuity (20-byte packets, %d%% lost, one %d-sample FIFO overflow, "
+           "timestamps wrap)\n", STREAM_LOSS_PERCENT, STREAM_OVERFLOW_SAMPLES);
+    printf("  packets %zu, lost %u (detected %u), samples missing %u (detected %u), gaps reported %u\n",
+           packets.size(), droppedPackets, tracker.lostPackets(),
+           droppedSamples + STREAM_OVERFLOW_SAMPLES, tracker.missingSamples(), gapsReported);
+    printf("  overflow gap starts a packet: %s\n", overflowAtBoundary ? "yes" : "NO");
+    printf("  24-bit timestamps unwrapped to device time: %s\n", timesOk ? "exact" : "WRONG");
+    printf("  loss detection: %s\n", pass ? "PASS" : "FAIL");
+    return pass;
+}
+
+// ============================================================================
+// BATCHING
+// ============================================================================
+
+#define BATCH_RECORDINGS 200        // Start/stop cycles
+#define BATCH_MAX_SAMPLES 1500      // Longest recording (60 s at 25 Hz)
+#define BATCH_REFUSE_PERCENT 20     // canSend() calls refused (BLE queue full)
+#define BATCH_HOLD_MS 2000          // PPG_TX_MAX_HOLD_MS in PPGManager.h
+
+// Stands in for the raw PPG characteristic: decodes every packet and files
+// its samples under the recording running when it was sent
+struct BatchSink : public PPGPacketSink {
+    uint32_t state;
+    int packetSize;
+    int refusePercent;
+    bool decodeOk;
+    bool sequenceOk;
+    uint32_t refused;
+    uint32_t now;
+    uint32_t maxLatency;            // Send time - first sample time
+    uint8_t nextSequence;
+    std::vector<uint32_t>* received;
+
+    BatchSink() : state(0x5EED1), packetSize(20), refusePercent(0), decodeOk(true),
+                  sequenceOk(true), refused(0), now(0), maxLatency(0), nextSequence(0),
+                  received(NULL) {}
+
+    int maxPacketSize() override { return packetSize; }
+
+    bool canSend() override {
+        if ((int)(nextRandom(&state) % 100) < refusePercent) {
+            refused++;
+            return false;
+        }
+        return true;
+    }
+
+    void send(const uint8_t* data, int length) override {
+        PPGPacketHeader header;
+        uint32_t values[PPG_PACKET_MAX_VALUES];
+        int count = decodePPGPacket(data, length, &header, values, PPG_PACKET_MAX_VALUES);
+        decodeOk = decodeOk && count > 0 && length <= packetSize;
+        sequenceOk = sequenceOk && header.sequence == nextSequence++;
+        maxLatency = std::max(maxLatency, now - header.timestamp);
+        for (int i = 0; i < count; i++) {
+            received->push_back(values[i]);
+        }
+    }
+};
+
+// Longest wait for a packet at 25 Hz in 244-byte packets with no refusals
+static uint32_t measureHoldLatency(const std::vector<long>& raw, uint32_t holdMs) {
+    const uint32_t period = 1000 / BENCH_FS;
+    BatchSink sink;
+    std::vector<uint32_t> received;
+    sink.received = &received;
+    sink.packetSize = PPG_PACKET_MAX_SIZE;
+    PPGBatcher batcher(sink, period);
+    batcher.setMaxHold(holdMs);
+    batcher.start();
+    for (size_t i = 0; i < raw.size(); i++) {
+        sink.now = (uint32_t)i * period;
+        batcher.add((uint32_t)raw[i] & PPG_FIFO_SAMPLE_MASK, sink.now);
+        batcher.poll(sink.now);
+    }
+    return sink.maxLatency;
+}
+
+// Start/stop recordings through a refusing sink as PPGManager does (add()
+// and poll() per sample, flush() on stop, poll() between recordings) and
+// check every sample's fate
+static bool reportBatching(const std::vector<long>& raw) {
+    const uint32_t period = 1000 / BENCH_FS;
+    const int sizes[] = {20, 64, 128, PPG_PACKET_MAX_SIZE};
+    uint32_t state = 0xBA7C4;
+    BatchSink sink;
+    sink.refusePercent = BATCH_REFUSE_PERCENT;
+    PPGBatcher batcher(sink, period);
+    batcher.setMaxHold(BATCH_HOLD_MS);
+
+    std::vector<std::vector<uint32_t> > accepted(BATCH_RECORDINGS), received(BATCH_RECORDINGS);
+    uint32_t totalAdded = 0, ringDropped = 0, undelivered = 0, failedStops = 0;
+    bool accountingOk = true, orderOk = true;
+    for (int r = 0; r <= BATCH_RECORDINGS; r++) {
+        uint32_t leftover = r > 0 ? (uint32_t)(accepted[r - 1].size() - received[r - 1].size()) : 0;
+        batcher.start();
+        accountingOk = accountingOk && batcher.samplesDropped() == leftover && batcher.pending() == 0;
+        undelivered += leftover;
+        if (r == BATCH_RECORDINGS) {
+            break;
+        }
+
+        // A recording: random length from a random point of the input
+        sink.received = &received[r];
+        sink.nextSequence = 0;
+        sink.packetSize = sizes[nextRandom(&state) % 4];
+        uint32_t length = nextRandom(&state) % (BATCH_MAX_SAMPLES + 1);
+        size_t offset = nextRandom(&state) % raw.size();
+        uint32_t ringFull = 0;
+        for (uint32_t i = 0; i < length; i++) {
+            sink.now += period;
+            uint32_t value = (uint32_t)raw[(offset + i) % raw.size()] & PPG_FIFO_SAMPLE_MASK;
+            if (batcher.add(value, sink.now)) {
+                accepted[r].push_back(value);
+            } else {
+                ringFull++;
+            }
+            batcher.poll(sink.now);
+        }
+        totalAdded += length;
+        ringDropped += ringFull;
+
+        // Stop, then a few idle loop() passes that retry what flush() could not send
+        if (!batcher.flush()) {
+            failedStops++;
+        }
+        accountingOk = accountingOk && batcher.samplesSent() + batcher.pending() == accepted[r].size() &&
+                       batcher.samplesDropped() == leftover + ringFull;
+        uint32_t idlePasses = nextRandom(&state) % 3;
+        for (uint32_t i = 0; i < idlePasses; i++) {
+            sink.now += period;
+            batcher.poll(sink.now);
+        }
+
+        // Exactly once: what arrived is the accepted sequence, or its start
+        orderOk = orderOk && received[r].size() <= accepted[r].size() &&
+                  std::equal(received[r].begin(), received[r].end(), accepted[r].begin());
+    }
+
+    uint32_t delivered = 0;
+    for (int r = 0; r < BATCH_RECORDINGS; r++) {
+        delivered += (uint32_t)received[r].size();
+    }
+    uint32_t latency = measureHoldLatency(raw, BATCH_HOLD_MS);
+    uint32_t unbounded = measureHoldLatency(raw, 0);
+    bool latencyOk = latency <= BATCH_HOLD_MS + period;
+    bool pass = accountingOk && orderOk && sink.decodeOk && sink.sequenceOk &&
+                delivered + undelivered + ringDropped == totalAdded && latencyOk;
+
+    printf("\nBatching (%d recordings, %d%% of sends refused, 20-244 byte packets)\n",
+           BATCH_RECORDINGS, BATCH_REFUSE_PERCENT);
+    printf("  samples %u: delivered %u, dropped by next start %u (flush refused %u times), ring full %u\n",
+           totalAdded, delivered, undelivered, failedStops, ringDropped);
+    printf("  sends refused %u, sequence restarts per recording: %s\n", sink.refused,
+           sink.sequenceOk ? "yes" : "NO");
+    printf("  max sample wait at 25 Hz, 244-byte packets: %u ms (hold %d ms), %u ms without hold\n",
+           latency, BATCH_HOLD_MS, unbounded);
+    printf("  exactly once, in order, per recording: %s\n", pass ? "PASS" : "FAIL");
+    return pass;
+}
+
+// ============================================================================
+// BLE LINK POLICY
+// ============================================================================
+
+#define LINK_PHASE_MS 20000         // Simulated time per mode
+#define LINK_POLL_MS 100            // update() period (one loop() pass)
+
+struct LinkPhase {
+    BLELinkParams granted;
+    uint32_t requests;
+};
+
+// Enter mode (begin() on a new connection) and poll for LINK_PHASE_MS
+static LinkPhase runLinkPhase(BLELinkPolicy* policy, BLELinkMode mode) {
+    BLEConnection* connection = Bluefruit.Connection(0);
+    uint32_t before = connection->parameterRequests + connection->phyRequests;
+    if (policy->isActive()) {
+        policy->setMode(mode);
+    } else {
+        policy->begin(0, mode);
+    }
+    for (int t = 0; t < LINK_PHASE_MS; t += LINK_POLL_MS) {
+        policy->update();
+        hostAdvanceClock(LINK_POLL_MS * 1000ul);
+    }
+    LinkPhase phase;
+    phase.granted = policy->granted();
+    phase.requests = connection->parameterRequests + connection->phyRequests - before;
+    return phase;
+}
+
+static bool reportLinkPolicy() {
+    struct Central {
+        const char* name;
+        HostCentral behaviour;
+    };
+    // minInterval, maxInterval, step, maxLatency, accepts, 2M, delay; initial interval, latency,
+    // timeout; MTU, packets per event
+    const Central centrals[] = {
+        {"cooperative", {6, 3200, 1, 499, true, true, 100, 24, 0, 500, 247, 6}},
+        {"15 ms steps", {12, 3200, 12, 30, true, true, 300, 24, 0, 72, 185, 4}},
+        {"1M PHY only", {6, 3200, 1, 499, true, false, 100, 36, 0, 400, 247, 6}},
+        {"min 50 ms", {40, 3200, 1, 499, true, true, 100, 40, 0, 400, 23, 1}},
+        {"ignores updates", {6, 3200, 1, 0, false, true, 100, 6, 0, 100, 23, 1}},
+    };
+
+    printf("\nBLE link policy (bleLinkPolicy.h) against simulated centrals, %d s per mode\n",
+           LINK_PHASE_MS / 1000);
+    printf("  requested: streaming %.2f ms / latency %d / %d ms / 2M, idle %.2f ms / latency %d / %d ms\n",
+           BLE_LINK_STREAM_INTERVAL * 1.25, BLE_LINK_STREAM_LATENCY, BLE_LINK_STREAM_TIMEOUT * 10,
+           BLE_LINK_IDLE_INTERVAL * 1.25, BLE_LINK_IDLE_LATENCY, BLE_LINK_IDLE_TIMEOUT * 10);
+    printf("  %-16s %-9s %9s %7s %8s %4s %9s %8s\n", "central", "mode", "interval", "latency",
+           "timeout", "PHY", "events/s", "requests");
+
+    bool pass = linkParamsValid(BLELinkPolicy::requested(BLE_LINK_STREAMING)) &&
+                linkParamsValid(BLELinkPolicy::requested(BLE_LINK_IDLE));
+    hostUseVirtualClock(true);
+    for (size_t c = 0; c < sizeof(centrals) / sizeof(centrals[0]); c++) {
+        Bluefruit.Advertising.start(0);
+        Bluefruit.hostConnect(centrals[c].behaviour);
+        BLELinkPolicy policy;
+
+        // Connected idle, then streaming, then idle again
+        const BLELinkMode modes[] = {BLE_LINK_IDLE, BLE_LINK_STREAMING, BLE_LINK_IDLE};
+        for (int m = 0; m < 3; m++) {
+            LinkPhase phase = runLinkPhase(&policy, modes[m]);
+            const BLELinkParams& g = phase.granted;
+            // Each mode change costs at most BLE_LINK_MAX_ATTEMPTS requests (parameters + PHY)
+            pass = pass && phase.requests <= 2 * BLE_LINK_MAX_ATTEMPTS;
+            if (centrals[c].behaviour.acceptsParameters && centrals[c].behaviour.intervalStep == 1 &&
+                centrals[c].behaviour.minInterval <= BLE_LINK_STREAM_INTERVAL) {
+                BLELinkParams want = BLELinkPolicy::requested(modes[m]);
+                pass = pass && g.interval == want.interval && g.latency == want.latency;
+            }
+            printf("  %-16s %-9s %6.2f ms %7d %5d ms %4s %9.2f %8u\n", m == 0 ? centrals[c].name : "",
+                   modes[m] == BLE_LINK_STREAMING ? "streaming" : "idle", g.interval * 1.25, g.latency,
+                   g.timeout * 10, g.phy == BLE_GAP_PHY_2MBPS ? "2M" : "1M",
+                   1000.0 / (g.interval * 1.25 * (g.latency + 1)), phase.requests);
+        }
+        policy.end();
+        Bluefruit.hostDisconnect();
+    }
+    hostUseVirtualClock(false);
+    printf("  presets valid, requests bounded, granted where possible: %s\n", pass ? "PASS" : "FAIL");
+    return pass;
+}
+
+// ============================================================================
+// FIRMWARE ON HOST
+// ============================================================================
+
+#define FIRMWARE_RAW_PPG_UUID "4aa76196-2777-4205-8260-8e3274beb327"    // BluetoothManager.cpp
+#define FIRMWARE_REC_CONTROL_UUID "684c8f42-a60c-431c-b8ed-251e966d6a9a"
+#define FIRMWARE_HRV_UUID "8881ab16-7694-4891-aebe-b0b11c6549d4"
+#define FIRMWARE_DIAGNOSTICS_UUID "5d0b8a4e-3c71-4f2a-9e62-1b7d4c8f0a93"
+#define FIRMWARE_DIAGNOSTICS_SIZE 26        // Whole payload (BluetoothManager.h, TRANSMIT QUEUE)
+#define FIRMWARE_DIAGNOSTICS_PACKET_SIZE 18 // Packet counters only (default MTU)
+#define FIRMWARE_CONNECT_MS 1000    // Power-up to the app connecting
+#define FIRMWARE_DRAIN_MS 5000      // Connected after the recording ends
+#define FIRMWARE_HANDOVER_MS 20000  // Recording time before the first central disconnects
+
+// The app: decodes raw PPG notifications and places each sample in the
+// stream by its packet's timestamp, as a receiver does
+struct FirmwareApp {
+    PPGStreamTracker tracker;
+    std::vector<uint32_t> samples;
+    std::vector<uint32_t> positions;    // Sample index since the first delivered sample
+    uint32_t nextPosition;
+    uint32_t decodeErrors;
+    uint32_t maxLatency;                // Delivery time - first sample time
+    uint32_t hrvReports;
+    uint32_t hrvErrors;                 // Wrong size or version (e.g. split at the MTU)
+    bool started;                       // Recording start written
+    uint32_t stalePackets;              // Raw PPG packets before that
+    int firstSequence;                  // Of the first raw PPG packet after it (-1: none)
+    uint32_t diagReports;               // Whole diagnostics payloads
+    uint32_t diagErrors;                // Other sizes, or sample counters that went back
+    uint32_t samplesLost;               // From the last whole diagnostics payload
+    uint32_t samplesDropped;
+
+    FirmwareApp()
+        : tracker(1000 / BENCH_FS), nextPosition(0), decodeErrors(0), maxLatency(0), hrvReports(0),
+          hrvErrors(0), started(false), stalePackets(0), firstSequence(-1), diagReports(0), diagErrors(0),
+          samplesLost(0), samplesDropped(0) {}
+
+    static uint32_t readUint32(const uint8_t* data) {
+        return data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+    }
+
+    static void onNotify(const BLECharacteristic& chr, const uint8_t* data, uint16_t length, void* context) {
+        FirmwareApp* app = static_cast<FirmwareApp*>(context);
+        if (strcmp(chr.hostUuid(), FIRMWARE_HRV_UUID) == 0) {
+            bool valid = length == BLE_HRV_SIZE && data[0] == BLE_HRV_VERSION;
+            valid ? app->hrvReports++ : app->hrvErrors++;
+            return;
+        }
+        if (strcmp(chr.hostUuid(), FIRMWARE_DIAGNOSTICS_UUID) == 0) {
+            if (length == FIRMWARE_DIAGNOSTICS_SIZE) {
+                uint32_t lost = readUint32(data + 18);
+                uint32_t dropped = readUint32(data + 22);
+                if (lost < app->samplesLost || dropped < app->samplesDropped) {
+                    app->diagErrors++;
+                }
+                app->samplesLost = lost;
+                app->samplesDropped = dropped;
+                app->diagReports++;
+            } else if (length != FIRMWARE_DIAGNOSTICS_PACKET_SIZE) {
+                app->diagErrors++;
+            }
+            return;
+        }
+        if (strcmp(chr.hostUuid(), FIRMWARE_RAW_PPG_UUID) != 0) {
+            return;
+        }
+        if (!app->started) {
+            app->stalePackets++;
+            return;
+        }
+        PPGPacketHeader header;
+        uint32_t values[PPG_PACKET_MAX_VALUES];
+        int count = decodePPGPacket(data, length, &header, values, PPG_PACKET_MAX_VALUES);
+        if (count <= 0) {
+            app->decodeErrors++;
+            return;
+        }
+        if (app->firstSequence < 0) {
+            app->firstSequence = header.sequence;
+        }
+        PPGStreamGap gap;
+        app->tracker.next(header, &gap);
+        if (gap.missingSamples > 0) {
+            app->nextPosition += gap.missingSamples;
+        }
+        for (int i = 0; i < count; i++) {
+            app->samples.push_back(values[i]);
+            app->positions.push_back(app->nextPosition++);
+        }
+        uint32_t first = PPGStreamTracker::unwrapFrom(header.timestamp, millis());
+        app->maxLatency = std::max(app->maxLatency, (uint32_t)(millis() - first));
+    }
+};
+
+// The app's samples against the recording: the first delivered sample is
+// the first one produced after startIndex (searched, as turning the sensor
+// on takes a few ms)
+static uint32_t countMismatches(const std::vector<long>& raw, const FirmwareApp& app, uint32_t startIndex) {
+    uint32_t best = (uint32_t)app.samples.size();
+    for (uint32_t offset = 0; offset < BENCH_FS && !app.samples.empty(); offset++) {
+        uint32_t mismatches = 0;
+        for (size_t i = 0; i < app.samples.size(); i++) {
+            long expected = raw[(startIndex + offset + app.positions[i]) % raw.size()] & PPG_FIFO_SAMPLE_MASK;
+            mismatches += app.samples[i] != (uint32_t)expected;
+        }
+        best = std::min(best, mismatches);
+    }
+    return best;
+}
+
+struct FirmwareRun {
+    uint32_t delivered;
+    uint32_t missing;
+    uint32_t lostPackets;
+    uint32_t mismatches;
+    uint32_t decodeErrors;
+    uint32_t maxLatency;
+    uint32_t hrvReports;
+    uint32_t hrvErrors;
+    uint32_t stalePackets;
+    int firstSequence;
+    uint32_t diagReports;
+    uint32_t diagErrors;
+    BLETxStats tx;
+    uint32_t firstMissing;      // Handover: samples the first central found absent,
+    BLETxStats firstTx;         // ...and its counters once the device noticed the disconnect
+    HostRadioStats radio;
+    float seconds;              // Connected time
+};
+
+// Power up the board with the recording on the sensor, run setup() and
+// loop() (BLE mode) on the virtual clock, connect the central and start a
+// recording from the app; loop until it times out and its packets drain.
+// With a handover central, central disconnects FIRMWARE_HANDOVER_MS into
+// its recording and handover connects and records instead (the run
+// describes the second recording).
+static FirmwareRun runFirmware(const std::vector<long>& raw, const HostCentral& central,
+                               const HostCentral* handover) {
+    hostUseVirtualClock(true);
+    HostBoard board;
+    board.begin(raw.data(), raw.size(), BENCH_FS);
+    FirmwareApp app;
+    FirmwareRun run = {};
+    {
+        PowerManager powerManager;
+        BluetoothManager bluetoothManager;
+        PPGManager ppgManager(bluetoothManager);
+        bluetoothManager.begin("W", "123");
+        bluetoothManager.setPowerManager(powerManager);
+        bluetoothManager.setPPGManager(ppgManager);
+        ppgManager.setUpSensor();
+        ppgManager.shutDownSensor();
+        bluetoothManager.startAdvertising();
+
+        // One loop() pass per ms while in BLE mode (serviceBLE())
+        auto loopPass = [&]() {
+            bluetoothManager.update();
+            ppgManager.realTimePPGRec();
+            hostAdvanceClock(1000);
+        };
+        for (int t = 0; t < FIRMWARE_CONNECT_MS; t++) {
+            loopPass();
+        }
+
+        const uint8_t start = 0x01;
+        FirmwareApp first;
+        Bluefruit.onNotify = FirmwareApp::onNotify;
+        if (handover != nullptr) {
+            Bluefruit.onNotifyContext = &first;
+            Bluefruit.hostConnect(central);
+            loopPass();
+            first.started = true;
+            Bluefruit.hostWrite(FIRMWARE_REC_CONTROL_UUID, &start, 1);
+            for (int t = 0; t < FIRMWARE_HANDOVER_MS; t++) {
+                loopPass();
+            }
+            Bluefruit.hostDisconnect();
+            for (int t = 0; t < FIRMWARE_CONNECT_MS; t++) {
+                loopPass();
+            }
+            run.firstMissing = first.tracker.missingSamples();
+            run.firstTx = bluetoothManager.getTxStats();
+            run.diagErrors = first.diagErrors;
+        }
+
+        Bluefruit.onNotifyContext = &app;
+        Bluefruit.hostConnect(handover != nullptr ? *handover : central);
+        unsigned long connectedAt = millis();
+        loopPass();
+        uint32_t startIndex = board.sensor.producedSamples();
+        app.started = true;
+        Bluefruit.hostWrite(FIRMWARE_REC_CONTROL_UUID, &start, 1);
+        while (ppgManager.isRecording()) {
+            loopPass();
+        }
+        for (int t = 0; t < FIRMWARE_DRAIN_MS; t++) {
+            loopPass();
+        }
+        run.tx = bluetoothManager.getTxStats();
+        run.radio = Bluefruit.radio;
+        run.seconds = (millis() - connectedAt) / 1000.0f;
+        Bluefruit.hostDisconnect();
+        loopPass();
+        run.mismatches = countMismatches(raw, app, startIndex);
+    }
+    Bluefruit.hostReset();
+    board.end();
+    hostUseVirtualClock(false);
+
+    run.delivered = (uint32_t)app.samples.size();
+    run.missing = app.tracker.missingSamples();
+    run.lostPackets = app.tracker.lostPackets();
+    run.decodeErrors = app.decodeErrors;
+    run.maxLatency = app.maxLatency;
+    run.hrvReports = app.hrvReports;
+    run.hrvErrors = app.hrvErrors;
+    run.stalePackets = app.stalePackets;
+    run.firstSequence = app.firstSequence;
+    run.diagReports = app.diagReports;
+    run.diagErrors += app.diagErrors;
+    return run;
+}
+
+// The firmware managers (PPGManager, BluetoothManager, PowerManager) built
+// against the host stand-ins, streaming one recording to each central
+static bool reportFirmwareOnHost(const std::vector<long>& raw) {
+    struct Central {
+        const char* name;
+        HostCentral behaviour;
+        bool lossless;          // Link fast enough for the stream
+        bool handover;          // Disconnects mid-recording; the first central records next
+    };
+    // As in reportLinkPolicy(); the 500 ms central is too slow for the stream
+    const Central centrals[] = {
+        {"cooperative", {6, 3200, 1, 499, true, true, 100, 24, 0, 500, 247, 6}, true, false},
+        {"15 ms steps", {12, 3200, 12, 30, true, true, 300, 24, 0, 72, 185, 4}, true, false},
+        {"min 50 ms", {40, 3200, 1, 499, true, true, 100, 40, 0, 400, 23, 1}, true, false},
+        {"ignores updates", {6, 3200, 1, 0, false, true, 100, 6, 0, 100, 23, 1}, true, false},
+        {"500 ms, 1/event", {400, 3200, 1, 0, false, false, 100, 400, 0, 600, 23, 1}, false, false},
+        {"500 ms -> coop.", {400, 3200, 1, 0, false, false, 100, 400, 0, 600, 23, 1}, true, true},
+    };
+    const uint32_t expected = COLLECTION_TIME / 1000 * BENCH_FS;
+
+    printf("\nFirmware on host (setup() + BLE-mode loop(), one %d s recording per central)\n",
+           COLLECTION_TIME / 1000);
+    printf("  %-16s %9s %8s %8s %8s %7s %8s %7s %11s %7s %9s %4s\n", "central", "delivered", "missing",
+           "mismatch", "packets", "retries", "tx queue", "dropped", "lost/drop", "wait", "events/s", "hrv");
+
+    bool pass = true;
+    uint32_t handoverCounted = 0;
+    for (size_t c = 0; c < sizeof(centrals) / sizeof(centrals[0]); c++) {
+        FirmwareRun run = runFirmware(raw, centrals[c].behaviour,
+                                      centrals[c].handover ? &centrals[0].behaviour : nullptr);
+        // Every sample the app found absent is in the sample counters
+        bool ok = run.mismatches == 0 && run.decodeErrors == 0 && run.lostPackets == 0 &&
+                  run.delivered > 0 && run.hrvErrors == 0 && run.stalePackets == 0 && run.firstSequence == 0 &&
+                  run.diagErrors == 0 && run.missing <= run.tx.samplesLost + run.tx.samplesDropped;
+        // Whole diagnostics payloads wherever they fit one notification
+        const HostCentral& last = centrals[c].handover ? centrals[0].behaviour : centrals[c].behaviour;
+        ok = ok && (last.mtu - 3 < FIRMWARE_DIAGNOSTICS_SIZE || run.diagReports > 0);
+        if (centrals[c].lossless) {
+            // The timeout leaves up to one A_FULL block unread in the sensor
+            ok = ok && run.missing == 0 && run.tx.dropped == 0 && run.tx.samplesLost == 0 &&
+                 run.tx.samplesDropped == 0 && run.delivered + PPG_FIFO_A_FULL_SAMPLES >= expected &&
+                 run.delivered <= expected && run.hrvReports > 0;
+        }
+        if (centrals[c].handover) {
+            // The first recording's undelivered samples, counted once the
+            // device noticed the disconnect
+            uint32_t counted = run.firstTx.samplesLost + run.firstTx.samplesDropped;
+            ok = ok && counted > 0 && run.firstMissing <= counted;
+            handoverCounted = counted;
+        }
+        pass = pass && ok;
+        printf("  %-16s %9u %8u %8u %8u %7u %5u/%-2d %7u %5u/%-5u %5u ms %9.2f %4u%s\n", centrals[c].name,
+               run.delivered, run.missing, run.mismatches, run.tx.sent, run.tx.retried,
+               run.tx.highWater, BLE_TX_QUEUE_SIZE, run.tx.dropped, run.tx.samplesLost, run.tx.samplesDropped,
+               run.maxLatency, run.radio.events / std::max(run.seconds, 1.0f), run.hrvReports,
+               ok ? "" : "  <- FAIL");
+    }
+    printf("  (missing: samples the app found absent from the stream; lost/drop: samples the\n"
+           "   device counted as lost before / dropped in the BLE stage; wait: first sample of a\n"
+           "   packet to its delivery; hrv: HRV notifications, each one whole %d-byte version %d\n"
+           "   payload; 500 ms -> coop.: the slow central disconnects %d s into its recording\n"
+           "   (%u samples counted undelivered), the second recording on the cooperative one is\n"
+           "   shown)\n", BLE_HRV_SIZE, BLE_HRV_VERSION, FIRMWARE_HANDOVER_MS / 1000, handoverCounted);
+    printf("  every sample in place or counted, complete on links that keep up, HRV intact,\n"
+           "  each recording from packet 0 with nothing of an earlier one: %s\n", pass ? "PASS" : "FAIL");
+    return pass;
+}
+
+// ============================================================================
+// FIRMWARE TASKS
+// ============================================================================
+
+#define FIRMWARE_TASK_RECORDING_MS 4000     // Recording started and stopped from the app
+#define FIRMWARE_TASK_DRAIN_MS 1000         // Connected after the stop
+
+// As runFirmware() with the cooperative central, on the wall clock: setUpSensor()
+// creates the acquisition, processing and BLE stage tasks (std::threads),
+// the board runs in its own thread and the main thread makes the loop()
+// passes, so the firmware's task path runs as on the device
+static bool reportFirmwareTasks(const std::vector<long>& raw) {
+    const HostCentral central = {6, 3200, 1, 499, true, true, 100, 24, 0, 500, 247, 6};
+
+    hostUseVirtualClock(false);
+    HostBoard board;
+    board.begin(raw.data(), raw.size(), BENCH_FS);
+    FirmwareApp app;
+    bool tasks = false;
+    uint32_t mismatches = 0;
+    uint32_t acquiredOverruns = 0;
+    uint32_t processedOverruns = 0;
+    BLETxStats tx = {};
+    {
+        PowerManager powerManager;
+        BluetoothManager bluetoothManager;
+        PPGManager ppgManager(bluetoothManager);
+        bluetoothManager.begin("W", "123");
+        bluetoothManager.setPowerManager(powerManager);
+        bluetoothManager.setPPGManager(ppgManager);
+        ppgManager.setUpSensor();
+        tasks = ppgManager.hasRecordingTasks();
+        ppgManager.shutDownSensor();
+        bluetoothManager.startAdvertising();
+
+        // loop() passes (serviceBLE()) for ms of wall time
+        auto runLoop = [&](uint32_t ms) {
+            unsigned long begin = millis();
+            while (millis() - begin < ms) {
+                bluetoothManager.update();
+                ppgManager.realTimePPGRec();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        };
+
+        Bluefruit.onNotify = FirmwareApp::onNotify;
+        Bluefruit.onNotifyContext = &app;
+        Bluefruit.hostConnect(central);
+        runLoop(100);
+        const uint8_t start = 0x01;
+        const uint8_t stop = 0x00;
+        uint32_t startIndex;
+        {
+            // The notification callback reads started on the board thread
+            HostLock lock;
+            startIndex = board.sensor.producedSamples();
+            app.started = true;
+        }
+        Bluefruit.hostWrite(FIRMWARE_REC_CONTROL_UUID, &start, 1);
+        runLoop(FIRMWARE_TASK_RECORDING_MS);
+        Bluefruit.hostWrite(FIRMWARE_REC_CONTROL_UUID, &stop, 1);
+        runLoop(FIRMWARE_TASK_DRAIN_MS);
+        Bluefruit.hostDisconnect();
+        runLoop(10);
+
+        // No more interrupts or connection events, then the tasks return
+        board.end();
+        ppgManager.stopRecordingTasks();
+        hostJoinTasks();
+        tx = bluetoothManager.getTxStats();
+        acquiredOverruns = ppgManager.getAcquiredOverruns();
+        processedOverruns = ppgManager.getProcessedOverruns();
+        mismatches = countMismatches(raw, app, startIndex);
+    }
+    Bluefruit.hostReset();
+
+    uint32_t delivered = (uint32_t)app.samples.size();
+    uint32_t missing = app.tracker.missingSamples();
+    // Turning the sensor on and the stop each leave up to one A_FULL block
+    const uint32_t minimum = FIRMWARE_TASK_RECORDING_MS / 1000 * BENCH_FS - 2 * PPG_FIFO_A_FULL_SAMPLES;
+    bool pass = tasks && mismatches == 0 && missing == 0 && app.tracker.lostPackets() == 0 &&
+                app.decodeErrors == 0 && app.stalePackets == 0 && app.firstSequence == 0 &&
+                tx.dropped == 0 && tx.samplesLost == 0 && tx.samplesDropped == 0 && delivered >= minimum &&
+                acquiredOverruns == 0 && processedOverruns == 0;
+
+    printf("\nFirmware tasks (stage tasks, board and loop() threads on the wall clock, %d s recording)\n",
+           FIRMWARE_TASK_RECORDING_MS / 1000);
+    printf("  stage tasks %s, delivered %u (min %u), missing %u, mismatch %u, packets %u, "
+           "lost/drop %u/%u, overruns %u/%u, wait %u ms\n",
+           tasks ? "created" : "NOT created", delivered, minimum, missing, mismatches, tx.sent,
+           tx.samplesLost, tx.samplesDropped, acquiredOverruns, processedOverruns, app.maxLatency);
+    printf("  recording complete and in place through the task path: %s\n", pass ? "PASS" : "FAIL");
+    return pass;
+}
+
+// ============================================================================
+// WEAR DETECTION
+// ============================================================================
+
+#define WEAR_BENCH_SECONDS 14400    // Virtual time per configuration
+#define WEAR_BENCH_MIN_WORN_S 60    // Device on / off for 1-10 minutes at a time
+#define WEAR_BENCH_MAX_WORN_S 600
+#define WEAR_BENCH_CHECK_S 60       // Blocking proximityCheck() period it is compared with
+#define WEAR_BENCH_CHECK_MS 3000    // ...and its SAMPLE_WINDOW
+
+struct WearRun {
+    uint32_t changes;           // Put on / taken off
+    uint32_t reported;          // Changes reported by a matching event
+    uint32_t spurious;          // Events that match no change
+    double onSum, onMax;        // Put on -> WEAR_ON (ms)
+    double offSum, offMax;      // Taken off -> WEAR_OFF (ms)
+    uint32_t onCount, offCount;
+    uint32_t wakes;             // update() calls
+    double samplingMs, proximityMs, shutdownMs, ledStepMs;
+
+    WearRun()
+        : changes(0), reported(0), spurious(0), onSum(0), onMax(0), offSum(0), offMax(0), onCount(0),
+          offCount(0), wakes(0), samplingMs(0), proximityMs(0), shutdownMs(0), ledStepMs(0) {}
+};
+
+// Sensor current (powerModel.h) over the time in each mode
+static double sensorCurrent(double samplingMs, double proximityMs, double shutdownMs, double ledStepMs) {
+    double totalMs = samplingMs + proximityMs + shutdownMs;
+    return ((samplingMs + proximityMs) * SENSOR_ACTIVE_MA + shutdownMs * SENSOR_SHUTDOWN_MA +
+            ledStepMs * SENSOR_LED_MA_PER_STEP * SENSOR_LED_DUTY) / totalMs;
+}
+
+// The device is put on and taken off at random, with the sensor set up as
+// PPGManager::setUpSensor() does; WearDetector runs as wellby_firmware.ino
+// runs it: update() on each INT edge and nextUpdate() ms after each call
+static WearRun simulateWear(const std::vector<long>& raw, uint32_t searchInterval, uint32_t seed) {
+    WearRun run;
+    hostUseVirtualClock(true);
+    Max30105Sim sensor;
+    sensor.setSource(raw.data(), raw.size(), BENCH_FS, PPG_FIFO_SLOT_GREEN);
+    sensor.setContact(false);
+    Wire.attach(&sensor);
+
+    MAX30105 particleSensor;
+    particleSensor.begin(Wire, I2C_SPEED_FAST);
+    particleSensor.setup(255, SAMPLING_AVERAGE, LED_MODE, SAMPLING_RATE, 411, 2048);
+    particleSensor.setPulseAmplitudeRed(0);
+    particleSensor.setPulseAmplitudeIR(0);
+    particleSensor.shutDown();
+
+    WearDetector wear(particleSensor);
+    wear.begin(WEAR_PROXIMITY_THRESHOLD, WEAR_PILOT_AMPLITUDE, searchInterval, WEAR_CHECK_INTERVAL,
+               WEAR_CONFIRM_TIME);
+    unsigned long start = millis();
+    unsigned long end = start + WEAR_BENCH_SECONDS * 1000ul;
+    wear.start(start);
+    uint32_t next = wear.nextUpdate(start);
+    unsigned long due = start + next;
+    bool timed = next != WEAR_NO_POLL;
+
+    uint32_t state = seed | 1;  // xorshift never leaves 0
+    const uint32_t spanMs = (WEAR_BENCH_MAX_WORN_S - WEAR_BENCH_MIN_WORN_S) * 1000;
+    unsigned long nextChange = start + WEAR_BENCH_MIN_WORN_S * 1000ul + nextRandom(&state) % spanMs;
+    unsigned long changedAt = 0;
+    bool worn = false;
+    bool pending = false;
+    bool line = false;
+    while (millis() < end) {
+        hostAdvanceClock(1000);
+        sensor.advance(1);
+        unsigned long now = millis();
+
+        // Changes stop a full check before the end, so each can be reported
+        if (now >= nextChange && now + WEAR_BENCH_MIN_WORN_S * 1000ul < end) {
+            worn = !worn;
+            sensor.setContact(worn);
+            changedAt = now;
+            pending = true;
+            run.changes++;
+            nextChange = now + WEAR_BENCH_MIN_WORN_S * 1000ul + nextRandom(&state) % spanMs;
+        }
+
+        bool edge = sensor.interruptAsserted() && !line;
+        if (edge || (timed && (long)(now - due) >= 0)) {
+            run.wakes++;
+            WearEvent event = wear.update(now);
+            if (event != WEAR_NO_CHANGE) {
+                if (pending && (event == WEAR_ON) == worn) {
+                    double latency = (double)(now - changedAt);
+                    if (worn) {
+                        run.onSum += latency;
+                        run.onMax = std::max(run.onMax, latency);
+                        run.onCount++;
+                    } else {
+                        run.offSum += latency;
+                        run.offMax = std::max(run.offMax, latency);
+                        run.offCount++;
+                    }
+                    run.reported++;
+                    pending = false;
+                } else {
+                    run.spurious++;
+                }
+            }
+            next = wear.nextUpdate(now);
+            timed = next != WEAR_NO_POLL;
+            due = now + next;
+        }
+        line = sensor.interruptAsserted();
+    }
+    Wire.detach(&sensor);
+    hostUseVirtualClock(false);
+
+    run.samplingMs = sensor.samplingMs();
+    run.proximityMs = sensor.proximityMs();
+    run.shutdownMs = sensor.shutdownMs();
+    run.ledStepMs = sensor.ledStepMs();
+    return run;
+}
+
+// WearDetector with the PPGManager.h settings at several search intervals,
+// against the blocking proximityCheck() it replaces
+static bool reportWearDetection(const std::vector<long>& raw, uint32_t seed) {
+    const uint32_t searchIntervals[] = {0, 2000, WEAR_SEARCH_INTERVAL, 15000};
+    const double period = 1000.0 / BENCH_FS;
+
+    printf("\nWear detection (wearDetector.h, virtual clock, %d h, on/off every %d-%d min)\n",
+           WEAR_BENCH_SECONDS / 3600, WEAR_BENCH_MIN_WORN_S / 60, WEAR_BENCH_MAX_WORN_S / 60);
+    printf("  %-16s %7s %8s %8s %9s %9s %9s %8s %8s %8s\n", "mode", "changes", "on avg", "on max",
+           "off avg", "off max", "LEDs s/h", "prox s/h", "wakes/h", "est. mA");
+
+    // The blocking check: 3 s of sampling at recording current once a minute
+    double checkShare = (double)WEAR_BENCH_CHECK_MS / (WEAR_BENCH_CHECK_S * 1000);
+    double checkMa = sensorCurrent(checkShare, 0, 1 - checkShare, checkShare * 255);
+    printf("  %-16s %7s %6.1f s %6.1f s %7.1f s %7.1f s %9.0f %8.0f %8d %8.4f\n", "check/min (old)", "-",
+           (WEAR_BENCH_CHECK_S * 1000 + WEAR_BENCH_CHECK_MS) / 2000.0,
+           (WEAR_BENCH_CHECK_S * 1000 + WEAR_BENCH_CHECK_MS) / 1000.0,
+           (WEAR_BENCH_CHECK_S * 1000 + WEAR_BENCH_CHECK_MS) / 2000.0,
+           (WEAR_BENCH_CHECK_S * 1000 + WEAR_BENCH_CHECK_MS) / 1000.0, checkShare * 3600, 0.0,
+           3600 / WEAR_BENCH_CHECK_S, checkMa);
+
+    bool pass = true;
+    for (size_t i = 0; i < sizeof(searchIntervals) / sizeof(searchIntervals[0]); i++) {
+        uint32_t searchInterval = searchIntervals[i];
+        WearRun run = simulateWear(raw, searchInterval, seed + (uint32_t)i);
+
+        // Contact is seen at the first reading of the next probe, removal
+        // at the end of the next check
+        double onBound = searchInterval + 2 * period;
+        double offBound = WEAR_CHECK_INTERVAL + WEAR_CONFIRM_TIME + 2 * period;
+        bool ok = run.changes > 0 && run.reported == run.changes && run.spurious == 0 &&
+                  run.onMax <= onBound && run.offMax <= offBound;
+        pass = pass && ok;
+
+        char name[32];
+        if (searchInterval == 0) {
+            snprintf(name, sizeof(name), "continuous");
+        } else {
+            snprintf(name, sizeof(name), "probe every %us", (unsigned)(searchInterval / 1000));
+        }
+        double hours = WEAR_BENCH_SECONDS / 3600.0;
+        printf("  %-16s %7u %6.1f s %6.1f s %7.1f s %7.1f s %9.1f %8.1f %8.0f %8.4f%s\n", name, run.changes,
+               run.onSum / std::max<uint32_t>(run.onCount, 1) / 1000, run.onMax / 1000,
+               run.offSum / std::max<uint32_t>(run.offCount, 1) / 1000, run.offMax / 1000,
+               run.samplingMs / 1000 / hours, run.proximityMs / 1000 / hours, run.wakes / hours,
+               sensorCurrent(run.samplingMs, run.proximityMs, run.shutdownMs, run.ledStepMs),
+               ok ? "" : "  <- FAIL");
+    }
+    printf("  (LEDs: time sampling at recording current; prox: time in proximity mode on the pilot\n"
+           "   LED; est. mA: sensor alone, powerModel.h; probes while worn every %d s)\n",
+           WEAR_CHECK_INTERVAL / 1000);
+    printf("  every change reported once, within one probe interval: %s\n", pass ? "PASS" : "FAIL");
+    return pass;
+}
+
+// ============================================================================
+// RECORDING TASKS
+// ============================================================================
+
+#define TASK_RECORDINGS 300         // Start/stop cycles
+#define TASK_RECORDING_US 4000      // Longest recording
+#define TASK_WAKE_US 60             // Longest time between FIFO interrupts
+#define TASK_BURST_PERCENT 2        // Blocks that take processing TASK_BURST_US
+#define TASK_BURST_US 400
+#define TASK_REFUSE_PERCENT 20      // transmit() calls refused (BLE queue full)
+#define TASK_STALL_PERCENT 2        // transmit() calls that block TASK_STALL_US
+#define TASK_STALL_US 1500
+#define TASK_DRAIN_MS 5000          // Longest wait for the last stop to get through
+
+static void spinMicros(uint32_t us) {
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+    while (std::chrono::steady_clock::now() < end) {
+    }
+}
+
+// Stand-in for PPGManager's stages. Blocks carry a running sample index
+// and the recording they were acquired in (timestamp); processing inverts
+// the samples, so the BLE stage can tell processed blocks from raw ones.
+// Each member is touched by one stage only, apart from the atomics.
+class StressStages : public PPGTaskStages {
+public:
+    StressStages()
+        : recording(0), nextSample(0), processState(0x2545F491), transmitState(0x9E3779B9),
+          txRecording(0), lastFirstSample(0), started(false), errors(0), blocksAcquired(0),
+          blocksDelivered(0), acqMarkerCount(0), lastAcqMarker(PPG_TASK_BLOCK), txMarkers(0) {}
+
+    bool acquire(PPGTaskItem* item) override {
+        if (item->event != PPG_TASK_BLOCK) {
+            recording += item->event == PPG_TASK_START ? 1 : 0;
+            acqMarkers.push_back(item->event);
+            lastAcqMarker = item->event;
+            acqMarkerCount++;
+            return true;
+        }
+        uint8_t count = 1 + nextRandom(&acquireState) % PPG_FIFO_DEPTH;
+        item->block.timestamp = recording;
+        item->block.firstSample = nextSample;
+        item->block.count = count;
+        item->block.overflow = 0;
+        for (uint8_t i = 0; i < count; i++) {
+            item->block.samples[i] = nextSample + i;
+        }
+        nextSample += count;
+        blocksAcquired++;
+        return true;
+    }
+
+    void process(PPGTaskItem* item) override {
+        if (item->event != PPG_TASK_BLOCK) {
+            procMarkers.push_back(item->event);
+            return;
+        }
+        for (uint8_t i = 0; i < item->block.count; i++) {
+            item->block.samples[i] = ~item->block.samples[i];
+        }
+        if (nextRandom(&processState) % 100 < TASK_BURST_PERCENT) {
+            spinMicros(TASK_BURST_US);
+        }
+    }
+
+    bool transmit(const PPGTaskItem& item) override {
+        uint32_t roll = nextRandom(&transmitState) % 100;
+        if (roll < TASK_REFUSE_PERCENT) {
+            return false;
+        }
+        if (roll >= 100 - TASK_STALL_PERCENT) {
+            std::this_thread::sleep_for(std::chrono::microseconds(TASK_STALL_US));
+        }
+        if (item.event != PPG_TASK_BLOCK) {
+            txRecording += item.event == PPG_TASK_START ? 1 : 0;
+            txMarkerLog.push_back(item.event);
+            txMarkers++;
+            return true;
+        }
+        const PPGSampleBlock& block = item.block;
+        bool inOrder = !started || block.firstSample > lastFirstSample;
+        bool ok = inOrder && block.timestamp == txRecording && block.count >= 1 &&
+                  block.count <= PPG_FIFO_DEPTH;
+        for (uint8_t i = 0; ok && i < block.count; i++) {
+            ok = block.samples[i] == ~(block.firstSample + i);
+        }
+        errors += ok ? 0 : 1;
+        started = true;
+        lastFirstSample = block.firstSample;
+        blocksDelivered++;
+        return true;
+    }
+
+    bool service(uint32_t now) override { return false; }
+
+    // Acquisition
+    uint32_t acquireState = 0x12345678;
+    uint32_t recording;
+    uint32_t nextSample;
+    std::vector<uint8_t> acqMarkers;
+    // Processing
+    uint32_t processState;
+    std::vector<uint8_t> procMarkers;
+    // BLE
+    uint32_t transmitState;
+    uint32_t txRecording;
+    uint32_t lastFirstSample;
+    bool started;
+    std::vector<uint8_t> txMarkerLog;
+    std::atomic<uint32_t> errors;
+    std::atomic<uint32_t> blocksAcquired;
+    std::atomic<uint32_t> blocksDelivered;
+    std::atomic<uint32_t> acqMarkerCount;
+    std::atomic<uint8_t> lastAcqMarker;
+    std::atomic<uint32_t> txMarkers;
+};
+
+static bool reportRecordingTasks() {
+    printf("\nRecording tasks (ppgTasks.h: acquisition, processing, BLE on std::thread)\n");
+    hostUseVirtualClock(false);
+
+    StressStages* stages = new StressStages();
+    PPGTaskPipeline* pipeline = new PPGTaskPipeline(*stages);
+    pipeline->setPollInterval(PPG_TASK_NO_POLL);
+    if (!pipeline->startTasks()) {
+        printf("  tasks could not be created: FAIL\n");
+        return false;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::atomic<bool> done(false);
+    std::thread sensor([&]() {
+        uint32_t state = 0xC0FFEE11;
+        while (!done) {
+            pipeline->wakeFromISR();
+            std::this_thread::sleep_for(std::chrono::microseconds(nextRandom(&state) % TASK_WAKE_US));
+        }
+    });
+
+    // Starts, stops, and now and then a restart or a stop right after a start
+    uint32_t state = 0x5EED1234;
+    uint32_t requests = 0;
+    for (int r = 0; r < TASK_RECORDINGS; r++) {
+        pipeline->start();
+        requests += 2;
+        std::this_thread::sleep_for(std::chrono::microseconds(nextRandom(&state) % TASK_RECORDING_US));
+        if (nextRandom(&state) % 10 == 0) {
+            pipeline->start();
+            requests++;
+            std::this_thread::sleep_for(std::chrono::microseconds(nextRandom(&state) % TASK_RECORDING_US));
+        }
+        pipeline->stop();
+        if (nextRandom(&state) % 2 == 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(nextRandom(&state) % TASK_RECORDING_US));
+        }
+    }
+
+    // Done once the last stop has reached the BLE stage: every block
+    // acquired before it has been delivered or dropped by then
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(TASK_DRAIN_MS);
+    bool drained = false;
+    while (!drained && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        drained = stages->lastAcqMarker == PPG_TASK_STOP && stages->txMarkers == stages->acqMarkerCount;
+    }
+    done = true;
+    sensor.join();
+    pipeline->stopTasks();
+    hostJoinTasks();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Markers alternate start/stop and arrive unchanged at every stage
+    bool alternating = true;
+    for (size_t i = 0; i < stages->acqMarkers.size(); i++) {
+        alternating = alternating && stages->acqMarkers[i] == (i % 2 == 0 ? PPG_TASK_START : PPG_TASK_STOP);
+    }
+    bool markersOk = alternating && stages->acqMarkers.size() % 2 == 0 &&
+                     stages->procMarkers == stages->acqMarkers && stages->txMarkerLog == stages->acqMarkers;
+    uint32_t acquired = stages->blocksAcquired;
+    uint32_t delivered = stages->blocksDelivered;
+    bool accounted = acquired == pipeline->blocksAcquired() &&
+                     acquired == delivered + pipeline->acquiredOverruns() + pipeline->processedOverruns();
+
+    printf("  %u recordings from %u start/stop requests, %.2f s\n", (unsigned)stages->acqMarkers.size() / 2,
+           requests, seconds);
+    printf("  blocks acquired %u, delivered %u, dropped: processing behind %u, BLE behind %u\n", acquired,
+           delivered, pipeline->acquiredOverruns(), pipeline->processedOverruns());
+    printf("  every block in order, processed, in its recording, or counted: %s (%u errors)\n",
+           accounted && drained && stages->errors == 0 ? "PASS" : "FAIL", (unsigned)stages->errors);
+    printf("  every start/stop reaches every stage in order: %s\n", markersOk && drained ? "PASS" : "FAIL");
+    bool pass = accounted && drained && stages->errors == 0 && markersOk;
+
+    delete pipeline;
+    delete stages;
+    return pass;
+}
+
+// ============================================================================
+// SPSC RING
+// ============================================================================
+
+#define RING_STRESS_ITEMS 10000000  // Items per stress run
+#define RING_THROUGHPUT_ITEMS 10000000
+#define RING_CAPACITY 256
+
+// Two words written separately, so a torn copy is detectable
+struct RingItem {
+    uint32_t sequence;
+    uint32_t check;  // ~sequence
+};
+
+typedef SpscRing<RingItem, RING_CAPACITY> StressRing;
+
+static void stressProducer(StressRing* ring, uint32_t items) {
+    uint32_t state = 0x12345678;
+    RingItem batch[37];
+    uint32_t next = 0;
+    while (next < items) {
+        if (ring->freeSpace() == 0) {
+            std::this_thread::yield();  // Let the consumer run on single-core hosts
+        }
+        uint32_t method = nextRandom(&state) % 3;
+        uint32_t want = 1 + nextRandom(&state) % 37;
+        if (want > items - next) {
+            want = items - next;
+        }
+        if (method == 0) {
+            RingItem item = {next, ~next};
+            next += ring->push(item) ? 1 : 0;
+        } else if (method == 1) {
+            for (uint32_t i = 0; i < want; i++) {
+                batch[i].sequence = next + i;
+                batch[i].check = ~(next + i);
+            }
+            next += ring->push(batch, want);
+        } else {
+            RingItem* slots;
+            uint32_t run = std::min(ring->prepare(&slots), want);
+            for (uint32_t i = 0; i < run; i++) {
+                slots[i].sequence = next + i;
+                slots[i].check = ~(next + i);
+            }
+            ring->commit(run);
+            next += run;
+        }
+    }
+}
+
+// Returns the number of out-of-sequence or torn items seen
+static uint32_t stressConsumer(StressRing* ring, uint32_t items) {
+    uint32_t state = 0x9E3779B9;
+    RingItem batch[37];
+    uint32_t expected = 0;
+    uint32_t errors = 0;
+    auto check = [&](const RingItem& item) {
+        if (item.sequence != expected || item.check != ~expected) {
+            errors++;
+            expected = item.sequence;  // Resynchronise so one fault counts once
+        }
+        expected++;
+    };
+    // Runs to the end even after errors, so the producer is never left blocked
+    while (expected < items) {
+        if (ring->empty()) {
+            std::this_thread::yield();
+        }
+        uint32_t method = nextRandom(&state) % 3;
+        uint32_t want = 1 + nextRandom(&state) % 37;
+        if (method == 0) {
+            RingItem item;
+            if (ring->pop(&item)) {
+                check(item);
+            }
+        } else if (method == 1) {
+            uint32_t count = ring->pop(batch, want);
+            for (uint32_t i = 0; i < count; i++) {
+                check(batch[i]);
+            }
+        } else {
+            const RingItem* run;
+            uint32_t count = std::min(ring->peek(&run), want);
+            for (uint32_t i = 0; i < count; i++) {
+                check(run[i]);
+            }
+            ring->consume(count);
+        }
+    }
+    return errors;
+}
+
+// Move items through a ring between two threads, batch items at a time
+template <typename Queue>
+static double measureThroughput(Queue& queue, uint32_t items, uint32_t batch,
+                                bool (*push)(Queue&, const uint32_t*, uint32_t),
+                                uint32_t (*pop)(Queue&, uint32_t*, uint32_t)) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::thread producer([&]() {
+        uint32_t values[64];
+        for (uint32_t next = 0; next < items;) {
+            uint32_t count = std::min(batch, items - next);
+            for (uint32_t i = 0; i < count; i++) {
+                values[i] = next + i;
+            }
+            while (!push(queue, values, count)) {
+                std::this_thread::yield();
+            }
+            next += count;
+        }
+    });
+    uint32_t values[64];
+    uint64_t sum = 0;
+    for (uint32_t received = 0; received < items;) {
+        uint32_t count = pop(queue, values, batch);
+        if (count == 0) {
+            std::this_thread::yield();
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            sum += values[i];
+        }
+        received += count;
+    }
+    producer.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (sum != (uint64_t)items * (items - 1) / 2) {
+        printf("  WARNING: throughput run lost or corrupted items\n");
+    }
+    return items / seconds;
+}
+
+typedef SpscRing<uint32_t, RING_CAPACITY> ThroughputRing;
+
+struct LockedQueue {
+    std::mutex lock;
+    std::deque<uint32_t> items;
+};
+
+// Batch push is all-or-nothing so the producer's batches stay whole
+static bool ringPush(ThroughputRing& ring, const uint32_t* values, uint32_t count) {
+    return ring.freeSpace() >= count && ring.push(values, count) == count;
+}
+
+static uint32_t ringPop(ThroughputRing& ring, uint32_t* values, uint32_t count) {
+    return ring.pop(values, count);
+}
+
+static bool lockedPush(LockedQueue& queue, const uint32_t* values, uint32_t count) {
+    std::lock_guard<std::mutex> guard(queue.lock);
+    if (queue.items.size() + count > RING_CAPACITY) {
+        return false;
+    }
+    queue.items.insert(queue.items.end(), values, values + count);
+    return true;
+}
+
+static uint32_t lockedPop(LockedQueue& queue, uint32_t* values, uint32_t count) {
+    std::lock_guard<std::mutex> guard(queue.lock);
+    uint32_t n = std::min<uint32_t>(count, queue.items.size());
+    std::copy(queue.items.begin(), queue.items.begin() + n, values);
+    queue.items.erase(queue.items.begin(), queue.items.begin() + n);
+    return n;
+}
+
+static bool reportSpscRing() {
+    printf("\nSPSC ring (capacity %d, 2 threads)\n", RING_CAPACITY);
+
+    StressRing* stress = new StressRing();
+    std::thread producer(stressProducer, stress, (uint32_t)RING_STRESS_ITEMS);
+    uint32_t errors = stressConsumer(stress, RING_STRESS_ITEMS);
+    producer.join();
+    bool pass = errors == 0 && stress->empty();
+    printf("  stress: %d items, mixed single/batch/zero-copy: %s (%u errors)\n",
+           RING_STRESS_ITEMS, pass ? "PASS" : "FAIL", errors);
+    delete stress;
+
+    printf("  %-22s %12s\n", "queue", "Mitems/s");
+    const uint32_t batches[] = {1, 16, 64};
+    for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+        ThroughputRing* ring = new ThroughputRing();
+        LockedQueue locked;
+        double ringRate = measureThroughput(*ring, RING_THROUGHPUT_ITEMS, batches[b], ringPush, ringPop);
+        double lockedRate = measureThroughput(locked, RING_THROUGHPUT_ITEMS, batches[b], lockedPush, lockedPop);
+        char name[32];
+        snprintf(name, sizeof(name), "SpscRing, batch %u", batches[b]);
+        printf("  %-22s %12.1f\n", name, ringRate / 1e6);
+        snprintf(name, sizeof(name), "mutex+deque, batch %u", batches[b]);
+        printf("  %-22s %12.1f\n", name, lockedRate / 1e6);
+        delete ring;
+    }
+    return pass;
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, &options)) {
+        usage();
+        return 1;
+    }
+    options.synth.fs = BENCH_FS;
+    Serial.setQuiet(!options.serial);
+
+    SyntheticPpg synthetic;
+    std::vector<long> raw;
+    if (options.csvPath != NULL) {
+        if (!loadCsv(options.csvPath, &raw)) {
+            return 1;
+        }
+        printf("Input: %s\n", options.csvPath);
+    } else {
+        synthetic = generateSyntheticPpg(options.synth);
+        raw = synthetic.samples;
+        printf("Input: synthetic, HR %.0f bpm, SDNN %.0f ms, noise %.2f, wander %.2f, "
+               "motion %.1f/min, seed %u\n",
+               options.synth.heartRate, options.synth.sdnn, options.synth.noise,
+               options.synth.wander, options.synth.motionBursts, options.synth.seed);
+        if (options.dumpPath != NULL) {
+            dumpCsv(options.dumpPath, synthetic);
+        }
+    }
+
+    bool pass = runBenchmark(raw, options.reps);
+
+    if (options.csvPath == NULL) {
+        pass &= reportHrvAccuracy(raw, synthetic);
+        pass &= reportPeakAccuracy(raw, &synthetic);
+    } else {
+        pass &= reportPeakAccuracy(raw, NULL);
+    }
+    pass &= reportBiquadEquivalence(raw);
+    pass &= reportFixedPointError(raw);
+    if (options.csvPath == NULL) {
+        pass &= reportSqiAccuracy(options.synth.seed);
+    }
+    pass &= reportFifoAcquisition(raw);
+    pass &= reportInterruptAcquisition(raw);
+    pass &= reportPacketFormat(raw);
+    pass &= reportCompression(raw, options.synth.seed);
+    pass &= reportStreamContinuity(raw);
+    pass &= reportBatching(raw);
+    pass &= reportLinkPolicy();
+    pass &= reportFirmwareOnHost(raw);
+    pass &= reportFirmwareTasks(raw);
+    pass &= reportWearDetection(raw, options.synth.seed);
+    pass &= reportRecordingTasks();
+    pass &= reportSpscRing();
+
+    printf("\n%s\n", pass ? "All checks passed" : "FAILED");
+    return pass ? 0 : 1;
+}
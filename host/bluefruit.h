@@ -0,0 +1,313 @@
+/*
+ * bluefruit.h (host stub)
+ *
+ * Stand-in for the parts of the Adafruit Bluefruit API used by the
+ * firmware (BluetoothManager.cpp, bleLinkPolicy.cpp), with a simulated
+ * central on one connection.
+ *
+ * CENTRAL:
+ * hostConnect() connects while advertising, subscribes to every notify
+ * characteristic and runs the connect callback; hostWrite() writes a
+ * characteristic as the app would; hostDisconnect() ends the link.
+ * Requested connection parameters are rounded and clamped the way phones
+ * do, may be ignored or lack the 2M PHY, and take effect
+ * HostCentral::delayMs after the request (on the virtual clock, see
+ * Arduino.h), like the link-layer update procedure. The ATT MTU is the
+ * smaller of what both sides support, once the peripheral asks for it.
+ *
+ * RADIO:
+ * notify() takes one of the SoftDevice's notification buffers
+ * (hvn_tx_queue_size: 3 with BANDWIDTH_MAX, 1 otherwise) per MTU-sized
+ * piece, and fails when none is free rather than blocking. Buffers are
+ * sent at connection events, up to HostCentral::packetsPerEvent each;
+ * every event that sends some raises BLE_GATTS_EVT_HVN_TX_COMPLETE
+ * through the event callback and hands the data to the central
+ * (HostBluefruit::onNotify). Events run in hostProcess(), which a
+ * simulation calls as its clock moves. The peripheral skips up to
+ * slave-latency events while it has nothing to send. While advertising,
+ * hostProcess() counts advertising events: fast interval until the fast
+ * timeout, then the slow one.
+ *
+ * NOT MODELLED: Packet loss and retransmission, data length and PHY
+ * effects on how much fits in an event, advertising delay jitter, security.
+ */
+
+#ifndef HOST_BLUEFRUIT_H
+#define HOST_BLUEFRUIT_H
+
+#include "Arduino.h"
+#include <deque>
+#include <vector>
+
+#define BLE_CONN_HANDLE_INVALID 0xFFFF
+
+#define BLE_GAP_PHY_AUTO 0x00
+#define BLE_GAP_PHY_1MBPS 0x01
+#define BLE_GAP_PHY_2MBPS 0x02
+#define BLE_GAP_PHY_CODED 0x04
+
+#define BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE 0x06
+#define BLE_HCI_CONNECTION_TIMEOUT 0x08
+#define BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION 0x13
+#define BLE_GATTS_EVT_HVN_TX_COMPLETE 0x57
+
+#define CHR_PROPS_READ 0x02
+#define CHR_PROPS_WRITE_WO_RESP 0x04
+#define CHR_PROPS_WRITE 0x08
+#define CHR_PROPS_NOTIFY 0x10
+
+enum SecureMode_t { SECMODE_NO_ACCESS = 0x00, SECMODE_OPEN = 0x11 };
+enum { BANDWIDTH_AUTO, BANDWIDTH_LOW, BANDWIDTH_NORMAL, BANDWIDTH_HIGH, BANDWIDTH_MAX };
+
+#define HOST_BLE_ATT_MTU_MIN 23
+#define HOST_BLE_VALUE_MAX 512
+#define HOST_BLE_MAX_CHARACTERISTICS 16
+
+// SoftDevice event (only the TX-complete event is generated)
+struct ble_evt_t {
+    struct {
+        uint16_t evt_id;
+        uint16_t evt_len;
+    } header;
+    struct {
+        struct {
+            uint16_t conn_handle;
+            union {
+                struct {
+                    uint8_t count;
+                } hvn_tx_complete;
+            } params;
+        } gatts_evt;
+    } evt;
+};
+
+// How the simulated central behaves
+struct HostCentral {
+    uint16_t minInterval;       // 1.25 ms units
+    uint16_t maxInterval;
+    uint16_t intervalStep;      // Granted interval is rounded up to a multiple (1 = exact)
+    uint16_t maxLatency;
+    bool acceptsParameters;     // false: parameter requests are ignored
+    bool supports2M;
+    unsigned long delayMs;      // Time until a request takes effect
+
+    // Initial parameters on connect
+    uint16_t interval;
+    uint16_t latency;
+    uint16_t timeout;
+
+    uint16_t mtu;               // Largest ATT MTU the central accepts (23 = no exchange)
+    uint8_t packetsPerEvent;    // Notifications received per connection event
+};
+
+class BLECharacteristic;
+class BLEService;
+
+typedef void (*write_cb_t)(uint16_t conn_hdl, BLECharacteristic* chr, uint8_t* data, uint16_t len);
+
+class BLEConnection {
+public:
+    BLEConnection();
+
+    // Bluefruit API
+    bool requestConnectionParameter(uint16_t interval, uint16_t latency, uint16_t timeout);
+    bool requestPHY(uint8_t phy);
+    bool requestDataLengthUpdate() { return true; }
+    bool requestMtuExchange(uint16_t mtu);
+    uint16_t getConnectionInterval();
+    uint16_t getSlaveLatency();
+    uint16_t getSupervisionTimeout();
+    uint8_t getPHY();
+    uint16_t getMtu() const { return mtu; }
+
+    // Simulation control: connect to a central with this behaviour
+    void hostConnect(const HostCentral& central);
+
+    uint32_t parameterRequests;
+    uint32_t phyRequests;
+
+private:
+    friend class HostBluefruit;
+
+    HostCentral central;
+    uint16_t interval, latency, timeout;
+    uint8_t phy;
+    uint16_t mtu;
+
+    bool parameterPending;
+    uint16_t pendingInterval, pendingLatency, pendingTimeout;
+    unsigned long parameterTime;
+    bool phyPending;
+    uint8_t pendingPhy;
+    unsigned long phyTime;
+
+    // Apply requests whose delay has passed
+    void process();
+};
+
+class BLEService {
+public:
+    BLEService() { uuid[0] = 0; }
+    BLEService(const char* uuid);
+    void begin() {}
+
+    char uuid[37];
+};
+
+class BLECharacteristic {
+public:
+    BLECharacteristic();
+    BLECharacteristic(const char* uuid);
+
+    void setProperties(uint8_t properties) { this->properties = properties; }
+    void setPermission(SecureMode_t read, SecureMode_t write) {}
+    void setFixedLen(uint16_t length) { maxLength = length; }
+    void setMaxLen(uint16_t length) { maxLength = length; }
+    void setWriteCallback(write_cb_t callback) { writeCallback = callback; }
+    void begin();
+
+    // Set the value the central reads
+    uint16_t write(const void* data, uint16_t length);
+
+    // Send to the subscribed central (split into MTU-sized notifications)
+    // Returns: false if not subscribed or no notification buffer is free
+    bool notify(const void* data, uint16_t length);
+    bool notifyEnabled() const { return subscribed; }
+
+    // Simulation
+    const char* hostUuid() const { return uuid; }
+    uint16_t hostValue(uint8_t* data, uint16_t size) const;
+
+private:
+    friend class HostBluefruit;
+
+    char uuid[37];
+    uint8_t properties;
+    uint16_t maxLength;
+    write_cb_t writeCallback;
+    bool subscribed;
+    uint8_t value[HOST_BLE_VALUE_MAX];
+    uint16_t valueLength;
+};
+
+class HostAdvertising {
+public:
+    // Bluefruit defaults: 20 ms for 30 s, then 152.5 ms
+    HostAdvertising()
+        : running(false), restart(false), fastInterval(32), slowInterval(244), fastTimeout(30),
+          startUs(0), nextEventUs(0) {}
+
+    void addFlags(uint8_t flags) {}
+    void addTxPower() {}
+    void addService(BLEService& service) {}
+    void addName() {}
+    void restartOnDisconnect(bool enable) { restart = enable; }
+    // 0.625 ms units
+    void setInterval(uint16_t fast, uint16_t slow) { fastInterval = fast; slowInterval = slow; }
+    void setFastTimeout(uint16_t seconds) { fastTimeout = seconds; }
+    bool start(uint16_t timeout = 0);
+    bool stop() { running = false; return true; }
+    bool isRunning() const { return running; }
+
+private:
+    friend class HostBluefruit;
+    bool running;
+    bool restart;
+    uint16_t fastInterval, slowInterval, fastTimeout;
+    unsigned long long startUs;
+    unsigned long long nextEventUs;
+};
+
+class HostPeriph {
+public:
+    HostPeriph() : connectCallback(NULL), disconnectCallback(NULL) {}
+
+    void setConnectCallback(void (*callback)(uint16_t conn_hdl)) { connectCallback = callback; }
+    void setDisconnectCallback(void (*callback)(uint16_t conn_hdl, uint8_t reason)) {
+        disconnectCallback = callback;
+    }
+
+private:
+    friend class HostBluefruit;
+    void (*connectCallback)(uint16_t);
+    void (*disconnectCallback)(uint16_t, uint8_t);
+};
+
+// Radio activity since hostConnect() (advertising: since the last connect)
+struct HostRadioStats {
+    uint32_t events;            // Connection events the peripheral attended
+    uint32_t eventsWithData;    // ... that sent notifications
+    uint32_t notifications;     // Notifications delivered to the central
+    uint32_t bytes;             // Notification payload bytes delivered
+    uint32_t notifyFailures;    // notify() calls refused (no buffer)
+    uint32_t advertisingEvents;
+};
+
+class HostBluefruit {
+public:
+    HostBluefruit();
+
+    // Bluefruit API
+    void configPrphBandwidth(uint8_t bandwidth);
+    bool begin(uint8_t prphCount = 1, uint8_t centralCount = 0) { return true; }
+    void setTxPower(int8_t power) {}
+    void setName(const char* name) {}
+    void setEventCallback(void (*callback)(ble_evt_t* event)) { eventCallback = callback; }
+    bool connected() const { return isConnected; }
+
+    // Connection for a handle (handle 0 while connected), NULL otherwise
+    BLEConnection* Connection(uint16_t connHandle) {
+        return isConnected && connHandle == 0 ? &connection : NULL;
+    }
+
+    HostPeriph Periph;
+    HostAdvertising Advertising;
+
+    // Simulation: central actions
+    // Returns: false if not advertising (or already connected)
+    bool hostConnect(const HostCentral& central);
+    void hostDisconnect(uint8_t reason = BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+    // Returns: false if no characteristic has this UUID
+    bool hostWrite(const char* uuid, const uint8_t* data, uint16_t length);
+    BLECharacteristic* hostFind(const char* uuid);
+
+    // Run connection and advertising events up to the current time
+    void hostProcess();
+
+    // Back to power-on state: no connection, characteristics or callbacks
+    void hostReset();
+
+    // Notifications as the central receives them
+    void (*onNotify)(const BLECharacteristic& chr, const uint8_t* data, uint16_t length, void* context);
+    void* onNotifyContext;
+
+    // Radio model (see RADIO); restored by configPrphBandwidth()
+    uint8_t txBuffers;
+    uint16_t maxMtu;
+
+    HostRadioStats radio;
+    BLEConnection connection;
+
+private:
+    friend class BLECharacteristic;
+
+    struct Notification {
+        const BLECharacteristic* characteristic;
+        std::vector<uint8_t> data;
+    };
+
+    bool isConnected;
+    void (*eventCallback)(ble_evt_t* event);
+    BLECharacteristic* characteristics[HOST_BLE_MAX_CHARACTERISTICS];
+    int characteristicCount;
+    std::deque<Notification> txQueue;
+    unsigned long long nextEventUs;
+    uint32_t eventCounter;
+
+    void add(BLECharacteristic* characteristic);
+    bool queueNotification(const BLECharacteristic* characteristic, const uint8_t* data, uint16_t length);
+};
+
+extern HostBluefruit Bluefruit;
+
+#endif
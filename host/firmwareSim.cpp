@@ -0,0 +1,735 @@
+/*
+ * firmwareSim.cpp
+ *
+ * Discrete-event simulation of the whole firmware: setup() and loop() from
+ * wellby_firmware.ino, unchanged, on the simulated board (hostBoard.h) and
+ * the virtual clock (Arduino.h).
+ *
+ * OVERVIEW:
+ * A script of user and app actions drives the device: button patterns on
+ * D7, a central connecting and disconnecting, recording control writes.
+ * Between actions the simulator runs loop() passes and charges each pass
+ * to the device state it started in:
+ * - CPU busy: a pass that returns without blocking means loop() spins, so
+ *   the CPU is busy for the whole SIM_SPIN_US the pass stands for. Time in
+ *   delay() and the scheduler's wait (ulTaskNotifyTake(), until an event
+ *   or the next timer) blocks the loop task and counts as sleep; such
+ *   passes cost CPU_LOOP_PASS_US plus their I2C transfers.
+ * - Radio: on-air time of the connection events, notifications and
+ *   advertising events the radio model ran (bluefruit.h), using the
+ *   figures in powerModel.h
+ * sleepMode() ends in SYSTEMOFF: the simulator powers the radio down and
+ * jumps to the next action; a button press matching the GPIO sense
+ * configuration wakes the device through a reset (globals constructed
+ * again, setup() runs), as on the nRF52. Hours of SYSTEMOFF therefore cost
+ * nothing, and an hour of spinning loop() takes about a second.
+ *
+ * Each action is also timed until the device responds: button patterns
+ * until the system state changes, "start" until the first raw PPG
+ * notification reaches the app, "stop" until the recording ends, "wear"
+ * and "remove" until PPGManager reports the new wear state.
+ *
+ * The sensor is accounted separately, for the whole run: time sampling,
+ * in proximity mode (wear detection) and shut down, and the LED drive
+ * (max30105Sim.h), turned into an average current with powerModel.h.
+ *
+ * CHECKS:
+ * Outside BLE mode nothing records, so the sensor must not sample there
+ * for longer than SIM_IDLE_SAMPLING_MS at a time (e.g. a recording left
+ * running when a double press returns to IDLE); the simulator then exits
+ * with status 1.
+ *
+ * SCRIPT (one action per line, '#' starts a comment):
+ *   <seconds> double | long | press     Button pattern starting at that time
+ *   <seconds> connect [fast | slow]     Central connects (if advertising)
+ *   <seconds> start | stop              App writes 0x01 / 0x00 to recording control
+ *   <seconds> disconnect
+ *   <seconds> battery <volts>
+ *   <seconds> wear | remove             Device put on / taken off (worn at the start)
+ *   <seconds> end                       End of the simulation (default: last action + 60 s)
+ *
+ * USAGE:
+ *   ./firmwareSim [--script FILE] [--csv FILE] [--seed N] [--verbose]
+ *   --csv plays one raw sample per line (25 Hz) on the sensor instead of a
+ *   synthetic 10 minute recording; --verbose keeps the firmware's Serial
+ *   output (stderr)
+ * Exits with status 1 if a check fails.
+ *
+ */
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "bluefruit.h"
+#include "hostBoard.h"
+#include "powerModel.h"
+#include "syntheticPpg.h"
+#include "ppgPacket.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <vector>
+
+// The Arduino IDE generates prototypes for the sketch's functions
+void setup();
+void loop();
+void sleepMode();
+
+#include "wellby_firmware.ino"
+
+#define SIM_FS 25                   // Sensor playback rate (EFFECTIVE_SAMPLING_RATE)
+#define SIM_SPIN_US 1000            // Device time one non-blocking loop() pass stands for
+#define SIM_CLICK_MS 100            // Button held per short press
+#define SIM_CLICK_GAP_MS 150        // Released between the presses of a double press
+#define SIM_LONG_PRESS_MS 1200      // Button held for a long press (> 800 ms)
+#define SIM_TAIL_S 60               // Simulated after the last action when the script has no "end"
+#define SIM_IDLE_SAMPLING_MS 100    // Longest sensor sampling outside BLE mode
+
+#define SIM_RAW_PPG_UUID "4aa76196-2777-4205-8260-8e3274beb327"     // BluetoothManager.cpp
+#define SIM_REC_CONTROL_UUID "684c8f42-a60c-431c-b8ed-251e966d6a9a"
+
+static const char* const defaultScript[] = {
+    "# Two app sessions, then a night in SYSTEMOFF",
+    "10 double          # BLE mode",
+    "40 connect fast",
+    "45 start           # runs for COLLECTION_TIME, then stops itself",
+    "150 start",
+    "180 stop",
+    "200 disconnect",
+    "205 connect slow",
+    "210 start",
+    "240 disconnect     # during the recording",
+    "260 double         # back to IDLE",
+    "320 remove         # off the wrist",
+    "600 wear",
+    "620 double",
+    "630 connect fast",
+    "635 start",
+    "650 double         # back to IDLE during the recording",
+    "700 double",
+    "710 start",
+    "725 long           # SYSTEMOFF during the recording",
+    "900 press          # wake-up",
+    "1200 long          # SYSTEMOFF",
+    "8100 press         # wake-up",
+    "8400 end",
+};
+
+// ============================================================================
+// STATES AND ACCOUNTING
+// ============================================================================
+
+enum SimState {
+    SIM_BOOT,
+    SIM_IDLE,
+    SIM_ADVERTISING,
+    SIM_CONNECTED,
+    SIM_RECORDING,
+    SIM_SYSTEMOFF,
+    SIM_STATE_COUNT
+};
+
+static const char* const stateNames[SIM_STATE_COUNT] = {
+    "boot (setup())", "IDLE", "BLE, no central", "BLE, connected", "BLE, recording", "SYSTEMOFF",
+};
+
+struct StateStats {
+    double timeUs;
+    double busyUs;
+    double radioUs;
+    uint32_t passes;
+};
+
+static StateStats stats[SIM_STATE_COUNT];
+static HostBoard board;
+static std::vector<long> samples;
+static bool systemOff = false;
+static bool buttonDown = false;
+static uint32_t notifications = 0;
+static uint32_t samplesDelivered = 0;
+static unsigned long long firstNotifyUs = 0;    // First raw PPG notification since the last "start"
+static unsigned long long idleSamplingUs = 0;   // Sensor sampling outside BLE mode since (0: not)
+static uint32_t idleSamplingErrors = 0;         // ...for longer than SIM_IDLE_SAMPLING_MS
+
+// Sensor time (ms) and LED drive of the boards before the last reset
+static double sensorSamplingMs = 0, sensorProximityMs = 0, sensorShutdownMs = 0, sensorLedStepMs = 0;
+
+static SimState deviceState() {
+    if (systemOff) {
+        return SIM_SYSTEMOFF;
+    }
+    if (currentSystemState != BLE) {
+        return SIM_IDLE;
+    }
+    if (ppgManager.isRecording()) {
+        return SIM_RECORDING;
+    }
+    return bluetoothManager.isConnected() ? SIM_CONNECTED : SIM_ADVERTISING;
+}
+
+static uint32_t counted(uint32_t after, uint32_t before) {
+    return after >= before ? after - before : after;  // Stats restart at each connection
+}
+
+// On-air time of the radio activity between two snapshots
+static double radioTime(const HostRadioStats& before, const HostRadioStats& after) {
+    double byteUs = Bluefruit.connected() && Bluefruit.connection.getPHY() == BLE_GAP_PHY_2MBPS
+                        ? RADIO_BYTE_US_2M : RADIO_BYTE_US_1M;
+    uint32_t notified = counted(after.notifications, before.notifications);
+    return counted(after.events, before.events) * RADIO_EVENT_US +
+           notified * (RADIO_NOTIFY_US + RADIO_NOTIFY_HEADER_BYTES * byteUs) +
+           counted(after.bytes, before.bytes) * byteUs +
+           counted(after.advertisingEvents, before.advertisingEvents) * RADIO_ADV_EVENT_US;
+}
+
+// Run one pass of body() and charge it to the state the device was in
+static void runPass(void (*body)(), SimState state) {
+    unsigned long long start = micros();
+    unsigned long long blockedBefore = hostBlockedMicros();
+    uint32_t i2cBefore = Wire.bytesTransferred();
+    HostRadioStats radioBefore = Bluefruit.radio;
+
+    body();
+
+    unsigned long long blocked = hostBlockedMicros() - blockedBefore;
+    if (blocked == 0) {
+        hostAdvanceClock(SIM_SPIN_US);
+    }
+    double elapsed = (double)(micros() - start);
+    double busy = elapsed;
+    if (blocked > 0) {
+        busy = std::min(elapsed, (elapsed - blocked) + CPU_LOOP_PASS_US +
+                                     (Wire.bytesTransferred() - i2cBefore) * CPU_I2C_BYTE_US);
+    }
+    StateStats& s = stats[state];
+    s.timeUs += elapsed;
+    s.busyUs += busy;
+    s.radioUs += radioTime(radioBefore, Bluefruit.radio);
+    s.passes++;
+}
+
+// ============================================================================
+// DEVICE
+// ============================================================================
+
+static void onNotify(const BLECharacteristic& chr, const uint8_t* data, uint16_t length, void* context) {
+    if (strcmp(chr.hostUuid(), SIM_RAW_PPG_UUID) != 0) {
+        return;
+    }
+    PPGPacketHeader header;
+    uint32_t values[PPG_PACKET_MAX_VALUES];
+    int count = decodePPGPacket(data, length, &header, values, PPG_PACKET_MAX_VALUES);
+    notifications++;
+    samplesDelivered += count > 0 ? count : 0;
+    if (firstNotifyUs == 0) {
+        firstNotifyUs = micros();
+    }
+}
+
+// Power-on or wake-up reset: RAM is lost, so the sketch's globals start
+// over and setup() runs on a freshly reset board
+static void collectSensorTime() {
+    sensorSamplingMs += board.sensor.samplingMs();
+    sensorProximityMs += board.sensor.proximityMs();
+    sensorShutdownMs += board.sensor.shutdownMs();
+    sensorLedStepMs += board.sensor.ledStepMs();
+}
+
+static void powerOn() {
+    // The sensor model starts over with the board
+    collectSensorTime();
+    bool worn = board.sensor.hasContact();
+    board.begin(samples.data(), samples.size(), SIM_FS);
+    board.setWorn(worn);
+    board.setButton(buttonDown);
+
+    powerManager.~PowerManager();
+    new (&powerManager) PowerManager();
+    buttonManager.~ButtonManager();
+    new (&buttonManager) ButtonManager(BUTTON_PIN);
+    ppgManager.~PPGManager();
+    bluetoothManager.~BluetoothManager();
+    new (&bluetoothManager) BluetoothManager();
+    new (&ppgManager) PPGManager(bluetoothManager);
+    scheduler.~EventScheduler();
+    new (&scheduler) EventScheduler();
+    currentSystemState = IDLE;
+
+    Bluefruit.onNotify = onNotify;
+    systemOff = false;
+    runPass(setup, SIM_BOOT);
+}
+
+// After sleepMode(): the radio is off and the central's link times out
+static void enterSystemOff() {
+    if (Bluefruit.connected()) {
+        Bluefruit.hostDisconnect(BLE_HCI_CONNECTION_TIMEOUT);
+    }
+    Bluefruit.hostReset();
+    systemOff = true;
+}
+
+// A pin configured to sense its current level wakes the device
+static bool senseWake() {
+    for (uint32_t pin = 0; pin < 32; pin++) {
+        uint32_t sense = (NRF_GPIO->PIN_CNF[pin] & GPIO_PIN_CNF_SENSE_Msk) >> GPIO_PIN_CNF_SENSE_Pos;
+        if ((sense == GPIO_PIN_CNF_SENSE_High && digitalRead(pin) == HIGH) ||
+            (sense == GPIO_PIN_CNF_SENSE_Low && digitalRead(pin) == LOW)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// ============================================================================
+// SCRIPT
+// ============================================================================
+
+enum SimActionType {
+    ACT_BUTTON_DOWN,
+    ACT_BUTTON_UP,
+    ACT_CONNECT,
+    ACT_START,
+    ACT_STOP,
+    ACT_DISCONNECT,
+    ACT_BATTERY,
+    ACT_WEAR,
+    ACT_REMOVE,
+    ACT_END,
+};
+
+// One script line, with how long the device took to respond
+struct ScriptEntry {
+    double seconds;
+    char text[40];
+    bool timed;                 // Has a response to wait for
+    int mode;                   // Device mode when it started (button patterns)...
+    int newMode;                // ...and after the response
+    unsigned long long startUs;
+    double responseMs;          // < 0: no response (yet)
+    const char* result;         // Set when the action could not be performed
+};
+
+struct SimAction {
+    unsigned long long timeUs;
+    SimActionType type;
+    int entry;                  // ScriptEntry index
+    int central;
+    float volts;
+};
+
+// minInterval, maxInterval, step, maxLatency, accepts, 2M, delay; initial interval, latency,
+// timeout; MTU, packets per event (as in the bench)
+static const HostCentral centrals[] = {
+    {6, 3200, 1, 499, true, true, 100, 24, 0, 500, 247, 6},     // fast: current phone
+    {40, 3200, 1, 499, true, true, 100, 40, 0, 400, 23, 1},     // slow: 50 ms minimum, no MTU exchange
+};
+
+static std::vector<ScriptEntry> entries;
+static std::vector<SimAction> actions;
+
+static void addAction(double seconds, SimActionType type, int entry, int central = 0, float volts = 0) {
+    SimAction action;
+    action.timeUs = (unsigned long long)(seconds * 1e6);
+    action.type = type;
+    action.entry = entry;
+    action.central = central;
+    action.volts = volts;
+    actions.push_back(action);
+}
+
+// Returns: false (after a message) if the line is not a valid action
+static bool parseLine(const char* text, int lineNumber) {
+    char line[128];
+    strncpy(line, text, sizeof(line) - 1);
+    line[sizeof(line) - 1] = 0;
+    char* comment = strchr(line, '#');
+    if (comment != NULL) {
+        *comment = 0;
+    }
+    double seconds;
+    char name[32], argument[32] = "";
+    int fields = sscanf(line, "%lf %31s %31s", &seconds, name, argument);
+    if (fields <= 0) {
+        return true;  // Blank or comment
+    }
+    if (fields < 2 || seconds < 0) {
+        fprintf(stderr, "Script line %d: expected <seconds> <action>\n", lineNumber);
+        return false;
+    }
+
+    ScriptEntry entry;
+    entry.seconds = seconds;
+    snprintf(entry.text, sizeof(entry.text), "%s %s", name, argument);
+    entry.timed = false;
+    entry.mode = 0;
+    entry.newMode = 0;
+    entry.startUs = 0;
+    entry.responseMs = -1;
+    entry.result = NULL;
+    int index = (int)entries.size();
+
+    const double click = SIM_CLICK_MS / 1000.0;
+    if (strcmp(name, "press") == 0 || strcmp(name, "double") == 0) {
+        entry.timed = true;
+        addAction(seconds, ACT_BUTTON_DOWN, index);
+        addAction(seconds + click, ACT_BUTTON_UP, index);
+        if (name[0] == 'd') {
+            double second = seconds + click + SIM_CLICK_GAP_MS / 1000.0;
+            addAction(second, ACT_BUTTON_DOWN, index);
+            addAction(second + click, ACT_BUTTON_UP, index);
+        }
+    } else if (strcmp(name, "long") == 0) {
+        entry.timed = true;
+        addAction(seconds, ACT_BUTTON_DOWN, index);
+        addAction(seconds + SIM_LONG_PRESS_MS / 1000.0, ACT_BUTTON_UP, index);
+    } else if (strcmp(name, "connect") == 0) {
+        int central = strcmp(argument, "slow") == 0 ? 1 : 0;
+        if (argument[0] != 0 && central == 0 && strcmp(argument, "fast") != 0) {
+            fprintf(stderr, "Script line %d: unknown central '%s'\n", lineNumber, argument);
+            return false;
+        }
+        addAction(seconds, ACT_CONNECT, index, central);
+    } else if (strcmp(name, "start") == 0 || strcmp(name, "stop") == 0) {
+        entry.timed = true;
+        addAction(seconds, strcmp(name, "start") == 0 ? ACT_START : ACT_STOP, index);
+    } else if (strcmp(name, "disconnect") == 0) {
+        addAction(seconds, ACT_DISCONNECT, index);
+    } else if (strcmp(name, "battery") == 0 && fields == 3) {
+        addAction(seconds, ACT_BATTERY, index, 0, (float)atof(argument));
+    } else if (strcmp(name, "wear") == 0 || strcmp(name, "remove") == 0) {
+        entry.timed = true;
+        addAction(seconds, name[0] == 'w' ? ACT_WEAR : ACT_REMOVE, index);
+    } else if (strcmp(name, "end") == 0) {
+        addAction(seconds, ACT_END, index);
+    } else {
+        fprintf(stderr, "Script line %d: unknown action '%s'\n", lineNumber, name);
+        return false;
+    }
+    entries.push_back(entry);
+    return true;
+}
+
+static bool loadScript(const char* path) {
+    int lineNumber = 0;
+    if (path == NULL) {
+        for (size_t i = 0; i < sizeof(defaultScript) / sizeof(defaultScript[0]); i++) {
+            if (!parseLine(defaultScript[i], ++lineNumber)) {
+                return false;
+            }
+        }
+    } else {
+        FILE* file = fopen(path, "r");
+        if (file == NULL) {
+            fprintf(stderr, "Cannot open %s\n", path);
+            return false;
+        }
+        char line[128];
+        bool ok = true;
+        while (ok && fgets(line, sizeof(line), file) != NULL) {
+            ok = parseLine(line, ++lineNumber);
+        }
+        fclose(file);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    // Actions in time order (stable, so a pattern's steps keep their order)
+    std::stable_sort(actions.begin(), actions.end(),
+                     [](const SimAction& a, const SimAction& b) { return a.timeUs < b.timeUs; });
+    if (actions.empty() || actions.back().type != ACT_END) {
+        double last = actions.empty() ? 0 : actions.back().timeUs / 1e6;
+        parseLine("0 end", 0);
+        actions.back().timeUs = (unsigned long long)((last + SIM_TAIL_S) * 1e6);
+        entries.back().seconds = last + SIM_TAIL_S;
+    }
+    return true;
+}
+
+// What button patterns change: the system state, or being off
+static int deviceMode() {
+    return systemOff ? -1 : (int)currentSystemState;
+}
+
+// Returns: false at the end of the script
+static bool applyAction(const SimAction& action) {
+    ScriptEntry& entry = entries[action.entry];
+    if (entry.startUs == 0) {
+        entry.startUs = micros();
+        entry.mode = deviceMode();
+    }
+    switch (action.type) {
+        case ACT_BUTTON_DOWN:
+        case ACT_BUTTON_UP:
+            buttonDown = action.type == ACT_BUTTON_DOWN;
+            board.setButton(buttonDown);
+            break;
+        case ACT_CONNECT:
+            if (systemOff || !Bluefruit.hostConnect(centrals[action.central])) {
+                entry.result = "not advertising";
+            }
+            break;
+        case ACT_START:
+        case ACT_STOP: {
+            uint8_t value = action.type == ACT_START ? 0x01 : 0x00;
+            if (action.type == ACT_START) {
+                firstNotifyUs = 0;
+            }
+            if (systemOff || !Bluefruit.hostWrite(SIM_REC_CONTROL_UUID, &value, 1)) {
+                entry.result = "not connected";
+                entry.timed = false;
+            }
+            break;
+        }
+        case ACT_DISCONNECT:
+            if (!Bluefruit.connected()) {
+                entry.result = "not connected";
+            }
+            Bluefruit.hostDisconnect();
+            break;
+        case ACT_BATTERY:
+            board.setBatteryVoltage(action.volts);
+            break;
+        case ACT_WEAR:
+        case ACT_REMOVE:
+            board.setWorn(action.type == ACT_WEAR);
+            break;
+        case ACT_END:
+            return false;
+    }
+    return true;
+}
+
+// Record the response time of actions still waiting for one
+static void checkResponses() {
+    for (size_t i = 0; i < entries.size(); i++) {
+        ScriptEntry& entry = entries[i];
+        if (!entry.timed || entry.startUs == 0 || entry.responseMs >= 0) {
+            continue;
+        }
+        bool responded;
+        if (strncmp(entry.text, "start", 5) == 0) {
+            responded = firstNotifyUs != 0;
+        } else if (strncmp(entry.text, "stop", 4) == 0) {
+            responded = !systemOff && !ppgManager.isRecording();
+        } else if (strncmp(entry.text, "wear", 4) == 0 || strncmp(entry.text, "remove", 6) == 0) {
+            responded = !systemOff && ppgManager.isWorn() == (entry.text[0] == 'w');
+        } else {
+            responded = deviceMode() != entry.mode;
+        }
+        if (responded) {
+            entry.responseMs = (micros() - entry.startUs) / 1000.0;
+            entry.newMode = deviceMode();
+        }
+    }
+}
+
+// Outside BLE mode (and before SYSTEMOFF) the sensor only probes for skin
+// contact; count each time it samples for longer
+static void checkSensor() {
+    bool idle = !systemOff && currentSystemState != BLE;
+    if (!idle || !board.sensor.isSampling()) {
+        idleSamplingUs = 0;
+        return;
+    }
+    if (idleSamplingUs == 0) {
+        idleSamplingUs = micros();
+    } else if (idleSamplingUs != 1 && micros() - idleSamplingUs > SIM_IDLE_SAMPLING_MS * 1000ULL) {
+        idleSamplingErrors++;
+        idleSamplingUs = 1;  // Counted until it stops
+    }
+}
+
+// ============================================================================
+// REPORT
+// ============================================================================
+
+static const char* modeName(int mode) {
+    switch (mode) {
+        case -1: return "SYSTEMOFF";
+        case IDLE: return "IDLE";
+        case SLEEP: return "SLEEP";
+        case BLE: return "BLE";
+        default: return "?";
+    }
+}
+
+static void printReport(const char* scriptName, double wallSeconds) {
+    double totalUs = 0;
+    for (int s = 0; s < SIM_STATE_COUNT; s++) {
+        totalUs += stats[s].timeUs;
+    }
+    printf("Firmware simulation (%s): %.0f s of device time in %.2f s\n", scriptName, totalUs / 1e6,
+           wallSeconds);
+
+    printf("\nScript\n");
+    printf("  %9s  %-18s %s\n", "time (s)", "action", "response");
+    for (size_t i = 0; i < entries.size(); i++) {
+        const ScriptEntry& entry = entries[i];
+        printf("  %9.3f  %-18s ", entry.seconds, entry.text);
+        if (entry.result != NULL) {
+            printf("ignored: %s\n", entry.result);
+        } else if (!entry.timed) {
+            printf("-\n");
+        } else if (entry.responseMs < 0) {
+            printf("NONE\n");
+        } else if (strncmp(entry.text, "start", 5) == 0) {
+            printf("first notification after %.0f ms\n", entry.responseMs);
+        } else if (strncmp(entry.text, "stop", 4) == 0) {
+            printf("recording stopped after %.0f ms\n", entry.responseMs);
+        } else if (strncmp(entry.text, "wear", 4) == 0 || strncmp(entry.text, "remove", 6) == 0) {
+            printf("%s after %.0f ms\n", entry.text[0] == 'w' ? "worn" : "removed", entry.responseMs);
+        } else {
+            printf("%s -> %s after %.0f ms\n", modeName(entry.mode), modeName(entry.newMode),
+                   entry.responseMs);
+        }
+    }
+
+    printf("\nPer state (CPU and radio models in powerModel.h)\n");
+    printf("  %-16s %10s %6s %11s %8s %8s %9s\n", "state", "time (s)", "share", "loop passes",
+           "CPU %", "radio %", "est. mA");
+    double totalBusy = 0, totalRadio = 0, totalCharge = 0;
+    for (int s = 0; s < SIM_STATE_COUNT; s++) {
+        const StateStats& st = stats[s];
+        if (st.timeUs <= 0) {
+            continue;
+        }
+        double cpu = st.busyUs / st.timeUs;
+        double radio = st.radioUs / st.timeUs;
+        double sleepMa = s == SIM_SYSTEMOFF ? CPU_SYSTEMOFF_MA : CPU_SLEEP_MA;
+        double current = cpu * CPU_ACTIVE_MA + (1 - cpu) * sleepMa + radio * RADIO_MA;
+        printf("  %-16s %10.1f %5.1f%% %11u %8.2f %8.3f %9.4f\n", stateNames[s], st.timeUs / 1e6,
+               100 * st.timeUs / totalUs, st.passes, 100 * cpu, 100 * radio, current);
+        totalBusy += st.busyUs;
+        totalRadio += st.radioUs;
+        totalCharge += current * st.timeUs;
+    }
+    printf("  %-16s %10.1f %5.1f%% %11s %8.2f %8.3f %9.4f\n", "total", totalUs / 1e6, 100.0, "",
+           100 * totalBusy / totalUs, 100 * totalRadio / totalUs, totalCharge / totalUs);
+    printf("  (LEDs and sensor excluded; loop passes that do not block spin for %d us each)\n",
+           SIM_SPIN_US);
+
+    // Sampling and proximity mode draw the supply current plus their LED pulses
+    double sensorMs = sensorSamplingMs + sensorProximityMs + sensorShutdownMs;
+    double ledMa = sensorLedStepMs * SENSOR_LED_MA_PER_STEP * SENSOR_LED_DUTY / sensorMs;
+    double sensorMa = ((sensorSamplingMs + sensorProximityMs) * SENSOR_ACTIVE_MA +
+                       sensorShutdownMs * SENSOR_SHUTDOWN_MA) / sensorMs + ledMa;
+    printf("\nSensor: %.1f s sampling, %.1f s proximity mode, %.1f s shut down\n",
+           sensorSamplingMs / 1000, sensorProximityMs / 1000, sensorShutdownMs / 1000);
+    printf("  est. %.4f mA average, of which LEDs %.4f mA\n", sensorMa, ledMa);
+
+    printf("\nRaw PPG delivered to the app: %u samples in %u notifications\n", samplesDelivered,
+           notifications);
+    printf("Sensor sampling outside BLE mode for over %d ms: %u times: %s\n", SIM_IDLE_SAMPLING_MS,
+           idleSamplingErrors, idleSamplingErrors == 0 ? "PASS" : "FAIL");
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+static void usage() {
+    printf("Usage: firmwareSim [--script FILE] [--csv FILE] [--seed N] [--verbose]\n");
+}
+
+// One raw sample per line; lines that do not start with a number are skipped
+static bool loadCsv(const char* path, std::vector<long>* values) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return false;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char* end;
+        long value = strtol(line, &end, 10);
+        if (end != line) {
+            values->push_back(value);
+        }
+    }
+    fclose(file);
+    return !values->empty();
+}
+
+int main(int argc, char** argv) {
+    const char* scriptPath = NULL;
+    const char* csvPath = NULL;
+    bool verbose = false;
+    SyntheticPpgConfig synth;
+    synth.fs = SIM_FS;
+    synth.seconds = 600;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--verbose") == 0) {
+            verbose = true;
+        } else if (strcmp(arg, "--script") == 0 && value != NULL) {
+            scriptPath = argv[++i];
+        } else if (strcmp(arg, "--csv") == 0 && value != NULL) {
+            csvPath = argv[++i];
+        } else if (strcmp(arg, "--seed") == 0 && value != NULL) {
+            synth.seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (!loadScript(scriptPath)) {
+        return 1;
+    }
+    if (csvPath != NULL) {
+        if (!loadCsv(csvPath, &samples)) {
+            return 1;
+        }
+    } else {
+        samples = generateSyntheticPpg(synth).samples;
+    }
+    if (!verbose && freopen("/dev/null", "w", stderr) == NULL) {
+        return 1;
+    }
+
+    std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+    hostUseVirtualClock(true);
+    powerOn();
+
+    size_t next = 0;
+    bool running = true;
+    while (running) {
+        while (running && next < actions.size() && actions[next].timeUs <= micros()) {
+            running = applyAction(actions[next++]);
+        }
+        if (!running) {
+            break;
+        }
+
+        if (systemOff) {
+            if (senseWake()) {
+                powerOn();
+            } else {
+                // Nothing runs until the next action
+                unsigned long long now = micros();
+                stats[SIM_SYSTEMOFF].timeUs += actions[next].timeUs - now;
+                hostAdvanceClock(actions[next].timeUs - now);
+            }
+        } else {
+            // The loop task wakes for the next action, as it would for its interrupt
+            hostSetWaitLimit(actions[next].timeUs);
+            runPass(loop, deviceState());
+            if (NRF_POWER->SYSTEMOFF) {
+                enterSystemOff();
+            }
+        }
+        checkResponses();
+        checkSensor();
+    }
+    collectSensorTime();
+    board.end();
+    hostUseVirtualClock(false);
+
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    printReport(scriptPath != NULL ? scriptPath : "built-in script", wallSeconds);
+    return idleSamplingErrors == 0 ? 0 : 1;
+}
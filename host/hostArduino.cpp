@@ -0,0 +1,450 @@
+/*
+ * hostArduino.cpp
+ *
+ * Linux implementation of the Arduino stub (see Arduino.h in this folder).
+ */
+
+#include "Arduino.h"
+#include <stdio.h>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+HostSerial Serial;
+HostNrfGpio hostNrfGpio;
+HostNrfPower hostNrfPower;
+
+// ============================================================================
+// SERIAL
+// ============================================================================
+
+void HostSerial::print(const char* s) {
+    if (!quiet) {
+        fputs(s, stderr);
+    }
+}
+
+void HostSerial::print(char c) {
+    if (!quiet) {
+        fputc(c, stderr);
+    }
+}
+
+void HostSerial::println() { print('\n'); }
+
+void HostSerial::print(int value, int base) { print((long)value, base); }
+void HostSerial::print(unsigned int value, int base) { print((unsigned long)value, base); }
+
+void HostSerial::print(long value, int base) {
+    char text[24];
+    if (base == HEX) {
+        snprintf(text, sizeof(text), "%lX", (unsigned long)value);
+    } else {
+        snprintf(text, sizeof(text), "%ld", value);
+    }
+    print(text);
+}
+
+void HostSerial::print(unsigned long value, int base) {
+    char text[24];
+    snprintf(text, sizeof(text), base == HEX ? "%lX" : "%lu", value);
+    print(text);
+}
+
+void HostSerial::print(double value, int digits) {
+    char text[64];
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    print(text);
+}
+
+// ============================================================================
+// TIME
+// ============================================================================
+
+#define HOST_CLOCK_LISTENERS 4
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+static bool virtualClock = false;
+static unsigned long long virtualMicros = 0;
+static unsigned long long blockedMicros = 0;
+
+struct ClockListener {
+    HostClockListener listener;
+    void* context;
+};
+static ClockListener clockListeners[HOST_CLOCK_LISTENERS];
+
+static void notifyClockListeners() {
+    for (int i = 0; i < HOST_CLOCK_LISTENERS; i++) {
+        if (clockListeners[i].listener != NULL) {
+            clockListeners[i].listener(clockListeners[i].context);
+        }
+    }
+}
+
+unsigned long millis() {
+    if (virtualClock) {
+        return (unsigned long)(virtualMicros / 1000);
+    }
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long micros() {
+    if (virtualClock) {
+        return (unsigned long)virtualMicros;
+    }
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+}
+
+void delay(unsigned long ms) {
+    blockedMicros += (unsigned long long)ms * 1000;
+    if (virtualClock) {
+        virtualMicros += (unsigned long long)ms * 1000;
+        notifyClockListeners();
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// Blocked until the first tick boundary after now (ticks are 976.5625 us)
+static void sleepToNextTick() {
+    unsigned long long tick = virtualMicros * HOST_RTOS_TICK_HZ / 1000000 + 1;
+    unsigned long long wake = (tick * 1000000 + HOST_RTOS_TICK_HZ - 1) / HOST_RTOS_TICK_HZ;
+    blockedMicros += wake - virtualMicros;
+    virtualMicros = wake;
+    notifyClockListeners();
+}
+
+static unsigned long long waitLimit = ~0ULL;
+
+void hostUseVirtualClock(bool enable) {
+    virtualClock = enable;
+    virtualMicros = 0;
+    blockedMicros = 0;
+    waitLimit = ~0ULL;
+}
+
+bool hostClockIsVirtual() {
+    return virtualClock;
+}
+
+unsigned long long hostBlockedMicros() {
+    return blockedMicros;
+}
+
+void hostAdvanceClock(unsigned long us) {
+    virtualMicros += us;
+    notifyClockListeners();
+}
+
+void hostAddClockListener(HostClockListener listener, void* context) {
+    for (int i = 0; i < HOST_CLOCK_LISTENERS; i++) {
+        if (clockListeners[i].listener == NULL) {
+            clockListeners[i].listener = listener;
+            clockListeners[i].context = context;
+            return;
+        }
+    }
+    fprintf(stderr, "hostAddClockListener: more than %d listeners\n", HOST_CLOCK_LISTENERS);
+    abort();
+}
+
+void hostRemoveClockListener(HostClockListener listener, void* context) {
+    for (int i = 0; i < HOST_CLOCK_LISTENERS; i++) {
+        if (clockListeners[i].listener == listener && clockListeners[i].context == context) {
+            clockListeners[i].listener = NULL;
+        }
+    }
+}
+
+static std::recursive_mutex hardwareMutex;
+
+HostLock::HostLock() {
+    hardwareMutex.lock();
+}
+
+HostLock::~HostLock() {
+    hardwareMutex.unlock();
+}
+
+// ============================================================================
+// GPIO / ADC
+// ============================================================================
+
+struct HostPin {
+    uint32_t mode;
+    int output;                 // Level written by the firmware
+    bool driven;                // Driven from outside (hostSetPin())
+    int external;
+    uint32_t analog;
+    void (*handler)(void);
+    uint32_t interruptMode;
+};
+
+static HostPin pins[HOST_PIN_COUNT];
+static thread_local bool inInterrupt = false;
+
+static HostPin* findPin(uint32_t pin) {
+    return pin < HOST_PIN_COUNT ? &pins[pin] : NULL;
+}
+
+// Level the MCU sees on a pin
+static int pinLevel(const HostPin& p) {
+    if (p.driven) {
+        return p.external;
+    }
+    switch (p.mode) {
+        case OUTPUT: return p.output;
+        case INPUT_PULLUP:
+        case INPUT_PULLUP_SENSE: return HIGH;
+        default: return LOW;
+    }
+}
+
+// Run the pin's handler if going from 'before' to its level is a matching edge
+static void checkEdge(HostPin& p, int before) {
+    int after = pinLevel(p);
+    if (p.handler == NULL || before == after) {
+        return;
+    }
+    uint32_t mode = p.interruptMode & ~ISR_DEFERRED;
+    if (mode == CHANGE || (mode == FALLING && after == LOW) || (mode == RISING && after == HIGH)) {
+        bool deferred = (p.interruptMode & ISR_DEFERRED) != 0;
+        inInterrupt = !deferred;
+        p.handler();
+        inInterrupt = false;
+    }
+}
+
+void pinMode(uint32_t pin, uint32_t mode) {
+    HostLock lock;
+    HostPin* p = findPin(pin);
+    if (p != NULL) {
+        int before = pinLevel(*p);
+        p->mode = mode;
+        if (mode == INPUT_PULLUP_SENSE && pin < 32) {
+            hostNrfGpio.PIN_CNF[pin] = (hostNrfGpio.PIN_CNF[pin] & ~GPIO_PIN_CNF_SENSE_Msk) |
+                                       (GPIO_PIN_CNF_SENSE_Low << GPIO_PIN_CNF_SENSE_Pos);
+        }
+        checkEdge(*p, before);
+    }
+}
+
+void digitalWrite(uint32_t pin, uint32_t value) {
+    HostLock lock;
+    HostPin* p = findPin(pin);
+    if (p != NULL) {
+        int before = pinLevel(*p);
+        p->output = value ? HIGH : LOW;
+        checkEdge(*p, before);
+    }
+}
+
+int digitalRead(uint32_t pin) {
+    HostLock lock;
+    HostPin* p = findPin(pin);
+    return p != NULL ? pinLevel(*p) : LOW;
+}
+
+uint32_t analogRead(uint32_t pin) {
+    HostLock lock;
+    HostPin* p = findPin(pin);
+    return p != NULL ? p->analog : 0;
+}
+
+int attachInterrupt(uint32_t pin, void (*handler)(void), uint32_t mode) {
+    HostLock lock;
+    HostPin* p = findPin(pin);
+    if (p == NULL) {
+        return 0;
+    }
+    p->handler = handler;
+    p->interruptMode = mode;
+    return 1;
+}
+
+void detachInterrupt(uint32_t pin) {
+    HostLock lock;
+    HostPin* p = findPin(pin);
+    if (p != NULL) {
+        p->handler = NULL;
+    }
+}
+
+bool isInISR() {
+    return inInterrupt;
+}
+
+void hostSetPin(uint32_t pin, int level) {
+    HostLock lock;
+    HostPin* p = findPin(pin);
+    if (p != NULL) {
+        int before = pinLevel(*p);
+        p->driven = true;
+        p->external = level ? HIGH : LOW;
+        checkEdge(*p, before);
+    }
+}
+
+void hostReleasePin(uint32_t pin) {
+    HostLock lock;
+    HostPin* p = findPin(pin);
+    if (p != NULL) {
+        int before = pinLevel(*p);
+        p->driven = false;
+        checkEdge(*p, before);
+    }
+}
+
+void hostSetAnalog(uint32_t pin, uint32_t value) {
+    HostLock lock;
+    HostPin* p = findPin(pin);
+    if (p != NULL) {
+        p->analog = value;
+    }
+}
+
+int hostPinOutput(uint32_t pin) {
+    HostLock lock;
+    HostPin* p = findPin(pin);
+    return p != NULL ? p->output : LOW;
+}
+
+void hostResetPins() {
+    HostLock lock;
+    memset(pins, 0, sizeof(pins));
+    for (int i = 0; i < 32; i++) {
+        hostNrfGpio.PIN_CNF[i] = 0;
+    }
+    hostNrfPower.SYSTEMOFF = 0;
+}
+
+// ============================================================================
+// FREERTOS
+// ============================================================================
+
+struct HostTask {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t notifications;
+    UBaseType_t priority;
+};
+
+static std::mutex taskListMutex;
+static std::vector<std::unique_ptr<HostTask>> tasks;
+static HostTask loopTask;
+static thread_local HostTask* currentTask = NULL;
+
+static std::chrono::microseconds tickDuration(TickType_t ticks) {
+    return std::chrono::microseconds((uint64_t)ticks * 1000000 / HOST_RTOS_TICK_HZ);
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackWords,
+                       void* parameter, UBaseType_t priority, TaskHandle_t* handle) {
+    if (virtualClock) {
+        return pdFAIL;
+    }
+    HostTask* task = new HostTask();
+    task->notifications = 0;
+    task->priority = priority;
+    // As on FreeRTOS, the handle is valid before the task first runs
+    if (handle != NULL) {
+        *handle = task;
+    }
+    std::lock_guard<std::mutex> lock(taskListMutex);
+    tasks.emplace_back(task);
+    task->thread = std::thread([task, function, parameter]() {
+        currentTask = task;
+        function(parameter);
+    });
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    // Only self-deletion is used: the task function returns right after
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return currentTask != NULL ? currentTask : &loopTask;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait) {
+    HostTask* task = xTaskGetCurrentTaskHandle();
+    if (virtualClock) {
+        // Only the loop task runs; whatever notifies it runs from the clock
+        // listeners, on this thread. SYSTEMOFF would not have returned.
+        for (TickType_t waited = 0; task->notifications == 0 && waited != ticksToWait &&
+                                    virtualMicros < waitLimit && !hostNrfPower.SYSTEMOFF; waited++) {
+            sleepToNextTick();
+        }
+    }
+    std::unique_lock<std::mutex> lock(task->mutex);
+    if (!virtualClock && ticksToWait == portMAX_DELAY) {
+        task->notified.wait(lock, [task]() { return task->notifications > 0; });
+    } else if (!virtualClock) {
+        task->notified.wait_for(lock, tickDuration(ticksToWait),
+                                [task]() { return task->notifications > 0; });
+    }
+    uint32_t count = task->notifications;
+    if (count > 0) {
+        task->notifications = clearOnExit ? 0 : count - 1;
+    }
+    return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        task->notifications++;
+    }
+    task->notified.notify_one();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken) {
+    xTaskNotifyGive(task);
+    if (higherPriorityTaskWoken != NULL) {
+        *higherPriorityTaskWoken = pdTRUE;
+    }
+}
+
+void hostSetWaitLimit(unsigned long long us) {
+    waitLimit = us;
+}
+
+struct HostMutex {
+    std::recursive_timed_mutex mutex;
+};
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    return new HostMutex();
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticksToWait) {
+    if (ticksToWait == portMAX_DELAY) {
+        mutex->mutex.lock();
+        return pdTRUE;
+    }
+    return mutex->mutex.try_lock_for(tickDuration(ticksToWait)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex) {
+    mutex->mutex.unlock();
+    return pdTRUE;
+}
+
+void hostJoinTasks() {
+    std::lock_guard<std::mutex> lock(taskListMutex);
+    for (size_t i = 0; i < tasks.size(); i++) {
+        if (tasks[i]->thread.joinable()) {
+            tasks[i]->thread.join();
+        }
+    }
+    tasks.clear();
+}
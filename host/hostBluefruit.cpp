@@ -0,0 +1,347 @@
+/*
+ * hostBluefruit.cpp
+ *
+ * Simulated BLE central and radio for the Bluefruit stand-in (see
+ * bluefruit.h in this folder).
+ */
+
+#include "bluefruit.h"
+
+HostBluefruit Bluefruit;
+
+// ============================================================================
+// CONNECTION
+// ============================================================================
+
+BLEConnection::BLEConnection()
+    : parameterRequests(0), phyRequests(0), interval(0), latency(0), timeout(0),
+      phy(BLE_GAP_PHY_1MBPS), mtu(HOST_BLE_ATT_MTU_MIN), parameterPending(false), pendingInterval(0),
+      pendingLatency(0), pendingTimeout(0), parameterTime(0), phyPending(false), pendingPhy(0),
+      phyTime(0) {
+    memset(&central, 0, sizeof(central));
+}
+
+void BLEConnection::hostConnect(const HostCentral& central) {
+    this->central = central;
+    interval = central.interval;
+    latency = central.latency;
+    timeout = central.timeout;
+    phy = BLE_GAP_PHY_1MBPS;
+    mtu = HOST_BLE_ATT_MTU_MIN;
+    parameterPending = false;
+    phyPending = false;
+    parameterRequests = 0;
+    phyRequests = 0;
+}
+
+bool BLEConnection::requestConnectionParameter(uint16_t interval, uint16_t latency, uint16_t timeout) {
+    HostLock lock;
+    parameterRequests++;
+    if (!central.acceptsParameters) {
+        return true;  // Sent, never answered
+    }
+    uint16_t step = central.intervalStep > 0 ? central.intervalStep : 1;
+    interval = (interval + step - 1) / step * step;
+    if (interval < central.minInterval) interval = central.minInterval;
+    if (interval > central.maxInterval) interval = central.maxInterval;
+    if (latency > central.maxLatency) latency = central.maxLatency;
+
+    parameterPending = true;
+    pendingInterval = interval;
+    pendingLatency = latency;
+    pendingTimeout = timeout;
+    parameterTime = millis();
+    return true;
+}
+
+bool BLEConnection::requestPHY(uint8_t phy) {
+    HostLock lock;
+    phyRequests++;
+    phyPending = true;
+    pendingPhy = (phy == BLE_GAP_PHY_2MBPS && !central.supports2M) ? BLE_GAP_PHY_1MBPS : phy;
+    phyTime = millis();
+    return true;
+}
+
+bool BLEConnection::requestMtuExchange(uint16_t mtu) {
+    HostLock lock;
+    uint16_t agreed = mtu < Bluefruit.maxMtu ? mtu : Bluefruit.maxMtu;
+    if (central.mtu < agreed) {
+        agreed = central.mtu;
+    }
+    this->mtu = agreed > HOST_BLE_ATT_MTU_MIN ? agreed : HOST_BLE_ATT_MTU_MIN;
+    return true;
+}
+
+void BLEConnection::process() {
+    HostLock lock;
+    if (parameterPending && millis() - parameterTime >= central.delayMs) {
+        interval = pendingInterval;
+        latency = pendingLatency;
+        timeout = pendingTimeout;
+        parameterPending = false;
+    }
+    if (phyPending && millis() - phyTime >= central.delayMs) {
+        phy = pendingPhy;
+        phyPending = false;
+    }
+}
+
+uint16_t BLEConnection::getConnectionInterval() {
+    HostLock lock;
+    process();
+    return interval;
+}
+
+uint16_t BLEConnection::getSlaveLatency() {
+    HostLock lock;
+    process();
+    return latency;
+}
+
+uint16_t BLEConnection::getSupervisionTimeout() {
+    HostLock lock;
+    process();
+    return timeout;
+}
+
+uint8_t BLEConnection::getPHY() {
+    HostLock lock;
+    process();
+    return phy;
+}
+
+// ============================================================================
+// SERVICES AND CHARACTERISTICS
+// ============================================================================
+
+static void copyUuid(char* destination, const char* uuid) {
+    strncpy(destination, uuid, 36);
+    destination[36] = 0;
+}
+
+BLEService::BLEService(const char* uuid) {
+    copyUuid(this->uuid, uuid);
+}
+
+BLECharacteristic::BLECharacteristic()
+    : properties(0), maxLength(20), writeCallback(NULL), subscribed(false), valueLength(0) {
+    uuid[0] = 0;
+}
+
+BLECharacteristic::BLECharacteristic(const char* uuid) : BLECharacteristic() {
+    copyUuid(this->uuid, uuid);
+}
+
+void BLECharacteristic::begin() {
+    Bluefruit.add(this);
+}
+
+uint16_t BLECharacteristic::write(const void* data, uint16_t length) {
+    HostLock lock;
+    valueLength = length < maxLength ? length : maxLength;
+    memcpy(value, data, valueLength);
+    return valueLength;
+}
+
+bool BLECharacteristic::notify(const void* data, uint16_t length) {
+    HostLock lock;
+    if (!subscribed || !Bluefruit.connected()) {
+        return false;
+    }
+    write(data, length);
+
+    // Longer values go out as several notifications, each needing a buffer
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint16_t piece = Bluefruit.connection.getMtu() - 3;
+    do {
+        uint16_t size = length < piece ? length : piece;
+        if (!Bluefruit.queueNotification(this, bytes, size)) {
+            return false;
+        }
+        bytes += size;
+        length -= size;
+    } while (length > 0);
+    return true;
+}
+
+uint16_t BLECharacteristic::hostValue(uint8_t* data, uint16_t size) const {
+    HostLock lock;
+    uint16_t length = valueLength < size ? valueLength : size;
+    memcpy(data, value, length);
+    return length;
+}
+
+// ============================================================================
+// PERIPHERAL
+// ============================================================================
+
+bool HostAdvertising::start(uint16_t timeout) {
+    running = true;
+    startUs = micros();
+    nextEventUs = startUs;
+    return true;
+}
+
+HostBluefruit::HostBluefruit()
+    : onNotify(NULL), onNotifyContext(NULL), isConnected(false), eventCallback(NULL),
+      characteristicCount(0), nextEventUs(0), eventCounter(0) {
+    configPrphBandwidth(BANDWIDTH_NORMAL);
+    memset(&radio, 0, sizeof(radio));
+}
+
+void HostBluefruit::configPrphBandwidth(uint8_t bandwidth) {
+    // hvn_tx_queue_size and ATT MTU of the Bluefruit bandwidth presets
+    txBuffers = bandwidth == BANDWIDTH_MAX ? 3 : 1;
+    maxMtu = bandwidth >= BANDWIDTH_HIGH ? 247 : HOST_BLE_ATT_MTU_MIN;
+}
+
+void HostBluefruit::add(BLECharacteristic* characteristic) {
+    // A characteristic re-created with the same UUID replaces the old one
+    for (int i = 0; i < characteristicCount; i++) {
+        if (strcmp(characteristics[i]->uuid, characteristic->uuid) == 0) {
+            characteristics[i] = characteristic;
+            return;
+        }
+    }
+    if (characteristicCount < HOST_BLE_MAX_CHARACTERISTICS) {
+        characteristics[characteristicCount++] = characteristic;
+    }
+}
+
+BLECharacteristic* HostBluefruit::hostFind(const char* uuid) {
+    for (int i = 0; i < characteristicCount; i++) {
+        if (strcmp(characteristics[i]->uuid, uuid) == 0) {
+            return characteristics[i];
+        }
+    }
+    return NULL;
+}
+
+bool HostBluefruit::hostConnect(const HostCentral& central) {
+    HostLock lock;
+    if (isConnected || !Advertising.running) {
+        return false;
+    }
+    Advertising.running = false;
+    isConnected = true;
+    connection.hostConnect(central);
+    txQueue.clear();
+    memset(&radio, 0, sizeof(radio));
+    nextEventUs = micros() + central.interval * 1250ull;
+    eventCounter = 0;
+
+    // The app subscribes to everything it can
+    for (int i = 0; i < characteristicCount; i++) {
+        characteristics[i]->subscribed = (characteristics[i]->properties & CHR_PROPS_NOTIFY) != 0;
+    }
+    if (Periph.connectCallback != NULL) {
+        Periph.connectCallback(0);
+    }
+    return true;
+}
+
+void HostBluefruit::hostDisconnect(uint8_t reason) {
+    HostLock lock;
+    if (!isConnected) {
+        return;
+    }
+    isConnected = false;
+    txQueue.clear();
+    for (int i = 0; i < characteristicCount; i++) {
+        characteristics[i]->subscribed = false;
+    }
+    if (Advertising.restart) {
+        Advertising.start(0);
+    }
+    if (Periph.disconnectCallback != NULL) {
+        Periph.disconnectCallback(0, reason);
+    }
+}
+
+bool HostBluefruit::hostWrite(const char* uuid, const uint8_t* data, uint16_t length) {
+    HostLock lock;
+    BLECharacteristic* characteristic = hostFind(uuid);
+    if (characteristic == NULL || !isConnected || length > HOST_BLE_VALUE_MAX) {
+        return false;
+    }
+    characteristic->write(data, length);
+    if (characteristic->writeCallback != NULL) {
+        uint8_t copy[HOST_BLE_VALUE_MAX];
+        memcpy(copy, data, length);
+        characteristic->writeCallback(0, characteristic, copy, length);
+    }
+    return true;
+}
+
+bool HostBluefruit::queueNotification(const BLECharacteristic* characteristic, const uint8_t* data,
+                                      uint16_t length) {
+    hostProcess();
+    if (txQueue.size() >= txBuffers) {
+        radio.notifyFailures++;
+        return false;
+    }
+    Notification notification;
+    notification.characteristic = characteristic;
+    notification.data.assign(data, data + length);
+    txQueue.push_back(notification);
+    return true;
+}
+
+void HostBluefruit::hostProcess() {
+    HostLock lock;
+    while (Advertising.running && !isConnected && micros() >= Advertising.nextEventUs) {
+        bool fast = Advertising.nextEventUs - Advertising.startUs < Advertising.fastTimeout * 1000000ull;
+        Advertising.nextEventUs += (fast ? Advertising.fastInterval : Advertising.slowInterval) * 625ull;
+        radio.advertisingEvents++;
+    }
+    while (isConnected && micros() >= nextEventUs) {
+        connection.process();
+        nextEventUs += connection.interval * 1250ull;
+        eventCounter++;
+
+        // With nothing to send, the peripheral only wakes every latency + 1 events
+        if (txQueue.empty()) {
+            if (eventCounter % (connection.latency + 1) == 0) {
+                radio.events++;
+            }
+            continue;
+        }
+        radio.events++;
+        radio.eventsWithData++;
+        uint8_t count = 0;
+        while (!txQueue.empty() && count < connection.central.packetsPerEvent) {
+            Notification notification = txQueue.front();
+            txQueue.pop_front();
+            count++;
+            radio.notifications++;
+            radio.bytes += notification.data.size();
+            if (onNotify != NULL) {
+                onNotify(*notification.characteristic, notification.data.data(),
+                         (uint16_t)notification.data.size(), onNotifyContext);
+            }
+        }
+        if (eventCallback != NULL) {
+            ble_evt_t event;
+            memset(&event, 0, sizeof(event));
+            event.header.evt_id = BLE_GATTS_EVT_HVN_TX_COMPLETE;
+            event.evt.gatts_evt.conn_handle = 0;
+            event.evt.gatts_evt.params.hvn_tx_complete.count = count;
+            eventCallback(&event);
+        }
+    }
+}
+
+void HostBluefruit::hostReset() {
+    HostLock lock;
+    isConnected = false;
+    txQueue.clear();
+    characteristicCount = 0;
+    eventCallback = NULL;
+    onNotify = NULL;
+    onNotifyContext = NULL;
+    Periph = HostPeriph();
+    Advertising = HostAdvertising();
+    configPrphBandwidth(BANDWIDTH_NORMAL);
+    memset(&radio, 0, sizeof(radio));
+}
@@ -0,0 +1,96 @@
+/*
+ * hostBoard.cpp
+ *
+ * Simulated Wellby board (see hostBoard.h).
+ */
+
+#include "hostBoard.h"
+#include "Wire.h"
+#include "bluefruit.h"
+
+// PowerManager.cpp: voltage = VOLTAGE_DIVIDER * ADC_VREF * reading / ADC_MAX_VALUE
+#define BOARD_VOLTAGE_DIVIDER 2.961
+#define BOARD_ADC_VREF 3.6
+#define BOARD_ADC_MAX 4096
+
+HostBoard::HostBoard() : active(false), lastMs(0), running(false) {
+}
+
+HostBoard::~HostBoard() {
+    end();
+}
+
+void HostBoard::begin(const long* samples, size_t count, int sampleRate) {
+    end();
+    hostResetPins();
+    Bluefruit.hostReset();
+    sensor = Max30105Sim();
+    sensor.setSource(samples, count, sampleRate);
+    Wire.attach(&sensor);
+    setBatteryVoltage(3.9);
+    setButton(false);
+
+    lastMs = millis();
+    active = true;
+    if (hostClockIsVirtual()) {
+        hostAddClockListener(onClock, this);
+    } else {
+        running = true;
+        thread = std::thread(&HostBoard::run, this);
+    }
+}
+
+void HostBoard::end() {
+    if (!active) {
+        return;
+    }
+    if (thread.joinable()) {
+        running = false;
+        thread.join();
+    } else {
+        hostRemoveClockListener(onClock, this);
+    }
+    Wire.detach(&sensor);
+    active = false;
+}
+
+void HostBoard::setBatteryVoltage(float volts) {
+    hostSetAnalog(HOST_BOARD_VBAT_PIN,
+                  (uint32_t)(volts * BOARD_ADC_MAX / (BOARD_VOLTAGE_DIVIDER * BOARD_ADC_VREF) + 0.5));
+}
+
+void HostBoard::setButton(bool pressed) {
+    // The button pulls the pin LOW; released, the pull-up holds it HIGH
+    if (pressed) {
+        hostSetPin(HOST_BOARD_BUTTON_PIN, LOW);
+    } else {
+        hostReleasePin(HOST_BOARD_BUTTON_PIN);
+    }
+}
+
+void HostBoard::onClock(void* context) {
+    static_cast<HostBoard*>(context)->update();
+}
+
+void HostBoard::run() {
+    while (running) {
+        update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void HostBoard::update() {
+    HostLock lock;
+    unsigned long now = millis();
+    sensor.advance(now - lastMs);
+    lastMs = now;
+
+    // Open drain: driven LOW while asserted, otherwise left to the pull-up
+    if (sensor.interruptAsserted()) {
+        hostSetPin(HOST_BOARD_INT_PIN, LOW);
+    } else {
+        hostReleasePin(HOST_BOARD_INT_PIN);
+    }
+
+    Bluefruit.hostProcess();
+}
@@ -0,0 +1,71 @@
+/*
+ * hostBoard.h
+ *
+ * The Wellby board around the firmware on the host: wires the simulated
+ * peripherals to the virtual clock and to the pins the firmware uses.
+ *
+ * MODELLED:
+ * - MAX30105 (max30105Sim.h) on the I2C bus, playing back a recording
+ *   (synthetic or read from a file) as time passes, with its open-drain
+ *   INT line on D2; worn (skin contact) unless setWorn(false)
+ * - Battery voltage on the VBAT ADC input (PowerManager.cpp divider)
+ * - The user button on D7 (active LOW)
+ * - BLE connection events (Bluefruit.hostProcess(), see bluefruit.h)
+ * On the virtual clock all of it advances from a clock listener
+ * (Arduino.h), so firmware that busy-waits with delay() or millis() sees
+ * the board move. On the wall clock a board thread advances it every
+ * millisecond instead, next to the firmware's own tasks; each pass holds
+ * the HostLock (Arduino.h).
+ *
+ * USAGE EXAMPLE:
+ *   hostUseVirtualClock(true);
+ *   HostBoard board;
+ *   board.begin(samples.data(), samples.size(), 25);
+ *   ... construct the managers, then per loop pass:
+ *   hostAdvanceClock(1000);
+ *   board.end();
+ *
+ */
+
+#ifndef HOST_BOARD_H
+#define HOST_BOARD_H
+
+#include "Arduino.h"
+#include "max30105Sim.h"
+#include <atomic>
+#include <thread>
+
+#define HOST_BOARD_INT_PIN 2        // PPG_INT_PIN in PPGManager.h
+#define HOST_BOARD_BUTTON_PIN 7     // BUTTON_PIN in wellby_firmware.ino
+#define HOST_BOARD_VBAT_PIN 32      // PIN_VBAT in PowerManager.cpp
+
+class HostBoard {
+public:
+    HostBoard();
+    ~HostBoard();
+
+    // Power the board: pins, radio and sensor reset, sensor playing
+    // samples at sampleRate Hz from the current time, battery at 3.9 V
+    void begin(const long* samples, size_t count, int sampleRate);
+
+    // Detach from the clock and the I2C bus
+    void end();
+
+    void setBatteryVoltage(float volts);
+    void setButton(bool pressed);
+    void setWorn(bool worn) { sensor.setContact(worn); }
+
+    Max30105Sim sensor;
+
+private:
+    bool active;
+    unsigned long lastMs;
+    std::atomic<bool> running;  // Board thread (wall clock only)
+    std::thread thread;
+
+    static void onClock(void* context);
+    void run();
+    void update();
+};
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ * hostMax30105.cpp
+ *
+ * SparkFun MAX30105 library subset for the host (see MAX30105.h in this
+ * folder). Register values as in the library and the datasheet.
+ */
+
+#include "MAX30105.h"
+
+#define REG_INT_STATUS_1 0x00
+#define REG_INT_ENABLE_1 0x02
+#define REG_FIFO_WR_PTR 0x04
+#define REG_OVF_COUNTER 0x05
+#define REG_FIFO_RD_PTR 0x06
+#define REG_FIFO_DATA 0x07
+#define REG_FIFO_CONFIG 0x08
+#define REG_MODE_CONFIG 0x09
+#define REG_SPO2_CONFIG 0x0A
+#define REG_LED1_PA 0x0C
+#define REG_LED2_PA 0x0D
+#define REG_LED3_PA 0x0E
+#define REG_LED_PROX_AMP 0x10
+#define REG_MULTI_LED_1 0x11
+#define REG_MULTI_LED_2 0x12
+#define REG_PROX_INT_THRESH 0x30
+#define REG_PART_ID 0xFF
+
+#define PART_ID 0x15
+#define MODE_SHUTDOWN 0x80
+#define MODE_RESET 0x40
+#define MODE_MULTI_LED 0x07
+#define INT_A_FULL 0x80
+#define INT_PROX 0x10
+#define FIFO_ROLLOVER 0x10
+
+MAX30105::MAX30105() : wire(&Wire), address(MAX30105_ADDRESS), activeLEDs(1) {
+    memset(&sense, 0, sizeof(sense));
+}
+
+bool MAX30105::begin(TwoWire& wirePort, uint32_t i2cSpeed, uint8_t i2cAddress) {
+    wire = &wirePort;
+    address = i2cAddress;
+    wire->begin();
+    wire->setClock(i2cSpeed);
+    return readPartID() == PART_ID;
+}
+
+void MAX30105::setup(uint8_t powerLevel, uint8_t sampleAverage, uint8_t ledMode, int sampleRate,
+                     int pulseWidth, int adcRange) {
+    softReset();
+
+    setFIFOAverage(sampleAverage);
+    enableFIFORollover();
+
+    // All active slots in multi-LED mode, as the library does for ledMode 3
+    activeLEDs = ledMode == 3 ? 3 : ledMode == 2 ? 2 : 1;
+    writeRegister8(address, REG_MODE_CONFIG, ledMode == 3 ? MODE_MULTI_LED : ledMode == 2 ? 0x03 : 0x02);
+
+    // SPO2_CONFIG: ADC range [6:5], sample rate [4:2], pulse width [1:0]
+    uint8_t range = adcRange < 4096 ? 0 : adcRange < 8192 ? 1 : adcRange < 16384 ? 2 : 3;
+    const int rates[] = {50, 100, 200, 400, 800, 1000, 1600, 3200};
+    uint8_t rate = 0;
+    while (rate < 7 && rates[rate] < sampleRate) {
+        rate++;
+    }
+    uint8_t width = pulseWidth < 118 ? 0 : pulseWidth < 215 ? 1 : pulseWidth < 411 ? 2 : 3;
+    writeRegister8(address, REG_SPO2_CONFIG, (uint8_t)(range << 5 | rate << 2 | width));
+
+    setPulseAmplitudeRed(powerLevel);
+    setPulseAmplitudeIR(powerLevel);
+    setPulseAmplitudeGreen(powerLevel);
+    setPulseAmplitudeProximity(powerLevel);
+
+    // Slot 1 red, slot 2 IR, slot 3 green
+    writeRegister8(address, REG_MULTI_LED_1, ledMode >= 2 ? 0x21 : 0x01);
+    writeRegister8(address, REG_MULTI_LED_2, ledMode >= 3 ? 0x03 : 0x00);
+
+    clearFIFO();
+}
+
+void MAX30105::softReset() {
+    bitMask(REG_MODE_CONFIG, (uint8_t)~MODE_RESET, MODE_RESET);
+    unsigned long start = millis();
+    while (millis() - start < 100) {
+        if ((readRegister8(address, REG_MODE_CONFIG) & MODE_RESET) == 0) {
+            break;
+        }
+        delay(1);
+    }
+}
+
+void MAX30105::shutDown() {
+    bitMask(REG_MODE_CONFIG, (uint8_t)~MODE_SHUTDOWN, MODE_SHUTDOWN);
+}
+
+void MAX30105::wakeUp() {
+    bitMask(REG_MODE_CONFIG, (uint8_t)~MODE_SHUTDOWN, 0);
+}
+
+void MAX30105::setPulseAmplitudeRed(uint8_t value) { writeRegister8(address, REG_LED1_PA, value); }
+void MAX30105::setPulseAmplitudeIR(uint8_t value) { writeRegister8(address, REG_LED2_PA, value); }
+void MAX30105::setPulseAmplitudeGreen(uint8_t value) { writeRegister8(address, REG_LED3_PA, value); }
+void MAX30105::setPulseAmplitudeProximity(uint8_t value) { writeRegister8(address, REG_LED_PROX_AMP, value); }
+
+void MAX30105::setFIFOAverage(uint8_t samples) {
+    uint8_t code = 0;
+    while (code < 5 && (1 << code) < samples) {
+        code++;
+    }
+    bitMask(REG_FIFO_CONFIG, 0x1F, (uint8_t)(code << 5));
+}
+
+void MAX30105::enableFIFORollover() {
+    bitMask(REG_FIFO_CONFIG, (uint8_t)~FIFO_ROLLOVER, FIFO_ROLLOVER);
+}
+
+void MAX30105::setFIFOAlmostFull(uint8_t freeSlots) {
+    bitMask(REG_FIFO_CONFIG, 0xF0, freeSlots & 0x0F);
+}
+
+void MAX30105::enableAFULL() {
+    bitMask(REG_INT_ENABLE_1, (uint8_t)~INT_A_FULL, INT_A_FULL);
+}
+
+void MAX30105::disableAFULL() {
+    bitMask(REG_INT_ENABLE_1, (uint8_t)~INT_A_FULL, 0);
+}
+
+void MAX30105::enablePROXINT() {
+    bitMask(REG_INT_ENABLE_1, (uint8_t)~INT_PROX, INT_PROX);
+}
+
+void MAX30105::disablePROXINT() {
+    bitMask(REG_INT_ENABLE_1, (uint8_t)~INT_PROX, 0);
+}
+
+void MAX30105::setProximityThreshold(uint8_t threshMSB) {
+    writeRegister8(address, REG_PROX_INT_THRESH, threshMSB);
+}
+
+uint8_t MAX30105::getINT1() {
+    return readRegister8(address, REG_INT_STATUS_1);
+}
+
+void MAX30105::clearFIFO() {
+    writeRegister8(address, REG_FIFO_WR_PTR, 0);
+    writeRegister8(address, REG_OVF_COUNTER, 0);
+    writeRegister8(address, REG_FIFO_RD_PTR, 0);
+}
+
+uint16_t MAX30105::check() {
+    uint8_t readPointer = readRegister8(address, REG_FIFO_RD_PTR);
+    uint8_t writePointer = readRegister8(address, REG_FIFO_WR_PTR);
+    if (readPointer == writePointer) {
+        return 0;
+    }
+    int samples = (writePointer - readPointer) & 0x1F;
+
+    // Whole samples per transfer, within the Wire buffer
+    int sampleBytes = activeLEDs * 3;
+    int bytesLeft = samples * sampleBytes;
+    while (bytesLeft > 0) {
+        int chunk = bytesLeft < I2C_BUFFER_LENGTH ? bytesLeft : I2C_BUFFER_LENGTH / sampleBytes * sampleBytes;
+        bytesLeft -= chunk;
+
+        wire->beginTransmission(address);
+        wire->write(REG_FIFO_DATA);
+        wire->endTransmission();
+        wire->requestFrom(address, (uint8_t)chunk);
+        for (; chunk > 0; chunk -= sampleBytes) {
+            sense.head = (sense.head + 1) % MAX30105_STORAGE_SIZE;
+            uint32_t values[3] = {0, 0, 0};
+            for (int led = 0; led < activeLEDs; led++) {
+                uint32_t value = (uint32_t)wire->read() << 16;
+                value |= (uint32_t)wire->read() << 8;
+                value |= (uint32_t)wire->read();
+                values[led] = value & 0x3FFFF;
+            }
+            sense.red[sense.head] = values[0];
+            sense.IR[sense.head] = values[1];
+            sense.green[sense.head] = values[2];
+        }
+    }
+    return (uint16_t)samples;
+}
+
+uint8_t MAX30105::available() {
+    return (uint8_t)((sense.head - sense.tail + MAX30105_STORAGE_SIZE) % MAX30105_STORAGE_SIZE);
+}
+
+bool MAX30105::safeCheck(uint8_t maxTimeToCheck) {
+    unsigned long start = millis();
+    while (millis() - start <= maxTimeToCheck) {
+        if (check() > 0) {
+            return true;
+        }
+        delay(1);
+    }
+    return false;
+}
+
+uint32_t MAX30105::getRed() { return safeCheck(250) ? sense.red[sense.head] : 0; }
+uint32_t MAX30105::getIR() { return safeCheck(250) ? sense.IR[sense.head] : 0; }
+uint32_t MAX30105::getGreen() { return safeCheck(250) ? sense.green[sense.head] : 0; }
+
+uint8_t MAX30105::readPartID() {
+    return readRegister8(address, REG_PART_ID);
+}
+
+uint8_t MAX30105::readRegister8(uint8_t address, uint8_t reg) {
+    wire->beginTransmission(address);
+    wire->write(reg);
+    wire->endTransmission(false);
+    if (wire->requestFrom(address, (uint8_t)1) == 0) {
+        return 0;
+    }
+    return (uint8_t)wire->read();
+}
+
+void MAX30105::writeRegister8(uint8_t address, uint8_t reg, uint8_t value) {
+    wire->beginTransmission(address);
+    wire->write(reg);
+    wire->write(value);
+    wire->endTransmission();
+}
+
+void MAX30105::bitMask(uint8_t reg, uint8_t mask, uint8_t thing) {
+    uint8_t value = readRegister8(address, reg) & mask;
+    writeRegister8(address, reg, value | thing);
+}
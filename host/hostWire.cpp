@@ -0,0 +1,107 @@
+/*
+ * hostWire.cpp
+ *
+ * Simulated I2C bus (see Wire.h in this folder).
+ */
+
+#include "Wire.h"
+
+TwoWire Wire;
+
+TwoWire::TwoWire()
+    : txAddress(0), txLength(0), rxLength(0), rxIndex(0), transactionCount(0), byteCount(0) {
+    for (int i = 0; i < HOST_WIRE_MAX_DEVICES; i++) {
+        devices[i] = NULL;
+    }
+}
+
+void TwoWire::attach(HostI2CDevice* device) {
+    HostLock lock;
+    for (int i = 0; i < HOST_WIRE_MAX_DEVICES; i++) {
+        if (devices[i] == NULL || devices[i] == device) {
+            devices[i] = device;
+            return;
+        }
+    }
+}
+
+void TwoWire::detach(HostI2CDevice* device) {
+    HostLock lock;
+    for (int i = 0; i < HOST_WIRE_MAX_DEVICES; i++) {
+        if (devices[i] == device) {
+            devices[i] = NULL;
+        }
+    }
+}
+
+HostI2CDevice* TwoWire::find(uint8_t address) {
+    for (int i = 0; i < HOST_WIRE_MAX_DEVICES; i++) {
+        if (devices[i] != NULL && devices[i]->i2cAddress() == address) {
+            return devices[i];
+        }
+    }
+    return NULL;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+    txAddress = address;
+    txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t value) {
+    if (txLength >= HOST_WIRE_BUFFER) {
+        return 0;
+    }
+    txBuffer[txLength++] = value;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t length) {
+    size_t written = 0;
+    while (written < length && write(data[written])) {
+        written++;
+    }
+    return written;
+}
+
+uint8_t TwoWire::endTransmission(bool stop) {
+    HostLock lock;
+    HostI2CDevice* device = find(txAddress);
+    transactionCount++;
+    if (device == NULL) {
+        return 2;
+    }
+    device->i2cWrite(txBuffer, txLength);
+    byteCount += txLength + 1;  // Plus address byte
+    txLength = 0;
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, bool stop) {
+    HostLock lock;
+    rxLength = 0;
+    rxIndex = 0;
+    HostI2CDevice* device = find(address);
+    transactionCount++;
+    if (device == NULL) {
+        return 0;
+    }
+    if (quantity > HOST_WIRE_BUFFER) {
+        quantity = HOST_WIRE_BUFFER;
+    }
+    device->i2cRead(rxBuffer, quantity);
+    rxLength = quantity;
+    byteCount += quantity + 1;
+    return quantity;
+}
+
+int TwoWire::available() {
+    return (int)(rxLength - rxIndex);
+}
+
+int TwoWire::read() {
+    if (rxIndex >= rxLength) {
+        return -1;
+    }
+    return rxBuffer[rxIndex++];
+}
@@ -0,0 +1,261 @@
+/*
+ * max30105Sim.cpp
+ *
+ * Register-level MAX30105 simulation (see max30105Sim.h).
+ */
+
+#include "max30105Sim.h"
+
+// Register addresses
+#define REG_INT_STATUS_1 0x00
+#define REG_INT_ENABLE_1 0x02
+#define REG_FIFO_WR_PTR 0x04
+#define REG_OVF_COUNTER 0x05
+#define REG_FIFO_RD_PTR 0x06
+#define REG_FIFO_DATA 0x07
+#define REG_FIFO_CONFIG 0x08
+#define REG_MODE_CONFIG 0x09
+#define REG_LED1_PA 0x0C
+#define REG_PILOT_PA 0x10
+#define REG_MULTI_LED_1 0x11
+#define REG_MULTI_LED_2 0x12
+#define REG_PROX_INT_THRESH 0x30
+#define REG_PART_ID 0xFF
+
+#define MODE_SHUTDOWN_BIT 0x80
+#define MODE_RESET_BIT 0x40
+#define FIFO_ROLLOVER_BIT 0x10
+#define FIFO_A_FULL_MASK 0x0F
+#define INT_A_FULL 0x80
+#define INT_PROX 0x10
+#define POINTER_MASK (MAX30105_SIM_FIFO_DEPTH - 1)
+#define OVF_MAX 0x1F
+
+Max30105Sim::Max30105Sim()
+    : pointer(0), fifoCount(0), byteIndex(0), source(NULL), sourceCount(0), sampleRate(25),
+      sourceSlot(2), produced(0), overflowed(0), pendingTime(0), contact(true), proximityMode(false),
+      ledSteps(0) {
+    memset(modeMs, 0, sizeof(modeMs));
+    resetRegisters();
+}
+
+void Max30105Sim::resetRegisters() {
+    memset(registers, 0, sizeof(registers));
+    registers[REG_PART_ID] = 0x15;
+    registers[REG_MODE_CONFIG] = 0x02;  // Red only until configured
+    fifoCount = 0;
+    byteIndex = 0;
+    proximityMode = false;
+}
+
+void Max30105Sim::setSource(const long* samples, size_t count, int rate, int slot) {
+    source = samples;
+    sourceCount = count;
+    sampleRate = rate > 0 ? rate : 1;
+    sourceSlot = slot;
+    produced = 0;
+    pendingTime = 0;
+}
+
+void Max30105Sim::advance(unsigned long ms) {
+    if (source == NULL || sourceCount == 0) {
+        return;
+    }
+    double period = 1000.0 / sampleRate;
+    pendingTime += ms;
+    while (pendingTime >= period) {
+        pendingTime -= period;
+        long value = source[produced % sourceCount];
+        if (registers[REG_MODE_CONFIG] & MODE_SHUTDOWN_BIT) {
+            modeMs[2] += period;
+        } else if (proximityMode) {
+            modeMs[1] += period;
+            ledSteps += registers[REG_PILOT_PA] * period;
+            proximityReading();
+        } else {
+            modeMs[0] += period;
+            ledSteps += pulsedAmplitude() * period;
+            pushSample(contact ? value : value >> MAX30105_SIM_AIR_SHIFT);
+        }
+        produced++;
+    }
+}
+
+void Max30105Sim::proximityReading() {
+    long counts = registers[REG_PILOT_PA] * (long)(contact ? MAX30105_SIM_SKIN_COUNTS : MAX30105_SIM_AIR_COUNTS);
+    if (counts > 0x3FFFF) {
+        counts = 0x3FFFF;
+    }
+    // PROX_INT_THRESH is compared with the 8 MSBs of the 18-bit count
+    if ((counts >> 10) > registers[REG_PROX_INT_THRESH]) {
+        registers[REG_INT_STATUS_1] |= INT_PROX;
+        proximityMode = false;
+    }
+}
+
+int Max30105Sim::activeSlots() const {
+    switch (registers[REG_MODE_CONFIG] & 0x07) {
+        case 0x02: return 1;  // Red
+        case 0x03: return 2;  // Red + IR
+        case 0x07: {
+            // Multi-LED: slots 1-4, each enabled if its 3-bit field is non-zero
+            int slots = 0;
+            uint8_t fields[4] = {
+                (uint8_t)(registers[REG_MULTI_LED_1] & 0x07), (uint8_t)((registers[REG_MULTI_LED_1] >> 4) & 0x07),
+                (uint8_t)(registers[REG_MULTI_LED_2] & 0x07), (uint8_t)((registers[REG_MULTI_LED_2] >> 4) & 0x07)};
+            for (int i = 0; i < 4; i++) {
+                if (fields[i] != 0) {
+                    slots = i + 1;
+                }
+            }
+            return slots > 0 ? slots : 1;
+        }
+        default: return 1;
+    }
+}
+
+int Max30105Sim::pulsedAmplitude() const {
+    // LED1 (red), LED2 (IR), LED3 (green) amplitudes in consecutive registers
+    switch (registers[REG_MODE_CONFIG] & 0x07) {
+        case 0x02: return registers[REG_LED1_PA];
+        case 0x03: return registers[REG_LED1_PA] + registers[REG_LED1_PA + 1];
+        case 0x07: {
+            // Multi-LED slot fields 1-3 name the LED pulsed in that slot
+            int total = 0;
+            uint8_t fields[4] = {
+                (uint8_t)(registers[REG_MULTI_LED_1] & 0x07), (uint8_t)((registers[REG_MULTI_LED_1] >> 4) & 0x07),
+                (uint8_t)(registers[REG_MULTI_LED_2] & 0x07), (uint8_t)((registers[REG_MULTI_LED_2] >> 4) & 0x07)};
+            for (int i = 0; i < 4; i++) {
+                if (fields[i] >= 1 && fields[i] <= 3) {
+                    total += registers[REG_LED1_PA + fields[i] - 1];
+                }
+            }
+            return total;
+        }
+        default: return 0;
+    }
+}
+
+void Max30105Sim::pushSample(long value) {
+    uint8_t& writePointer = registers[REG_FIFO_WR_PTR];
+    uint8_t& readPointer = registers[REG_FIFO_RD_PTR];
+    uint8_t& overflow = registers[REG_OVF_COUNTER];
+
+    if (fifoCount == MAX30105_SIM_FIFO_DEPTH) {
+        overflowed++;
+        if (overflow < OVF_MAX) {
+            overflow++;
+        }
+        if (!(registers[REG_FIFO_CONFIG] & FIFO_ROLLOVER_BIT)) {
+            return;  // New sample discarded
+        }
+        // Oldest sample is overwritten
+        readPointer = (readPointer + 1) & POINTER_MASK;
+        byteIndex = 0;
+        fifoCount--;
+    }
+
+    int slots = activeSlots();
+    for (int s = 0; s < slots; s++) {
+        uint32_t slotValue = (uint32_t)value & 0x3FFFF;
+        if (s != sourceSlot) {
+            slotValue ^= 0x2AAAA;
+        }
+        fifo[writePointer][s * 3] = (uint8_t)(slotValue >> 16);
+        fifo[writePointer][s * 3 + 1] = (uint8_t)(slotValue >> 8);
+        fifo[writePointer][s * 3 + 2] = (uint8_t)slotValue;
+    }
+    writePointer = (writePointer + 1) & POINTER_MASK;
+    fifoCount++;
+
+    // FIFO_CONFIG[3:0] is the number of free slots left when A_FULL is raised
+    if (fifoCount == MAX30105_SIM_FIFO_DEPTH - (registers[REG_FIFO_CONFIG] & FIFO_A_FULL_MASK)) {
+        registers[REG_INT_STATUS_1] |= INT_A_FULL;
+    }
+}
+
+bool Max30105Sim::isSampling() const {
+    return !(registers[REG_MODE_CONFIG] & MODE_SHUTDOWN_BIT) && !proximityMode;
+}
+
+bool Max30105Sim::interruptAsserted() const {
+    return (registers[REG_INT_STATUS_1] & registers[REG_INT_ENABLE_1]) != 0;
+}
+
+uint8_t Max30105Sim::readFifoByte() {
+    if (fifoCount == 0) {
+        return 0;
+    }
+    uint8_t& readPointer = registers[REG_FIFO_RD_PTR];
+    uint8_t value = fifo[readPointer][byteIndex++];
+    if (byteIndex == activeSlots() * 3) {
+        // Complete sample read: advance and clear the overflow counter
+        byteIndex = 0;
+        readPointer = (readPointer + 1) & POINTER_MASK;
+        fifoCount--;
+        registers[REG_OVF_COUNTER] = 0;
+    }
+    return value;
+}
+
+void Max30105Sim::writeRegister(uint8_t address, uint8_t value) {
+    switch (address) {
+        case REG_INT_STATUS_1:
+        case REG_FIFO_DATA:
+        case REG_PART_ID:
+            return;  // Read-only
+        case REG_FIFO_WR_PTR:
+        case REG_FIFO_RD_PTR:
+            registers[address] = value & POINTER_MASK;
+            fifoCount = (registers[REG_FIFO_WR_PTR] - registers[REG_FIFO_RD_PTR]) & POINTER_MASK;
+            byteIndex = 0;
+            return;
+        case REG_OVF_COUNTER:
+            registers[address] = value & OVF_MAX;
+            return;
+        case REG_MODE_CONFIG:
+            if (value & MODE_RESET_BIT) {
+                resetRegisters();
+                return;
+            }
+            // Every write restarts proximity mode while it is enabled
+            registers[address] = value;
+            proximityMode = (registers[REG_INT_ENABLE_1] & INT_PROX) != 0;
+            return;
+        case REG_INT_ENABLE_1:
+            registers[address] = value;
+            if (!(value & INT_PROX)) {
+                proximityMode = false;
+            }
+            return;
+        default:
+            registers[address] = value;
+    }
+}
+
+void Max30105Sim::i2cWrite(const uint8_t* data, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    pointer = data[0];
+    for (size_t i = 1; i < length; i++) {
+        writeRegister(pointer, data[i]);
+        if (pointer != REG_FIFO_DATA) {
+            pointer++;
+        }
+    }
+}
+
+void Max30105Sim::i2cRead(uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (pointer == REG_FIFO_DATA) {
+            data[i] = readFifoByte();
+        } else if (pointer == REG_INT_STATUS_1) {
+            // Status bits clear on read, releasing the INT pin
+            data[i] = registers[pointer];
+            registers[pointer++] = 0;
+        } else {
+            data[i] = registers[pointer++];
+        }
+    }
+}
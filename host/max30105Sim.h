@@ -0,0 +1,138 @@
+/*
+ * max30105Sim.h
+ *
+ * Register-level simulation of the MAX30105 for host tests/benchmarks.
+ *
+ * MODELLED:
+ * - Register file with auto-incrementing register pointer
+ * - 32-sample FIFO with FIFO_WR_PTR / OVF_COUNTER / FIFO_RD_PTR and
+ *   FIFO_DATA (0x07), which pops bytes and does not auto-increment
+ * - Rollover (FIFO_CONFIG bit 4): when full, the oldest sample is
+ *   overwritten; otherwise new samples are discarded. Either way
+ *   OVF_COUNTER counts lost samples (saturating at 31) and is cleared
+ *   when a complete sample is read
+ * - Active LED slots from MODE_CONFIG (2 = Red, 3 = Red + IR,
+ *   7 = multi-LED slots from MULTI_LED_CONFIG1/2); 3 bytes per slot
+ * - A_FULL interrupt: INT_STATUS_1 (0x00) bit 7 is set when the FIFO
+ *   reaches 32 - FIFO_CONFIG[3:0] samples and cleared when INT_STATUS_1
+ *   is read; the INT pin is asserted while an enabled (INT_ENABLE_1) status
+ *   bit is set (interruptAsserted())
+ * - PART_ID (0xFF) = 0x15
+ * - MODE_CONFIG RESET (bit 6) restores power-on registers and self-clears;
+ *   SHDN (bit 7) stops sampling: the source keeps playing in step with
+ *   time, but samples due while shut down never reach the FIFO
+ * - Proximity mode: a MODE_CONFIG write with PROX_INT_EN (INT_ENABLE_1
+ *   bit 4) set starts it (clearing PROX_INT_EN ends it). Each sample
+ *   period is then one IR reading at PILOT_PA (0x10) and nothing reaches
+ *   the FIFO; the first reading whose count >> 10 exceeds PROX_INT_THRESH
+ *   (0x30) sets PROX_INT (INT_STATUS_1 bit 4) and switches to normal mode
+ * - Skin contact (setContact()): on skin a proximity reading is
+ *   MAX30105_SIM_SKIN_COUNTS per PILOT_PA step, off skin
+ *   MAX30105_SIM_AIR_COUNTS, and FIFO samples drop to the source value
+ *   >> MAX30105_SIM_AIR_SHIFT
+ * - Time spent sampling, in proximity mode and shut down, and the LED
+ *   amplitude pulsed over time, for power estimates
+ *
+ * NOT MODELLED: Other interrupt sources, temperature, ADC settings, LED
+ * currents in the samples. Sample timing comes from advance(), not from
+ * registers.
+ *
+ * USAGE EXAMPLE:
+ *   Max30105Sim sensor;
+ *   sensor.setSource(samples.data(), samples.size(), 25);
+ *   Wire.attach(&sensor);
+ *   sensor.advance(320);   // 320 ms of sensor time -> 8 samples in FIFO
+ *
+ */
+
+#ifndef MAX30105_SIM_H
+#define MAX30105_SIM_H
+
+#include "Wire.h"
+
+#define MAX30105_SIM_FIFO_DEPTH 32
+#define MAX30105_SIM_MAX_SLOTS 4
+#define MAX30105_SIM_SKIN_COUNTS 1500   // Proximity IR count per PILOT_PA step on skin
+#define MAX30105_SIM_AIR_COUNTS 50      // ...and off skin (cover glass reflection)
+#define MAX30105_SIM_AIR_SHIFT 6        // FIFO samples off skin: source value >> 6
+
+class Max30105Sim : public HostI2CDevice {
+public:
+    Max30105Sim();
+
+    // Samples played back (in a loop) in LED slot 'slot' (0-based, 2 = green
+    // in ledMode 3); other slots hold the value XOR 0x2AAAA so that reading
+    // the wrong slot is detectable
+    void setSource(const long* samples, size_t count, int sampleRate, int slot = 2);
+
+    // Let 'ms' of sensor time pass, pushing samples into the FIFO
+    void advance(unsigned long ms);
+
+    // Index of the next source sample to be produced
+    uint32_t producedSamples() const { return produced; }
+
+    // Samples lost to a full FIFO (not saturated, unlike OVF_COUNTER)
+    uint32_t overflowedSamples() const { return overflowed; }
+
+    // INT pin level: true = asserted (driven LOW)
+    bool interruptAsserted() const;
+
+    // Sensor against the skin (default) or off the wrist
+    void setContact(bool touching) { contact = touching; }
+    bool hasContact() const { return contact; }
+    bool inProximityMode() const { return proximityMode; }
+
+    // Sampling in normal mode (main LEDs pulsing): neither shut down nor
+    // in proximity mode
+    bool isSampling() const;
+
+    // Sensor time since construction (ms): sampling (normal mode), in
+    // proximity mode, shut down
+    double samplingMs() const { return modeMs[0]; }
+    double proximityMs() const { return modeMs[1]; }
+    double shutdownMs() const { return modeMs[2]; }
+
+    // LED drive since construction: amplitude register steps of the LEDs
+    // pulsed (LEDx_PA, or PILOT_PA in proximity mode) x ms
+    double ledStepMs() const { return ledSteps; }
+
+    // Direct register access (bypassing I2C)
+    uint8_t reg(uint8_t address) const { return registers[address]; }
+    void setReg(uint8_t address, uint8_t value) { writeRegister(address, value); }
+
+    // HostI2CDevice
+    uint8_t i2cAddress() const { return 0x57; }
+    void i2cWrite(const uint8_t* data, size_t length);
+    void i2cRead(uint8_t* data, size_t length);
+
+private:
+    uint8_t registers[256];
+    uint8_t pointer;             // Register pointer
+
+    uint8_t fifo[MAX30105_SIM_FIFO_DEPTH][MAX30105_SIM_MAX_SLOTS * 3];
+    int fifoCount;               // Samples in FIFO
+    int byteIndex;               // Bytes of the current (oldest) sample already read
+
+    const long* source;
+    size_t sourceCount;
+    int sampleRate;
+    int sourceSlot;
+    uint32_t produced;
+    uint32_t overflowed;
+    double pendingTime;          // Sensor time not yet turned into a sample (ms)
+
+    bool contact;
+    bool proximityMode;
+    double modeMs[3];            // Sampling, proximity, shutdown
+    double ledSteps;
+
+    int activeSlots() const;
+    int pulsedAmplitude() const; // Sum of LEDx_PA over the active slots
+    void proximityReading();
+    void resetRegisters();
+    void pushSample(long value);
+    uint8_t readFifoByte();
+    void writeRegister(uint8_t address, uint8_t value);
+};
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * memoryTracker.cpp
+ *
+ * malloc/free wrappers used by the host benchmark (see memoryTracker.h).
+ * The bench also runs firmware tasks and ring stress tests on std::thread,
+ * so the counters are lock-free atomics (no allocation, safe in malloc).
+ */
+
+#include "memoryTracker.h"
+#include <stdlib.h>
+#include <malloc.h>  // malloc_usable_size
+#include <atomic>
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+}
+
+static std::atomic<size_t> currentBytes(0);
+static std::atomic<size_t> baseBytes(0);
+static std::atomic<size_t> peakBytes(0);
+static std::atomic<size_t> allocationCount(0);
+
+static void added(void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    size_t bytes = malloc_usable_size(ptr);
+    size_t level = currentBytes.fetch_add(bytes) + bytes;
+    size_t peak = peakBytes.load();
+    while (level > peak && !peakBytes.compare_exchange_weak(peak, level)) {
+    }
+    allocationCount++;
+}
+
+static void removed(void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    size_t bytes = malloc_usable_size(ptr);
+    size_t level = currentBytes.load();
+    while (!currentBytes.compare_exchange_weak(level, bytes < level ? level - bytes : 0)) {
+    }
+}
+
+extern "C" {
+
+void* __wrap_malloc(size_t size) {
+    void* ptr = __real_malloc(size);
+    added(ptr);
+    return ptr;
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    void* ptr = __real_calloc(count, size);
+    added(ptr);
+    return ptr;
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    removed(ptr);
+    void* result = __real_realloc(ptr, size);
+    if (result == NULL && size > 0) {
+        added(ptr);  // Original block is still allocated
+        return NULL;
+    }
+    added(result);
+    return result;
+}
+
+void __wrap_free(void* ptr) {
+    removed(ptr);
+    __real_free(ptr);
+}
+
+}
+
+namespace MemoryTracker {
+
+size_t current() { return currentBytes; }
+
+void beginStage() {
+    size_t level = currentBytes.load();
+    baseBytes = level;
+    peakBytes = level;
+    allocationCount = 0;
+}
+
+size_t stagePeak() {
+    size_t peak = peakBytes.load();
+    size_t base = baseBytes.load();
+    return peak > base ? peak - base : 0;
+}
+
+size_t stageAllocations() { return allocationCount; }
+
+}
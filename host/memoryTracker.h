@@ -0,0 +1,42 @@
+/*
+ * memoryTracker.h
+ *
+ * Heap usage accounting for host benchmarks.
+ *
+ * The Makefile links with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,
+ * --wrap=free, so every allocation made by the processing sources goes
+ * through memoryTracker.cpp. Sizes are taken from malloc_usable_size(),
+ * i.e. they include allocator rounding but not its per-block header.
+ * The counters are atomic, so threads may allocate at any time; a stage
+ * measured while other threads allocate includes their allocations.
+ *
+ * USAGE EXAMPLE:
+ *   MemoryTracker::beginStage();
+ *   int* peaks = thresholdPeakDetection(...);
+ *   free(peaks);
+ *   size_t bytes = MemoryTracker::stagePeak();
+ *
+ */
+
+#ifndef MEMORY_TRACKER_H
+#define MEMORY_TRACKER_H
+
+#include <stddef.h>
+
+namespace MemoryTracker {
+
+// Bytes currently allocated through the wrapped functions
+size_t current();
+
+// Start a new measurement: stagePeak() is relative to the current level
+void beginStage();
+
+// Highest allocation level above the beginStage() level
+size_t stagePeak();
+
+// Number of malloc/calloc/realloc calls since beginStage()
+size_t stageAllocations();
+
+}
+
+#endif
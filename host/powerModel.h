@@ -0,0 +1,46 @@
+/*
+ * powerModel.h
+ *
+ * Time and current figures used to turn simulated activity into CPU busy
+ * time, radio on-air time and an average current estimate (nRF52840
+ * datasheet figures, 3 V, DC/DC enabled; MAX30105 for the sensor). These are models for comparing
+ * firmware changes with each other, not measurements.
+ *
+ * USAGE EXAMPLE:
+ *   double busyUs = passes * CPU_LOOP_PASS_US + i2cBytes * CPU_I2C_BYTE_US;
+ *   double duty = busyUs / elapsedUs;
+ *   double mA = duty * CPU_ACTIVE_MA + (1 - duty) * CPU_SLEEP_MA;
+ *
+ */
+
+#ifndef POWER_MODEL_H
+#define POWER_MODEL_H
+
+#include "Arduino.h"
+
+// CPU (BLE radio and sensor excluded)
+#define CPU_ACTIVE_MA 3.3           // CPU running from flash
+#define CPU_SLEEP_MA 0.003          // System ON idle, RTC running
+#define CPU_SYSTEMOFF_MA 0.0004     // System OFF, wake on GPIO sense
+#define CPU_LOOP_PASS_US 15         // One loop() pass with nothing to do (no RTOS tick:
+                                    // tickless idle stops it while every task blocks)
+#define CPU_WAKE_US 40              // GPIO interrupt + switch to the deferred task
+#define CPU_I2C_BYTE_US 22.5        // 9 bit times at 400 kHz (CPU waits for TWIM)
+
+// Radio (0 dBm; TX and RX draw about the same)
+#define RADIO_MA 4.7
+#define RADIO_EVENT_US 350          // Connection event: HFXO/ramp-up and an empty PDU exchange
+#define RADIO_NOTIFY_US 380         // Per notification: turnarounds and the central's empty ack
+#define RADIO_NOTIFY_HEADER_BYTES 17  // Preamble, access address, LL/L2CAP/ATT headers, CRC
+#define RADIO_BYTE_US_1M 8
+#define RADIO_BYTE_US_2M 4
+#define RADIO_ADV_EVENT_US 1300     // Three channels: ADV_IND and a scan request window each
+
+// MAX30105 (datasheet typical figures). LED current only flows during
+// pulses: amplitude steps x SENSOR_LED_MA_PER_STEP x SENSOR_LED_DUTY
+#define SENSOR_ACTIVE_MA 0.6        // Sampling or proximity mode, LEDs excluded
+#define SENSOR_SHUTDOWN_MA 0.0007   // SHDN
+#define SENSOR_LED_MA_PER_STEP 0.2  // LEDx_PA / PILOT_PA step
+#define SENSOR_LED_DUTY 0.0822      // 411 us pulses at 200 samples/s (PPGManager.h)
+
+#endif
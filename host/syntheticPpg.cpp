@@ -0,0 +1,152 @@
+/*
+ * syntheticPpg.cpp
+ *
+ * Implementation of the synthetic PPG generator.
+ * See syntheticPpg.h for the signal model.
+ */
+
+#include "syntheticPpg.h"
+#include <math.h>
+
+// Beat shape (seconds after beat onset)
+#define SYSTOLIC_DELAY 0.15     // Systolic peak
+#define SYSTOLIC_WIDTH 0.06
+#define DIASTOLIC_DELAY 0.40    // Diastolic (reflected) wave
+#define DIASTOLIC_WIDTH 0.09
+#define DIASTOLIC_RATIO 0.4     // Diastolic / systolic amplitude
+#define BEAT_SPAN 2.0           // Time after onset a beat still contributes
+
+#define WANDER_FREQUENCY 0.05   // Slow baseline wander (Hz)
+#define ADC_MAX 262143          // 18-bit ADC full scale
+#define MIN_RR 300              // Physiological RR limits (ms)
+#define MAX_RR 2000
+
+// ============================================================================
+// RANDOM NUMBERS (xorshift32, platform independent)
+// ============================================================================
+
+class XorShift {
+public:
+    explicit XorShift(uint32_t seed) : state(seed ? seed : 0x9E3779B9u) {}
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // Uniform in [0, 1)
+    double uniform() { return (next() >> 8) * (1.0 / 16777216.0); }
+
+    // Standard normal (Box-Muller)
+    double gaussian() {
+        double u1 = uniform();
+        double u2 = uniform();
+        if (u1 < 1e-12) {
+            u1 = 1e-12;
+        }
+        return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+    }
+
+private:
+    uint32_t state;
+};
+
+static double gaussianPulse(double t, double centre, double width) {
+    double d = (t - centre) / width;
+    return exp(-0.5 * d * d);
+}
+
+// ============================================================================
+// GENERATOR
+// ============================================================================
+
+SyntheticPpg generateSyntheticPpg(const SyntheticPpgConfig& config) {
+    SyntheticPpg out;
+    XorShift rng(config.seed);
+
+    int n = (int)(config.seconds * config.fs);
+    double fs = config.fs;
+    double respHz = config.respirationRate / 60.0;
+
+    // --- Beat onsets: RSA sinusoid + jitter, total SD ~ sdnn ---
+    // Var = jitter^2 + rsa^2 / 2 with rsa = sdnn, jitter = sdnn / sqrt(2)
+    double meanRR = 60000.0 / config.heartRate;
+    double rsa = config.sdnn;
+    double jitter = config.sdnn / sqrt(2.0);
+
+    std::vector<double> onsets;
+    double t = -rng.uniform() * meanRR / 1000.0;
+    while (t < config.seconds + 1) {
+        onsets.push_back(t);
+        double rr = meanRR + rsa * sin(2 * M_PI * respHz * t) + jitter * rng.gaussian();
+        if (rr < MIN_RR) rr = MIN_RR;
+        if (rr > MAX_RR) rr = MAX_RR;
+        t += rr / 1000.0;
+    }
+
+    // --- Ground truth peaks and RR intervals ---
+    int previousBeat = -1;
+    for (size_t b = 0; b < onsets.size(); b++) {
+        int peak = (int)lround((onsets[b] + SYSTOLIC_DELAY) * fs);
+        if (peak < 0 || peak >= n) {
+            continue;
+        }
+        if (previousBeat >= 0) {
+            out.rrIntervals.push_back((int)lround((onsets[b] - onsets[previousBeat]) * 1000.0));
+        }
+        out.peaks.push_back(peak);
+        previousBeat = (int)b;
+    }
+
+    // --- Motion bursts ---
+    out.motion.assign(n, 0);
+    std::vector<double> motionSignal(n, 0.0);
+    int bursts = (int)lround(config.motionBursts * config.seconds / 60.0);
+    int burstSamples = (int)(config.motionDuration * fs);
+    for (int m = 0; m < bursts && burstSamples < n; m++) {
+        int start = (int)(rng.uniform() * (n - burstSamples));
+        double freq = 0.8 + 2.2 * rng.uniform();  // Overlaps the heart rate band
+        double phase = 2 * M_PI * rng.uniform();
+        double walk = 0;
+        double amplitude = config.motionAmplitude * config.acAmplitude;
+        for (int i = start; i < start + burstSamples; i++) {
+            walk += 0.3 * rng.gaussian();
+            motionSignal[i] += amplitude * (sin(2 * M_PI * freq * i / fs + phase) + 0.5 * walk);
+            out.motion[i] = 1;
+        }
+    }
+
+    // --- Samples ---
+    double wanderPhase = 2 * M_PI * rng.uniform();
+    out.samples.resize(n);
+    size_t firstBeat = 0;
+    for (int i = 0; i < n; i++) {
+        double ts = i / fs;
+
+        // Sum contributions of beats that started within BEAT_SPAN
+        while (firstBeat < onsets.size() && onsets[firstBeat] < ts - BEAT_SPAN) {
+            firstBeat++;
+        }
+        double pulse = 0;
+        for (size_t b = firstBeat; b < onsets.size() && onsets[b] <= ts; b++) {
+            double tau = ts - onsets[b];
+            pulse += gaussianPulse(tau, SYSTOLIC_DELAY, SYSTOLIC_WIDTH) +
+                     DIASTOLIC_RATIO * gaussianPulse(tau, DIASTOLIC_DELAY, DIASTOLIC_WIDTH);
+        }
+
+        double baseline = config.wander * config.acAmplitude *
+                          (0.6 * sin(2 * M_PI * WANDER_FREQUENCY * ts + wanderPhase) +
+                           0.4 * sin(2 * M_PI * respHz * ts));
+
+        double value = config.dcLevel + config.acAmplitude * pulse + baseline + motionSignal[i] +
+                       config.noise * config.acAmplitude * rng.gaussian();
+
+        if (value < 0) value = 0;
+        if (value > ADC_MAX) value = ADC_MAX;
+        out.samples[i] = (long)value;
+    }
+
+    return out;
+}
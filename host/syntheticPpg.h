@@ -0,0 +1,63 @@
+/*
+ * syntheticPpg.h
+ *
+ * Parametric synthetic PPG generator for host benchmarks and test vectors.
+ *
+ * SIGNAL MODEL:
+ * - Beat timing: mean RR from heartRate, modulated by respiratory sinus
+ *   arrhythmia plus Gaussian jitter, scaled so the RR standard deviation
+ *   is close to sdnn
+ * - Beat shape: systolic Gaussian pulse plus a smaller, later diastolic
+ *   wave (dicrotic notch between them), summed over overlapping beats
+ * - Baseline wander: slow sinusoid plus respiratory baseline modulation
+ * - Sensor noise: white Gaussian noise
+ * - Motion bursts: randomly placed bursts of large, band-overlapping
+ *   oscillation and random-walk drift
+ * Output is in raw sensor counts (DC level + AC), clamped to the 18-bit
+ * range of the MAX30105 ADC.
+ *
+ * LABELS:
+ * Every generated vector carries its ground truth: true systolic peak
+ * indices, true RR intervals, and a per-sample motion flag. This makes the
+ * output usable as labelled test vectors for peak detection, HRV and
+ * signal quality (SQI) evaluation.
+ *
+ * DETERMINISM:
+ * A private xorshift generator is used (not <random>), so the same config
+ * and seed produce the same samples on every platform and compiler.
+ *
+ */
+
+#ifndef SYNTHETIC_PPG_H
+#define SYNTHETIC_PPG_H
+
+#include <stdint.h>
+#include <vector>
+
+struct SyntheticPpgConfig {
+    int fs = 25;                    // Sampling frequency (Hz)
+    float seconds = 60;             // Duration
+    float heartRate = 70;           // Mean heart rate (bpm)
+    float sdnn = 40;                // Target RR standard deviation (ms)
+    float respirationRate = 15;     // Breaths per minute (drives RSA and wander)
+    long dcLevel = 100000;          // DC level (counts)
+    float acAmplitude = 2000;       // Pulse amplitude (counts)
+    float noise = 0.02;             // White noise std (fraction of acAmplitude)
+    float wander = 0.5;             // Baseline wander amplitude (fraction of acAmplitude)
+    float motionBursts = 0;         // Motion bursts per minute
+    float motionDuration = 3;       // Duration of each burst (seconds)
+    float motionAmplitude = 4;      // Burst amplitude (fraction of acAmplitude)
+    uint32_t seed = 1;              // Random seed
+};
+
+struct SyntheticPpg {
+    std::vector<long> samples;      // Raw sensor counts
+    std::vector<int> peaks;         // True systolic peak indices
+    std::vector<int> rrIntervals;   // True RR intervals (ms) between consecutive peaks
+    std::vector<uint8_t> motion;    // 1 where a motion burst is present
+};
+
+// Generate one labelled recording
+SyntheticPpg generateSyntheticPpg(const SyntheticPpgConfig& config);
+
+#endif
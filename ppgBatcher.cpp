@@ -0,0 +1,123 @@
+/*
+ * ppgBatcher.cpp
+ *
+ * Implementation of PPG sample batching.
+ * See ppgBatcher.h for interface documentation.
+ */
+
+#include "ppgBatcher.h"
+
+PPGBatcher::PPGBatcher(PPGPacketSink& sink, uint32_t samplePeriodMs, uint8_t encoding, int riceOrder)
+    : sink(sink), samplePeriod(samplePeriodMs), encoding(encoding),
+      maxPacketSize(PPG_PACKET_MAX_SIZE), maxHold(0), writer(riceOrder), packetOpen(false),
+      packetReady(false), packetStart(0), lastTimestamp(0), sequence(0), sent(0), dropped(0),
+      packets(0) {
+}
+
+void PPGBatcher::setMaxPacketSize(int bytes) {
+    maxPacketSize = bytes < PPG_PACKET_MAX_SIZE ? bytes : PPG_PACKET_MAX_SIZE;
+}
+
+void PPGBatcher::start() {
+    // Whatever the last flush() could not deliver belongs to the previous
+    // recording: drop it rather than send it as part of this one
+    dropped = 0;
+    discard();
+
+    sequence = 0;
+    writer.reset();
+    sent = 0;
+    packets = 0;
+}
+
+void PPGBatcher::discard() {
+    uint32_t count = pending();
+    samples.reset();
+    packetOpen = false;
+    packetReady = false;
+    if (count > 0) {
+        dropped += count;
+        sink.dropped(count);
+    }
+}
+
+uint32_t PPGBatcher::pending() const {
+    return samples.size() + (packetOpen ? writer.sampleCount() : 0);
+}
+
+bool PPGBatcher::add(uint32_t value, uint32_t timestamp) {
+    PPGTxSample sample = {value, timestamp};
+    if (!samples.push(sample)) {
+        dropped++;
+        sink.dropped(1);
+        return false;
+    }
+    encodeQueued();
+    return true;
+}
+
+void PPGBatcher::poll(uint32_t now) {
+    if (!encodeQueued() || !packetOpen) {
+        return;
+    }
+    if (maxHold > 0 && now - packetStart >= maxHold) {
+        sendPacket();
+    }
+}
+
+bool PPGBatcher::flush() {
+    if (!encodeQueued()) {
+        return false;
+    }
+    return !packetOpen || sendPacket();
+}
+
+bool PPGBatcher::encodeQueued() {
+    // Compressed packets hold a variable number of samples, so a packet is
+    // finished when the next sample does not fit
+    if (packetReady && !sendPacket()) {
+        return false;
+    }
+    const uint32_t gapLimit = samplePeriod * 3 / 2;
+    const PPGTxSample* next;
+    while (samples.peek(&next) > 0) {
+        bool gap = next->timestamp - lastTimestamp > gapLimit;
+        if (packetOpen && (gap || !writer.add(next->value))) {
+            if (!sendPacket()) {
+                return false;
+            }
+        }
+        if (!packetOpen) {
+            // Size the packet for the link; the header carries the first
+            // sample's time, the rest follow at the sample rate
+            int size = sink.maxPacketSize();
+            if (size > maxPacketSize) {
+                size = maxPacketSize;
+            }
+            writer.begin(packet, size, sequence++, next->timestamp, PPG_CHANNEL_GREEN, encoding);
+            writer.add(next->value);
+            packetOpen = true;
+            packetStart = next->timestamp;
+        }
+        lastTimestamp = next->timestamp;
+        samples.consume(1);
+
+        if (writer.full() && !sendPacket()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PPGBatcher::sendPacket() {
+    if (!sink.canSend()) {
+        packetReady = true;
+        return false;
+    }
+    sink.send(packet, writer.size());
+    sent += writer.sampleCount();
+    packets++;
+    packetOpen = false;
+    packetReady = false;
+    return true;
+}
@@ -0,0 +1,152 @@
+/*
+ * ppgBatcher.h
+ *
+ * Batching of PPG samples into BLE packets (ppgPacket.h).
+ *
+ * OVERVIEW:
+ * Samples are queued in a fixed ring as they are acquired, encoded into
+ * an open packet and handed to a PPGPacketSink (the BLE link) when:
+ * - the packet is full, or the next sample does not fit
+ * - the next sample is more than 1.5 sample periods after the previous
+ *   one (FIFO overflow, SQI gating): receivers assume a packet's samples
+ *   are evenly spaced
+ * - its first sample is older than the maximum hold time (setMaxHold()),
+ *   so a large MTU or a slow source still delivers with bounded latency
+ * - flush() is called (recording stopped, link lost)
+ * A sample leaves the ring only once it is in a packet, so while the sink
+ * cannot take packets (canSend() false) the finished packet and the
+ * samples after it wait, and queueSpace() shrinks: that is the
+ * backpressure signal for acquisition.
+ *
+ * RECORDINGS:
+ * start() begins a recording: sequence numbers restart, the coder
+ * adaptation restarts, and anything left from the previous recording that
+ * flush() could not deliver is dropped (and counted) rather than sent as
+ * part of the new one.
+ *
+ * ACCOUNTING:
+ * Every sample passed to add() ends up in exactly one of samplesSent()
+ * (handed to the sink in a packet), samplesDropped() (ring full, or
+ * discarded by start() or discard()) or pending() (queued or in the open
+ * packet).
+ *
+ * USAGE EXAMPLE:
+ *   PPGBatcher batcher(link, 40);               // link: a PPGPacketSink
+ *   batcher.start();
+ *   batcher.add(sample, millis());              // Per sample
+ *   batcher.poll(millis());                     // Per loop() pass
+ *   batcher.flush();                            // On stop / disconnect
+ *
+ */
+
+#ifndef PPG_BATCHER_H
+#define PPG_BATCHER_H
+
+#include <Arduino.h>
+#include "spscRing.h"
+#include "ppgPacket.h"
+
+#define PPG_BATCH_RING_SIZE 64      // Queued samples (power of two)
+
+// ============================================================================
+// PACKET SINK
+// ============================================================================
+
+// Where finished packets go (e.g. the raw PPG characteristic)
+class PPGPacketSink {
+public:
+    virtual ~PPGPacketSink() {}
+
+    // Largest packet the link takes now (bytes)
+    virtual int maxPacketSize() = 0;
+
+    // True if send() can take a packet now
+    virtual bool canSend() = 0;
+
+    virtual void send(const uint8_t* data, int length) = 0;
+
+    // Samples the batcher dropped (also counted in samplesDropped())
+    virtual void dropped(uint32_t samples) {}
+};
+
+// ============================================================================
+// BATCHER
+// ============================================================================
+
+// Sample waiting for transmission, with its acquisition time
+struct PPGTxSample {
+    uint32_t value;                 // 18-bit reading
+    uint32_t timestamp;             // millis() at acquisition
+};
+
+class PPGBatcher {
+public:
+    PPGBatcher(PPGPacketSink& sink, uint32_t samplePeriodMs,
+               uint8_t encoding = PPG_ENCODING_RICE, int riceOrder = 1);
+
+    // Largest packet to build, even if the link allows more (bytes)
+    void setMaxPacketSize(int bytes);
+
+    // Longest time a sample may wait in an open packet (ms, 0 = until full)
+    void setMaxHold(uint32_t ms) { maxHold = ms; }
+
+    // Begin a recording (see RECORDINGS)
+    void start();
+
+    // Queue one sample and encode what can be sent
+    // Returns: false if the ring was full and the sample was dropped
+    bool add(uint32_t value, uint32_t timestamp);
+
+    // Retry a packet the sink refused, and send the open packet once its
+    // first sample is older than the maximum hold time
+    void poll(uint32_t now);
+
+    // Drop everything queued and the open packet, counted in
+    // samplesDropped() (e.g. the link they were meant for has gone)
+    void discard();
+
+    // Send everything queued now
+    // Returns: true if nothing is left; false if the sink refused (kept,
+    // retried by poll() or another flush())
+    bool flush();
+
+    // Free ring slots (backpressure: acquisition should hold samples back
+    // when this is smaller than what it is about to add)
+    uint32_t queueSpace() const { return samples.freeSpace(); }
+
+    // Samples queued or in the open packet
+    uint32_t pending() const;
+
+    // Counters since start()
+    uint32_t samplesSent() const { return sent; }
+    uint32_t samplesDropped() const { return dropped; }
+    uint32_t packetsSent() const { return packets; }
+
+private:
+    PPGPacketSink& sink;
+    uint32_t samplePeriod;
+    uint8_t encoding;
+    int maxPacketSize;
+    uint32_t maxHold;
+
+    SpscRing<PPGTxSample, PPG_BATCH_RING_SIZE> samples;
+    uint8_t packet[PPG_PACKET_MAX_SIZE];
+    PPGPacketWriter writer;
+    bool packetOpen;
+    bool packetReady;               // Complete, waiting for the sink
+    uint32_t packetStart;           // Timestamp of the open packet's first sample
+    uint32_t lastTimestamp;         // Timestamp of the last sample encoded
+    uint8_t sequence;
+
+    uint32_t sent;
+    uint32_t dropped;
+    uint32_t packets;
+
+    // Encode queued samples; returns false if stopped by backpressure
+    bool encodeQueued();
+
+    // Hand the open packet to the sink; false if it cannot take it
+    bool sendPacket();
+};
+
+#endif
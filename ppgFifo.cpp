@@ -0,0 +1,162 @@
+/*
+ * ppgFifo.cpp
+ *
+ * Implementation of MAX30105 FIFO burst acquisition.
+ * See ppgFifo.h for interface documentation.
+ */
+
+#include "ppgFifo.h"
+
+PPGFifoReader::PPGFifoReader(TwoWire& wire, uint8_t address)
+    : wire(wire), address(address), sampleIndex(0), lost(0), drains(0), errors(0),
+      saturations(0) {
+    begin(3, PPG_FIFO_SLOT_GREEN);
+}
+
+void PPGFifoReader::begin(uint8_t activeSlots, uint8_t channelSlot) {
+    if (activeSlots < 1) activeSlots = 1;
+    if (activeSlots > PPG_FIFO_MAX_SLOTS) activeSlots = PPG_FIFO_MAX_SLOTS;
+    if (channelSlot >= activeSlots) channelSlot = activeSlots - 1;
+
+    bytesPerSample = activeSlots * PPG_FIFO_BYTES_PER_SLOT;
+    channelOffset = channelSlot * PPG_FIFO_BYTES_PER_SLOT;
+}
+
+void PPGFifoReader::clear() {
+    // Same sequence as MAX30105::clearFIFO()
+    writeRegister(PPG_FIFO_WR_PTR, 0);
+    writeRegister(PPG_FIFO_OVF_COUNTER, 0);
+    writeRegister(PPG_FIFO_RD_PTR, 0);
+
+    sampleIndex = 0;
+    lost = 0;
+    drains = 0;
+    errors = 0;
+    saturations = 0;
+}
+
+int PPGFifoReader::drain(PPGSampleBlock* block) {
+    block->count = 0;
+    block->overflow = 0;
+
+    // WR_PTR, OVF_COUNTER and RD_PTR are consecutive registers
+    uint8_t pointers[3];
+    if (!readRegisters(PPG_FIFO_WR_PTR, pointers, 3)) {
+        errors++;
+        return -1;
+    }
+    uint8_t writePointer = pointers[0] & (PPG_FIFO_DEPTH - 1);
+    uint8_t overflow = pointers[1] & (PPG_FIFO_DEPTH - 1);
+    uint8_t readPointer = pointers[2] & (PPG_FIFO_DEPTH - 1);
+
+    // Equal pointers mean empty - or full if samples have been overwritten
+    int available = (writePointer - readPointer) & (PPG_FIFO_DEPTH - 1);
+    if (overflow > 0 && available == 0) {
+        available = PPG_FIFO_DEPTH;
+    }
+
+    block->timestamp = millis();
+    block->overflow = overflow;
+    if (overflow >= PPG_FIFO_OVF_MAX) {
+        saturations++;
+    }
+    lost += overflow;
+    sampleIndex += overflow;
+    block->firstSample = sampleIndex;
+
+    if (available == 0) {
+        return 0;
+    }
+
+    // Point at FIFO_DATA once; each read then pops bytes from the FIFO
+    wire.beginTransmission(address);
+    wire.write(PPG_FIFO_DATA);
+    if (wire.endTransmission(false) != 0) {
+        errors++;
+        return -1;
+    }
+
+    // Whole samples per transfer, so a sample never spans two reads
+    int samplesPerChunk = PPG_FIFO_I2C_CHUNK / bytesPerSample;
+    int remaining = available;
+    while (remaining > 0) {
+        int samples = remaining < samplesPerChunk ? remaining : samplesPerChunk;
+        int bytes = samples * bytesPerSample;
+        if (wire.requestFrom((int)address, bytes) != bytes) {
+            // Keep the samples decoded so far; the next drain resumes from RD_PTR
+            errors++;
+            while (wire.available()) {
+                wire.read();
+            }
+            break;
+        }
+
+        for (int s = 0; s < samples; s++) {
+            uint32_t value = 0;
+            for (int b = 0; b < bytesPerSample; b++) {
+                uint8_t byte = wire.read();
+                if (b >= channelOffset && b < channelOffset + PPG_FIFO_BYTES_PER_SLOT) {
+                    value = (value << 8) | byte;
+                }
+            }
+            block->samples[block->count++] = value & PPG_FIFO_SAMPLE_MASK;
+        }
+        remaining -= samples;
+    }
+
+    sampleIndex += block->count;
+    drains++;
+    return block->count;
+}
+
+bool PPGFifoReader::enableAlmostFullInterrupt(uint8_t samples) {
+    if (samples < PPG_FIFO_A_FULL_MIN) samples = PPG_FIFO_A_FULL_MIN;
+    if (samples > PPG_FIFO_A_FULL_MAX) samples = PPG_FIFO_A_FULL_MAX;
+
+    // The threshold is programmed as free slots remaining, not samples held
+    return updateRegister(PPG_FIFO_CONFIG, PPG_FIFO_A_FULL_MASK, PPG_FIFO_DEPTH - samples) &&
+           updateRegister(PPG_FIFO_INT_ENABLE_1, PPG_FIFO_INT_A_FULL, PPG_FIFO_INT_A_FULL);
+}
+
+bool PPGFifoReader::disableAlmostFullInterrupt() {
+    return updateRegister(PPG_FIFO_INT_ENABLE_1, PPG_FIFO_INT_A_FULL, 0);
+}
+
+int PPGFifoReader::readInterruptStatus() {
+    uint8_t status;
+    if (!readRegisters(PPG_FIFO_INT_STATUS_1, &status, 1)) {
+        errors++;
+        return -1;
+    }
+    return status;
+}
+
+bool PPGFifoReader::writeRegister(uint8_t reg, uint8_t value) {
+    wire.beginTransmission(address);
+    wire.write(reg);
+    wire.write(value);
+    return wire.endTransmission() == 0;
+}
+
+bool PPGFifoReader::readRegisters(uint8_t reg, uint8_t* data, uint8_t length) {
+    wire.beginTransmission(address);
+    wire.write(reg);
+    if (wire.endTransmission(false) != 0) {
+        return false;
+    }
+    if (wire.requestFrom((int)address, (int)length) != length) {
+        return false;
+    }
+    for (uint8_t i = 0; i < length; i++) {
+        data[i] = wire.read();
+    }
+    return true;
+}
+
+bool PPGFifoReader::updateRegister(uint8_t reg, uint8_t mask, uint8_t value) {
+    uint8_t current;
+    if (!readRegisters(reg, &current, 1)) {
+        return false;
+    }
+    return writeRegister(reg, (current & ~mask) | (value & mask));
+}
@@ -0,0 +1,183 @@
+/*
+ * ppgFifo.h
+ *
+ * Burst acquisition from the MAX30105 sample FIFO.
+ *
+ * OVERVIEW:
+ * particleSensor.getGreen() waits for one new sample per call, so the
+ * effective sample rate depends on how often loop() gets round to it, and
+ * samples are dropped or duplicated. The MAX30105 already buffers up to
+ * 32 samples in its FIFO; PPGFifoReader empties it in one pass:
+ * 1. Read FIFO_WR_PTR, OVF_COUNTER and FIFO_RD_PTR (one 3-byte read)
+ * 2. Number of samples = (WR_PTR - RD_PTR) mod 32 (32 if OVF > 0)
+ * 3. Read all of them from FIFO_DATA in as few I2C transfers as the Wire
+ *    buffer allows (PPG_FIFO_I2C_CHUNK bytes, whole samples only)
+ * The MCU therefore wakes once per block of samples instead of once per
+ * sample, and the sensor's own clock sets the sample timing.
+ *
+ * SAMPLE FORMAT:
+ * Each FIFO sample holds 3 bytes per active LED slot (MSB first, 18-bit).
+ * With ledMode 3 (Red + IR + Green) a sample is 9 bytes; only the
+ * configured channel slot is kept.
+ *
+ * BLOCKS:
+ * Each drain produces a PPGSampleBlock stamped with millis() at the time
+ * of the read (= time of its newest sample) and the running index of its
+ * first sample. Samples overwritten in the FIFO before they could be read
+ * are counted in the block and in lostSamples(), and advance the running
+ * index, so downstream code can detect and size gaps.
+ *
+ * POLL INTERVAL LIMITS:
+ * The FIFO lasts 32 samples (1.28 s at 25 Hz). Drain well within that:
+ * - A FIFO that is exactly full with nothing lost yet has WR_PTR == RD_PTR
+ *   and reads as empty (a hardware ambiguity)
+ * - OVF_COUNTER saturates at 31; a block reporting PPG_FIFO_OVF_MAX lost
+ *   samples may have lost more, so its running index is only a lower bound
+ *   (counted in saturatedCount())
+ *
+ * ALMOST-FULL INTERRUPT:
+ * Instead of polling on a timer, the sensor can pull its INT pin low once
+ * the FIFO holds a given number of samples (A_FULL, 17-31 samples). The
+ * handler drains the FIFO and hands the block on through a ring (e.g.
+ * PPGBlockRing, spscRing.h: single producer, single consumer, no locks;
+ * PPGManager drains in its acquisition task, see ppgTasks.h), so the core
+ * can sleep between blocks. A block read on A_FULL is stamped within the
+ * interrupt latency of its newest sample instead of up to one poll late.
+ * A_FULL is edge-like: it is raised when the FIFO reaches the threshold
+ * and released by reading INT_STATUS_1 (readInterruptStatus()). 32 is not
+ * allowed: a FIFO drained exactly full reads as empty (see below), and
+ * thresholds near 31 leave little time for interrupt latency.
+ *
+ * USAGE EXAMPLE:
+ *   PPGFifoReader fifo(Wire);
+ *   fifo.begin(3, PPG_FIFO_SLOT_GREEN);
+ *   fifo.clear();
+ *   PPGSampleBlock block;
+ *   if (fifo.drain(&block) > 0) { ...block.samples[0..count-1]... }
+ *
+ *   // Interrupt-driven: producer (INT handler) and consumer (loop)
+ *   fifo.enableAlmostFullInterrupt(17);
+ *   on INT:    fifo.readInterruptStatus(); fifo.drain(&block); ring.push(block);
+ *   in loop(): while (ring.pop(&block)) { ... }
+ *
+ */
+
+#ifndef PPG_FIFO_H
+#define PPG_FIFO_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "spscRing.h"
+
+// ============================================================================
+// MAX30105 FIFO REGISTERS
+// ============================================================================
+
+#define PPG_FIFO_I2C_ADDRESS 0x57   // MAX30105 7-bit address
+#define PPG_FIFO_INT_STATUS_1 0x00  // Interrupt status (cleared on read)
+#define PPG_FIFO_INT_ENABLE_1 0x02  // Interrupt enable
+#define PPG_FIFO_WR_PTR 0x04        // FIFO write pointer
+#define PPG_FIFO_OVF_COUNTER 0x05   // Samples lost to overflow (saturates at 31)
+#define PPG_FIFO_RD_PTR 0x06        // FIFO read pointer
+#define PPG_FIFO_DATA 0x07          // FIFO data (does not auto-increment)
+#define PPG_FIFO_CONFIG 0x08        // Averaging, rollover, almost-full threshold
+
+#define PPG_FIFO_INT_A_FULL 0x80    // A_FULL bit in INT_STATUS_1 / INT_ENABLE_1
+#define PPG_FIFO_A_FULL_MASK 0x0F   // FIFO_CONFIG bits 3:0 = free slots left at A_FULL
+#define PPG_FIFO_A_FULL_MIN 17      // Fewest samples A_FULL can be raised at (32 - 15)
+#define PPG_FIFO_A_FULL_MAX 31      // Most samples allowed (32 would read as empty)
+
+#define PPG_FIFO_DEPTH 32           // Samples held by the FIFO
+#define PPG_FIFO_OVF_MAX 31         // OVF_COUNTER saturation value
+#define PPG_FIFO_BYTES_PER_SLOT 3   // Bytes per LED slot per sample
+#define PPG_FIFO_MAX_SLOTS 4        // Multi-LED mode supports up to 4 slots
+#define PPG_FIFO_SAMPLE_MASK 0x3FFFF  // 18-bit ADC value
+
+// LED slot order in ledMode 3 (see SparkFun MAX30105::setup())
+#define PPG_FIFO_SLOT_RED 0
+#define PPG_FIFO_SLOT_IR 1
+#define PPG_FIFO_SLOT_GREEN 2
+
+// Largest read per I2C transfer (Wire buffer size)
+#ifndef PPG_FIFO_I2C_CHUNK
+#define PPG_FIFO_I2C_CHUNK 32
+#endif
+
+// ============================================================================
+// SAMPLE BLOCK
+// ============================================================================
+
+struct PPGSampleBlock {
+    uint32_t timestamp;         // millis() when the block was read (newest sample)
+    uint32_t firstSample;       // Running index of samples[0] since clear()
+    uint8_t count;              // Valid samples
+    uint8_t overflow;           // Samples lost immediately before samples[0] (see PPG_FIFO_OVF_MAX)
+    uint32_t samples[PPG_FIFO_DEPTH];  // Selected channel, oldest first
+};
+
+// ============================================================================
+// BLOCK RING
+// ============================================================================
+
+// Blocks buffered between the interrupt handler and the main loop
+#ifndef PPG_BLOCK_RING_SIZE
+#define PPG_BLOCK_RING_SIZE 4       // Power of two
+#endif
+
+// Handoff of sample blocks from the FIFO interrupt handler (producer) to
+// the main loop (consumer), see spscRing.h
+typedef SpscRing<PPGSampleBlock, PPG_BLOCK_RING_SIZE> PPGBlockRing;
+
+// ============================================================================
+// FIFO READER
+// ============================================================================
+
+class PPGFifoReader {
+public:
+    PPGFifoReader(TwoWire& wire, uint8_t address = PPG_FIFO_I2C_ADDRESS);
+
+    // Set the sample layout configured on the sensor
+    //   activeSlots: LED slots per sample (ledMode 3 = 3)
+    //   channelSlot: Slot to keep (e.g. PPG_FIFO_SLOT_GREEN)
+    void begin(uint8_t activeSlots, uint8_t channelSlot);
+
+    // Empty the sensor FIFO and restart the running sample index
+    void clear();
+
+    // Read every sample currently in the FIFO into block
+    // Returns: Samples read (0 if none), or -1 on an I2C error
+    int drain(PPGSampleBlock* block);
+
+    // Raise INT once the FIFO holds 'samples' (PPG_FIFO_A_FULL_MIN-PPG_FIFO_A_FULL_MAX)
+    bool enableAlmostFullInterrupt(uint8_t samples);
+    bool disableAlmostFullInterrupt();
+
+    // Read (and so clear) INT_STATUS_1, releasing the INT pin
+    // Returns: Status bits (PPG_FIFO_INT_A_FULL, ...), or -1 on an I2C error
+    int readInterruptStatus();
+
+    // Counters since clear()
+    uint32_t totalSamples() const { return sampleIndex - lost; }
+    uint32_t lostSamples() const { return lost; }
+    uint32_t drainCount() const { return drains; }
+    uint32_t errorCount() const { return errors; }
+    uint32_t saturatedCount() const { return saturations; }
+
+private:
+    TwoWire& wire;
+    uint8_t address;
+    uint8_t bytesPerSample;
+    uint8_t channelOffset;      // Byte offset of the kept slot within a sample
+
+    uint32_t sampleIndex;       // Running index of the next sample (incl. lost)
+    uint32_t lost;
+    uint32_t drains;
+    uint32_t errors;
+    uint32_t saturations;       // Drains where OVF_COUNTER had saturated
+
+    bool writeRegister(uint8_t reg, uint8_t value);
+    bool readRegisters(uint8_t reg, uint8_t* data, uint8_t length);
+    bool updateRegister(uint8_t reg, uint8_t mask, uint8_t value);
+};
+
+#endif
@@ -0,0 +1,392 @@
+/*
+ * ppgPacket.cpp
+ *
+ * Implementation of the versioned PPG packet format.
+ * See ppgPacket.h for the byte layout.
+ */
+
+#include "ppgPacket.h"
+
+// ============================================================================
+// BIT PACKING (MSB first)
+// ============================================================================
+
+// Write the low 'bits' bits of value at bit position pos; bytes are
+// cleared as they are first touched, so the buffer need not be zeroed
+static void putBits(uint8_t* data, uint32_t pos, uint32_t value, int bits) {
+    while (bits > 0) {
+        int used = pos & 7;
+        int space = 8 - used;
+        int take = bits < space ? bits : space;
+        uint8_t chunk = (value >> (bits - take)) & ((1u << take) - 1);
+        if (used == 0) {
+            data[pos >> 3] = 0;
+        }
+        data[pos >> 3] |= chunk << (space - take);
+        pos += take;
+        bits -= take;
+    }
+}
+
+static uint32_t getBits(const uint8_t* data, uint32_t pos, int bits) {
+    uint32_t value = 0;
+    while (bits > 0) {
+        int used = pos & 7;
+        int space = 8 - used;
+        int take = bits < space ? bits : space;
+        uint8_t chunk = (data[pos >> 3] >> (space - take)) & ((1u << take) - 1);
+        value = (value << take) | chunk;
+        pos += take;
+        bits -= take;
+    }
+    return value;
+}
+
+// ============================================================================
+// RICE CODING
+// ============================================================================
+
+// Longest code for one value (escape prefix + raw residual)
+#define RICE_MAX_CODE_BITS (PPG_RICE_ESCAPE + PPG_RICE_ESCAPE_BITS)
+
+static void riceStart(PPGRiceChannel* channel, int k0) {
+    channel->previous1 = 0;
+    channel->previous2 = 0;
+    channel->seen = 0;
+    channel->count = 1;
+    channel->sum = 1u << k0;
+}
+
+static int riceParameter(const PPGRiceChannel* channel) {
+    int k = 0;
+    while ((channel->count << k) < channel->sum && k < PPG_RICE_MAX_K) {
+        k++;
+    }
+    return k;
+}
+
+static int32_t ricePredict(const PPGRiceChannel* channel, int order) {
+    if (order == 2 && channel->seen >= 2) {
+        return 2 * channel->previous1 - channel->previous2;
+    }
+    return channel->previous1;
+}
+
+static void riceUpdate(PPGRiceChannel* channel, int32_t value, uint32_t residual) {
+    if (channel->seen > 0) {
+        channel->sum += residual;
+        if (++channel->count >= PPG_RICE_RESET) {
+            channel->sum >>= 1;
+            channel->count >>= 1;
+        }
+    }
+    channel->previous2 = channel->previous1;
+    channel->previous1 = value;
+    channel->seen++;
+}
+
+static uint32_t zigzag(int32_t residual) {
+    return ((uint32_t)residual << 1) ^ (uint32_t)(residual >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// ============================================================================
+// FORMAT HELPERS
+// ============================================================================
+
+int ppgChannelCount(uint8_t channelMask) {
+    int count = 0;
+    for (int bit = 0; bit < 3; bit++) {
+        count += (channelMask >> bit) & 1;
+    }
+    return count;
+}
+
+int ppgEncodingBits(uint8_t encoding) {
+    switch (encoding) {
+        case PPG_ENCODING_PACKED18: return 18;
+        case PPG_ENCODING_PACKED24: return 24;
+        default: return 0;
+    }
+}
+
+int ppgPacketCapacity(int packetSize, uint8_t encoding, int channelCount) {
+    int bits = ppgEncodingBits(encoding);
+    if (bits == 0 || channelCount < 1 || packetSize <= PPG_PACKET_HEADER_SIZE) {
+        return 0;
+    }
+    int frames = (packetSize - PPG_PACKET_HEADER_SIZE) * 8 / (bits * channelCount);
+    return frames < 255 ? frames : 255;  // Count is one byte
+}
+
+// ============================================================================
+// ENCODER
+// ============================================================================
+
+PPGPacketWriter::PPGPacketWriter(int riceOrder)
+    : buffer(NULL), encoding(PPG_ENCODING_PACKED18), bits(18), channels(1), maxFrames(0),
+      frames(0), valuesInFrame(0), bitPosition(0), capacityBits(0), maxValue(0),
+      riceOrder(riceOrder == 1 ? 1 : 2), nextK0(PPG_RICE_INITIAL_K) {
+}
+
+void PPGPacketWriter::begin(uint8_t* buffer, int capacity, uint8_t sequence, uint32_t timestamp,
+                            uint8_t channelMask, uint8_t encoding) {
+    this->buffer = buffer;
+    this->encoding = encoding;
+    bits = ppgEncodingBits(encoding);
+    channels = ppgChannelCount(channelMask);
+    frames = 0;
+    valuesInFrame = 0;
+    bitPosition = 0;
+    capacityBits = capacity > PPG_PACKET_HEADER_SIZE ? (capacity - PPG_PACKET_HEADER_SIZE) * 8 : 0;
+
+    buffer[0] = (PPG_PACKET_VERSION << 5) | ((encoding & 0x03) << 3) | (channelMask & 0x07);
+    buffer[1] = sequence;
+    buffer[2] = timestamp & 0xFF;
+    buffer[3] = (timestamp >> 8) & 0xFF;
+    buffer[4] = (timestamp >> 16) & 0xFF;
+    buffer[5] = 0;
+
+    if (encoding == PPG_ENCODING_RICE) {
+        maxFrames = 255;
+        maxValue = (1ul << PPG_VALUE_BITS) - 1;
+        if (capacityBits < PPG_RICE_K_BITS + 1) {
+            maxFrames = 0;
+            return;
+        }
+        // Preamble: k0 and predictor order; every channel starts from k0
+        putBits(buffer + PPG_PACKET_HEADER_SIZE, 0, nextK0, PPG_RICE_K_BITS);
+        putBits(buffer + PPG_PACKET_HEADER_SIZE, PPG_RICE_K_BITS, riceOrder - 1, 1);
+        bitPosition = PPG_RICE_K_BITS + 1;
+        for (int c = 0; c < 3; c++) {
+            riceStart(&rice[c], nextK0);
+        }
+    } else {
+        maxFrames = ppgPacketCapacity(capacity, encoding, channels);
+        maxValue = bits > 0 ? (1ul << bits) - 1 : 0;
+    }
+}
+
+bool PPGPacketWriter::full() const {
+    if (frames >= maxFrames) {
+        return true;
+    }
+    // Rice: not even a one-bit code per channel left
+    return encoding == PPG_ENCODING_RICE && capacityBits - bitPosition < (uint32_t)channels;
+}
+
+bool PPGPacketWriter::add(uint32_t value) {
+    if (frames >= maxFrames) {
+        return false;
+    }
+    if (value > maxValue) {
+        value = maxValue;
+    }
+    if (encoding == PPG_ENCODING_RICE) {
+        if (!addRice(value)) {
+            return false;
+        }
+    } else {
+        putBits(buffer + PPG_PACKET_HEADER_SIZE, bitPosition, value, bits);
+        bitPosition += bits;
+    }
+
+    if (++valuesInFrame == channels) {
+        valuesInFrame = 0;
+        frames++;
+        buffer[5] = frames;
+    }
+    return true;
+}
+
+int PPGPacketWriter::size() const {
+    return PPG_PACKET_HEADER_SIZE + (bitPosition + 7) / 8;
+}
+
+bool PPGPacketWriter::addRice(uint32_t value) {
+    PPGRiceChannel* channel = &rice[valuesInFrame];
+    int k = riceParameter(channel);
+    uint32_t residual = 0;
+    int length;
+    if (channel->seen == 0) {
+        length = PPG_VALUE_BITS;
+    } else {
+        residual = zigzag((int32_t)value - ricePredict(channel, riceOrder));
+        uint32_t quotient = residual >> k;
+        length = quotient < PPG_RICE_ESCAPE ? quotient + 1 + k : RICE_MAX_CODE_BITS;
+    }
+
+    // The rest of the frame must fit too, or the packet would end mid-frame
+    uint32_t reserve = (channels - 1 - valuesInFrame) * RICE_MAX_CODE_BITS;
+    if (bitPosition + length + reserve > capacityBits) {
+        return false;
+    }
+
+    uint8_t* payload = buffer + PPG_PACKET_HEADER_SIZE;
+    if (channel->seen == 0) {
+        putBits(payload, bitPosition, value, PPG_VALUE_BITS);
+    } else if (length == RICE_MAX_CODE_BITS) {
+        putBits(payload, bitPosition, (1u << PPG_RICE_ESCAPE) - 1, PPG_RICE_ESCAPE);
+        putBits(payload, bitPosition + PPG_RICE_ESCAPE, residual, PPG_RICE_ESCAPE_BITS);
+    } else {
+        uint32_t quotient = residual >> k;
+        putBits(payload, bitPosition, ((1u << quotient) - 1) << 1, quotient + 1);
+        putBits(payload, bitPosition + quotient + 1, residual & ((1u << k) - 1), k);
+    }
+    bitPosition += length;
+    riceUpdate(channel, (int32_t)value, residual);
+
+    // The next packet starts where this one's adaptation ended
+    if (valuesInFrame == 0) {
+        nextK0 = riceParameter(channel);
+    }
+    return true;
+}
+
+// ============================================================================
+// DECODER
+// ============================================================================
+
+// Rice payload of totalBits bits; returns count, or -1 if it runs short or
+// decodes to values outside 18 bits
+static int decodeRice(const uint8_t* payload, uint32_t totalBits, int channels, int count,
+                      uint32_t* values) {
+    if (totalBits < PPG_RICE_K_BITS + 1) {
+        return -1;
+    }
+    int k0 = getBits(payload, 0, PPG_RICE_K_BITS);
+    int order = getBits(payload, PPG_RICE_K_BITS, 1) + 1;
+    uint32_t pos = PPG_RICE_K_BITS + 1;
+
+    PPGRiceChannel rice[3];
+    for (int c = 0; c < channels; c++) {
+        riceStart(&rice[c], k0);
+    }
+
+    for (int i = 0; i < count; i++) {
+        PPGRiceChannel* channel = &rice[i % channels];
+        int32_t value;
+        uint32_t residual = 0;
+        if (channel->seen == 0) {
+            if (pos + PPG_VALUE_BITS > totalBits) {
+                return -1;
+            }
+            value = getBits(payload, pos, PPG_VALUE_BITS);
+            pos += PPG_VALUE_BITS;
+        } else {
+            int k = riceParameter(channel);
+            uint32_t quotient = 0;
+            while (quotient < PPG_RICE_ESCAPE) {
+                if (pos >= totalBits) {
+                    return -1;
+                }
+                if (getBits(payload, pos++, 1) == 0) {
+                    break;
+                }
+                quotient++;
+            }
+            int tailBits = quotient == PPG_RICE_ESCAPE ? PPG_RICE_ESCAPE_BITS : k;
+            if (pos + tailBits > totalBits) {
+                return -1;
+            }
+            uint32_t tail = getBits(payload, pos, tailBits);
+            pos += tailBits;
+            residual = quotient == PPG_RICE_ESCAPE ? tail : (quotient << k) | tail;
+            value = ricePredict(channel, order) + unzigzag(residual);
+            if (value < 0 || value >= (1 << PPG_VALUE_BITS)) {
+                return -1;
+            }
+        }
+        riceUpdate(channel, value, residual);
+        values[i] = value;
+    }
+    return count;
+}
+
+int decodePPGPacket(const uint8_t* data, int length, PPGPacketHeader* header,
+                    uint32_t* values, int maxValues) {
+    if (length < PPG_PACKET_HEADER_SIZE) {
+        return -1;
+    }
+    header->version = data[0] >> 5;
+    header->encoding = (data[0] >> 3) & 0x03;
+    header->channelMask = data[0] & 0x07;
+    header->sequence = data[1];
+    header->timestamp = data[2] | ((uint32_t)data[3] << 8) | ((uint32_t)data[4] << 16);
+    header->sampleCount = data[5];
+
+    int bits = ppgEncodingBits(header->encoding);
+    int channels = ppgChannelCount(header->channelMask);
+    if (header->version != PPG_PACKET_VERSION || channels == 0 ||
+        (bits == 0 && header->encoding != PPG_ENCODING_RICE)) {
+        return -1;
+    }
+
+    int count = header->sampleCount * channels;
+    if (header->encoding == PPG_ENCODING_RICE) {
+        return count > maxValues ? -1 : decodeRice(data + PPG_PACKET_HEADER_SIZE,
+                                                  (length - PPG_PACKET_HEADER_SIZE) * 8,
+                                                  channels, count, values);
+    }
+    if (count > maxValues ||
+        length < PPG_PACKET_HEADER_SIZE + (int)(((uint32_t)count * bits + 7) / 8)) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        values[i] = getBits(data + PPG_PACKET_HEADER_SIZE, (uint32_t)i * bits, bits);
+    }
+    return count;
+}
+
+// ============================================================================
+// STREAM CONTINUITY
+// ============================================================================
+
+PPGStreamTracker::PPGStreamTracker(uint32_t samplePeriodMs)
+    : samplePeriod(samplePeriodMs > 0 ? samplePeriodMs : 1) {
+    reset();
+}
+
+void PPGStreamTracker::reset() {
+    started = false;
+    expectedSequence = 0;
+    expectedTimestamp = 0;
+    packets = 0;
+    lost = 0;
+    missing = 0;
+}
+
+bool PPGStreamTracker::next(const PPGPacketHeader& header, PPGStreamGap* gap) {
+    gap->lostPackets = 0;
+    gap->missingSamples = 0;
+    gap->gapMs = 0;
+
+    if (started) {
+        gap->lostPackets = (uint8_t)(header.sequence - expectedSequence);
+
+        // Signed 24-bit distance; block timestamps jitter by less than half
+        // a sample period, so round to whole samples
+        int32_t delta = (int32_t)(((header.timestamp - expectedTimestamp) & PPG_TIMESTAMP_MASK) << 8) >> 8;
+        int32_t half = samplePeriod / 2;
+        gap->missingSamples = (delta >= 0 ? delta + half : delta - half) / (int32_t)samplePeriod;
+        gap->gapMs = gap->missingSamples != 0 ? delta : 0;
+    }
+    started = true;
+    expectedSequence = header.sequence + 1;
+    expectedTimestamp = (header.timestamp + header.sampleCount * samplePeriod) & PPG_TIMESTAMP_MASK;
+
+    packets++;
+    lost += gap->lostPackets;
+    if (gap->missingSamples > 0) {
+        missing += gap->missingSamples;
+    }
+    return gap->lostPackets > 0 || gap->missingSamples > 0;
+}
+
+uint32_t PPGStreamTracker::unwrapFrom(uint32_t timestamp24, uint32_t reference) {
+    int32_t delta = (int32_t)(((timestamp24 - reference) & PPG_TIMESTAMP_MASK) << 8) >> 8;
+    return reference + delta;
+}
@@ -0,0 +1,251 @@
+/*
+ * ppgPacket.h
+ *
+ * Versioned BLE packet format for raw PPG samples.
+ *
+ * OVERVIEW:
+ * The original stream sent each sample as int16 + 0xFE delimiter: the
+ * 18-bit reading wrapped, a third of the bytes were delimiters (which real
+ * data can contain) and nothing identified lost or reordered packets. Each
+ * packet now carries a small header and full-resolution samples, bit-packed
+ * so no bits are wasted:
+ *
+ *   byte 0    version (bits 7-5) | encoding (bits 4-3) | channel mask (bits 2-0)
+ *   byte 1    sequence number (increments per packet, wraps at 256)
+ *   byte 2-4  timestamp of the first sample (ms, 24-bit little-endian, wraps
+ *             every ~4.6 hours)
+ *   byte 5    sample count (frames; one value per channel in the mask)
+ *   byte 6-   samples, oldest first; within a frame, channels in mask bit
+ *             order (red, IR, green)
+ *
+ * ENCODINGS:
+ * - PPG_ENCODING_PACKED18: 18 bits per value, MSB first, packed across
+ *   byte boundaries; the last byte is zero-padded
+ * - PPG_ENCODING_PACKED24: 24 bits per value, big-endian (byte aligned, for
+ *   simple decoders)
+ * - PPG_ENCODING_RICE: lossless prediction + adaptive Rice coding (below)
+ * Value 3 is reserved; decoders must reject packets with an unknown
+ * version or encoding.
+ *
+ * RICE ENCODING:
+ * Consecutive PPG samples differ by a few hundred counts at most, so
+ * coding the prediction error takes far fewer than 18 bits. Bitstream
+ * after the header (MSB first):
+ *   4 bits   k0: initial Rice parameter
+ *   1 bit    predictor: 0 = first order (x[n-1]), 1 = second order
+ *            (2 x[n-1] - x[n-2])
+ *   per channel, first frame: the value in 18 bits
+ *   then per value: residual r = x - prediction (the first residual of a
+ *   channel always uses first order), mapped to u = zigzag(r) (0, -1, 1,
+ *   -2, ... -> 0, 1, 2, 3, ...) and Rice coded with parameter k:
+ *     q = u >> k as q one-bits and a zero-bit, then the low k bits of u;
+ *     if q >= PPG_RICE_ESCAPE: PPG_RICE_ESCAPE one-bits, then u in
+ *     PPG_RICE_ESCAPE_BITS bits
+ * k adapts per channel as in LOCO-I: with A = k0-seeded sum of u and N the
+ * count, k is the smallest value with N << k >= A; A and N are halved
+ * every PPG_RICE_RESET values. Predictor and k restart in every packet
+ * (k0 carries the previous packet's final k), so each notification
+ * decodes on its own and a lost one does not affect the next. Packets
+ * hold as many samples as fit, so their sample count varies.
+ *
+ * CAPACITY:
+ * Fixed encodings: samples per packet = (payload - 6) * 8 / 18 for one
+ * channel: 6 in the default 20-byte notification (previously 6 truncated
+ * samples in 18 bytes), 105 in a 244-byte one. The Rice encoding takes
+ * about 11-12 bits per sample on synthetic PPG at 25 Hz: ~8-9 samples in
+ * 20 bytes (the raw first sample dominates) and ~160-175 in 244 bytes,
+ * 1.4-1.7x packed18 (see the host bench).
+ *
+ * LOSS DETECTION AND TIMING:
+ * The sequence number counts packets per recording (restarting at 0), so
+ * a receiver sees every lost notification as a skipped number. The
+ * timestamp is the device's millis() of the first sample (low 24 bits);
+ * later samples follow at the sample period. PPGStreamTracker checks both
+ * for each packet: lost packets from the sequence, missing samples
+ * (lost packets, or samples the sensor FIFO overwrote) from the distance
+ * between where the previous packet's samples end and this packet starts.
+ * Receivers map device time to wall-clock time with the time-sync
+ * characteristic (BluetoothManager.h) and unwrapFrom() below.
+ *
+ * USAGE EXAMPLE:
+ *   PPGPacketWriter packet;
+ *   packet.begin(buffer, sizeof(buffer), sequence++, timestampMs, PPG_CHANNEL_GREEN);
+ *   while (!packet.full() && packet.add(next sample)) ...
+ *   notify(buffer, packet.size());   // A sample add() refused starts the next packet
+ *
+ *   PPGPacketHeader header;
+ *   uint32_t samples[PPG_PACKET_MAX_VALUES];
+ *   int count = decodePPGPacket(buffer, length, &header, samples, PPG_PACKET_MAX_VALUES);
+ *   PPGStreamGap gap;
+ *   if (tracker.next(header, &gap)) { ...gap.missingSamples before this packet... }
+ *
+ */
+
+#ifndef PPG_PACKET_H
+#define PPG_PACKET_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// FORMAT CONSTANTS
+// ============================================================================
+
+#define PPG_PACKET_VERSION 1
+#define PPG_PACKET_HEADER_SIZE 6
+
+#define PPG_ENCODING_PACKED18 0
+#define PPG_ENCODING_RICE 1
+#define PPG_ENCODING_PACKED24 2
+
+// Rice encoding parameters (part of the format)
+#define PPG_RICE_K_BITS 4           // Bits for k0
+#define PPG_RICE_MAX_K 15
+#define PPG_RICE_ESCAPE 16          // Unary prefix that marks an escaped value
+#define PPG_RICE_ESCAPE_BITS 21     // Escaped zigzag residual (any 18-bit 2nd-order residual)
+#define PPG_RICE_RESET 16           // Adaptation window (values)
+#define PPG_RICE_INITIAL_K 6        // k0 of the first packet
+#define PPG_VALUE_BITS 18           // Raw value width in the Rice encoding
+
+// Channel mask bits (byte 0, bits 2-0)
+#define PPG_CHANNEL_RED 0x01
+#define PPG_CHANNEL_IR 0x02
+#define PPG_CHANNEL_GREEN 0x04
+
+#define PPG_PACKET_MAX_SIZE 244     // Largest BLE notification payload (ATT MTU 247)
+#define PPG_PACKET_MAX_VALUES (255 * 3)  // 255 frames (count byte) of up to 3 channels
+
+// Decoded header
+struct PPGPacketHeader {
+    uint8_t version;
+    uint8_t encoding;
+    uint8_t channelMask;
+    uint8_t sequence;
+    uint32_t timestamp;             // First sample (ms, 24-bit)
+    uint8_t sampleCount;            // Frames
+};
+
+// Number of channels (set bits) in a mask
+int ppgChannelCount(uint8_t channelMask);
+
+// Bits per value for a fixed-width encoding (0 if unknown or variable)
+int ppgEncodingBits(uint8_t encoding);
+
+// Frames of channelCount values that fit in a packet of packetSize bytes
+// (fixed-width encodings; the Rice encoding's capacity depends on the data)
+int ppgPacketCapacity(int packetSize, uint8_t encoding, int channelCount);
+
+// Per-channel Rice coder state (shared by encoder and decoder)
+struct PPGRiceChannel {
+    int32_t previous1;              // x[n-1]
+    int32_t previous2;              // x[n-2]
+    int seen;                       // Values coded in this packet
+    uint32_t sum;                   // A: running sum of zigzag residuals
+    uint32_t count;                 // N
+};
+
+// ============================================================================
+// ENCODER
+// ============================================================================
+
+class PPGPacketWriter {
+public:
+    // riceOrder: predictor order (1 or 2) used by the Rice encoding
+    PPGPacketWriter(int riceOrder = 2);
+
+    // Start a packet in buffer (capacity bytes, at most 255 frames)
+    void begin(uint8_t* buffer, int capacity, uint8_t sequence, uint32_t timestamp,
+               uint8_t channelMask, uint8_t encoding = PPG_ENCODING_PACKED18);
+
+    // Append one value (frames are complete after ppgChannelCount() values)
+    // Values are clamped to the encoding's range. Returns false if the
+    // value does not fit; the packet is unchanged and can be sent as is.
+    bool add(uint32_t value);
+
+    // True when no further frame can fit
+    bool full() const;
+
+    // Restart Rice adaptation at PPG_RICE_INITIAL_K (e.g. per recording)
+    void reset() { nextK0 = PPG_RICE_INITIAL_K; }
+
+    // Frames written so far
+    int sampleCount() const { return frames; }
+
+    // Bytes to transmit (header + packed samples)
+    int size() const;
+
+private:
+    uint8_t* buffer;
+    uint8_t encoding;
+    int bits;                       // Bits per value (fixed-width encodings)
+    int channels;
+    int maxFrames;
+    int frames;
+    int valuesInFrame;
+    uint32_t bitPosition;           // Next free bit after the header
+    uint32_t capacityBits;          // Payload bits available after the header
+    uint32_t maxValue;
+
+    // Rice encoding
+    int riceOrder;
+    int nextK0;                     // k0 of the next packet
+    PPGRiceChannel rice[3];
+
+    bool addRice(uint32_t value);
+};
+
+// ============================================================================
+// DECODER
+// ============================================================================
+
+// Parse a packet into header and values (frames * channels, interleaved)
+// Returns: Values decoded, or -1 if the packet is malformed, of another
+// version/encoding, or needs more than maxValues
+int decodePPGPacket(const uint8_t* data, int length, PPGPacketHeader* header,
+                    uint32_t* values, int maxValues);
+
+// ============================================================================
+// STREAM CONTINUITY
+// ============================================================================
+
+#define PPG_TIMESTAMP_MASK 0xFFFFFF  // Packet timestamps are 24-bit
+
+// Discontinuity found before a packet
+struct PPGStreamGap {
+    uint32_t lostPackets;           // Sequence numbers skipped
+    int32_t missingSamples;         // Sample periods missing (negative: overlap)
+    int32_t gapMs;                  // Time missing (negative: overlap)
+};
+
+// Follows consecutive packets of one recording on the receiving side
+class PPGStreamTracker {
+public:
+    // samplePeriodMs: time between samples (40 at 25 Hz)
+    PPGStreamTracker(uint32_t samplePeriodMs);
+
+    // Start of a recording (sequence numbers restart)
+    void reset();
+
+    // Account for a decoded packet, in arrival order
+    // Returns: true if packets or samples are missing before it (gap filled in)
+    bool next(const PPGPacketHeader& header, PPGStreamGap* gap);
+
+    // Totals since reset()
+    uint32_t packetCount() const { return packets; }
+    uint32_t lostPackets() const { return lost; }
+    uint32_t missingSamples() const { return missing; }
+
+    // Full 32-bit device time from a 24-bit packet timestamp, taking the
+    // value nearest to a full reference time (e.g. from the time sync)
+    static uint32_t unwrapFrom(uint32_t timestamp24, uint32_t reference);
+
+private:
+    uint32_t samplePeriod;
+    bool started;
+    uint8_t expectedSequence;
+    uint32_t expectedTimestamp;     // Where the next packet's first sample belongs (24-bit)
+    uint32_t packets;
+    uint32_t lost;
+    uint32_t missing;
+};
+
+#endif
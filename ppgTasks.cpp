@@ -0,0 +1,247 @@
+/*
+ * ppgTasks.cpp
+ *
+ * Stage tasks and queues for real-time PPG recording (see ppgTasks.h).
+ */
+
+#include "ppgTasks.h"
+
+// Pending recording control (PPGTaskPipeline::requests)
+#define PPG_TASK_REQUEST_STOP 0x01
+#define PPG_TASK_REQUEST_START 0x02
+
+PPGTaskPipeline::PPGTaskPipeline(PPGTaskStages& stages)
+    : stages(stages), pollInterval(PPG_TASK_NO_POLL), acquiredDropped(0), processedDropped(0),
+      acquiredBlocks(0), stopsQueued(0), requests(0), acquireDue(false), acquiring(false), lastPoll(0),
+      serviceDue(false), acquisitionTask(NULL), processingTask(NULL), txTask(NULL),
+      stopping(false) {
+}
+
+// ============================================================================
+// TASKS
+// ============================================================================
+
+bool PPGTaskPipeline::startTasks() {
+    if (hasTasks()) {
+        return true;
+    }
+    // Consumers first, so each task's downstream handle exists when it runs
+    stopping = false;
+    if (xTaskCreate(txLoop, "ppgTx", PPG_TX_STACK, this, PPG_TX_PRIORITY, &txTask) != pdPASS ||
+        xTaskCreate(processingLoop, "ppgProc", PPG_PROCESSING_STACK, this, PPG_PROCESSING_PRIORITY,
+                    &processingTask) != pdPASS ||
+        xTaskCreate(acquisitionLoop, "ppgAcq", PPG_ACQUISITION_STACK, this, PPG_ACQUISITION_PRIORITY,
+                    &acquisitionTask) != pdPASS) {
+        stopTasks();
+        acquisitionTask = NULL;
+        processingTask = NULL;
+        txTask = NULL;
+        return false;
+    }
+    return true;
+}
+
+void PPGTaskPipeline::stopTasks() {
+    stopping = true;
+    notify(acquisitionTask);
+    notify(processingTask);
+    notify(txTask);
+}
+
+void PPGTaskPipeline::notify(TaskHandle_t task) {
+    if (task != NULL) {
+        xTaskNotifyGive(task);
+    }
+}
+
+void PPGTaskPipeline::acquisitionLoop(void* context) {
+    PPGTaskPipeline* pipeline = static_cast<PPGTaskPipeline*>(context);
+    while (!pipeline->stopping) {
+        // Sleep until the FIFO interrupt, a request or the next poll
+        TickType_t wait = portMAX_DELAY;
+        if (pipeline->acquiring && pipeline->pollInterval != PPG_TASK_NO_POLL) {
+            uint32_t elapsed = millis() - pipeline->lastPoll;
+            wait = pdMS_TO_TICKS(elapsed < pipeline->pollInterval ? pipeline->pollInterval - elapsed : 0);
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+        pipeline->runAcquisition(millis());
+    }
+    vTaskDelete(NULL);
+}
+
+void PPGTaskPipeline::processingLoop(void* context) {
+    PPGTaskPipeline* pipeline = static_cast<PPGTaskPipeline*>(context);
+    while (!pipeline->stopping) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        pipeline->runProcessing();
+    }
+    vTaskDelete(NULL);
+}
+
+void PPGTaskPipeline::txLoop(void* context) {
+    PPGTaskPipeline* pipeline = static_cast<PPGTaskPipeline*>(context);
+    while (!pipeline->stopping) {
+        ulTaskNotifyTake(pdTRUE, pipeline->serviceDue ? pdMS_TO_TICKS(PPG_TX_SERVICE_MS) : portMAX_DELAY);
+        pipeline->runTransmit(millis());
+    }
+    vTaskDelete(NULL);
+}
+
+// ============================================================================
+// CONTROL
+// ============================================================================
+
+void PPGTaskPipeline::start() {
+    requests.fetch_or(PPG_TASK_REQUEST_START);
+    notify(acquisitionTask);
+}
+
+void PPGTaskPipeline::stop() {
+    // Also cancels a start that acquisition has not applied yet
+    requests.store(PPG_TASK_REQUEST_STOP);
+    notify(acquisitionTask);
+}
+
+void PPGTaskPipeline::wakeFromISR() {
+    acquireDue = true;
+    if (acquisitionTask != NULL) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(acquisitionTask, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+void PPGTaskPipeline::wakeTransmit() {
+    notify(txTask);
+}
+
+void PPGTaskPipeline::runInline(uint32_t now) {
+    runAcquisition(now);
+    runProcessing();
+    runTransmit(now);
+}
+
+// ============================================================================
+// STAGES
+// ============================================================================
+
+void PPGTaskPipeline::applyRequest(uint8_t event) {
+    PPGTaskItem* item;
+    acquired.prepare(&item);  // Room checked by runAcquisition()
+    item->event = event;
+    item->skip = 0;
+    item->reportLength = 0;
+    item->block.count = 0;
+    stages.acquire(item);
+    acquired.commit(1);
+    acquiring = event == PPG_TASK_START;
+}
+
+void PPGTaskPipeline::runAcquisition(uint32_t now) {
+    // Recording control first, so no block crosses a recording boundary.
+    // A request is applied whole (stop + start takes two slots) or waits.
+    if (requests.load() != 0 && acquired.freeSpace() >= 2) {
+        uint8_t pending = requests.exchange(0);
+        if (acquiring) {
+            applyRequest(PPG_TASK_STOP);
+        }
+        if (pending & PPG_TASK_REQUEST_START) {
+            applyRequest(PPG_TASK_START);
+            lastPoll = now;
+            acquireDue = false;
+        }
+        notify(processingTask);
+    }
+    if (!acquiring) {
+        return;
+    }
+
+    bool due = acquireDue.exchange(false);
+    if (pollInterval != PPG_TASK_NO_POLL && now - lastPoll >= pollInterval) {
+        lastPoll = now;
+        due = true;
+    }
+    if (!due) {
+        return;
+    }
+
+    // Read straight into the queue; with no room, read anyway (the sensor
+    // FIFO must be emptied) and drop the block
+    PPGTaskItem* slot;
+    PPGTaskItem scratch;
+    bool room = acquired.prepare(&slot) > 0;
+    PPGTaskItem* item = room ? slot : &scratch;
+    item->event = PPG_TASK_BLOCK;
+    item->skip = 0;
+    item->reportLength = 0;
+    if (!stages.acquire(item)) {
+        return;
+    }
+    acquiredBlocks++;
+    if (room) {
+        acquired.commit(1);
+        notify(processingTask);
+    } else {
+        acquiredDropped++;
+    }
+}
+
+void PPGTaskPipeline::runProcessing() {
+    bool queued = false;
+    const PPGTaskItem* head;
+    while (acquired.peek(&head) > 0) {
+        PPGTaskItem* slot;
+        PPGTaskItem scratch;
+        bool room = processed.prepare(&slot) > 0;
+        if (!room && head->event != PPG_TASK_BLOCK) {
+            break;  // Recording markers wait for the BLE stage
+        }
+        PPGTaskItem* item = room ? slot : &scratch;
+        *item = *head;
+        acquired.consume(1);
+
+        // Blocks the BLE stage has no room for are still processed (live
+        // heart rate keeps running), then dropped
+        stages.process(item);
+        if (room) {
+            if (item->event == PPG_TASK_STOP) {
+                stopsQueued++;
+            }
+            processed.commit(1);
+            queued = true;
+        } else {
+            processedDropped++;
+        }
+    }
+    if (queued) {
+        notify(txTask);
+    }
+    if (requests.load() != 0) {
+        notify(acquisitionTask);  // Room for a request that was waiting
+    }
+}
+
+void PPGTaskPipeline::runTransmit(uint32_t now) {
+    bool taken = false;
+    const PPGTaskItem* head;
+    while (processed.peek(&head) > 0) {
+        if (stages.transmit(*head)) {
+            if (head->event == PPG_TASK_STOP) {
+                stopsQueued--;
+            }
+        } else if (head->event == PPG_TASK_BLOCK && stopsQueued.load() > 0) {
+            // The recording has ended: let its stop through (see QUEUES)
+            processedDropped++;
+        } else {
+            break;
+        }
+        processed.consume(1);
+        taken = true;
+    }
+    if (taken && !acquired.empty()) {
+        notify(processingTask);  // A marker may be waiting for room
+    }
+    // Keep waking while a refused item waits or the stage has timed work
+    bool busy = stages.service(now);
+    serviceDue = busy || !processed.empty();
+}
@@ -0,0 +1,202 @@
+/*
+ * ppgTasks.h
+ *
+ * Acquisition, processing and BLE stages of real-time PPG recording, run
+ * as three FreeRTOS tasks connected by bounded queues.
+ *
+ * OVERVIEW:
+ * In a single loop task, a slow BLE call or a burst of on-device
+ * processing delays the next FIFO drain, and the sensor FIFO only lasts
+ * 1.28 s. PPGTaskPipeline splits recording into stages that each run in
+ * their own task, in priority order:
+ * 1. Acquisition (TASK_PRIO_HIGH): reads sample blocks from the sensor
+ *    when its FIFO interrupt arrives (wakeFromISR()) or every poll interval
+ * 2. Processing (TASK_PRIO_NORMAL): live heart rate, SQI, HRV on each block
+ * 3. BLE (TASK_PRIO_LOW, as loop()): packetizes and notifies, and services
+ *    the batch hold time and the BLE transmit queue (its only user);
+ *    processing's reports (HRV metrics) ride on their block's item and
+ *    are notified from here too
+ * The stages themselves are a PPGTaskStages implementation (PPGManager);
+ * this file only moves items between them and decides when each runs.
+ *
+ * QUEUES:
+ * Two SpscRings of PPGTaskItems (acquisition -> processing, processing ->
+ * BLE). A stage never waits for the next one: when a queue is full, the
+ * block is dropped and counted (acquiredOverruns(), processedOverruns()),
+ * so a stalled consumer costs samples downstream, not sampling itself.
+ * Dropped blocks show up as a jump in the next block's firstSample and in
+ * timestamps, as a FIFO overflow does. The BLE stage may refuse an item
+ * (transmit() false: BLE queue full); it stays at the head of its queue
+ * and is retried, until a stop is queued behind it: that recording has
+ * ended, so the refused blocks ahead of the stop are dropped (counted in
+ * processedOverruns()) rather than hold the stop back, e.g. after the
+ * central that could not keep up disconnected.
+ *
+ * RECORDING CONTROL:
+ * start() and stop() may be called from any task. Acquisition applies
+ * them in order and sends PPG_TASK_START / PPG_TASK_STOP items down the
+ * queues, so every stage resets or flushes in its own task, between the
+ * last block of one recording and the first of the next. These items are
+ * never dropped: a stage holds one back until the next queue has room.
+ *
+ * WITHOUT TASKS:
+ * If startTasks() is not called or fails (heap), runInline() runs the
+ * three stages in turn from the caller, e.g. once per loop() pass. The
+ * host simulations run this way, on their virtual clock.
+ *
+ * USAGE EXAMPLE:
+ *   PPGTaskPipeline pipeline(stages);           // stages: a PPGTaskStages
+ *   pipeline.setPollInterval(PPG_TASK_NO_POLL); // Interrupt-driven
+ *   pipeline.startTasks();
+ *   pipeline.start();                           // Recording starts
+ *   on INT:    pipeline.wakeFromISR();
+ *   pipeline.stop();
+ *
+ */
+
+#ifndef PPG_TASKS_H
+#define PPG_TASKS_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "spscRing.h"
+#include "ppgFifo.h"
+
+// ============================================================================
+// CONFIGURATION
+// ============================================================================
+
+#define PPG_ACQUIRED_QUEUE_SIZE 4   // Blocks from acquisition to processing (power of two)
+#define PPG_PROCESSED_QUEUE_SIZE 8  // Blocks from processing to BLE (power of two) - ~5 s at A_FULL 17
+#define PPG_TX_SERVICE_MS 100       // BLE stage period while service() has work (hold time, retries)
+#define PPG_TASK_REPORT_SIZE 14     // Largest processing report carried to the BLE stage (HRV metrics)
+
+#define PPG_ACQUISITION_PRIORITY TASK_PRIO_HIGH
+#define PPG_PROCESSING_PRIORITY TASK_PRIO_NORMAL
+#define PPG_TX_PRIORITY TASK_PRIO_LOW
+#define PPG_ACQUISITION_STACK 512   // Words
+#define PPG_PROCESSING_STACK 1024   // Words (float HRV metrics)
+#define PPG_TX_STACK 768            // Words (packet encoding)
+
+#define PPG_TASK_NO_POLL 0xFFFFFFFFu  // setPollInterval(): interrupt-driven only
+
+// ============================================================================
+// ITEMS AND STAGES
+// ============================================================================
+
+enum PPGTaskEvent {
+    PPG_TASK_BLOCK,                 // Samples in block
+    PPG_TASK_START,                 // Recording starts (block unused)
+    PPG_TASK_STOP                   // Recording stops (block.firstSample: index after the last sample read)
+};
+
+struct PPGTaskItem {
+    uint8_t event;                  // PPGTaskEvent
+    uint32_t skip;                  // Bit i set: samples[i] is not transmitted (SQI gate)
+    uint8_t reportLength;           // Bytes in report, set by processing (0: none)
+    uint8_t report[PPG_TASK_REPORT_SIZE];  // Sent by the BLE stage with the block
+    PPGSampleBlock block;
+};
+
+static_assert(PPG_FIFO_DEPTH <= 32, "PPGTaskItem::skip has one bit per block sample");
+
+// The work done by each stage, called from that stage's task only
+class PPGTaskStages {
+public:
+    virtual ~PPGTaskStages() {}
+
+    // Acquisition: START / STOP power the sensor up or down; BLOCK reads
+    // the samples available into item->block
+    // Returns: false if there was nothing to read (nothing is queued)
+    virtual bool acquire(PPGTaskItem* item) = 0;
+
+    // Processing: every item, in order; may set item->skip
+    virtual void process(PPGTaskItem* item) = 0;
+
+    // BLE: every item, in order
+    // Returns: false if it cannot be taken now (kept and retried)
+    virtual bool transmit(const PPGTaskItem& item) = 0;
+
+    // BLE: periodic work (batch hold time, refused packets, BLE queue)
+    // Returns: true while it should keep being called every PPG_TX_SERVICE_MS
+    virtual bool service(uint32_t now) = 0;
+};
+
+// ============================================================================
+// PIPELINE
+// ============================================================================
+
+class PPGTaskPipeline {
+public:
+    PPGTaskPipeline(PPGTaskStages& stages);
+
+    // How acquisition finds blocks while recording: every ms milliseconds,
+    // or PPG_TASK_NO_POLL to wait for wakeFromISR() (set before startTasks())
+    void setPollInterval(uint32_t ms) { pollInterval = ms; }
+
+    // Create the stage tasks (once)
+    // Returns: false if they could not be created (use runInline())
+    bool startTasks();
+    bool hasTasks() const { return acquisitionTask != NULL; }
+
+    // Make every task return after its current pass (host tests; on the
+    // device the tasks run until reset)
+    void stopTasks();
+
+    // Begin / end a recording (any task, see RECORDING CONTROL)
+    void start();
+    void stop();
+
+    // A block is ready in the sensor (interrupt handler)
+    void wakeFromISR();
+
+    // Let the BLE stage retry (e.g. notifications were sent)
+    void wakeTransmit();
+
+    // Without tasks: run acquisition, processing and BLE in turn
+    void runInline(uint32_t now);
+
+    // Counters since construction
+    uint32_t acquiredOverruns() const { return acquiredDropped.load(); }    // Processing fell behind
+    uint32_t processedOverruns() const { return processedDropped.load(); }  // BLE fell behind
+    uint32_t blocksAcquired() const { return acquiredBlocks.load(); }
+
+private:
+    PPGTaskStages& stages;
+    uint32_t pollInterval;
+
+    SpscRing<PPGTaskItem, PPG_ACQUIRED_QUEUE_SIZE> acquired;
+    SpscRing<PPGTaskItem, PPG_PROCESSED_QUEUE_SIZE> processed;
+    std::atomic<uint32_t> acquiredDropped;
+    std::atomic<uint32_t> processedDropped;
+    std::atomic<uint32_t> acquiredBlocks;
+    std::atomic<uint8_t> stopsQueued;   // PPG_TASK_STOP items in processed
+
+    // Recording control, applied by acquisition (PPG_TASK_REQUEST_* bits)
+    std::atomic<uint8_t> requests;
+    std::atomic<bool> acquireDue;   // Set by wakeFromISR()
+    bool acquiring;                 // Acquisition task only
+    uint32_t lastPoll;              // Acquisition task only
+    bool serviceDue;                // BLE task only
+
+    TaskHandle_t acquisitionTask;
+    TaskHandle_t processingTask;
+    TaskHandle_t txTask;
+    std::atomic<bool> stopping;
+
+    // One pass of each stage
+    void runAcquisition(uint32_t now);
+    void runProcessing();
+    void runTransmit(uint32_t now);
+
+    // Queue a recording marker and run its acquisition part
+    void applyRequest(uint8_t event);
+
+    void notify(TaskHandle_t task);
+
+    static void acquisitionLoop(void* context);
+    static void processingLoop(void* context);
+    static void txLoop(void* context);
+};
+
+#endif
@@ -13,9 +13,25 @@
  */
 
 #include "processing.h"
+#include "streamingFilters.h"
+#include "processingFixed.h"
+#include "runningStats.h"
 #include <stdlib.h>  // malloc, free, realloc
 #include <math.h>    // sqrt, pow, ceil
 
+// ============================================================================
+// INTERNAL HELPERS
+// ============================================================================
+
+// Upper bound on the number of events (peaks/valleys) in 'size' samples
+// when consecutive events must be more than 'minSpacing' samples apart
+static int maxEventCount(int size, int minSpacing) {
+    if (size <= 0) {
+        return 0;
+    }
+    return (size - 1) / (minSpacing + 1) + 1;
+}
+
 // ============================================================================
 // BANDPASS FILTER
 // ============================================================================
@@ -23,25 +39,13 @@
  * Second-order IIR bandpass filter designed for heart rate frequencies.
  * Removes DC offset and high-frequency noise while preserving 0.5-4 Hz band.
  * 
- * Filter coefficients (b, a) were designed using digital filter design tools
- * for optimal heart rate signal extraction from PPG.
+ * Batch wrapper around the streaming Biquad (see streamingFilters.h) using
+ * PPG_BANDPASS_COEFFS. The first two output samples are seeded from the
+ * raw input, exactly as a freshly reset Biquad does.
  */
 void bandpassFilter(long* input, float* output, int size) {
-    // Filter coefficients (numerator and denominator)
-    float b[] = {0.292893, 0, -0.292893};  // Numerator coefficients
-    float a[] = {1, -1.16574, 0.292893};   // Denominator coefficients
-    
-    for (int i = 0; i < size; i++) {
-        if (i < 2) {
-            // Initialize first two samples (insufficient history for filtering)
-            output[i] = input[i];
-        } else {
-            // Apply IIR filter equation: y[n] = b[0]*x[n] + b[1]*x[n-1] + b[2]*x[n-2] 
-            //                                   - a[1]*y[n-1] - a[2]*y[n-2]
-            output[i] = b[0] * input[i] + b[1] * input[i - 1] + b[2] * input[i - 2] -
-                        a[1] * output[i - 1] - a[2] * output[i - 2];
-        }
-    }
+    Biquad bandpass(PPG_BANDPASS_COEFFS);
+    bandpass.processBlock(input, output, size);
 }
 
 // ============================================================================
@@ -50,20 +54,26 @@ void bandpassFilter(long* input, float* output, int size) {
 /*
  * Simple moving average filter for signal smoothing.
  * Each output sample is the average of the current and previous windowSize samples.
+ * 
+ * Uses a running sum, so cost is O(size) regardless of window length.
+ * For per-sample streaming use MovingAverage / MovingAverageInt from
+ * streamingFilters.h instead.
+ * 
+ * Note: input and output must be different buffers (the sample leaving the
+ * window is read back from input).
  */
 void movingAverageFilter(float* input, float* output, int size, int windowSize) {
+    float sum = 0;
+    
     for (int i = 0; i < size; i++) {
-        float sum = 0;
-        int count = 0;
-        
-        // Average current and previous samples within window
-        for (int j = 0; j < windowSize; j++) {
-            if ((i - j) >= 0) {
-                sum += input[i - j];
-                count++;
-            }
+        // Add newest sample, drop the one that just left the window
+        sum += input[i];
+        if (i >= windowSize) {
+            sum -= input[i - windowSize];
         }
         
+        // Average over samples available so far (fewer than windowSize at start)
+        int count = (i < windowSize) ? (i + 1) : windowSize;
         output[i] = sum / count;
     }
 }
@@ -76,6 +86,7 @@ void movingAverageFilter(float* input, float* output, int size, int windowSize)
  * or invalid readings. Returns compacted array.
  * 
  * WARNING: Caller must free() the returned pointer.
+ * Returns NULL (newSize = 0) if the allocation fails.
  */
 float* removeZero(long* input, int size, int* newSize) {
     // First pass: Count non-zero elements
@@ -89,8 +100,10 @@ float* removeZero(long* input, int size, int* newSize) {
     // Allocate output array
     float* output = (float*)malloc(count * sizeof(float));
     if (output == NULL) {
+        // Report failure to caller instead of halting the device
         Serial.println("ERROR: Memory allocation failed in removeZero()");
-        while (1);  // Halt - critical error
+        *newSize = 0;
+        return NULL;
     }
     
     // Second pass: Copy non-zero values
@@ -105,23 +118,6 @@ float* removeZero(long* input, int size, int* newSize) {
     return output;
 }
 
-// ============================================================================
-// SIGNAL QUALITY CHECK (PLACEHOLDER)
-// ============================================================================
-/*
- * Placeholder for signal quality assessment.
- * TODO: Implement quality metrics based on:
- * - Signal amplitude variance
- * - Presence of clear peaks
- * - RR interval consistency
- * - Motion artifact detection
- */
-int signalQual(float* signal, int fs) {
-    // Currently returns 1 (good quality) for all signals
-    // Implement proper quality assessment as needed
-    return 1;
-}
-
 // ============================================================================
 // NOISE ELIMINATION (SIMPLIFIED VERSION)
 // ============================================================================
@@ -147,9 +143,9 @@ int* valleyDetection(float* dataset, int size, int fs, float min_distance, int*
     // Calculate minimum sample distance between valleys
     int TH_elapsed = (int)ceil(min_distance * fs);
     
-    // Allocate memory for potential valleys (worst case: all samples)
-    int* valleyList = (int*)malloc(size * sizeof(int));
-    int nvalleys = 0;
+    // Allocate for the most valleys that can be min_distance apart
+    int* valleyArray = (int*)malloc(maxEventCount(size, TH_elapsed) * sizeof(int));
+    int valid_valleys = 0;
     
     // Calculate signal mean (threshold for valley detection)
     float localaverage = 0;
@@ -158,47 +154,26 @@ int* valleyDetection(float* dataset, int size, int fs, float min_distance, int*
     }
     localaverage /= size;
     
-    // Temporary window to track consecutive below-average samples
-    int* window = (int*)malloc(size * sizeof(int));
-    int window_size = 0;
-    
     // Scan signal for valleys (regions below average)
+    // Only the minimum of the current below-average run is tracked, so no
+    // scratch buffers are needed
+    int run_min = -1;  // Index of minimum in current run (-1 = no valley in progress)
+    
     for (int i = 0; i < size; i++) {
-        if (dataset[i] > localaverage && window_size < 1) {
-            // Above average, no valley in progress
-            continue;
-        } else if (dataset[i] <= localaverage) {
-            // Below average - add to current valley window
-            window[window_size++] = i;
-        } else {
-            // End of valley - find minimum within window
-            if (window_size > 0) {
-                int min_index = 0;
-                for (int j = 1; j < window_size; j++) {
-                    if (dataset[window[j]] < dataset[window[min_index]]) {
-                        min_index = j;
-                    }
-                }
-                valleyList[nvalleys++] = window[min_index];
-                window_size = 0;
+        if (dataset[i] <= localaverage) {
+            // Below average - extend current valley
+            if (run_min < 0 || dataset[i] < dataset[run_min]) {
+                run_min = i;
             }
+        } else if (run_min >= 0) {
+            // End of valley - keep it unless too close to the previous valley
+            if (valid_valleys == 0 || (run_min - valleyArray[valid_valleys - 1]) > TH_elapsed) {
+                valleyArray[valid_valleys++] = run_min;
+            }
+            run_min = -1;
         }
     }
     
-    // Filter valleys that are too close together
-    int* valleyArray = (int*)malloc(nvalleys * sizeof(int));
-    int valid_valleys = 0;
-    
-    for (int i = 0; i < nvalleys; i++) {
-        if (valid_valleys == 0 || (valleyList[i] - valleyArray[valid_valleys - 1]) > TH_elapsed) {
-            valleyArray[valid_valleys++] = valleyList[i];
-        }
-    }
-    
-    // Cleanup
-    free(window);
-    free(valleyList);
-    
     *valley_count = valid_valleys;
     return valleyArray;
 }
@@ -235,42 +210,39 @@ int** pairValley(int* valleys, int valley_count) {
  * - Standard deviation (signal variability)
  * - Kurtosis (peakedness/tailedness)
  * - Skewness (asymmetry)
+ * 
+ * Each segment is visited once: a MomentAccumulator (runningStats.h)
+ * updates all central moments per sample, so no pow() calls are needed.
+ * Flat segments (zero variance) report 0 skewness/kurtosis instead of NaN.
  */
 void statisticDetection(float* signal, int size, int fs, int** valleys, int valley_count, 
                         float* stds, float* kurtosiss, float* skews) {
+    MomentAccumulator segment;
+    
     for (int i = 0; i < valley_count; i++) {
         int start = valleys[i][0];
         int end = valleys[i][1];
-        int length = end - start + 1;
         
-        // Calculate mean
-        float sum = 0;
-        for (int j = start; j <= end; j++) {
-            sum += signal[j];
-        }
-        float mean = sum / length;
+        segment.reset();
+        segment.pushBlock(signal + start, end - start + 1);
         
-        // Calculate variance (for standard deviation)
-        float variance = 0;
-        for (int j = start; j <= end; j++) {
-            variance += pow(signal[j] - mean, 2);
-        }
-        variance /= length;
-        stds[i] = sqrt(variance);
-        
-        // Calculate kurtosis (measure of outliers)
-        float fourth_moment = 0;
-        for (int j = start; j <= end; j++) {
-            fourth_moment += pow(signal[j] - mean, 4);
-        }
-        kurtosiss[i] = (fourth_moment / length) / (variance * variance) - 3;
+        stds[i] = segment.stddev();
+        kurtosiss[i] = segment.kurtosis();
+        skews[i] = segment.skewness();
+    }
+}
+
+void statisticDetection(const float* signal, int size, int fs, const CycleSegment* segments, 
+                        int segment_count, float* stds, float* kurtosiss, float* skews) {
+    MomentAccumulator segment;
+    
+    for (int i = 0; i < segment_count; i++) {
+        segment.reset();
+        segment.pushBlock(signal + segments[i].start, segments[i].end - segments[i].start + 1);
         
-        // Calculate skewness (measure of asymmetry)
-        float third_moment = 0;
-        for (int j = start; j <= end; j++) {
-            third_moment += pow(signal[j] - mean, 3);
-        }
-        skews[i] = (third_moment / length) / pow(sqrt(variance), 3);
+        stds[i] = segment.stddev();
+        kurtosiss[i] = segment.kurtosis();
+        skews[i] = segment.skewness();
     }
 }
 
@@ -360,6 +332,72 @@ float* eliminateNoiseInTime(float* data, int size, int fs, float* ths, int cycle
     return filtered_data;
 }
 
+/*
+ * Statistics and thresholds for flat segments. Rejected segments are
+ * marked with std = -1; returns the number of samples in kept segments.
+ */
+static int markNoisySegments(float* data, int size, int fs, float* ths, 
+                             const CycleSegment* segments, int segment_count, 
+                             float* stds, float* kurtosiss, float* skews) {
+    statisticDetection(data, size, fs, segments, segment_count, stds, kurtosiss, skews);
+    
+    float std_ths, kurt_ths, skews_ths[2];
+    statisticThreshold(stds, kurtosiss, skews, segment_count, ths, &std_ths, &kurt_ths, skews_ths);
+    
+    int final_size = 0;
+    for (int i = 0; i < segment_count; i++) {
+        if (stds[i] < std_ths && 
+            kurtosiss[i] < kurt_ths && 
+            skews[i] > skews_ths[0] && 
+            skews[i] < skews_ths[1]) {
+            final_size += segments[i].end - segments[i].start + 1;
+        } else {
+            stds[i] = -1;
+        }
+    }
+    return final_size;
+}
+
+// Copy samples of segments not marked as noisy (std = -1) to output
+static void copyCleanSegments(const float* data, const CycleSegment* segments, int segment_count, 
+                              const float* stds, float* output) {
+    int idx = 0;
+    for (int i = 0; i < segment_count; i++) {
+        if (stds[i] < 0) {
+            continue;
+        }
+        for (int j = segments[i].start; j <= segments[i].end; j++) {
+            output[idx++] = data[j];
+        }
+    }
+}
+
+/*
+ * Flat-segment version: same thresholds as above, but segments are read
+ * straight from a contiguous CycleSegment array (no pointer chasing).
+ * 
+ * WARNING: Caller must free() the returned pointer.
+ */
+float* eliminateNoiseInTime(float* data, int size, int fs, float* ths, int cycle, 
+                            const CycleSegment* segments, int segment_count, int* newSize) {
+    // One allocation holds all three statistics arrays
+    float* stats = (float*)malloc(3 * segment_count * sizeof(float));
+    float* stds = stats;
+    float* kurtosiss = stats + segment_count;
+    float* skews = stats + 2 * segment_count;
+    
+    int final_size = markNoisySegments(data, size, fs, ths, segments, segment_count, 
+                                       stds, kurtosiss, skews);
+    
+    float* filtered_data = (float*)malloc(final_size * sizeof(float));
+    copyCleanSegments(data, segments, segment_count, stds, filtered_data);
+    
+    free(stats);
+    
+    *newSize = final_size;
+    return filtered_data;
+}
+
 // ============================================================================
 // THRESHOLD PEAK DETECTION
 // ============================================================================
@@ -377,8 +415,11 @@ float* eliminateNoiseInTime(float* data, int size, int fs, float* ths, int cycle
  */
 int* thresholdPeakDetection(float* dataset, int size, int fs, float threshold_factor, 
                             float min_distance, int* peak_count) {
-    // Estimate maximum number of peaks (one per 10 samples is generous)
-    int max_peaks = size / 10;
+    // Convert minimum distance from seconds to samples
+    int TH_elapsed = (int)ceil(min_distance * fs);
+    
+    // Upper bound on peak count: accepted peaks are more than TH_elapsed apart
+    int max_peaks = maxEventCount(size, TH_elapsed);
     int* peakList = (int*)malloc(max_peaks * sizeof(int));
     int peak_idx = 0;
     
@@ -390,11 +431,8 @@ int* thresholdPeakDetection(float* dataset, int size, int fs, float threshold_fa
     local_average /= size;
     local_average *= threshold_factor;  // Apply threshold factor
     
-    // Convert minimum distance from seconds to samples
-    int TH_elapsed = (int)ceil(min_distance * fs);
-    
     // Scan for peaks (local maxima above threshold)
-    for (int i = 1; i < size - 1; i++) {
+    for (int i = 1; i < size - 1 && peak_idx < max_peaks; i++) {
         // Check if current sample is:
         // 1. Above threshold
         // 2. Greater than previous sample
@@ -514,6 +552,81 @@ float* calculateHRVMetrics(int* rr_intervals, int rrCount, int* metricsCount) {
     return metrics;
 }
 
+// ============================================================================
+// COMPLETE HRV PIPELINE
+// ============================================================================
+/*
+ * Runs the same steps as PPGManager::processPPGData() on one window and
+ * returns the HRV metrics as floats. PROCESSING_FIXED_POINT selects the
+ * arithmetic; only the final metric conversion uses float in fixed mode.
+ */
+int runHRVPipeline(long* input, int size, int fs, float* metrics) {
+    int trimmedSize = size - 2 * PIPELINE_EDGE_SAMPLES;
+    int searchSize = trimmedSize - PIPELINE_PEAK_SKIP;
+    if (searchSize < 3) {
+        return 0;  // Window too short to contain any beats
+    }
+    
+#if PROCESSING_FIXED_POINT
+    // Step 1-3: Filter and smooth in Q23.8
+    ppg_q_t* filtered = (ppg_q_t*)malloc(size * sizeof(ppg_q_t));
+    ppg_q_t* smoothed = (ppg_q_t*)malloc(trimmedSize * sizeof(ppg_q_t));
+    bandpassFilterQ(input, filtered, size);
+    movingAverageFilterQ(filtered + PIPELINE_EDGE_SAMPLES, smoothed, trimmedSize, 
+                         PIPELINE_SMOOTHING_WINDOW);
+    
+    // Step 4: Peak detection (at most one peak per minimum distance)
+    int minDistanceMs = (int)(PIPELINE_PEAK_MIN_DISTANCE * 1000);
+    int maxPeaks = searchSize * 1000 / (minDistanceMs * fs) + 1;
+    int* peaks = (int*)malloc(maxPeaks * sizeof(int));
+    int peakCount = thresholdPeakDetectionQ(smoothed + PIPELINE_PEAK_SKIP, searchSize, fs,
+                                            FLOAT_TO_Q(PIPELINE_PEAK_THRESHOLD, THRESHOLD_Q_FRAC_BITS),
+                                            minDistanceMs, peaks, maxPeaks);
+    free(filtered);
+    free(smoothed);
+    
+    // Step 5-6: RR intervals and HRV metrics
+    int rrCount;
+    int* rr_intervals = calcRrIntervals(peaks, peakCount, fs, &rrCount);
+    int32_t metricsQ[3];
+    int metricsCount = calculateHRVMetricsQ(rr_intervals, rrCount, metricsQ);
+    for (int i = 0; i < metricsCount; i++) {
+        metrics[i] = HRV_Q_TO_FLOAT(metricsQ[i]);
+    }
+#else
+    // Step 1-3: Filter and smooth
+    float* filtered = (float*)malloc(size * sizeof(float));
+    float* smoothed = (float*)malloc(trimmedSize * sizeof(float));
+    bandpassFilter(input, filtered, size);
+    movingAverageFilter(filtered + PIPELINE_EDGE_SAMPLES, smoothed, trimmedSize, 
+                        PIPELINE_SMOOTHING_WINDOW);
+    
+    // Step 4: Peak detection
+    int peakCount;
+    int* peaks = thresholdPeakDetection(smoothed + PIPELINE_PEAK_SKIP, searchSize, fs,
+                                        PIPELINE_PEAK_THRESHOLD, PIPELINE_PEAK_MIN_DISTANCE,
+                                        &peakCount);
+    free(filtered);
+    free(smoothed);
+    
+    // Step 5-6: RR intervals and HRV metrics
+    int rrCount;
+    int* rr_intervals = calcRrIntervals(peaks, peakCount, fs, &rrCount);
+    int metricsCount;
+    float* result = calculateHRVMetrics(rr_intervals, rrCount, &metricsCount);
+    for (int i = 0; i < metricsCount; i++) {
+        metrics[i] = result[i];
+    }
+    free(result);
+#endif
+    
+    // Cleanup
+    free(peaks);
+    free(rr_intervals);
+    
+    return metricsCount;
+}
+
 // ============================================================================
 // ESTIMATE RR INTERVAL CONSISTENCY
 // ============================================================================
@@ -543,3 +656,373 @@ float estimateRRIntervalConsistency(int* rr_intervals, int rrCount) {
     // Return standard deviation
     return sqrt(varianceRR / rrCount);
 }
+
+// ============================================================================
+// ARENA-BASED API
+// ============================================================================
+/*
+ * The overloads below take a ProcessingArena instead of calling malloc().
+ * Results are returned as Spans pointing into the arena; temporary buffers
+ * are released before returning wherever the result does not depend on
+ * them. On arena exhaustion an empty Span is returned (nothing halts).
+ * 
+ * Algorithms are identical to the malloc versions above.
+ */
+
+Span<float> removeZero(const long* input, int size, ProcessingArena& arena) {
+    Span<float> result = {NULL, 0};
+    
+    int count = 0;
+    for (int i = 0; i < size; i++) {
+        if (input[i] != 0) {
+            count++;
+        }
+    }
+    
+    float* output = arena.allocateArray<float>(count);
+    if (output == NULL) {
+        return result;
+    }
+    
+    int j = 0;
+    for (int i = 0; i < size; i++) {
+        if (input[i] != 0) {
+            output[j++] = (float)input[i];
+        }
+    }
+    
+    result.data = output;
+    result.count = count;
+    return result;
+}
+
+/*
+ * Only the minimum of the current below-average run is tracked, so unlike
+ * the malloc version no size-length scratch buffers are needed.
+ */
+Span<int> valleyDetection(const float* dataset, int size, int fs, float min_distance, 
+                          ProcessingArena& arena) {
+    Span<int> result = {NULL, 0};
+    int TH_elapsed = (int)ceil(min_distance * fs);
+    
+    int* valleys = arena.allocateArray<int>(maxEventCount(size, TH_elapsed));
+    if (valleys == NULL) {
+        return result;
+    }
+    
+    // Signal mean (threshold for valley detection)
+    float localaverage = 0;
+    for (int i = 0; i < size; i++) {
+        localaverage += dataset[i];
+    }
+    localaverage /= size;
+    
+    int nvalleys = 0;
+    int run_min = -1;  // Index of minimum in current below-average run (-1 = no run)
+    
+    for (int i = 0; i < size; i++) {
+        if (dataset[i] <= localaverage) {
+            // Below average - extend current valley run
+            if (run_min < 0 || dataset[i] < dataset[run_min]) {
+                run_min = i;
+            }
+        } else if (run_min >= 0) {
+            // End of valley - keep it if far enough from the previous one
+            if (nvalleys == 0 || (run_min - valleys[nvalleys - 1]) > TH_elapsed) {
+                valleys[nvalleys++] = run_min;
+            }
+            run_min = -1;
+        }
+    }
+    
+    result.data = valleys;
+    result.count = nvalleys;
+    return result;
+}
+
+/*
+ * Pairs are stored contiguously in the arena; the returned int* array
+ * points into that block, so statisticDetection() can use it unchanged.
+ */
+Span<int*> pairValley(const int* valleys, int valley_count, ProcessingArena& arena) {
+    Span<int*> result = {NULL, 0};
+    int pairCount = valley_count - 1;
+    if (pairCount <= 0) {
+        return result;
+    }
+    
+    ArenaMark start = arena.mark();
+    int** pairedValleys = arena.allocateArray<int*>(pairCount);
+    int* storage = arena.allocateArray<int>(2 * pairCount);
+    if (pairedValleys == NULL || storage == NULL) {
+        arena.rewind(start);
+        return result;
+    }
+    
+    for (int i = 0; i < pairCount; i++) {
+        pairedValleys[i] = storage + 2 * i;
+        pairedValleys[i][0] = valleys[i];      // Start of segment
+        pairedValleys[i][1] = valleys[i + 1];  // End of segment
+    }
+    
+    result.data = pairedValleys;
+    result.count = pairCount;
+    return result;
+}
+
+Span<float> eliminateNoiseInTime(float* data, int size, int fs, float* ths, int cycle, 
+                                 int** valleys, int valley_count, ProcessingArena& arena) {
+    Span<float> result = {NULL, 0};
+    
+    // Step 1: Statistics for each segment (temporary)
+    ArenaMark scratch = arena.mark();
+    float* stds = arena.allocateArray<float>(valley_count);
+    float* kurtosiss = arena.allocateArray<float>(valley_count);
+    float* skews = arena.allocateArray<float>(valley_count);
+    if (stds == NULL || kurtosiss == NULL || skews == NULL) {
+        arena.rewind(scratch);
+        return result;
+    }
+    statisticDetection(data, size, fs, valleys, valley_count, stds, kurtosiss, skews);
+    
+    // Step 2: Adaptive thresholds
+    float std_ths, kurt_ths, skews_ths[2];
+    statisticThreshold(stds, kurtosiss, skews, valley_count, ths, &std_ths, &kurt_ths, skews_ths);
+    
+    // Step 3: Find valid segments (rejected ones are marked with std = -1)
+    int final_size = 0;
+    for (int i = 0; i < valley_count; i++) {
+        if (stds[i] < std_ths && 
+            kurtosiss[i] < kurt_ths && 
+            skews[i] > skews_ths[0] && 
+            skews[i] < skews_ths[1]) {
+            final_size += valleys[i][1] - valleys[i][0] + 1;
+        } else {
+            stds[i] = -1;
+        }
+    }
+    
+    // Step 4: Copy valid segments. Output is allocated after the scratch
+    // arrays, so the scratch is only released when the arena is rewound.
+    float* filtered_data = arena.allocateArray<float>(final_size);
+    if (filtered_data == NULL) {
+        arena.rewind(scratch);
+        return result;
+    }
+    int idx = 0;
+    for (int i = 0; i < valley_count; i++) {
+        if (stds[i] < 0) {
+            continue;
+        }
+        for (int j = valleys[i][0]; j <= valleys[i][1]; j++) {
+            filtered_data[idx++] = data[j];
+        }
+    }
+    
+    result.data = filtered_data;
+    result.count = final_size;
+    return result;
+}
+
+Span<CycleSegment> valleySegments(const int* valleys, int valley_count, ProcessingArena& arena) {
+    Span<CycleSegment> result = {NULL, 0};
+    int segmentCount = valley_count - 1;
+    
+    CycleSegment* segments = arena.allocateArray<CycleSegment>(segmentCount);
+    if (segments == NULL) {
+        return result;
+    }
+    
+    for (int i = 0; i < segmentCount; i++) {
+        segments[i].start = valleys[i];
+        segments[i].end = valleys[i + 1];
+    }
+    
+    result.data = segments;
+    result.count = segmentCount;
+    return result;
+}
+
+Span<float> eliminateNoiseInTime(float* data, int size, int fs, float* ths, int cycle, 
+                                 const CycleSegment* segments, int segment_count, 
+                                 ProcessingArena& arena) {
+    Span<float> result = {NULL, 0};
+    
+    ArenaMark scratch = arena.mark();
+    float* stats = arena.allocateArray<float>(3 * segment_count);
+    if (stats == NULL) {
+        return result;
+    }
+    float* stds = stats;
+    
+    int final_size = markNoisySegments(data, size, fs, ths, segments, segment_count, 
+                                       stds, stats + segment_count, stats + 2 * segment_count);
+    
+    float* filtered_data = arena.allocateArray<float>(final_size);
+    if (filtered_data == NULL) {
+        arena.rewind(scratch);
+        return result;
+    }
+    copyCleanSegments(data, segments, segment_count, stds, filtered_data);
+    
+    result.data = filtered_data;
+    result.count = final_size;
+    return result;
+}
+
+Span<int> thresholdPeakDetection(const float* dataset, int size, int fs, float threshold_factor, 
+                                 float min_distance, ProcessingArena& arena) {
+    Span<int> result = {NULL, 0};
+    int TH_elapsed = (int)ceil(min_distance * fs);
+    
+    int* peaks = arena.allocateArray<int>(maxEventCount(size, TH_elapsed));
+    if (peaks == NULL) {
+        return result;
+    }
+    
+    // Threshold as fraction of mean amplitude
+    float local_average = 0;
+    for (int i = 0; i < size; i++) {
+        local_average += dataset[i];
+    }
+    local_average /= size;
+    local_average *= threshold_factor;
+    
+    int peak_idx = 0;
+    for (int i = 1; i < size - 1; i++) {
+        if (dataset[i] >= local_average && 
+            dataset[i] > dataset[i - 1] && 
+            dataset[i] > dataset[i + 1]) {
+            if (peak_idx == 0 || (i - peaks[peak_idx - 1]) > TH_elapsed) {
+                peaks[peak_idx++] = i;
+            }
+        }
+    }
+    
+    result.data = peaks;
+    result.count = peak_idx;
+    return result;
+}
+
+Span<int> calcRrIntervals(const int* peaks, int peakCount, int fs, ProcessingArena& arena) {
+    Span<int> result = {NULL, 0};
+    if (peakCount < 2) {
+        return result;  // Need at least 2 peaks to calculate an interval
+    }
+    
+    int* rr_intervals = arena.allocateArray<int>(peakCount - 1);
+    if (rr_intervals == NULL) {
+        return result;
+    }
+    
+    int rr_idx = 0;
+    for (int i = 1; i < peakCount; i++) {
+        int rr_interval = (peaks[i] - peaks[i - 1]) * 1000 / fs;
+        if (rr_interval >= 300 && rr_interval <= 1500) {
+            rr_intervals[rr_idx++] = rr_interval;
+        }
+    }
+    
+    result.data = rr_intervals;
+    result.count = rr_idx;
+    return result;
+}
+
+Span<float> calculateHRVMetrics(const int* rr_intervals, int rrCount, ProcessingArena& arena) {
+    Span<float> result = {NULL, 0};
+    if (rrCount == 0) {
+        return result;
+    }
+    
+    float* metrics = arena.allocateArray<float>(3);
+    if (metrics == NULL) {
+        return result;
+    }
+    
+    float sumRR = 0;
+    for (int i = 0; i < rrCount; i++) {
+        sumRR += rr_intervals[i];
+    }
+    float avgRR = sumRR / rrCount;
+    metrics[0] = 60000.0 / avgRR;
+    
+    float varianceRR = 0;
+    for (int i = 0; i < rrCount; i++) {
+        float dev = rr_intervals[i] - avgRR;
+        varianceRR += dev * dev;
+    }
+    metrics[1] = sqrt(varianceRR / rrCount);
+    
+    float sumOfSquares = 0;
+    for (int i = 1; i < rrCount; i++) {
+        float diff = rr_intervals[i] - rr_intervals[i - 1];
+        sumOfSquares += diff * diff;
+    }
+    metrics[2] = sqrt(sumOfSquares / (rrCount - 1));
+    
+    result.data = metrics;
+    result.count = 3;
+    return result;
+}
+
+/*
+ * Arena version of runHRVPipeline(). All buffers come from the arena and
+ * are released before returning, so calling this once per window uses the
+ * same memory every time and never touches the heap.
+ */
+int runHRVPipeline(long* input, int size, int fs, float* metrics, ProcessingArena& arena) {
+    int trimmedSize = size - 2 * PIPELINE_EDGE_SAMPLES;
+    int searchSize = trimmedSize - PIPELINE_PEAK_SKIP;
+    if (searchSize < 3) {
+        return 0;
+    }
+    
+    ArenaMark start = arena.mark();
+    int metricsCount = 0;
+    
+#if PROCESSING_FIXED_POINT
+    ppg_q_t* filtered = arena.allocateArray<ppg_q_t>(size);
+    ppg_q_t* smoothed = arena.allocateArray<ppg_q_t>(trimmedSize);
+    int minDistanceMs = (int)(PIPELINE_PEAK_MIN_DISTANCE * 1000);
+    int maxPeaks = maxEventCount(searchSize, (minDistanceMs * fs + 999) / 1000);
+    int* peaks = arena.allocateArray<int>(maxPeaks);
+    
+    if (filtered != NULL && smoothed != NULL && peaks != NULL) {
+        bandpassFilterQ(input, filtered, size);
+        movingAverageFilterQ(filtered + PIPELINE_EDGE_SAMPLES, smoothed, trimmedSize, 
+                             PIPELINE_SMOOTHING_WINDOW);
+        int peakCount = thresholdPeakDetectionQ(smoothed + PIPELINE_PEAK_SKIP, searchSize, fs,
+                                                FLOAT_TO_Q(PIPELINE_PEAK_THRESHOLD, THRESHOLD_Q_FRAC_BITS),
+                                                minDistanceMs, peaks, maxPeaks);
+        
+        Span<int> rr = calcRrIntervals(peaks, peakCount, fs, arena);
+        int32_t metricsQ[3];
+        metricsCount = calculateHRVMetricsQ(rr.data, rr.count, metricsQ);
+        for (int i = 0; i < metricsCount; i++) {
+            metrics[i] = HRV_Q_TO_FLOAT(metricsQ[i]);
+        }
+    }
+#else
+    float* filtered = arena.allocateArray<float>(size);
+    float* smoothed = arena.allocateArray<float>(trimmedSize);
+    
+    if (filtered != NULL && smoothed != NULL) {
+        bandpassFilter(input, filtered, size);
+        movingAverageFilter(filtered + PIPELINE_EDGE_SAMPLES, smoothed, trimmedSize, 
+                            PIPELINE_SMOOTHING_WINDOW);
+        Span<int> peaks = thresholdPeakDetection(smoothed + PIPELINE_PEAK_SKIP, searchSize, fs,
+                                                 PIPELINE_PEAK_THRESHOLD, 
+                                                 PIPELINE_PEAK_MIN_DISTANCE, arena);
+        Span<int> rr = calcRrIntervals(peaks.data, peaks.count, fs, arena);
+        Span<float> result = calculateHRVMetrics(rr.data, rr.count, arena);
+        for (int i = 0; i < result.count; i++) {
+            metrics[i] = result[i];
+        }
+        metricsCount = result.count;
+    }
+#endif
+    
+    // Window done - release everything for the next call
+    arena.rewind(start);
+    return metricsCount;
+}
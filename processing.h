@@ -27,11 +27,26 @@
  * - SDNN: Standard deviation of RR intervals (overall variability)
  * - RMSSD: Root mean square of successive differences (short-term variability)
  * 
+ * STREAMING ALTERNATIVE:
+ * bandpassFilter() needs the whole recording in RAM. For sample-by-sample
+ * filtering as data arrives, use Biquad / BiquadCascade from
+ * streamingFilters.h, which produce identical output.
+ * 
+ * FIXED-POINT PATH:
+ * processingFixed.h provides integer-only versions of the filtering,
+ * detection and HRV stages. Set PROCESSING_FIXED_POINT to 1 to make
+ * runHRVPipeline() use them and keep the FPU idle.
+ * 
  * MEMORY CONSIDERATIONS:
- * These functions use dynamic memory allocation (malloc/free).
+ * The original functions use dynamic memory allocation (malloc/free).
  * Ensure sufficient heap memory is available (typically >8KB for processing).
  * Always free() returned pointers after use to prevent memory leaks.
  * 
+ * Every allocating function also has an overload taking a ProcessingArena
+ * (processingArena.h). These return Spans into caller-owned memory and
+ * never touch the heap; rewind the arena to a mark after each analysis
+ * window so every window reuses the same buffer.
+ * 
  * USAGE EXAMPLE:
  * See PPGManager::processPPGData() for complete pipeline implementation.
  * 
@@ -45,6 +60,25 @@
 #define PROCESSING_H
 
 #include <Arduino.h>
+#include "processingArena.h"
+#include "processingTypes.h"  // CycleSegment
+
+// ============================================================================
+// CONFIGURATION
+// ============================================================================
+
+// Select the arithmetic used by runHRVPipeline()
+// 0 = float functions in this file, 1 = integer-only path (processingFixed.h)
+#ifndef PROCESSING_FIXED_POINT
+#define PROCESSING_FIXED_POINT 0
+#endif
+
+// Pipeline parameters used by runHRVPipeline() (see PPGManager::processPPGData)
+#define PIPELINE_EDGE_SAMPLES 25        // Samples trimmed from each end after bandpass
+#define PIPELINE_SMOOTHING_WINDOW 6     // Moving average window (samples)
+#define PIPELINE_PEAK_SKIP 15           // Extra settling samples skipped before peak search
+#define PIPELINE_PEAK_THRESHOLD 0.9     // Peak threshold factor (x mean)
+#define PIPELINE_PEAK_MIN_DISTANCE 0.4  // Minimum time between peaks (seconds)
 
 // ============================================================================
 // FILTERING FUNCTIONS
@@ -56,6 +90,7 @@
 //   input: Raw PPG signal (integer array)
 //   output: Filtered signal (float array, pre-allocated)
 //   size: Number of samples
+// Note: Stateless batch wrapper around Biquad (streamingFilters.h)
 void bandpassFilter(long* input, float* output, int size);
 
 // Apply moving average filter for signal smoothing
@@ -65,6 +100,7 @@ void bandpassFilter(long* input, float* output, int size);
 //   output: Smoothed signal (float array, pre-allocated)
 //   size: Number of samples
 //   windowSize: Number of samples to average (typical: 4-8)
+// Note: O(size) running sum; input and output must not overlap
 void movingAverageFilter(float* input, float* output, int size, int windowSize);
 
 // ============================================================================
@@ -80,9 +116,7 @@ void movingAverageFilter(float* input, float* output, int size, int windowSize);
 // Returns: Filtered signal (caller must free())
 float* removeZero(long* input, int size, int* newSize);
 
-// Assess signal quality (placeholder - to be implemented)
-// Returns: Quality score (1 = good, 0 = poor)
-int signalQual(float* signal, int fs);
+// Window signal quality: signalQual() in signalQuality.h
 
 // ============================================================================
 // PEAK AND VALLEY DETECTION
@@ -125,6 +159,7 @@ int* thresholdPeakDetection(float* dataset, int size, int fs, float threshold_fa
 
 // Calculate statistical metrics for signal segments
 // Used for quality assessment and noise detection
+// Single pass per segment (see MomentAccumulator in runningStats.h)
 void statisticDetection(float* signal, int size, int fs, int** valleys, int valley_count, float* stds, float* kurtosiss, float* skews);
 
 // Determine thresholds for noise elimination based on statistics
@@ -137,6 +172,18 @@ void eliminateNoiseInTime(float* data, int size, int fs, float* ths, int cycle);
 // Returns dynamically allocated array - caller must free()
 float* eliminateNoiseInTime(float* data, int size, int fs, float* ths, int cycle, int** valleys, int valley_count, int* newSize);
 
+// ----------------------------------------------------------------------------
+// Flat cycle-segment layout
+// ----------------------------------------------------------------------------
+// Calculate statistics for flat cycle segments (same metrics as above)
+void statisticDetection(const float* signal, int size, int fs, const CycleSegment* segments, 
+                        int segment_count, float* stds, float* kurtosiss, float* skews);
+
+// Eliminate noisy segments given flat cycle segments
+// Returns dynamically allocated array - caller must free()
+float* eliminateNoiseInTime(float* data, int size, int fs, float* ths, int cycle, 
+                            const CycleSegment* segments, int segment_count, int* newSize);
+
 // ============================================================================
 // HRV CALCULATION
 // ============================================================================
@@ -160,11 +207,67 @@ int* calcRrIntervals(int* peaks, int peakCount, int fs, int* rrCount);
 //   metricsCount: Output parameter - number of metrics (always 3)
 // Returns: Array containing [Heart Rate (bpm), SDNN (ms), RMSSD (ms)]
 //          Caller must free()
+// Note: For per-beat updates over a sliding window see RollingHRV (rollingHrv.h)
 float* calculateHRVMetrics(int* rr_intervals, int rrCount, int* metricsCount);
 
+// Run the complete pipeline on one recording window:
+// bandpass -> trim edges -> moving average -> peaks -> RR intervals -> HRV
+// Uses float or fixed-point arithmetic depending on PROCESSING_FIXED_POINT
+// Parameters:
+//   input: Raw PPG signal (sensor counts)
+//   size: Number of samples
+//   fs: Sampling frequency (Hz)
+//   metrics: Output [Heart Rate (bpm), SDNN (ms), RMSSD (ms)] (pre-allocated, 3 floats)
+// Returns: Number of metrics written (3, or 0 if no valid RR intervals)
+int runHRVPipeline(long* input, int size, int fs, float* metrics);
+
 // Estimate consistency of RR intervals (standard deviation)
 // Used for signal quality assessment
 // Returns: Standard deviation of RR intervals, or -1 if insufficient data
 float estimateRRIntervalConsistency(int* rr_intervals, int rrCount);
 
+// ============================================================================
+// ARENA-BASED API (NO HEAP ALLOCATION)
+// ============================================================================
+// Same algorithms as the functions above, but results are allocated from a
+// caller-supplied ProcessingArena and returned as Spans. An empty Span
+// (count = 0) is returned if the arena runs out of space.
+
+// Remove zero values (see removeZero above)
+Span<float> removeZero(const long* input, int size, ProcessingArena& arena);
+
+// Detect valleys (see valleyDetection above) - no scratch buffers needed
+Span<int> valleyDetection(const float* dataset, int size, int fs, float min_distance, 
+                          ProcessingArena& arena);
+
+// Pair consecutive valleys; pairs are stored in one contiguous block
+Span<int*> pairValley(const int* valleys, int valley_count, ProcessingArena& arena);
+
+// Detect peaks (see thresholdPeakDetection above)
+Span<int> thresholdPeakDetection(const float* dataset, int size, int fs, float threshold_factor, 
+                                 float min_distance, ProcessingArena& arena);
+
+// Build flat cycle segments from consecutive valleys (replaces pairValley)
+Span<CycleSegment> valleySegments(const int* valleys, int valley_count, ProcessingArena& arena);
+
+// Eliminate noisy segments (see eliminateNoiseInTime above)
+// Per-segment statistics stay in the arena until it is rewound
+Span<float> eliminateNoiseInTime(float* data, int size, int fs, float* ths, int cycle, 
+                                 int** valleys, int valley_count, ProcessingArena& arena);
+
+// Eliminate noisy segments given flat cycle segments
+Span<float> eliminateNoiseInTime(float* data, int size, int fs, float* ths, int cycle, 
+                                 const CycleSegment* segments, int segment_count, 
+                                 ProcessingArena& arena);
+
+// Calculate RR intervals (see calcRrIntervals above)
+Span<int> calcRrIntervals(const int* peaks, int peakCount, int fs, ProcessingArena& arena);
+
+// Calculate [HR, SDNN, RMSSD] (see calculateHRVMetrics above)
+Span<float> calculateHRVMetrics(const int* rr_intervals, int rrCount, ProcessingArena& arena);
+
+// Run the complete pipeline using only arena memory
+// The arena is rewound to its entry position before returning
+int runHRVPipeline(long* input, int size, int fs, float* metrics, ProcessingArena& arena);
+
 #endif
@@ -0,0 +1,128 @@
+/*
+ * processingArena.h
+ *
+ * Bump-pointer memory arena for the on-device processing pipeline.
+ *
+ * OVERVIEW:
+ * The original processing.h functions malloc/realloc their results. On a
+ * 256 KB MCU that fragments the heap and makes allocation time unbounded.
+ * A ProcessingArena hands out memory from one caller-owned buffer by
+ * bumping an offset: allocation is O(1), there is no per-block header and
+ * nothing is ever freed individually. Instead, a mark is taken before an
+ * analysis window and the arena is rewound to it afterwards, so every
+ * window reuses exactly the same memory.
+ *
+ * FAILURE BEHAVIOUR:
+ * When the buffer is exhausted allocate() returns NULL and the arena
+ * records the overflow (see overflowed()). Functions taking an arena then
+ * return an empty Span instead of halting the device.
+ *
+ * USAGE EXAMPLE:
+ *   static StaticArena<8192> arena;
+ *   ArenaMark start = arena.mark();
+ *   Span<int> peaks = thresholdPeakDetection(data, size, fs, 0.9, 0.4, arena);
+ *   ...
+ *   arena.rewind(start);   // Window done - memory is reused next time
+ *
+ */
+
+#ifndef PROCESSING_ARENA_H
+#define PROCESSING_ARENA_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// SPAN - Non-owning view of arena memory
+// ============================================================================
+
+// Pointer + element count returned by arena-based functions
+// The memory belongs to the arena; it stays valid until the arena is
+// rewound past the point where it was allocated.
+template <typename T>
+struct Span {
+    T* data;
+    int count;
+
+    bool empty() const { return count == 0; }
+    T& operator[](int i) const { return data[i]; }
+};
+
+// Saved arena position (see ProcessingArena::mark / rewind)
+typedef size_t ArenaMark;
+
+// ============================================================================
+// PROCESSING ARENA
+// ============================================================================
+
+class ProcessingArena {
+public:
+    // Use an existing buffer (not owned, must outlive the arena)
+    ProcessingArena(void* buffer, size_t capacity)
+        : base((uint8_t*)buffer), capacity(capacity), offset(0), peak(0), overflow(false) {}
+
+    // Allocate raw bytes aligned to 'alignment' (power of two)
+    // Returns NULL (and flags overflow) when the buffer is exhausted
+    void* allocate(size_t bytes, size_t alignment = sizeof(void*)) {
+        size_t start = (offset + alignment - 1) & ~(alignment - 1);
+        if (start > capacity || bytes > capacity - start) {
+            overflow = true;
+            return NULL;
+        }
+        offset = start + bytes;
+        if (offset > peak) {
+            peak = offset;
+        }
+        return base + start;
+    }
+
+    // Allocate an uninitialised array of 'count' elements of type T
+    template <typename T>
+    T* allocateArray(int count) {
+        if (count <= 0) {
+            return NULL;
+        }
+        return (T*)allocate(count * sizeof(T), alignof(T));
+    }
+
+    // Current position - pass to rewind() to release everything after it
+    ArenaMark mark() const { return offset; }
+
+    // Release all allocations made after 'position'
+    void rewind(ArenaMark position) {
+        if (position <= offset) {
+            offset = position;
+        }
+    }
+
+    // Release everything and clear the overflow flag
+    void reset() {
+        offset = 0;
+        overflow = false;
+    }
+
+    // Usage statistics
+    size_t used() const { return offset; }
+    size_t size() const { return capacity; }
+    size_t highWater() const { return peak; }
+    bool overflowed() const { return overflow; }
+
+private:
+    uint8_t* base;     // Start of buffer
+    size_t capacity;   // Buffer size (bytes)
+    size_t offset;     // Next free byte
+    size_t peak;       // Highest offset reached (for sizing the buffer)
+    bool overflow;     // An allocation has failed since the last reset()
+};
+
+// Arena with its own statically sized storage
+// Declare as static / global so the buffer lives in .bss, not on the stack
+template <size_t BYTES>
+class StaticArena : public ProcessingArena {
+public:
+    StaticArena() : ProcessingArena(storage, BYTES) {}
+
+private:
+    alignas(8) uint8_t storage[BYTES];
+};
+
+#endif
@@ -0,0 +1,244 @@
+/*
+ * processingFixed.cpp
+ *
+ * Integer-only implementation of the on-device PPG pipeline.
+ * See processingFixed.h for Q-formats, saturation rules and error bounds.
+ *
+ * Each function follows the same algorithm as its float counterpart in
+ * processing.cpp so the two paths can be compared sample for sample.
+ */
+
+#include "processingFixed.h"
+
+// ============================================================================
+// FILTER COEFFICIENTS (Q1.30)
+// ============================================================================
+// Same bandpass design as PPG_BANDPASS_COEFFS (streamingFilters.cpp)
+
+static const int32_t BP_B0 = FLOAT_TO_Q(0.292893, PPG_COEFF_FRAC_BITS);
+static const int32_t BP_B1 = 0;
+static const int32_t BP_B2 = FLOAT_TO_Q(-0.292893, PPG_COEFF_FRAC_BITS);
+static const int32_t BP_A1 = FLOAT_TO_Q(-1.16574, PPG_COEFF_FRAC_BITS);
+static const int32_t BP_A2 = FLOAT_TO_Q(0.292893, PPG_COEFF_FRAC_BITS);
+
+// ============================================================================
+// INTEGER SQUARE ROOT
+// ============================================================================
+/*
+ * Bit-by-bit integer square root (no division, no FPU).
+ * Returns floor(sqrt(value)); at most 32 iterations.
+ */
+uint32_t isqrt64(uint64_t value) {
+    uint64_t result = 0;
+    uint64_t bit = (uint64_t)1 << 62;  // Highest power of four <= 2^63
+
+    while (bit > value) {
+        bit >>= 2;
+    }
+
+    while (bit != 0) {
+        if (value >= result + bit) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint32_t)result;
+}
+
+// ============================================================================
+// BANDPASS FILTER
+// ============================================================================
+/*
+ * Direct Form I biquad with Q1.30 coefficients and Q23.8 state.
+ * Products are accumulated in Q.38 (64-bit) and rounded back to Q23.8.
+ * The first two outputs are seeded from the raw input, as in bandpassFilter().
+ */
+void bandpassFilterQ(const long* input, ppg_q_t* output, int size) {
+    int64_t x1 = 0, x2 = 0;  // Previous inputs (Q23.8)
+    int64_t y1 = 0, y2 = 0;  // Previous outputs (Q23.8)
+
+    for (int i = 0; i < size; i++) {
+        int64_t x0 = (int64_t)input[i] << PPG_Q_FRAC_BITS;
+        int32_t y0;
+
+        if (i < 2) {
+            // Initialize first two samples (insufficient history for filtering)
+            y0 = saturate32(x0);
+        } else {
+            int64_t acc = BP_B0 * x0 + BP_B1 * x1 + BP_B2 * x2 -
+                          BP_A1 * y1 - BP_A2 * y2;
+            y0 = roundShift64(acc, PPG_COEFF_FRAC_BITS);
+        }
+
+        output[i] = y0;
+
+        x2 = x1;
+        x1 = x0;
+        y2 = y1;
+        y1 = y0;
+    }
+}
+
+// ============================================================================
+// MOVING AVERAGE FILTER
+// ============================================================================
+/*
+ * Running-sum moving average. The 64-bit sum is exact, so the only error
+ * is the final rounded division.
+ */
+void movingAverageFilterQ(const ppg_q_t* input, ppg_q_t* output, int size, int windowSize) {
+    int64_t sum = 0;
+
+    for (int i = 0; i < size; i++) {
+        sum += input[i];
+        if (i >= windowSize) {
+            sum -= input[i - windowSize];
+        }
+
+        int count = (i < windowSize) ? (i + 1) : windowSize;
+        int64_t half = count / 2;
+        output[i] = (ppg_q_t)(sum >= 0 ? (sum + half) / count : (sum - half) / count);
+    }
+}
+
+// ============================================================================
+// VALLEY DETECTION
+// ============================================================================
+/*
+ * Same algorithm as valleyDetection(): find the minimum of each run of
+ * samples at or below the signal mean, then drop valleys closer than
+ * min_distance. Only the running minimum of the current run is tracked,
+ * so no scratch buffers are needed.
+ */
+int valleyDetectionQ(const ppg_q_t* dataset, int size, int fs, int min_distance_ms,
+                     int* valleys, int max_valleys) {
+    if (size <= 0) {
+        return 0;
+    }
+
+    // Minimum sample distance between valleys (rounded up, as ceil() in float path)
+    int TH_elapsed = (min_distance_ms * fs + 999) / 1000;
+
+    // Signal mean (threshold for valley detection)
+    int64_t sum = 0;
+    for (int i = 0; i < size; i++) {
+        sum += dataset[i];
+    }
+    ppg_q_t localaverage = (ppg_q_t)(sum / size);
+
+    int nvalleys = 0;
+    int run_min = -1;  // Index of minimum in current below-average run (-1 = no run)
+
+    for (int i = 0; i < size; i++) {
+        if (dataset[i] <= localaverage) {
+            // Below average - extend current valley run
+            if (run_min < 0 || dataset[i] < dataset[run_min]) {
+                run_min = i;
+            }
+        } else if (run_min >= 0) {
+            // End of valley - keep it if far enough from the previous one
+            if (nvalleys == 0 || (run_min - valleys[nvalleys - 1]) > TH_elapsed) {
+                if (nvalleys < max_valleys) {
+                    valleys[nvalleys++] = run_min;
+                }
+            }
+            run_min = -1;
+        }
+    }
+
+    return nvalleys;
+}
+
+// ============================================================================
+// THRESHOLD PEAK DETECTION
+// ============================================================================
+/*
+ * Same algorithm as thresholdPeakDetection(): local maxima at or above
+ * threshold_factor * mean, at least min_distance apart.
+ */
+int thresholdPeakDetectionQ(const ppg_q_t* dataset, int size, int fs, int32_t threshold_factor_q15,
+                            int min_distance_ms, int* peaks, int max_peaks) {
+    if (size <= 0) {
+        return 0;
+    }
+
+    // Threshold as fraction of mean amplitude
+    int64_t sum = 0;
+    for (int i = 0; i < size; i++) {
+        sum += dataset[i];
+    }
+    int64_t mean = sum / size;
+    ppg_q_t threshold = roundShift64(mean * threshold_factor_q15, THRESHOLD_Q_FRAC_BITS);
+
+    // Convert minimum distance from milliseconds to samples (rounded up)
+    int TH_elapsed = (min_distance_ms * fs + 999) / 1000;
+
+    int peak_idx = 0;
+    for (int i = 1; i < size - 1 && peak_idx < max_peaks; i++) {
+        if (dataset[i] >= threshold &&
+            dataset[i] > dataset[i - 1] &&
+            dataset[i] > dataset[i + 1]) {
+
+            // Ensure minimum distance from previous peak
+            if (peak_idx == 0 || (i - peaks[peak_idx - 1]) > TH_elapsed) {
+                peaks[peak_idx++] = i;
+            }
+        }
+    }
+
+    return peak_idx;
+}
+
+// ============================================================================
+// CALCULATE HRV METRICS
+// ============================================================================
+/*
+ * Integer-only HR, SDNN and RMSSD.
+ * Sums are exact in 64 bits (RR <= 1500 ms, so even thousands of beats
+ * cannot overflow), and square roots are taken on values pre-scaled by
+ * 2^16 so the result lands directly in Q8.
+ */
+int calculateHRVMetricsQ(const int* rr_intervals, int rrCount, int32_t* metrics) {
+    if (rrCount == 0) {
+        return 0;
+    }
+
+    int64_t sumRR = 0;
+    int64_t sumSqRR = 0;
+    int64_t sumSqDiff = 0;
+
+    for (int i = 0; i < rrCount; i++) {
+        int64_t rr = rr_intervals[i];
+        sumRR += rr;
+        sumSqRR += rr * rr;
+        if (i > 0) {
+            int64_t diff = rr - rr_intervals[i - 1];
+            sumSqDiff += diff * diff;
+        }
+    }
+
+    // Heart rate: 60000 / mean RR = 60000 * n / sum(RR), in Q8
+    int64_t hrNumerator = (int64_t)60000 * rrCount << HRV_Q_FRAC_BITS;
+    metrics[0] = saturate32((hrNumerator + sumRR / 2) / sumRR);
+
+    // SDNN: population variance = (n * sum(x^2) - sum(x)^2) / n^2
+    // sqrt(variance * 2^16) = SDNN in Q8
+    uint64_t n = (uint64_t)rrCount;
+    uint64_t varianceNumerator = (uint64_t)(rrCount * sumSqRR - sumRR * sumRR);
+    uint64_t varianceQ16 = (varianceNumerator << (2 * HRV_Q_FRAC_BITS)) / (n * n);
+    metrics[1] = saturate32(isqrt64(varianceQ16));
+
+    // RMSSD: sqrt(mean of squared successive differences), in Q8
+    if (rrCount > 1) {
+        uint64_t meanSqDiffQ16 = ((uint64_t)sumSqDiff << (2 * HRV_Q_FRAC_BITS)) / (n - 1);
+        metrics[2] = saturate32(isqrt64(meanSqDiffQ16));
+    } else {
+        metrics[2] = 0;
+    }
+
+    return 3;
+}
@@ -0,0 +1,150 @@
+/*
+ * processingFixed.h
+ *
+ * Fixed-point (integer-only) version of the on-device PPG pipeline.
+ *
+ * OVERVIEW:
+ * Every function in processing.h works in float and uses pow()/sqrt().
+ * On the nRF52840 that keeps the FPU powered for the whole analysis.
+ * The functions here mirror the same pipeline stages using only 32/64-bit
+ * integer arithmetic, so the FPU can stay idle:
+ * 1. bandpassFilterQ: Second-order IIR bandpass (same design as bandpassFilter)
+ * 2. movingAverageFilterQ: Running-sum smoother
+ * 3. valleyDetectionQ / thresholdPeakDetectionQ: Minima / maxima detection
+ * 4. calcRrIntervals: Already integer, shared with the float path
+ * 5. calculateHRVMetricsQ: HR, SDNN, RMSSD with integer square roots
+ *
+ * Q-FORMATS:
+ * - Raw input:      long, sensor counts (MAX30105 is 18-bit, 0..262143)
+ * - Signal (ppg_q): int32, Q23.8  -> value = counts * 2^-8  (PPG_Q_FRAC_BITS)
+ * - Coefficients:   int32, Q1.30  -> range [-2, 2)           (PPG_COEFF_FRAC_BITS)
+ * - Threshold:      int32, Q15    -> 0.9 = 29491, 1.2 = 39322 (factor may exceed 1)
+ * - HRV metrics:    int32, Q8     -> bpm or ms * 2^-8         (HRV_Q_FRAC_BITS)
+ *
+ * SATURATION BEHAVIOUR:
+ * - Filter accumulators are 64-bit (Q30 * Q8 products), so intermediate
+ *   sums cannot overflow. Results are rounded to nearest and saturated
+ *   to the int32 range instead of wrapping.
+ * - Moving average sums are 64-bit and exact (no saturation required).
+ * - HRV metrics saturate at INT32_MAX (far above any physiological value).
+ *
+ * ACCURACY (vs float path on the same input):
+ * - bandpassFilterQ: within +/-1 count of bandpassFilter() for 18-bit input
+ * - movingAverageFilterQ: adds at most 1 LSB (2^-8 count) of rounding error
+ * - Peak/valley indices: identical except where two samples differ by less
+ *   than the filter error above (then off by at most one sample)
+ * - calculateHRVMetricsQ: within 1 Q8 LSB given the same RR intervals
+ *
+ * COMPILE-TIME SELECTION:
+ * Set PROCESSING_FIXED_POINT to 1 (see processing.h) to make
+ * runHRVPipeline() use this path instead of the float functions.
+ *
+ */
+
+#ifndef PROCESSING_FIXED_H
+#define PROCESSING_FIXED_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// Q-FORMAT DEFINITIONS
+// ============================================================================
+
+typedef int32_t ppg_q_t;            // Signal sample, Q23.8
+
+#define PPG_Q_FRAC_BITS 8           // Fractional bits in ppg_q_t
+#define PPG_COEFF_FRAC_BITS 30      // Fractional bits in filter coefficients
+#define THRESHOLD_Q_FRAC_BITS 15    // Fractional bits in threshold factors
+#define HRV_Q_FRAC_BITS 8           // Fractional bits in HRV metric outputs
+
+// Convert a float constant to fixed point at compile time (round to nearest)
+#define FLOAT_TO_Q(x, frac) ((int32_t)((x) * (float)(1L << (frac)) + ((x) >= 0 ? 0.5f : -0.5f)))
+
+// Convert fixed-point values back to float (for display / BLE only)
+#define PPG_Q_TO_FLOAT(q) ((float)(q) / (1L << PPG_Q_FRAC_BITS))
+#define HRV_Q_TO_FLOAT(q) ((float)(q) / (1L << HRV_Q_FRAC_BITS))
+
+// ============================================================================
+// SATURATING ARITHMETIC HELPERS
+// ============================================================================
+
+// Clamp a 64-bit value to the int32 range
+static inline int32_t saturate32(int64_t value) {
+    if (value > INT32_MAX) return INT32_MAX;
+    if (value < INT32_MIN) return INT32_MIN;
+    return (int32_t)value;
+}
+
+// Arithmetic shift right with round-to-nearest, then saturate to int32
+static inline int32_t roundShift64(int64_t value, int shift) {
+    return saturate32((value + ((int64_t)1 << (shift - 1))) >> shift);
+}
+
+// Integer square root: floor(sqrt(value))
+uint32_t isqrt64(uint64_t value);
+
+// ============================================================================
+// FILTERING FUNCTIONS
+// ============================================================================
+
+// Fixed-point bandpass filter (same design and start-up as bandpassFilter)
+// Parameters:
+//   input: Raw PPG signal (sensor counts)
+//   output: Filtered signal (Q23.8, pre-allocated)
+//   size: Number of samples
+void bandpassFilterQ(const long* input, ppg_q_t* output, int size);
+
+// Fixed-point moving average filter (same semantics as movingAverageFilter)
+// Parameters:
+//   input: Signal to filter (Q23.8)
+//   output: Smoothed signal (Q23.8, pre-allocated, must not overlap input)
+//   size: Number of samples
+//   windowSize: Number of samples to average
+void movingAverageFilterQ(const ppg_q_t* input, ppg_q_t* output, int size, int windowSize);
+
+// ============================================================================
+// PEAK AND VALLEY DETECTION
+// ============================================================================
+
+// Detect valleys (minima) - same algorithm as valleyDetection()
+// Writes into a caller-supplied array instead of allocating
+// Parameters:
+//   dataset: PPG signal (Q23.8)
+//   size: Number of samples
+//   fs: Sampling frequency (Hz)
+//   min_distance_ms: Minimum time between valleys (milliseconds)
+//   valleys: Output array of valley indices (pre-allocated)
+//   max_valleys: Capacity of valleys array
+// Returns: Number of valleys written (never more than max_valleys)
+int valleyDetectionQ(const ppg_q_t* dataset, int size, int fs, int min_distance_ms,
+                     int* valleys, int max_valleys);
+
+// Detect peaks (maxima) - same algorithm as thresholdPeakDetection()
+// Writes into a caller-supplied array instead of allocating
+// Parameters:
+//   dataset: PPG signal (Q23.8)
+//   size: Number of samples
+//   fs: Sampling frequency (Hz)
+//   threshold_factor_q15: Multiplier for mean threshold (Q15, 0.9 = 29491)
+//   min_distance_ms: Minimum time between peaks (milliseconds, typical: 400)
+//   peaks: Output array of peak indices (pre-allocated)
+//   max_peaks: Capacity of peaks array
+// Returns: Number of peaks written (never more than max_peaks)
+int thresholdPeakDetectionQ(const ppg_q_t* dataset, int size, int fs, int32_t threshold_factor_q15,
+                            int min_distance_ms, int* peaks, int max_peaks);
+
+// ============================================================================
+// HRV CALCULATION
+// ============================================================================
+
+// Calculate HRV metrics from RR intervals using integer arithmetic only
+// RR intervals come from calcRrIntervals() (already integer milliseconds)
+// Parameters:
+//   rr_intervals: Array of RR intervals (milliseconds)
+//   rrCount: Number of RR intervals
+//   metrics: Output [Heart Rate (bpm), SDNN (ms), RMSSD (ms)] in Q8
+// Returns: Number of metrics written (3, or 0 if rrCount == 0)
+// Note: RMSSD is reported as 0 when only one RR interval is available
+int calculateHRVMetricsQ(const int* rr_intervals, int rrCount, int32_t* metrics);
+
+#endif
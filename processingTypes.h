@@ -0,0 +1,30 @@
+/*
+ * processingTypes.h
+ *
+ * Plain data types shared by the batch and streaming processing modules.
+ *
+ * OVERVIEW:
+ * processing.h (batch functions), beatDetector.h and signalQuality.h
+ * (streaming detectors) all pass cardiac cycles around. Keeping those
+ * types here lets each module include only what it uses: processing.cpp
+ * does not depend on the streaming modules, and the streaming headers do
+ * not pull in the whole batch API.
+ *
+ */
+
+#ifndef PROCESSING_TYPES_H
+#define PROCESSING_TYPES_H
+
+// ============================================================================
+// CARDIAC CYCLES
+// ============================================================================
+
+// One cardiac cycle from one valley to the next (inclusive sample indices).
+// Segments are stored contiguously (e.g. by StreamingValleyDetector in
+// beatDetector.h), replacing the one-malloc-per-pair int** from pairValley().
+struct CycleSegment {
+    int start;  // Index of opening valley
+    int end;    // Index of closing valley
+};
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * rollingHrv.h
+ *
+ * Sliding-window HRV metrics updated in O(1) per beat.
+ *
+ * OVERVIEW:
+ * calculateHRVMetrics() in processing.h recomputes everything from the full
+ * RR array once per 60-second window. RollingHRV takes one RR interval at a
+ * time and keeps exact integer sums over the most recent WINDOW intervals,
+ * so the metrics below can be read after every beat:
+ * - Heart rate (bpm) = 60000 / mean RR
+ * - SDNN (ms): population standard deviation of RR
+ * - RMSSD (ms): root mean square of successive differences
+ * - pNN50 (%): successive differences larger than 50 ms
+ * - SD1 / SD2 (ms): Poincare plot axes
+ *     SD1^2 = Var(diff) / 2,  SD2^2 = 2 * SDNN^2 - SD1^2
+ * HR, SDNN and RMSSD use the same definitions as calculateHRVMetrics().
+ *
+ * EVICTION:
+ * When the window is full, each new interval evicts the oldest one and the
+ * successive difference that linked it to its neighbour. All sums are
+ * int64 over integer milliseconds, so add/remove never accumulates
+ * rounding error no matter how long the engine runs.
+ *
+ * GAPS:
+ * If a beat is missed or rejected (e.g. poor signal quality), call
+ * markGap() before pushing the next interval: it is still counted for
+ * HR/SDNN, but no successive difference is formed across the gap.
+ *
+ * USAGE EXAMPLE:
+ *   RollingHRV<64> hrv;
+ *   hrv.push(rrMs);
+ *   HRVMetrics m;
+ *   if (hrv.getMetrics(&m)) { ...m.rmssd... }
+ *
+ */
+
+#ifndef ROLLING_HRV_H
+#define ROLLING_HRV_H
+
+#include <Arduino.h>
+#include <math.h>  // sqrt
+
+#define HRV_NN50_THRESHOLD 50  // Successive difference counted by pNN50 (ms)
+
+// Snapshot of the metrics over the current window
+struct HRVMetrics {
+    float heartRate;  // bpm
+    float sdnn;       // ms
+    float rmssd;      // ms (0 if no successive differences)
+    float pnn50;      // % of successive differences > HRV_NN50_THRESHOLD
+    float sd1;        // ms
+    float sd2;        // ms
+    int beats;        // RR intervals in the window
+};
+
+// ============================================================================
+// ROLLING HRV ENGINE
+// ============================================================================
+
+template <int WINDOW>
+class RollingHRV {
+public:
+    static_assert(WINDOW >= 2, "RollingHRV needs room for a successive difference");
+
+    RollingHRV() { reset(); }
+
+    // Forget all intervals (start of a new recording)
+    void reset() {
+        head = 0;
+        count = 0;
+        gap = true;
+        sumRR = sumRR2 = 0;
+        sumDiff = sumDiff2 = 0;
+        diffCount = 0;
+        nn50Count = 0;
+    }
+
+    // Break the successive-difference chain before the next push()
+    void markGap() { gap = true; }
+
+    // Add one RR interval (ms), evicting the oldest if the window is full
+    void push(int rr) {
+        int slot;
+        if (count == WINDOW) {
+            slot = head;
+            evictOldest();
+        } else {
+            slot = (head + count) % WINDOW;
+            count++;
+        }
+
+        rrRing[slot] = rr;
+        sumRR += rr;
+        sumRR2 += (int64_t)rr * rr;
+
+        linked[slot] = !gap;
+        if (!gap) {
+            int diff = rr - lastRR;
+            diffRing[slot] = diff;
+            addDiff(diff);
+        }
+        lastRR = rr;
+        gap = false;
+    }
+
+    // Number of RR intervals in the window
+    int size() const { return count; }
+    bool isFull() const { return count == WINDOW; }
+
+    // Compute metrics over the window. Returns false if it is empty.
+    bool getMetrics(HRVMetrics* metrics) const {
+        if (count == 0) {
+            return false;
+        }
+
+        float n = count;
+        float meanRR = sumRR / n;
+        // n^2 * variance, exact in integer arithmetic
+        float varRR = (float)(count * sumRR2 - sumRR * sumRR) / (n * n);
+
+        metrics->beats = count;
+        metrics->heartRate = 60000.0 / meanRR;
+        metrics->sdnn = sqrt(varRR);
+
+        if (diffCount > 0) {
+            float m = diffCount;
+            float varDiff = (float)(diffCount * sumDiff2 - sumDiff * sumDiff) / (m * m);
+            float sd1Squared = varDiff / 2;
+            float sd2Squared = 2 * varRR - sd1Squared;
+
+            metrics->rmssd = sqrt(sumDiff2 / m);
+            metrics->pnn50 = 100.0 * nn50Count / m;
+            metrics->sd1 = sqrt(sd1Squared);
+            metrics->sd2 = sd2Squared > 0 ? sqrt(sd2Squared) : 0;
+        } else {
+            metrics->rmssd = 0;
+            metrics->pnn50 = 0;
+            metrics->sd1 = 0;
+            metrics->sd2 = 0;
+        }
+        return true;
+    }
+
+private:
+    int rrRing[WINDOW];     // RR intervals (ms)
+    int diffRing[WINDOW];   // Difference to the previous interval (if linked)
+    bool linked[WINDOW];    // diffRing entry is part of the sums
+    int head;               // Index of oldest interval
+    int count;              // Intervals stored
+    int lastRR;             // Most recently pushed interval
+    bool gap;               // Next push starts a new chain
+
+    int64_t sumRR, sumRR2;      // Sum of RR and RR^2
+    int64_t sumDiff, sumDiff2;  // Sum of successive differences and their squares
+    int diffCount;              // Successive differences in the window
+    int nn50Count;              // ... of which |diff| > HRV_NN50_THRESHOLD
+
+    void addDiff(int diff) {
+        sumDiff += diff;
+        sumDiff2 += (int64_t)diff * diff;
+        diffCount++;
+        if (abs(diff) > HRV_NN50_THRESHOLD) {
+            nn50Count++;
+        }
+    }
+
+    void removeDiff(int diff) {
+        sumDiff -= diff;
+        sumDiff2 -= (int64_t)diff * diff;
+        diffCount--;
+        if (abs(diff) > HRV_NN50_THRESHOLD) {
+            nn50Count--;
+        }
+    }
+
+    // Remove the oldest interval and the difference linking it to the next
+    void evictOldest() {
+        int rr = rrRing[head];
+        sumRR -= rr;
+        sumRR2 -= (int64_t)rr * rr;
+
+        // (The oldest interval's own link was dropped with its predecessor)
+        int next = (head + 1) % WINDOW;
+        if (linked[next]) {
+            removeDiff(diffRing[next]);
+            linked[next] = false;
+        }
+        head = next;
+    }
+};
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * runningStats.cpp
+ *
+ * Implementation of the single-pass moment accumulator.
+ * See runningStats.h for interface documentation.
+ *
+ * REFERENCE:
+ * Update and merge formulas from Terriberry (2007), "Computing higher-order
+ * moments online", extending Welford's variance algorithm.
+ */
+
+#include "runningStats.h"
+#include <math.h>  // sqrtf
+
+// ============================================================================
+// Constructor / Reset
+// ============================================================================
+
+MomentAccumulator::MomentAccumulator() {
+    reset();
+}
+
+void MomentAccumulator::reset() {
+    n = 0;
+    m1 = m2 = m3 = m4 = 0;
+}
+
+// ============================================================================
+// Adding Samples
+// ============================================================================
+/*
+ * Single-sample update. Higher moments must be updated before lower ones
+ * because each uses the previous values of the lower moments.
+ */
+void MomentAccumulator::push(float x) {
+    float n1 = n;
+    n++;
+    float nf = n;
+
+    float delta = x - m1;
+    float delta_n = delta / nf;
+    float delta_n2 = delta_n * delta_n;
+    float term1 = delta * delta_n * n1;
+
+    m1 += delta_n;
+    m4 += term1 * delta_n2 * (nf * nf - 3 * nf + 3) + 6 * delta_n2 * m2 - 4 * delta_n * m3;
+    m3 += term1 * delta_n * (nf - 2) - 3 * delta_n * m2;
+    m2 += term1;
+}
+
+void MomentAccumulator::pushBlock(const float* data, int size) {
+    for (int i = 0; i < size; i++) {
+        push(data[i]);
+    }
+}
+
+// ============================================================================
+// Merging
+// ============================================================================
+/*
+ * Pairwise combination of two sets of central moments (Chan et al. for M2,
+ * Terriberry for M3/M4).
+ */
+void MomentAccumulator::merge(const MomentAccumulator& other) {
+    if (other.n == 0) {
+        return;
+    }
+    if (n == 0) {
+        *this = other;
+        return;
+    }
+
+    float na = n;
+    float nb = other.n;
+    float nx = na + nb;
+
+    float delta = other.m1 - m1;
+    float delta2 = delta * delta;
+    float delta3 = delta * delta2;
+    float delta4 = delta2 * delta2;
+
+    float newM1 = (na * m1 + nb * other.m1) / nx;
+
+    float newM2 = m2 + other.m2 + delta2 * na * nb / nx;
+
+    float newM3 = m3 + other.m3 +
+                  delta3 * na * nb * (na - nb) / (nx * nx) +
+                  3 * delta * (na * other.m2 - nb * m2) / nx;
+
+    float newM4 = m4 + other.m4 +
+                  delta4 * na * nb * (na * na - na * nb + nb * nb) / (nx * nx * nx) +
+                  6 * delta2 * (na * na * other.m2 + nb * nb * m2) / (nx * nx) +
+                  4 * delta * (na * other.m3 - nb * m3) / nx;
+
+    n += other.n;
+    m1 = newM1;
+    m2 = newM2;
+    m3 = newM3;
+    m4 = newM4;
+}
+
+// ============================================================================
+// Derived Statistics
+// ============================================================================
+
+float MomentAccumulator::variance() const {
+    return n > 0 ? m2 / n : 0;
+}
+
+float MomentAccumulator::stddev() const {
+    return sqrtf(variance());
+}
+
+float MomentAccumulator::skewness() const {
+    // Flat segment: asymmetry is undefined, report 0 rather than NaN
+    if (n == 0 || m2 <= 0) {
+        return 0;
+    }
+    return sqrtf((float)n) * m3 / (m2 * sqrtf(m2));
+}
+
+float MomentAccumulator::kurtosis() const {
+    // Flat segment: tailedness is undefined, report 0 rather than NaN
+    if (n == 0 || m2 <= 0) {
+        return 0;
+    }
+    return n * m4 / (m2 * m2) - 3;
+}
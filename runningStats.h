@@ -0,0 +1,70 @@
+/*
+ * runningStats.h
+ *
+ * Single-pass, numerically stable statistics for PPG beat segments.
+ *
+ * OVERVIEW:
+ * statisticDetection() needs the standard deviation, skewness and kurtosis
+ * of every cardiac cycle. Computing them with separate passes for each
+ * moment (and pow() per sample) is too slow to run per beat on-device.
+ * MomentAccumulator updates all four central moments in one pass using
+ * the Welford / Terriberry recurrences, so samples can be pushed as they
+ * arrive and the statistics read out as soon as the beat ends.
+ *
+ * DEFINITIONS (population statistics, matching statisticDetection()):
+ * - variance = M2 / n
+ * - skewness = sqrt(n) * M3 / M2^1.5
+ * - kurtosis = n * M4 / M2^2 - 3   (excess kurtosis)
+ *
+ * MERGING:
+ * Two accumulators covering adjacent (or any disjoint) sample sets can be
+ * combined with merge(), e.g. to join partial beats or build window-level
+ * statistics from per-beat ones without revisiting the samples.
+ *
+ * USAGE EXAMPLE:
+ *   MomentAccumulator beat;
+ *   for (...) beat.push(sample);
+ *   float sd = beat.stddev();
+ *
+ */
+
+#ifndef RUNNING_STATS_H
+#define RUNNING_STATS_H
+
+#include <Arduino.h>
+
+class MomentAccumulator {
+public:
+    MomentAccumulator();
+
+    // Discard all samples
+    void reset();
+
+    // Add one sample
+    void push(float x);
+
+    // Add a block of samples
+    void pushBlock(const float* data, int size);
+
+    // Combine statistics of another accumulator into this one
+    void merge(const MomentAccumulator& other);
+
+    // Number of samples seen
+    uint32_t count() const { return n; }
+
+    // Population statistics (0 when fewer than one sample / zero variance)
+    float mean() const { return n > 0 ? m1 : 0; }
+    float variance() const;
+    float stddev() const;
+    float skewness() const;
+    float kurtosis() const;  // Excess kurtosis (normal distribution = 0)
+
+private:
+    uint32_t n;  // Sample count
+    float m1;    // Running mean
+    float m2;    // Sum of squared deviations from the mean
+    float m3;    // Sum of cubed deviations
+    float m4;    // Sum of fourth-power deviations
+};
+
+#endif
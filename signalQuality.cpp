@@ -0,0 +1,212 @@
+/*
+ * signalQuality.cpp
+ *
+ * Implementation of the per-beat signal quality index.
+ * See signalQuality.h for interface documentation.
+ */
+
+#include "signalQuality.h"
+#include "processing.h"  // estimateRRIntervalConsistency
+#include <math.h>  // sqrt
+
+// ============================================================================
+// INTERNAL HELPERS
+// ============================================================================
+
+// Map x linearly from [bad, good] to [0, 1], clamped (works for bad > good)
+static float linearScore(float x, float bad, float good) {
+    float t = (x - bad) / (good - bad);
+    if (t < 0) return 0;
+    if (t > 1) return 1;
+    return t;
+}
+
+// ============================================================================
+// STREAMING SQI
+// ============================================================================
+
+StreamingSQI::StreamingSQI(int fs, float min_distance)
+    : fs(fs), valleys(fs, min_distance) {
+    reset();
+}
+
+void StreamingSQI::reset() {
+    valleys.reset();
+    sampleCount = 0;
+    haveTemplate = false;
+    referenceAmplitude = 0;
+    badStreak = 0;
+    rrCount = 0;
+    rrHead = 0;
+    cycle.start = cycle.end = 0;
+    score = corrScore = ampScore = rrScore = 0;
+    beatCount = goodCount = 0;
+}
+
+bool StreamingSQI::process(float sample, float dcLevel) {
+    history[sampleCount % SQI_HISTORY_SAMPLES] = sample;
+    sampleCount++;
+
+    CycleSegment segment;
+    if (!valleys.process(sample, &segment)) {
+        return false;
+    }
+
+    scoreCycle(segment, dcLevel);
+    return true;
+}
+
+/*
+ * Scores one valley-to-valley cycle. The cycle's samples are read back
+ * from the history ring; a cycle too long to still be in the ring cannot
+ * be a plausible heartbeat and scores 0.
+ */
+void StreamingSQI::scoreCycle(const CycleSegment& segment, float dcLevel) {
+    cycle = segment;
+    beatCount++;
+
+    int length = segment.end - segment.start + 1;
+    if (length < 3 || sampleCount - segment.start > SQI_HISTORY_SAMPLES) {
+        score = corrScore = ampScore = rrScore = 0;
+        return;
+    }
+
+    // --- Resample beat to fixed length, find amplitude ---
+    float beat[SQI_TEMPLATE_LENGTH];
+    float lo = history[segment.start % SQI_HISTORY_SAMPLES];
+    float hi = lo;
+    for (int i = segment.start + 1; i <= segment.end; i++) {
+        float v = history[i % SQI_HISTORY_SAMPLES];
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+    }
+    float amplitude = hi - lo;
+
+    float mean = 0;
+    for (int k = 0; k < SQI_TEMPLATE_LENGTH; k++) {
+        float pos = (float)k * (length - 1) / (SQI_TEMPLATE_LENGTH - 1);
+        int i = (int)pos;
+        float frac = pos - i;
+        float a = history[(segment.start + i) % SQI_HISTORY_SAMPLES];
+        float b = (i + 1 < length) ? history[(segment.start + i + 1) % SQI_HISTORY_SAMPLES] : a;
+        beat[k] = a + (b - a) * frac;
+        mean += beat[k];
+    }
+    mean /= SQI_TEMPLATE_LENGTH;
+
+    // Zero mean, unit energy - correlation is then a dot product
+    float energy = 0;
+    for (int k = 0; k < SQI_TEMPLATE_LENGTH; k++) {
+        beat[k] -= mean;
+        energy += beat[k] * beat[k];
+    }
+    if (energy <= 0) {
+        score = corrScore = ampScore = rrScore = 0;
+        return;
+    }
+    float norm = 1.0 / sqrt(energy);
+    for (int k = 0; k < SQI_TEMPLATE_LENGTH; k++) {
+        beat[k] *= norm;
+    }
+
+    // --- 1. Template correlation ---
+    if (haveTemplate) {
+        float corr = 0;
+        for (int k = 0; k < SQI_TEMPLATE_LENGTH; k++) {
+            corr += beat[k] * beatTemplate[k];
+        }
+        corrScore = linearScore(corr, SQI_CORR_BAD, SQI_CORR_GOOD);
+    } else {
+        corrScore = 1;  // Nothing to compare the first beat against
+    }
+
+    // --- 2. Amplitude relative to recent good beats, and perfusion ---
+    ampScore = 1;
+    if (referenceAmplitude > 0) {
+        float ratio = amplitude / referenceAmplitude;
+        if (ratio < 0.5) {
+            ampScore = ratio / 0.5;
+        } else if (ratio > 2.0) {
+            ampScore = 2.0 / ratio;
+        }
+    }
+    if (dcLevel > 0) {
+        ampScore *= linearScore(amplitude / dcLevel, 0, SQI_MIN_PERFUSION);
+    }
+
+    // --- 3. RR consistency (cycle length in ms) ---
+    rrHistory[rrHead] = (int)((long)(length - 1) * 1000 / fs);
+    rrHead = (rrHead + 1) % SQI_RR_HISTORY;
+    if (rrCount < SQI_RR_HISTORY) {
+        rrCount++;
+    }
+
+    rrScore = 1;  // Too few cycles to judge rhythm yet
+    if (rrCount >= 3) {
+        // Ring order does not matter for the standard deviation
+        float sd = estimateRRIntervalConsistency(rrHistory, rrCount);
+        float meanRR = 0;
+        for (int i = 0; i < rrCount; i++) {
+            meanRR += rrHistory[i];
+        }
+        meanRR /= rrCount;
+        if (sd >= 0 && meanRR > 0) {
+            rrScore = linearScore(sd / meanRR, SQI_RR_CV_BAD, SQI_RR_CV_GOOD);
+        }
+    }
+
+    score = corrScore * ampScore * rrScore;
+
+    // --- Update references from good beats only ---
+    if (score < SQI_GOOD_THRESHOLD) {
+        if (++badStreak >= SQI_RESEED_BEATS) {
+            haveTemplate = false;
+            referenceAmplitude = 0;
+            badStreak = 0;
+        }
+    } else {
+        goodCount++;
+        badStreak = 0;
+        if (haveTemplate) {
+            // Blend, then renormalise to unit energy
+            float templateEnergy = 0;
+            for (int k = 0; k < SQI_TEMPLATE_LENGTH; k++) {
+                beatTemplate[k] += SQI_TEMPLATE_UPDATE * (beat[k] - beatTemplate[k]);
+                templateEnergy += beatTemplate[k] * beatTemplate[k];
+            }
+            if (templateEnergy > 0) {
+                float templateNorm = 1.0 / sqrt(templateEnergy);
+                for (int k = 0; k < SQI_TEMPLATE_LENGTH; k++) {
+                    beatTemplate[k] *= templateNorm;
+                }
+            }
+            referenceAmplitude += SQI_AMPLITUDE_UPDATE * (amplitude - referenceAmplitude);
+        } else {
+            for (int k = 0; k < SQI_TEMPLATE_LENGTH; k++) {
+                beatTemplate[k] = beat[k];
+            }
+            haveTemplate = true;
+            referenceAmplitude = amplitude;
+        }
+    }
+}
+
+// ============================================================================
+// WINDOW QUALITY
+// ============================================================================
+/*
+ * Window-level quality decision built on the per-beat SQI.
+ * No DC level is available here, so the perfusion check is skipped.
+ */
+int signalQual(float* signal, int size, int fs) {
+    StreamingSQI quality(fs);
+    for (int i = 0; i < size; i++) {
+        quality.process(signal[i]);
+    }
+
+    unsigned long beats = quality.beatsScored();
+    if (beats == 0) {
+        return 0;
+    }
+    return quality.goodBeats() >= SQI_MIN_GOOD_FRACTION * beats ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * signalQuality.h
+ *
+ * Per-beat signal quality index (SQI) for PPG signals.
+ *
+ * OVERVIEW:
+ * A loose or moving sensor still produces a signal, but its beats are
+ * misshapen, their amplitude collapses or jumps, and the beat-to-beat
+ * intervals become erratic. StreamingSQI scores every cardiac cycle as it
+ * completes, so the firmware can decide live whether a stretch of signal
+ * is worth transmitting or processing.
+ *
+ * SCORE COMPONENTS (each 0..1, multiplied together):
+ * 1. Template correlation: The beat is resampled to SQI_TEMPLATE_LENGTH
+ *    points and correlated with a running average of recent good beats.
+ *    Correlation >= SQI_CORR_GOOD scores 1, <= SQI_CORR_BAD scores 0.
+ * 2. Amplitude / perfusion: Beat amplitude relative to the running
+ *    amplitude of good beats (0.5x-2x scores 1). If the raw DC level is
+ *    supplied, the perfusion index (AC/DC) must also reach
+ *    SQI_MIN_PERFUSION, which catches a sensor lifted off the skin.
+ * 3. RR consistency: Coefficient of variation of recent cycle lengths,
+ *    from estimateRRIntervalConsistency() in processing.h.
+ *    CV <= SQI_RR_CV_GOOD scores 1, >= SQI_RR_CV_BAD scores 0.
+ *
+ * The template and reference amplitude are only updated by good beats. If
+ * SQI_RESEED_BEATS beats in a row are rejected (e.g. the first template was
+ * taken during motion, or the sensor was repositioned) both are discarded
+ * and rebuilt from the next beat.
+ *
+ * COST:
+ * Per sample: one valley detector update and one history write.
+ * Per beat: O(SQI_TEMPLATE_LENGTH + SQI_RR_HISTORY), no heap allocation.
+ *
+ * USAGE EXAMPLE:
+ *   StreamingSQI quality(25);
+ *   if (quality.process(smoothedSample, rawDcLevel)) {
+ *     if (quality.lastScore() < SQI_GOOD_THRESHOLD) { ...skip this beat... }
+ *   }
+ *
+ */
+
+#ifndef SIGNAL_QUALITY_H
+#define SIGNAL_QUALITY_H
+
+#include <Arduino.h>
+#include "beatDetector.h"
+
+// ============================================================================
+// SQI CONFIGURATION
+// ============================================================================
+
+#define SQI_TEMPLATE_LENGTH 32      // Points each beat is resampled to
+#define SQI_HISTORY_SAMPLES 128     // Sample history (must exceed longest beat + detection latency)
+#define SQI_RR_HISTORY 8            // Cycle lengths used for RR consistency
+#define SQI_TEMPLATE_UPDATE 0.2     // Weight of a new good beat in the template
+#define SQI_AMPLITUDE_UPDATE 0.2    // Weight of a new good beat in the reference amplitude
+#define SQI_RESEED_BEATS 8          // Consecutive bad beats before the template is rebuilt
+
+#define SQI_CORR_GOOD 0.9           // Template correlation scoring 1
+#define SQI_CORR_BAD 0.5            // Template correlation scoring 0
+#define SQI_RR_CV_GOOD 0.10         // RR coefficient of variation scoring 1
+#define SQI_RR_CV_BAD 0.40          // RR coefficient of variation scoring 0
+#define SQI_MIN_PERFUSION 0.001     // Minimum AC/DC ratio (0.1%) for skin contact
+
+#define SQI_GOOD_THRESHOLD 0.5      // Beats scoring at least this are "good"
+#define SQI_MIN_GOOD_FRACTION 0.7   // Fraction of good beats for a good window (signalQual)
+
+// ============================================================================
+// STREAMING SQI
+// ============================================================================
+
+class StreamingSQI {
+public:
+    // Parameters:
+    //   fs: Sampling frequency (Hz)
+    //   min_distance: Minimum time between valleys (seconds)
+    StreamingSQI(int fs, float min_distance = 0.4);
+
+    // Forget all history, including the beat template
+    void reset();
+
+    // Add one filtered sample. dcLevel is the raw (unfiltered) signal level
+    // for the perfusion check; pass 0 if unknown. Returns true when a beat
+    // has completed and lastScore() / lastCycle() have been updated.
+    bool process(float sample, float dcLevel = 0);
+
+    // Score of the most recent beat (0 = unusable, 1 = clean)
+    float lastScore() const { return score; }
+
+    // Cycle (valley to valley) the last score refers to
+    const CycleSegment& lastCycle() const { return cycle; }
+
+    // Individual components of the last score (for diagnostics)
+    float correlationScore() const { return corrScore; }
+    float amplitudeScore() const { return ampScore; }
+    float rhythmScore() const { return rrScore; }
+
+    // Beat counts since reset
+    unsigned long beatsScored() const { return beatCount; }
+    unsigned long goodBeats() const { return goodCount; }
+
+private:
+    int fs;
+    StreamingValleyDetector valleys;
+
+    // Recent filtered samples (ring, indexed by absolute sample number)
+    float history[SQI_HISTORY_SAMPLES];
+    long sampleCount;
+
+    // Running references built from good beats
+    float beatTemplate[SQI_TEMPLATE_LENGTH];
+    bool haveTemplate;
+    float referenceAmplitude;
+    int badStreak;  // Consecutive beats below SQI_GOOD_THRESHOLD
+
+    // Recent cycle lengths (ms)
+    int rrHistory[SQI_RR_HISTORY];
+    int rrCount;
+    int rrHead;
+
+    // Last result
+    CycleSegment cycle;
+    float score, corrScore, ampScore, rrScore;
+    unsigned long beatCount, goodCount;
+
+    // Score one completed cycle
+    void scoreCycle(const CycleSegment& segment, float dcLevel);
+};
+
+// ============================================================================
+// WINDOW QUALITY
+// ============================================================================
+
+// Assess signal quality of a filtered window
+// Every beat is scored by StreamingSQI; the window is good when at least
+// SQI_MIN_GOOD_FRACTION of its beats reach SQI_GOOD_THRESHOLD
+// Parameters:
+//   signal: Filtered PPG signal
+//   size: Number of samples
+//   fs: Sampling frequency (Hz)
+// Returns: Quality score (1 = good, 0 = poor or no beats found)
+int signalQual(float* signal, int size, int fs);
+
+#endif
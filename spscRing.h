@@ -0,0 +1,191 @@
+/*
+ * spscRing.h
+ *
+ * Fixed-capacity lock-free ring buffer for one producer and one consumer.
+ *
+ * OVERVIEW:
+ * Hands items (samples, bytes, sample blocks) from one context to another,
+ * e.g. from the FIFO interrupt handler to loop(), or from acquisition to the
+ * BLE sender, without locks, heap allocation or reallocation:
+ * - Capacity N is a power of two; head/tail are free-running 32-bit
+ *   counters, so full/empty need no spare slot and indexing is a mask
+ * - head is written only by the producer, tail only by the consumer; a
+ *   release store publishes the items before the index that exposes them,
+ *   and the other side reads it with an acquire load
+ * - Every method is O(1) or O(items copied); nothing blocks
+ * Works wherever std::atomic<uint32_t> is lock-free: Cortex-M3/M4 (LDREX/
+ * STREX, plain loads/stores here) and any host.
+ *
+ * THREAD SAFETY:
+ * Exactly one producer context may call the producer methods and exactly
+ * one consumer context the consumer methods. size()/empty() may be called
+ * from either side. reset() only while neither side is running.
+ *
+ * ZERO-COPY:
+ * peek() returns the longest contiguous run of readable items, so a caller
+ * can pass ring memory straight to e.g. a BLE notify and then consume()
+ * it; the run ends at the wrap point, so a caller that needs a fixed
+ * length must fall back to pop() when the run is shorter. prepare()/
+ * commit() are the producer-side equivalent.
+ *
+ * USAGE EXAMPLE:
+ *   SpscRing<uint8_t, 64> ring;
+ *   ring.push(bytes, 3);                    // Producer
+ *   const uint8_t* run;
+ *   uint32_t length = ring.peek(&run);      // Consumer, zero-copy
+ *   if (length >= 18) { notify(run, 18); ring.consume(18); }
+ *
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <atomic>
+
+// Keep head and tail on separate cache lines where there are caches (hosts);
+// Cortex-M4 has none, so word alignment is enough
+#ifndef SPSC_RING_ALIGN
+#if defined(__arm__)
+#define SPSC_RING_ALIGN 4
+#else
+#define SPSC_RING_ALIGN 64
+#endif
+#endif
+
+// ============================================================================
+// SPSC RING
+// ============================================================================
+
+template <typename T, uint32_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    SpscRing() : head(0), tail(0) {}
+
+    static constexpr uint32_t capacity() { return N; }
+
+    // Items readable by the consumer (a snapshot from either side)
+    uint32_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // ------------------------------------------------------------------------
+    // Producer
+    // ------------------------------------------------------------------------
+
+    // Slots the producer can fill
+    uint32_t freeSpace() const {
+        return N - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire));
+    }
+
+    // Copy one item in. Returns false if full.
+    bool push(const T& item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= N) {
+            return false;
+        }
+        buffer[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Copy up to count items in (oldest first). Returns items pushed.
+    uint32_t push(const T* items, uint32_t count) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t space = N - (h - tail.load(std::memory_order_acquire));
+        if (count > space) {
+            count = space;
+        }
+        uint32_t first = copyRun(h, count);
+        for (uint32_t i = 0; i < first; i++) {
+            buffer[(h & (N - 1)) + i] = items[i];
+        }
+        for (uint32_t i = first; i < count; i++) {
+            buffer[i - first] = items[i];
+        }
+        head.store(h + count, std::memory_order_release);
+        return count;
+    }
+
+    // Contiguous free slots starting at the write position (zero-copy fill)
+    uint32_t prepare(T** items) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t space = N - (h - tail.load(std::memory_order_acquire));
+        *items = &buffer[h & (N - 1)];
+        return copyRun(h, space);
+    }
+
+    // Publish count items written through prepare()
+    void commit(uint32_t count) {
+        head.store(head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    // ------------------------------------------------------------------------
+    // Consumer
+    // ------------------------------------------------------------------------
+
+    // Copy the oldest item out. Returns false if empty.
+    bool pop(T* item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        *item = buffer[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Copy up to count items out (oldest first). Returns items popped.
+    uint32_t pop(T* items, uint32_t count) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t available = head.load(std::memory_order_acquire) - t;
+        if (count > available) {
+            count = available;
+        }
+        uint32_t first = copyRun(t, count);
+        for (uint32_t i = 0; i < first; i++) {
+            items[i] = buffer[(t & (N - 1)) + i];
+        }
+        for (uint32_t i = first; i < count; i++) {
+            items[i] = buffer[i - first];
+        }
+        tail.store(t + count, std::memory_order_release);
+        return count;
+    }
+
+    // Contiguous readable items starting at the oldest (zero-copy read)
+    uint32_t peek(const T** items) const {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t available = head.load(std::memory_order_acquire) - t;
+        *items = &buffer[t & (N - 1)];
+        return copyRun(t, available);
+    }
+
+    // Release count items read through peek()
+    void consume(uint32_t count) {
+        tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    // Drop everything (only while neither side is running)
+    void reset() {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    T buffer[N];
+    alignas(SPSC_RING_ALIGN) std::atomic<uint32_t> head;  // Written by producer
+    alignas(SPSC_RING_ALIGN) std::atomic<uint32_t> tail;  // Written by consumer
+
+    // Part of a run of count items from index that fits before the wrap point
+    static uint32_t copyRun(uint32_t index, uint32_t count) {
+        uint32_t toEnd = N - (index & (N - 1));
+        return count < toEnd ? count : toEnd;
+    }
+};
+
+#endif
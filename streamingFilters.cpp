@@ -0,0 +1,94 @@
+/*
+ * streamingFilters.cpp
+ *
+ * Implementation of stateful streaming filters.
+ * See streamingFilters.h for interface documentation.
+ */
+
+#include "streamingFilters.h"
+
+// ============================================================================
+// FILTER COEFFICIENTS
+// ============================================================================
+// Second-order IIR bandpass for heart rate frequencies (0.5-4 Hz).
+// Coefficients were designed using digital filter design tools for optimal
+// heart rate signal extraction from PPG (previously inlined in bandpassFilter()).
+
+const BiquadCoefficients PPG_BANDPASS_COEFFS = {
+    0.292893, 0, -0.292893,  // b0, b1, b2
+    -1.16574, 0.292893       // a1, a2
+};
+
+// ============================================================================
+// Constructors
+// ============================================================================
+
+Biquad::Biquad() : startup(BIQUAD_SEED_FROM_INPUT) {
+    // Default to a pass-through section (b0 = 1, all others 0)
+    coeffs.b0 = 1;
+    coeffs.b1 = 0;
+    coeffs.b2 = 0;
+    coeffs.a1 = 0;
+    coeffs.a2 = 0;
+    reset();
+}
+
+Biquad::Biquad(const BiquadCoefficients& coefficients, BiquadStartup startup)
+    : coeffs(coefficients), startup(startup) {
+    reset();
+}
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+void Biquad::setCoefficients(const BiquadCoefficients& coefficients) {
+    coeffs = coefficients;
+}
+
+void Biquad::reset() {
+    x1 = x2 = 0;
+    y1 = y2 = 0;
+    primed = 0;
+}
+
+// ============================================================================
+// Sample Processing
+// ============================================================================
+/*
+ * Direct Form I is used (rather than the transposed form) so that the
+ * arithmetic is evaluated in exactly the same order as the original batch
+ * bandpassFilter(), keeping the two paths bit-identical.
+ */
+float Biquad::process(float input) {
+    float output;
+
+    if (startup == BIQUAD_SEED_FROM_INPUT && primed < 2) {
+        // Insufficient history - pass input through to seed the filter state
+        output = input;
+        primed++;
+    } else {
+        output = coeffs.b0 * input + coeffs.b1 * x1 + coeffs.b2 * x2 -
+                 coeffs.a1 * y1 - coeffs.a2 * y2;
+    }
+
+    // Shift history
+    x2 = x1;
+    x1 = input;
+    y2 = y1;
+    y1 = output;
+
+    return output;
+}
+
+void Biquad::processBlock(const float* input, float* output, int size) {
+    for (int i = 0; i < size; i++) {
+        output[i] = process(input[i]);
+    }
+}
+
+void Biquad::processBlock(const long* input, float* output, int size) {
+    for (int i = 0; i < size; i++) {
+        output[i] = process((float)input[i]);
+    }
+}
@@ -0,0 +1,292 @@
+/*
+ * streamingFilters.h
+ *
+ * Stateful, sample-by-sample filters for PPG signal conditioning.
+ *
+ * OVERVIEW:
+ * The batch functions in processing.h need a complete recording in RAM
+ * before they can run. The filters in this file keep their own history,
+ * so samples can be filtered one at a time (or one block at a time) as
+ * they arrive from PPGManager::collectPPGData().
+ *
+ * KEY CLASSES:
+ * - Biquad: Single second-order IIR section (Direct Form I)
+ * - BiquadCascade: Chain of N second-order sections
+ * - MovingAverage: O(1) running-sum smoother (float)
+ * - MovingAverageInt: O(1) running-sum smoother (integer, drift-free)
+ *
+ * EQUIVALENCE WITH BATCH PROCESSING:
+ * A Biquad fed the same samples produces bit-identical output to
+ * bandpassFilter() in processing.cpp, which is implemented on top of it.
+ * This includes the start-up behaviour: by default the first two outputs
+ * are seeded from the raw input (see BiquadStartup).
+ *
+ * USAGE EXAMPLE:
+ *   Biquad bandpass(PPG_BANDPASS_COEFFS);
+ *   MovingAverage<6> smoother;
+ *   float y = smoother.process(bandpass.process(particleSensor.getGreen()));
+ *
+ */
+
+#ifndef STREAMING_FILTERS_H
+#define STREAMING_FILTERS_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// BIQUAD (SECOND-ORDER SECTION)
+// ============================================================================
+
+// Coefficients of one second-order section, normalised so that a0 = 1
+// Difference equation:
+//   y[n] = b0*x[n] + b1*x[n-1] + b2*x[n-2] - a1*y[n-1] - a2*y[n-2]
+struct BiquadCoefficients {
+    float b0, b1, b2;   // Numerator (feed-forward) coefficients
+    float a1, a2;       // Denominator (feedback) coefficients
+};
+
+// Bandpass section used by bandpassFilter() (heart rate band, 0.5-4 Hz)
+extern const BiquadCoefficients PPG_BANDPASS_COEFFS;
+
+// How a section behaves before it has two samples of history
+enum BiquadStartup {
+    BIQUAD_SEED_FROM_INPUT,  // First two outputs equal the input (matches bandpassFilter())
+    BIQUAD_ZERO_STATE        // History starts at zero (textbook IIR behaviour)
+};
+
+class Biquad {
+public:
+    Biquad();
+    explicit Biquad(const BiquadCoefficients& coefficients,
+                    BiquadStartup startup = BIQUAD_SEED_FROM_INPUT);
+
+    // Replace coefficients (history is kept, call reset() for a clean start)
+    void setCoefficients(const BiquadCoefficients& coefficients);
+
+    // Clear filter history - next sample is treated as the first one
+    void reset();
+
+    // Filter a single sample and return the output
+    float process(float input);
+
+    // Filter a block of samples (input and output may be the same buffer)
+    void processBlock(const float* input, float* output, int size);
+
+    // Filter a block of raw sensor readings
+    void processBlock(const long* input, float* output, int size);
+
+private:
+    BiquadCoefficients coeffs;
+    BiquadStartup startup;
+
+    // Direct Form I history
+    float x1, x2;    // Previous two inputs
+    float y1, y2;    // Previous two outputs
+    uint8_t primed;  // Samples seen so far (saturates at 2)
+};
+
+// ============================================================================
+// BIQUAD CASCADE
+// ============================================================================
+
+// Chain of N second-order sections, each feeding the next
+// Higher-order filters are built by cascading sections (e.g. 4th order = 2)
+template <int N>
+class BiquadCascade {
+public:
+    BiquadCascade() {}
+
+    // Configure section i (0 to N-1)
+    void setSection(int i, const BiquadCoefficients& coefficients,
+                    BiquadStartup startup = BIQUAD_SEED_FROM_INPUT) {
+        sections[i] = Biquad(coefficients, startup);
+    }
+
+    // Clear history of every section
+    void reset() {
+        for (int i = 0; i < N; i++) {
+            sections[i].reset();
+        }
+    }
+
+    // Filter a single sample through all sections
+    float process(float input) {
+        float value = input;
+        for (int i = 0; i < N; i++) {
+            value = sections[i].process(value);
+        }
+        return value;
+    }
+
+    // Filter a block of samples (input and output may be the same buffer)
+    void processBlock(const float* input, float* output, int size) {
+        for (int n = 0; n < size; n++) {
+            output[n] = process(input[n]);
+        }
+    }
+
+    // Filter a block of raw sensor readings
+    void processBlock(const long* input, float* output, int size) {
+        for (int n = 0; n < size; n++) {
+            output[n] = process((float)input[n]);
+        }
+    }
+
+private:
+    Biquad sections[N];
+};
+
+// ============================================================================
+// MOVING AVERAGE (FLOAT)
+// ============================================================================
+
+// Running-sum moving average over the last WINDOW samples
+// Cost is O(1) per sample regardless of window length. Until WINDOW samples
+// have been seen, the output is the mean of the samples received so far
+// (same start-up behaviour as movingAverageFilter()).
+//
+// To stop rounding error from accumulating in the running sum over long
+// recordings, the sum is recomputed from the ring once per window wrap
+// (amortised O(1)). Use MovingAverageInt for exact, drift-free smoothing.
+template <int WINDOW>
+class MovingAverage {
+public:
+    MovingAverage() { reset(); }
+
+    // Clear history - next sample is treated as the first one
+    void reset() {
+        sum = 0;
+        head = 0;
+        count = 0;
+    }
+
+    // Add a sample and return the current average
+    float process(float input) {
+        if (count < WINDOW) {
+            count++;
+        } else {
+            sum -= ring[head];
+        }
+        ring[head] = input;
+        sum += input;
+
+        if (++head == WINDOW) {
+            head = 0;
+            if (count == WINDOW) {
+                resum();
+            }
+        }
+
+        if (count == WINDOW) {
+            return sum * INV_WINDOW;
+        }
+        return sum / count;
+    }
+
+    // Smooth a block of samples (input and output may be the same buffer)
+    void processBlock(const float* input, float* output, int size) {
+        for (int i = 0; i < size; i++) {
+            output[i] = process(input[i]);
+        }
+    }
+
+    // Current average without adding a sample (0 if empty)
+    float value() const {
+        return count > 0 ? sum / count : 0;
+    }
+
+    // True once a full window of samples has been received
+    bool isFull() const { return count == WINDOW; }
+
+private:
+    static const float INV_WINDOW;
+
+    float ring[WINDOW];  // Last WINDOW samples
+    float sum;           // Running sum of ring contents
+    int head;            // Next write position
+    int count;           // Valid samples in ring (saturates at WINDOW)
+
+    // Recompute sum from scratch to discard accumulated rounding error
+    void resum() {
+        float fresh = 0;
+        for (int i = 0; i < WINDOW; i++) {
+            fresh += ring[i];
+        }
+        sum = fresh;
+    }
+};
+
+template <int WINDOW>
+const float MovingAverage<WINDOW>::INV_WINDOW = 1.0f / WINDOW;
+
+// ============================================================================
+// MOVING AVERAGE (INTEGER / FIXED-POINT)
+// ============================================================================
+
+// Running-sum moving average for integer or fixed-point samples
+// The running sum is held in a 64-bit accumulator, so adding and evicting
+// samples is exact and there is no drift however long the recording.
+// Output is rounded to nearest. Once the window is full the divisor is the
+// compile-time WINDOW, so a power-of-two WINDOW turns the steady-state
+// division into a shift; only the warm-up divides by the sample count. Works directly on raw MAX30105 readings (18-bit)
+// or on Q-format values from the fixed-point pipeline.
+template <int WINDOW, typename T = int32_t>
+class MovingAverageInt {
+public:
+    MovingAverageInt() { reset(); }
+
+    // Clear history - next sample is treated as the first one
+    void reset() {
+        sum = 0;
+        head = 0;
+        count = 0;
+    }
+
+    // Add a sample and return the current (rounded) average
+    T process(T input) {
+        if (count < WINDOW) {
+            count++;
+        } else {
+            sum -= ring[head];
+        }
+        ring[head] = input;
+        sum += input;
+
+        if (++head == WINDOW) {
+            head = 0;
+        }
+
+        if (count == WINDOW) {
+            return divideRounded(sum, WINDOW);
+        }
+        return divideRounded(sum, count);
+    }
+
+    // Smooth a block of samples (input and output may be the same buffer)
+    void processBlock(const T* input, T* output, int size) {
+        for (int i = 0; i < size; i++) {
+            output[i] = process(input[i]);
+        }
+    }
+
+    // Exact running sum of the samples currently in the window
+    int64_t windowSum() const { return sum; }
+
+    // True once a full window of samples has been received
+    bool isFull() const { return count == WINDOW; }
+
+private:
+    T ring[WINDOW];  // Last WINDOW samples
+    int64_t sum;     // Exact running sum of ring contents
+    int head;        // Next write position
+    int count;       // Valid samples in ring (saturates at WINDOW)
+
+    // Round-half-away-from-zero division
+    static T divideRounded(int64_t numerator, int denominator) {
+        int64_t half = denominator / 2;
+        return (T)(numerator >= 0 ? (numerator + half) / denominator
+                                  : (numerator - half) / denominator);
+    }
+};
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * wearDetector.cpp
+ *
+ * Implementation of proximity-mode wear detection.
+ * See wearDetector.h for interface documentation.
+ */
+
+#include "wearDetector.h"
+
+// INT_STATUS_1 / INT_ENABLE_1 proximity bit (MAX30105 datasheet)
+#define WEAR_INT_PROX 0x10
+
+WearDetector::WearDetector(MAX30105& sensor)
+    : sensor(sensor), threshold(0), pilotAmplitude(0), searchInterval(0), checkInterval(0),
+      confirmTime(0), pollInterval(WEAR_NO_POLL), state(STOPPED), worn(false), probeStart(0),
+      nextProbe(0), probes(0), contacts(0) {
+}
+
+void WearDetector::begin(uint8_t threshold, uint8_t pilotAmplitude, uint32_t searchInterval,
+                         uint32_t checkInterval, uint32_t confirmTime) {
+    this->threshold = threshold;
+    this->pilotAmplitude = pilotAmplitude;
+    this->searchInterval = searchInterval;
+    this->checkInterval = checkInterval;
+    this->confirmTime = confirmTime;
+}
+
+void WearDetector::start(uint32_t now) {
+    sensor.setPulseAmplitudeProximity(pilotAmplitude);
+    sensor.setProximityThreshold(threshold);
+    sensor.enablePROXINT();
+    probe(now);
+}
+
+void WearDetector::stop() {
+    // The next MODE_CONFIG write starts normal mode again
+    sensor.disablePROXINT();
+    state = STOPPED;
+}
+
+void WearDetector::probe(uint32_t now) {
+    // Release INT, then re-enter proximity mode (any MODE_CONFIG write does)
+    sensor.getINT1();
+    sensor.wakeUp();
+    state = PROBING;
+    probeStart = now;
+    probes++;
+}
+
+void WearDetector::rest(uint32_t now, uint32_t interval) {
+    sensor.shutDown();
+    state = WAITING;
+    nextProbe = now + interval;
+}
+
+WearEvent WearDetector::update(uint32_t now) {
+    if (state == WAITING && (int32_t)(now - nextProbe) >= 0) {
+        probe(now);
+        return WEAR_NO_CHANGE;
+    }
+    if (state != PROBING) {
+        return WEAR_NO_CHANGE;
+    }
+
+    if (sensor.getINT1() & WEAR_INT_PROX) {
+        // The sensor has switched to normal mode: main LEDs off until the next probe
+        contacts++;
+        rest(now, checkInterval);
+        if (!worn) {
+            worn = true;
+            return WEAR_ON;
+        }
+        return WEAR_NO_CHANGE;
+    }
+    if (searchingContinuously() || now - probeStart < confirmTime) {
+        return WEAR_NO_CHANGE;
+    }
+
+    // A whole probe without contact
+    bool wasWorn = worn;
+    worn = false;
+    if (searchingContinuously()) {
+        probeStart = now;   // Stay armed
+    } else {
+        rest(now, searchInterval);
+    }
+    return wasWorn ? WEAR_OFF : WEAR_NO_CHANGE;
+}
+
+uint32_t WearDetector::nextUpdate(uint32_t now) const {
+    switch (state) {
+        case WAITING:
+            return (int32_t)(nextProbe - now) > 0 ? nextProbe - now : 0;
+        case PROBING:
+            if (searchingContinuously()) {
+                return pollInterval;
+            } else {
+                uint32_t elapsed = now - probeStart;
+                uint32_t left = elapsed < confirmTime ? confirmTime - elapsed : 0;
+                return left < pollInterval ? left : pollInterval;
+            }
+        default:
+            return WEAR_NO_POLL;
+    }
+}
@@ -0,0 +1,137 @@
+/*
+ * wearDetector.h
+ *
+ * Background wear (skin contact) detection with the MAX30105 proximity
+ * mode.
+ *
+ * OVERVIEW:
+ * Averaging the green channel for a few seconds blocks the caller and runs
+ * the main LEDs at recording current for the whole check. The MAX30105
+ * can look for skin by itself: with PROX_INT_EN set, writing MODE_CONFIG
+ * starts it in proximity mode, where it pulses only the IR LED at the
+ * pilot current (PILOT_PA) and stores no samples. Once an IR reading
+ * exceeds PROX_INT_THRESH it raises PROX_INT (INT pin low) and switches to
+ * normal mode with the recording LED settings. WearDetector probes with
+ * it:
+ * 1. Probe: proximity mode is armed for at most the confirm time
+ * 2. PROX_INT during the probe: skin contact. The sensor is shut down at
+ *    once, so the main LEDs only run for the few samples before that
+ * 3. No PROX_INT by the end of the probe: no contact
+ * 4. Sensor shut down until the next probe: the search interval while not
+ *    worn, the (longer) check interval while worn
+ * A change between contact and no contact is returned by update() as
+ * WEAR_ON / WEAR_OFF. Nothing waits: update() reads INT_STATUS_1 at most
+ * once and returns; call it when INT falls and after nextUpdate() ms.
+ *
+ * CONTINUOUS SEARCH:
+ * With a search interval of 0 the sensor stays in proximity mode while
+ * not worn, so contact is seen within one sample period instead of within
+ * a search interval, at the cost of sampling (pilot LED and sensor supply)
+ * all the time. PROX_INT only reports contact being made, so removal is
+ * still found by probing every check interval.
+ *
+ * THRESHOLD:
+ * PROX_INT_THRESH holds the 8 MSBs of the 18-bit IR count (count >> 10).
+ * The counts seen on skin scale with the pilot current; set both together.
+ *
+ * WITHOUT THE INT PIN:
+ * update() still reads PROX_INT (it latches) at the end of each probe, so
+ * detection works, but the main LEDs run from contact until then, and a
+ * continuous search is polled every poll interval.
+ *
+ * SHARED SENSOR:
+ * The INT pin, INT_STATUS_1 and MODE_CONFIG are shared with recording
+ * (A_FULL, ppgFifo.h): stop() before powering the sensor up to record, and
+ * start() again afterwards (the wear state carries over, so a device still
+ * worn reports nothing). update() clears every INT_STATUS_1 bit.
+ *
+ * USAGE EXAMPLE:
+ *   WearDetector wear(particleSensor);   // After particleSensor.setup()
+ *   wear.begin(8, 0x0A, 5000, 30000, 200);
+ *   wear.start(millis());
+ *   on INT, and nextUpdate(millis()) ms after each call:
+ *     switch (wear.update(millis())) { case WEAR_ON: ...; case WEAR_OFF: ...; }
+ *   wear.stop();                          // Before recording
+ *
+ */
+
+#ifndef WEAR_DETECTOR_H
+#define WEAR_DETECTOR_H
+
+#include <Arduino.h>
+#include "MAX30105.h"
+
+#define WEAR_NO_POLL 0xFFFFFFFFu    // nextUpdate() / setPollInterval(): INT only
+
+enum WearEvent {
+    WEAR_NO_CHANGE,
+    WEAR_ON,                        // Skin contact found
+    WEAR_OFF                        // Contact lost
+};
+
+class WearDetector {
+public:
+    WearDetector(MAX30105& sensor);
+
+    // Detection settings (before start())
+    //   threshold: PROX_INT_THRESH (IR count >> 10)
+    //   pilotAmplitude: PILOT_PA (IR LED current in proximity mode)
+    //   searchInterval: ms between probes while not worn (0 = continuous)
+    //   checkInterval: ms between probes while worn
+    //   confirmTime: ms a probe waits for PROX_INT
+    void begin(uint8_t threshold, uint8_t pilotAmplitude, uint32_t searchInterval,
+               uint32_t checkInterval, uint32_t confirmTime);
+
+    // Continuous search without the INT pin: read INT_STATUS_1 every ms
+    // (default WEAR_NO_POLL: wait for the interrupt)
+    void setPollInterval(uint32_t ms) { pollInterval = ms; }
+
+    // Enable proximity mode and probe now
+    void start(uint32_t now);
+
+    // Disable proximity mode (the sensor's power state is left as it is)
+    void stop();
+
+    // Finish or begin a probe as due
+    // Returns: WEAR_ON / WEAR_OFF when the wear state changes
+    WearEvent update(uint32_t now);
+
+    // ms until update() is next due, or WEAR_NO_POLL if only INT can
+    // change anything
+    uint32_t nextUpdate(uint32_t now) const;
+
+    bool isRunning() const { return state != STOPPED; }
+    bool isWorn() const { return worn; }
+
+    // Counters since construction
+    uint32_t probeCount() const { return probes; }
+    uint32_t contactCount() const { return contacts; }
+
+private:
+    enum State {
+        STOPPED,
+        WAITING,                    // Shut down until nextProbe
+        PROBING                     // Proximity mode armed since probeStart
+    };
+
+    MAX30105& sensor;
+    uint8_t threshold;
+    uint8_t pilotAmplitude;
+    uint32_t searchInterval;
+    uint32_t checkInterval;
+    uint32_t confirmTime;
+    uint32_t pollInterval;
+
+    State state;
+    bool worn;
+    uint32_t probeStart;
+    uint32_t nextProbe;
+    uint32_t probes;
+    uint32_t contacts;
+
+    void probe(uint32_t now);
+    void rest(uint32_t now, uint32_t interval);
+    bool searchingContinuously() const { return !worn && searchInterval == 0; }
+};
+
+#endif
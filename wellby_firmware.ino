@@ -18,12 +18,17 @@
  * PIN CONFIGURATION:
  * - D7: User button input (active LOW with internal pullup) + wake-up pin
  * - I2C: MAX30105 sensor communication (SDA/SCL)
+ * - D2: MAX30105 INT, optional (FIFO almost-full and skin contact
+ *   interrupts, see PPGManager.h)
  * - LED_GREEN, LED_RED, LED_BLUE: Status indication LEDs
  * - See PowerManager.h for battery management pins
  * 
  * DEVICE OPERATION MODES:
- * 1. IDLE: Default state, green LED, sensor shutdown, ready for button input
- *    - Can enable periodic proximity checks or routine metrics collection
+ * 1. IDLE: Default state, green LED, sensor in wear detection (short
+ *    low-power proximity probes), ready for button input
+ *    - Being put on / taken off is posted as an event (EVENT_WORN /
+ *      EVENT_REMOVED), where autonomous recording or routine metrics
+ *      collection can start and stop
  * 2. BLE: Bluetooth enabled, blue LED, real-time PPG streaming to connected app
  *    - Activated by double-press from IDLE mode
  *    - Recording initiated from mobile app via BLE characteristic write
@@ -36,6 +41,11 @@
  * - Long press (>800ms): Enter sleep mode
  * - Button press from sleep: Wake device to IDLE mode
  * 
+ * MAIN LOOP:
+ * - Event driven (eventScheduler.h): button edges, sensor FIFO blocks and
+ *   BLE activity post events, timers cover the rest, and the core sleeps
+ *   in between instead of polling (see EVENTS AND TIMERS below)
+ * 
  * BLE SERVICES:
  * - Real-time PPG data streaming (200Hz sampling with averaging)
  * - Battery status monitoring
@@ -54,6 +64,7 @@
 #include "buttonManager.h"
 #include "BluetoothManager.h"
 #include "PowerManager.h"
+#include "eventScheduler.h"
 
 // ============================================================================
 // CONFIGURATION - Modify these values for your specific device
@@ -67,6 +78,17 @@
 #define BUTTON_PIN 7                // Physical button connected to D7 (active LOW)
 #define WAKEUP_PIN D7               // Same pin used for wake from sleep mode
 
+// Event-driven loop timing (see EVENTS AND TIMERS below)
+#define BUTTON_POLL_MS 10           // handleButton() period while a press pattern is in progress
+#define BATTERY_TICK_MS 60000       // Battery status refresh in BLE mode
+#define SLEEP_BLINK_MS 1000         // Red LED before entering SYSTEMOFF
+// Wear detection timing is in PPGManager.h (WEAR_*)
+#if PPG_FIFO_ACQUISITION
+#define BLE_SERVICE_MS 100          // BLE mode housekeeping: link policy, hold time, recording timeout
+#else
+#define BLE_SERVICE_MS 10           // Per-sample acquisition reads one sample per pass
+#endif
+
 // ============================================================================
 // SYSTEM INITIALIZATION
 // ============================================================================
@@ -86,10 +108,81 @@ enum SystemState {
 SystemState currentSystemState = IDLE;
 
 // Optional: Idle state sub-modes for autonomous monitoring
-// Uncomment and implement in loop() if desired
+// Uncomment and implement as timers below if desired
 // enum IdleState { CHECK, RECORD, REST };
 // IdleState currentIdleState = REST;
 
+// ============================================================================
+// EVENTS AND TIMERS
+// ============================================================================
+
+/*
+ * loop() only runs the scheduler: work happens in the handlers below when
+ * an event is posted or a timer is due, and in between the loop task
+ * blocks, so the core sleeps (see eventScheduler.h). Handlers must not block.
+ * 
+ * EVENTS (posted from interrupts and other tasks):
+ * - EVENT_BUTTON: button pin changed (GPIO interrupt)
+ * - EVENT_PPG_DATA: a sensor FIFO block is ready (PPGManager wake callback)
+ * - EVENT_BLE: connect, disconnect, recording control write or
+ *   notifications sent (BluetoothManager wake callback)
+ * - EVENT_WEAR: skin contact interrupt (PROX_INT), or wear detection
+ *   resumed after a recording (PPGManager wear callback)
+ * - EVENT_WORN / EVENT_REMOVED: posted by serviceWear() when the wear
+ *   state changes
+ * 
+ * TIMERS:
+ * - buttonTimer: re-runs handleButton() every BUTTON_POLL_MS while a press
+ *   pattern is in progress (double press window, lockout)
+ * - bleTimer: BLE mode housekeeping every BLE_SERVICE_MS
+ * - batteryTimer: battery status every BATTERY_TICK_MS in BLE mode
+ * - sleepTimer: ends the red blink before SYSTEMOFF
+ * - wearTimer: next wear detection probe or probe timeout (one-shot,
+ *   re-armed by serviceWear())
+ */
+
+enum LoopEvent {
+  EVENT_BUTTON,
+  EVENT_PPG_DATA,
+  EVENT_BLE,
+  EVENT_WEAR,
+  EVENT_WORN,
+  EVENT_REMOVED
+};
+
+EventScheduler scheduler;
+int buttonTimer;
+int bleTimer;
+int batteryTimer;
+int sleepTimer;
+int wearTimer;
+
+// Handlers, defined after setup()
+void serviceButton(void* context);
+void serviceBLE(void* context);
+void refreshBattery(void* context);
+void enterSleep(void* context);
+void serviceWear(void* context);
+void deviceWorn(void* context);
+void deviceRemoved(void* context);
+void endRecording();
+
+void onButtonEdge() {
+  scheduler.post(EVENT_BUTTON);
+}
+
+void onPPGData() {
+  scheduler.post(EVENT_PPG_DATA);
+}
+
+void onBLEActivity() {
+  scheduler.post(EVENT_BLE);
+}
+
+void onWearActivity() {
+  scheduler.post(EVENT_WEAR);
+}
+
 // ============================================================================
 // SETUP - Initialize all system components
 // ============================================================================
@@ -116,23 +209,52 @@ void setup() {
   ppgManager.setUpSensor();
   
   // Immediately shut down sensor to conserve power in IDLE state
-  // Sensor will be activated when recording is requested
+  // Sensor will be activated when recording is requested, and probes for
+  // skin contact in proximity mode meanwhile (wear detection, below)
   ppgManager.shutDownSensor();
   
   // Set initial LED state: Green = IDLE mode, ready for commands
   buttonManager.setLEDs(true, false, false);
   
+  // Wire the event sources: button edges (GPIO interrupt), FIFO blocks
+  // (deferred interrupt task) and BLE activity (BLE task) wake the loop
+  scheduler.onEvent(EVENT_BUTTON, serviceButton);
+  scheduler.onEvent(EVENT_PPG_DATA, serviceBLE);
+  scheduler.onEvent(EVENT_BLE, serviceBLE);
+  scheduler.onEvent(EVENT_WEAR, serviceWear);
+  scheduler.onEvent(EVENT_WORN, deviceWorn);
+  scheduler.onEvent(EVENT_REMOVED, deviceRemoved);
+  buttonTimer = scheduler.addTimer(serviceButton);
+  bleTimer = scheduler.addTimer(serviceBLE);
+  batteryTimer = scheduler.addTimer(refreshBattery);
+  sleepTimer = scheduler.addTimer(enterSleep);
+  wearTimer = scheduler.addTimer(serviceWear);
+  attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), onButtonEdge, CHANGE);
+  ppgManager.setWakeCallback(onPPGData);
+  bluetoothManager.setWakeCallback(onBLEActivity);
+  ppgManager.setWearCallback(onWearActivity);
+  
+  // Look for skin contact in the background (posts EVENT_WEAR to begin)
+  ppgManager.startWearDetection();
+  
   Serial.println("=== Initialization Complete ===");
   Serial.println("Device in IDLE mode (Green LED)");
   Serial.println("Double-press: Enable BLE | Long-press: Sleep mode");
 }
 
 // ============================================================================
-// MAIN LOOP - Process button inputs and manage system states
+// MAIN LOOP - Run event and timer handlers, sleep in between
 // ============================================================================
 
 void loop() {
-  // Continuously check for button press events
+  scheduler.runOnce();
+}
+
+// ============================================================================
+// BUTTON - Press patterns and system state transitions
+// ============================================================================
+
+void serviceButton(void* context) {
   // ButtonManager handles debouncing and press pattern detection
   buttonManager.handleButton();
 
@@ -142,10 +264,12 @@ void loop() {
   if (buttonManager.isLongPress()) {
     Serial.println("Long press detected - entering sleep mode");
     
-    // Visual feedback: Blink red LED before sleeping
+    // Visual feedback: Blink red LED before sleeping (enterSleep() ends it)
     buttonManager.setLEDs(false, true, false);
-    delay(1000);
-    buttonManager.setLEDs(false, false, false);
+    endRecording();
+    scheduler.stopTimer(bleTimer);
+    scheduler.stopTimer(batteryTimer);
+    scheduler.startTimer(sleepTimer, SLEEP_BLINK_MS);
     
     // Transition to sleep state
     currentSystemState = SLEEP;
@@ -170,6 +294,8 @@ void loop() {
       bluetoothManager.updateBatteryStatus(powerManager.getBatteryStatus());
       
       currentSystemState = BLE;
+      scheduler.startTimer(bleTimer, BLE_SERVICE_MS, BLE_SERVICE_MS);
+      scheduler.startTimer(batteryTimer, BATTERY_TICK_MS, BATTERY_TICK_MS);
       
     } 
     // If already in BLE mode, return to IDLE
@@ -179,50 +305,119 @@ void loop() {
       // Stop Bluetooth advertising and disconnect
       bluetoothManager.stopAdvertising();
       
+      // A recording ends with BLE mode
+      endRecording();
+      
       // Visual feedback: Green LED indicates IDLE
       buttonManager.setLEDs(true, false, false);
       
       currentSystemState = IDLE;
+      scheduler.stopTimer(bleTimer);
+      scheduler.stopTimer(batteryTimer);
     }
   }
 
-  // -------------------------------------------------------------------------
-  // STATE-SPECIFIC BEHAVIOR
-  // -------------------------------------------------------------------------
-  
-  if (currentSystemState == IDLE) {
-    // IDLE MODE: Device is on but conserving power
-    // 
-    // Potential additions for autonomous monitoring:
-    // - Periodic proximity checks using ppgManager.proximityCheck()
-    // - Scheduled metric collection and storage
-    // - Motion detection before recording
-    //
-    // Currently: Device waits for user input (button press)
-    
-  } 
-  else if (currentSystemState == BLE && bluetoothManager.isConnected()) {
-    // BLE MODE: Device connected to mobile app
-    // 
-    // Real-time PPG recording is managed by the mobile app:
-    // 1. App writes 0x01 to recording control characteristic → start recording
-    // 2. PPG data streams continuously to app via BLE notifications
-    // 3. App writes 0x00 to recording control characteristic → stop recording
-    //
-    // The realTimePPGRec() function handles this automatically
-    ppgManager.realTimePPGRec();
-    
-  } 
-  else if (currentSystemState == SLEEP) {
-    // SLEEP MODE: Ultra-low power consumption
-    // This function does not return until device wakes via button press
-    sleepMode();
+  // Timeouts decide the pattern from here on, not edges: keep polling
+  if (buttonManager.isBusy()) {
+    scheduler.startTimer(buttonTimer, BUTTON_POLL_MS);
+  }
+}
+
+// ============================================================================
+// BLE MODE - Connection policy and real-time PPG streaming
+// ============================================================================
+
+void serviceBLE(void* context) {
+  // IDLE MODE: Device is on but conserving power; nothing runs until a
+  // button or wear event. Potential additions for autonomous monitoring
+  // (as timers, see deviceWorn()):
+  // - Scheduled metric collection and storage
+  // - Motion detection before recording
+  if (currentSystemState != BLE) {
+    return;
   }
+  
+  // Keep the connection parameters matched to what the device is doing
+  bluetoothManager.update();
+  
+  // BLE MODE: Real-time PPG recording is managed by the mobile app:
+  // 1. App writes 0x01 to recording control characteristic → start recording
+  // 2. PPG data streams continuously to app via BLE notifications
+  // 3. App writes 0x00 to recording control characteristic → stop recording
+  //
+  // Acquisition, processing and transmission run in their own tasks
+  // (ppgTasks.h); realTimePPGRec() handles the 60 s timeout and wakes the
+  // BLE stage, which owns the raw PPG transmit queue, so it sends the next
+  // packets after notifications free BLE buffers (backpressure). It also
+  // runs while disconnected, so a stop on disconnect reaches every stage
+  // when the stages run here in loop (no tasks): then it runs for every
+  // FIFO block too
+  ppgManager.realTimePPGRec();
 
   // Note: Recording can also be initiated via button press if desired
-  // Add button press detection here and call ppgManager.startRealTimePPGRecording()
+  // Add button press detection in serviceButton() and call ppgManager.startRealTimePPGRecording()
+}
+
+// Leaving BLE mode: serviceBLE() no longer runs, so neither the 60 s
+// timeout nor the stop on disconnect would end a recording in progress
+void endRecording() {
+  if (!ppgManager.isRecording()) {
+    return;
+  }
+  ppgManager.stopRealTimePPGRecording();
+  
+  // Without stage tasks the stop is applied here; the stage tasks apply it
+  // themselves (and the BLE stage sends the last packet)
+  ppgManager.realTimePPGRec();
+}
+
+void refreshBattery(void* context) {
+  powerManager.readAndSaveBatteryStatus();
+  bluetoothManager.updateBatteryStatus(powerManager.getBatteryStatus());
 }
 
+// ============================================================================
+// WEAR DETECTION - Skin contact from the sensor's proximity mode
+// ============================================================================
+
+void serviceWear(void* context) {
+  // Finish or begin a probe; reads one sensor register at most
+  WearEvent event = ppgManager.updateWearDetection();
+  if (event == WEAR_ON) {
+    scheduler.post(EVENT_WORN);
+  } else if (event == WEAR_OFF) {
+    scheduler.post(EVENT_REMOVED);
+  }
+  
+  // Next probe or probe timeout; the interrupt covers the rest
+  uint32_t delayMs = ppgManager.getWearUpdateDelay();
+  if (delayMs == WEAR_NO_POLL) {
+    scheduler.stopTimer(wearTimer);
+  } else {
+    scheduler.startTimer(wearTimer, delayMs);
+  }
+}
+
+void deviceWorn(void* context) {
+  Serial.println("Device worn");
+  
+  // Autonomous IDLE-mode recording would start here (IdleState RECORD
+  // above), e.g. ppgManager.startRealTimePPGRecording() once stored
+  // recordings are supported
+}
+
+void deviceRemoved(void* context) {
+  Serial.println("Device removed");
+  
+  // ...and stop here: samples without skin contact are unusable
+}
+
+void enterSleep(void* context) {
+  buttonManager.setLEDs(false, false, false);
+  
+  // This function does not return until device wakes via button press
+  sleepMode();
+}
 
 // ============================================================================
 // SLEEP MODE - Ultra-low power consumption state
@@ -247,7 +442,8 @@ void sleepMode() {
   Serial.println("WARNING: Device will reset on wake. Press button to wake.");
   Serial.flush();  // Ensure message is transmitted before sleep
   
-  // Shut down PPG sensor to eliminate power draw
+  // Shut down PPG sensor to eliminate power draw (no more wear probes)
+  ppgManager.stopWearDetection();
   ppgManager.shutDownSensor();
   
   // Configure button pin for sense capabilities in SYSTEMOFF mode